@@ -0,0 +1,57 @@
+#ifndef CAPTURE_FORMAT_H
+#define CAPTURE_FORMAT_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace capture
+{
+	// On-disk layout of a capture segment. A segment starts with a
+	// SegmentHeader, followed by records packed at 8-byte alignment. Each
+	// record is a RecordHeader, then the payload, then zero padding. A
+	// record type of NONE (all zeros) or the end of the file ends the
+	// segment. All fields are host-endian.
+	enum class RecordType : std::uint16_t
+	{
+		NONE = 0,
+		RAW = 1,
+		EVENT = 2,
+	};
+
+	constexpr std::uint64_t SEGMENT_MAGIC = 0x31304d5041434648; // HFCAPM01
+	constexpr std::uint32_t FORMAT_VERSION = 1;
+	constexpr std::size_t RECORD_ALIGNMENT = 8;
+
+	class SegmentHeader
+	{
+	public:
+		std::uint64_t _magic;
+		std::uint32_t _version;
+		std::uint32_t _header_size;
+		std::uint64_t _index;
+		std::int64_t _created_ns;
+		std::uint64_t _reserved[4];
+	};
+	static_assert(sizeof(SegmentHeader) == 64);
+
+	class RecordHeader
+	{
+	public:
+		std::uint32_t _length;
+		RecordType _type;
+		std::uint16_t _flags;
+		std::uint64_t _session_id;
+		std::int64_t _timestamp_ns;
+	};
+	static_assert(sizeof(RecordHeader) == 24);
+
+	// Bytes a record with a payload of the given length takes up,
+	// including its header and padding.
+	constexpr std::size_t record_size(std::size_t length)
+	{
+		return (sizeof(RecordHeader) + length + RECORD_ALIGNMENT - 1) &
+		       ~(RECORD_ALIGNMENT - 1);
+	}
+} // namespace capture
+
+#endif // CAPTURE_FORMAT_H
@@ -0,0 +1,218 @@
+#ifndef CAPTURE_READER_H
+#define CAPTURE_READER_H
+
+#include <algorithm>
+#include <atomic>
+#include <capture/Format.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <span>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace capture
+{
+	// Sequential reader over one or more capture segments. Each segment
+	// is mapped read-only with sequential read-ahead, and records are
+	// handed out as spans into the mapping. Nothing is copied, so a scan
+	// runs at page-cache bandwidth. Spans stay valid until the reader
+	// moves on to the next segment.
+	class Reader
+	{
+	public:
+		class Record
+		{
+		public:
+			RecordType _type;
+			std::uint64_t _session_id;
+			std::int64_t _timestamp_ns;
+			std::span<const char> _payload;
+			Record()
+			    : _type(RecordType::NONE)
+			    , _session_id(0)
+			    , _timestamp_ns(0)
+			    , _payload()
+			{
+			}
+		};
+
+	public:
+		Reader()
+		    : _paths()
+		    , _next_path(0)
+		    , _base(nullptr)
+		    , _size(0)
+		    , _offset(0)
+		    , _segment_index(0)
+		{
+		}
+
+		Reader(const Reader &) = delete;
+
+		Reader &operator=(const Reader &) = delete;
+
+		~Reader() { close(); }
+
+		// Read a single segment file.
+		bool open(const std::string &path)
+		{
+			return open(std::vector<std::string>{path});
+		}
+
+		// Read the given segments one after another.
+		bool open(std::vector<std::string> paths)
+		{
+			close();
+			_paths = std::move(paths);
+			_next_path = 0;
+			return do_next_segment();
+		}
+
+		// Read every <prefix>.<index>.cap segment in a directory, in index
+		// order.
+		bool open_directory(const std::string &directory,
+		                    const std::string &prefix = "capture")
+		{
+			return open(list_segments(directory, prefix));
+		}
+
+		void close()
+		{
+			do_unmap();
+			_paths.clear();
+			_next_path = 0;
+		}
+
+		bool is_open() const { return _base != nullptr; }
+
+		// Index of the segment currently being read.
+		std::uint64_t segment_index() const { return _segment_index; }
+
+		bool next(Record &record)
+		{
+			while (_base)
+			{
+				if (_offset + sizeof(RecordHeader) <= _size)
+				{
+					auto *data = _base + _offset;
+					auto *header = reinterpret_cast<const RecordHeader *>(data);
+					auto &field = const_cast<RecordType &>(header->_type);
+					auto type = std::atomic_ref<RecordType>(field).load(
+					    std::memory_order_acquire);
+					auto size = record_size(header->_length);
+					if (type != RecordType::NONE && _offset + size <= _size)
+					{
+						record._type = type;
+						record._session_id = header->_session_id;
+						record._timestamp_ns = header->_timestamp_ns;
+						record._payload = std::span<const char>(
+						    data + sizeof(RecordHeader), header->_length);
+						_offset += size;
+						return true;
+					}
+				}
+				if (!do_next_segment())
+					return false;
+			}
+			return false;
+		}
+
+		static std::vector<std::string> list_segments(
+		    const std::string &directory,
+		    const std::string &prefix = "capture")
+		{
+			std::vector<std::string> names;
+			DIR *dir = ::opendir(directory.c_str());
+			if (!dir)
+				return names;
+			auto head = prefix + ".";
+			const std::string tail = ".cap";
+			while (auto *entry = ::readdir(dir))
+			{
+				std::string name = entry->d_name;
+				if (name.size() > head.size() + tail.size() &&
+				    name.starts_with(head) && name.ends_with(tail))
+					names.push_back(std::move(name));
+			}
+			::closedir(dir);
+			// Indices are zero-padded, so name order is index order.
+			std::sort(names.begin(), names.end());
+			for (auto &name : names)
+				name = directory + "/" + name;
+			return names;
+		}
+
+	private:
+		std::vector<std::string> _paths;
+		std::size_t _next_path;
+		const char *_base;
+		std::size_t _size;
+		std::size_t _offset;
+		std::uint64_t _segment_index;
+
+		void do_unmap()
+		{
+			if (_base)
+				::munmap(const_cast<char *>(_base), _size);
+			_base = nullptr;
+			_size = 0;
+			_offset = 0;
+		}
+
+		// Map the next readable segment. Files that are empty or are not
+		// capture segments are skipped.
+		bool do_next_segment()
+		{
+			do_unmap();
+			while (_next_path < _paths.size())
+			{
+				if (do_map(_paths[_next_path++]))
+					return true;
+			}
+			return false;
+		}
+
+		bool do_map(const std::string &path)
+		{
+			int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+			if (fd < 0)
+				return false;
+			struct stat info;
+			if (::fstat(fd, &info) != 0 ||
+			    static_cast<std::size_t>(info.st_size) < sizeof(SegmentHeader))
+			{
+				::close(fd);
+				return false;
+			}
+			auto size = static_cast<std::size_t>(info.st_size);
+			void *base = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+			::close(fd);
+			if (base == MAP_FAILED)
+				return false;
+			::madvise(base, size, MADV_SEQUENTIAL);
+			::madvise(base, size, MADV_WILLNEED);
+			auto *header = static_cast<const SegmentHeader *>(base);
+			if (header->_magic != SEGMENT_MAGIC ||
+			    header->_version != FORMAT_VERSION ||
+			    header->_header_size < sizeof(SegmentHeader) ||
+			    header->_header_size > size)
+			{
+				::munmap(base, size);
+				return false;
+			}
+			_base = static_cast<const char *>(base);
+			_size = size;
+			_offset = header->_header_size;
+			_segment_index = header->_index;
+			return true;
+		}
+	};
+} // namespace capture
+
+#endif // CAPTURE_READER_H
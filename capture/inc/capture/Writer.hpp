@@ -0,0 +1,368 @@
+#ifndef CAPTURE_WRITER_H
+#define CAPTURE_WRITER_H
+
+#include <algorithm>
+#include <atomic>
+#include <capture/Format.hpp>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <span>
+#include <string>
+#include <sys/mman.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace capture
+{
+	// Append-only capture writer. write() runs on the I/O thread and does
+	// nothing but a memcpy into a mapped segment. A background thread
+	// creates and pre-faults the next segments, and unmaps, truncates and
+	// closes the full ones. Segments are passed between the two threads
+	// through single-producer/single-consumer rings, so neither side
+	// takes a lock or waits on the other.
+	//
+	// If the background thread falls behind and no segment is ready when
+	// one fills up, records are dropped and counted rather than blocking
+	// the caller. Segments are named <directory>/<prefix>.<index>.cap.
+	//
+	// Typical use is to forward TcpTlsSession's on_data spans:
+	//   writer.write(session_id, receive_ns, data);
+	class Writer
+	{
+	public:
+		static constexpr std::size_t DEFAULT_SEGMENT_SIZE = 256 << 20;
+
+	public:
+		Writer(std::string directory,
+		       std::string prefix = "capture",
+		       std::size_t segment_size = DEFAULT_SEGMENT_SIZE,
+		       std::size_t ready_segments = 2)
+		    : _directory(std::move(directory))
+		    , _prefix(std::move(prefix))
+		    , _segment_size(page_align(segment_size))
+		    , _ready(std::max<std::size_t>(ready_segments, 1) + 1)
+		    , _retired(RETIRE_CAPACITY)
+		    , _current()
+		    , _next_index(0)
+		    , _running(false)
+		    , _error(0)
+		    , _thread()
+		    , _records(0)
+		    , _bytes(0)
+		    , _dropped(0)
+		    , _segments(0)
+		{
+		}
+
+		Writer(const Writer &) = delete;
+
+		Writer &operator=(const Writer &) = delete;
+
+		~Writer() { close(); }
+
+		// Create the first segment and start the background thread.
+		// next_index is the index given to the first segment.
+		bool open(std::uint64_t next_index = 0)
+		{
+			if (_running.load(std::memory_order_acquire))
+				return false;
+			_next_index = next_index;
+			_error.store(0, std::memory_order_relaxed);
+			segment first;
+			if (!do_create(first))
+				return false;
+			_current = first;
+			++_segments;
+			_running.store(true, std::memory_order_release);
+			_thread = std::thread([this]() { do_run(); });
+			return true;
+		}
+
+		// Retire the current segment, stop the background thread and
+		// remove segments that were prepared but never written.
+		void close()
+		{
+			if (!_running.load(std::memory_order_acquire))
+				return;
+			if (_current._base && !_retired.push(_current))
+				do_retire(_current);
+			_current = segment();
+			_running.store(false, std::memory_order_release);
+			_thread.join();
+		}
+
+		bool is_open() const
+		{
+			return _running.load(std::memory_order_acquire);
+		}
+
+		// Append one record. Only call from a single thread.
+		bool write(std::uint64_t session_id,
+		           std::int64_t timestamp_ns,
+		           const std::span<const char> &payload,
+		           RecordType type = RecordType::RAW)
+		{
+			if (payload.size() > UINT32_MAX)
+			{
+				++_dropped;
+				return false;
+			}
+			auto size = record_size(payload.size());
+			if (!_current._base || _current._used + size > _current._size)
+			{
+				if (!do_rotate(size))
+				{
+					++_dropped;
+					return false;
+				}
+			}
+			auto *record = _current._base + _current._used;
+			auto *header = reinterpret_cast<RecordHeader *>(record);
+			header->_length = static_cast<std::uint32_t>(payload.size());
+			header->_flags = 0;
+			header->_session_id = session_id;
+			header->_timestamp_ns = timestamp_ns;
+			std::memcpy(record + sizeof(RecordHeader), payload.data(),
+			            payload.size());
+			// The type goes in last so a reader tailing the live segment
+			// never sees a partially written record.
+			std::atomic_ref<RecordType>(header->_type)
+			    .store(type, std::memory_order_release);
+			_current._used += size;
+			++_records;
+			_bytes += payload.size();
+			return true;
+		}
+
+		// Counters are maintained by the writing thread and are only
+		// exact when read from it.
+		std::uint64_t records() const { return _records; }
+
+		std::uint64_t bytes() const { return _bytes; }
+
+		std::uint64_t dropped() const { return _dropped; }
+
+		// Segments written to so far, including the current one.
+		std::uint64_t segments() const { return _segments; }
+
+		// errno of the last failure in the background thread, or 0.
+		int last_error() const
+		{
+			return _error.load(std::memory_order_relaxed);
+		}
+
+		std::string segment_path(std::uint64_t index) const
+		{
+			char name[32];
+			std::snprintf(name, sizeof(name), ".%08llu.cap",
+			              static_cast<unsigned long long>(index));
+			return _directory + "/" + _prefix + name;
+		}
+
+	private:
+		static constexpr std::size_t RETIRE_CAPACITY = 16;
+		static constexpr auto SERVICE_INTERVAL = std::chrono::milliseconds(1);
+
+		class segment
+		{
+		public:
+			int _fd;
+			char *_base;
+			std::size_t _size;
+			std::size_t _used;
+			std::uint64_t _index;
+			segment()
+			    : _fd(-1)
+			    , _base(nullptr)
+			    , _size(0)
+			    , _used(0)
+			    , _index(0)
+			{
+			}
+		};
+
+		class segment_ring
+		{
+		public:
+			segment_ring(std::size_t capacity)
+			    : _slots(capacity)
+			    , _head(0)
+			    , _tail(0)
+			{
+			}
+
+			bool push(const segment &value)
+			{
+				auto tail = _tail.load(std::memory_order_relaxed);
+				auto next = (tail + 1) % _slots.size();
+				if (next == _head.load(std::memory_order_acquire))
+					return false;
+				_slots[tail] = value;
+				_tail.store(next, std::memory_order_release);
+				return true;
+			}
+
+			bool pop(segment &value)
+			{
+				auto head = _head.load(std::memory_order_relaxed);
+				if (head == _tail.load(std::memory_order_acquire))
+					return false;
+				value = _slots[head];
+				_head.store((head + 1) % _slots.size(),
+				            std::memory_order_release);
+				return true;
+			}
+
+			bool full() const
+			{
+				auto tail = _tail.load(std::memory_order_relaxed);
+				return (tail + 1) % _slots.size() ==
+				       _head.load(std::memory_order_acquire);
+			}
+
+		private:
+			std::vector<segment> _slots;
+			alignas(64) std::atomic<std::size_t> _head;
+			alignas(64) std::atomic<std::size_t> _tail;
+		};
+
+		std::string _directory;
+		std::string _prefix;
+		std::size_t _segment_size;
+		// Background thread to writer: mapped, pre-faulted segments.
+		segment_ring _ready;
+		// Writer to background thread: full segments to close.
+		segment_ring _retired;
+		segment _current;
+		std::uint64_t _next_index;
+		std::atomic<bool> _running;
+		std::atomic<int> _error;
+		std::thread _thread;
+		std::uint64_t _records;
+		std::uint64_t _bytes;
+		std::uint64_t _dropped;
+		std::uint64_t _segments;
+
+		static std::size_t page_size()
+		{
+			return static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+		}
+
+		static std::size_t page_align(std::size_t size)
+		{
+			auto page = page_size();
+			return std::max((size + page - 1) / page * page, page);
+		}
+
+		bool do_rotate(std::size_t size)
+		{
+			if (sizeof(SegmentHeader) + size > _segment_size)
+				return false;
+			segment next;
+			if (!_ready.pop(next))
+				return false;
+			// The retire ring only fills if the background thread has
+			// stalled for many segments; close this one here instead.
+			if (_current._base && !_retired.push(_current))
+				do_retire(_current);
+			_current = next;
+			++_segments;
+			return true;
+		}
+
+		bool do_create(segment &created)
+		{
+			auto path = segment_path(_next_index);
+			int fd = ::open(path.c_str(),
+			                O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+			if (fd < 0)
+			{
+				_error.store(errno, std::memory_order_relaxed);
+				return false;
+			}
+			if (::ftruncate(fd, static_cast<off_t>(_segment_size)) != 0)
+			{
+				_error.store(errno, std::memory_order_relaxed);
+				::close(fd);
+				::unlink(path.c_str());
+				return false;
+			}
+			void *base = ::mmap(nullptr, _segment_size, PROT_READ | PROT_WRITE,
+			                    MAP_SHARED | MAP_POPULATE, fd, 0);
+			if (base == MAP_FAILED)
+			{
+				_error.store(errno, std::memory_order_relaxed);
+				::close(fd);
+				::unlink(path.c_str());
+				return false;
+			}
+			created._fd = fd;
+			created._base = static_cast<char *>(base);
+			created._size = _segment_size;
+			created._index = _next_index++;
+			// MAP_POPULATE only maps the pages for reading; touch each one
+			// so the first store on the I/O thread does not take a fault.
+			auto page = page_size();
+			for (std::size_t offset = 0; offset < _segment_size; offset += page)
+				reinterpret_cast<volatile char *>(created._base)[offset] = 0;
+			auto *header = reinterpret_cast<SegmentHeader *>(created._base);
+			header->_magic = SEGMENT_MAGIC;
+			header->_version = FORMAT_VERSION;
+			header->_header_size = sizeof(SegmentHeader);
+			header->_index = created._index;
+			header->_created_ns =
+			    std::chrono::duration_cast<std::chrono::nanoseconds>(
+			        std::chrono::system_clock::now().time_since_epoch())
+			        .count();
+			created._used = sizeof(SegmentHeader);
+			return true;
+		}
+
+		void do_retire(segment &retired)
+		{
+			::munmap(retired._base, retired._size);
+			if (::ftruncate(retired._fd, static_cast<off_t>(retired._used)) !=
+			    0)
+				_error.store(errno, std::memory_order_relaxed);
+			::close(retired._fd);
+			retired = segment();
+		}
+
+		void do_discard(segment &unused)
+		{
+			::munmap(unused._base, unused._size);
+			::close(unused._fd);
+			::unlink(segment_path(unused._index).c_str());
+			unused = segment();
+		}
+
+		void do_run()
+		{
+			segment value;
+			while (_running.load(std::memory_order_acquire))
+			{
+				while (_retired.pop(value))
+					do_retire(value);
+				while (!_ready.full())
+				{
+					if (!do_create(value))
+						break;
+					_ready.push(value);
+				}
+				std::this_thread::sleep_for(SERVICE_INTERVAL);
+			}
+			while (_retired.pop(value))
+				do_retire(value);
+			while (_ready.pop(value))
+				do_discard(value);
+		}
+	};
+} // namespace capture
+
+#endif // CAPTURE_WRITER_H
@@ -157,9 +157,10 @@ endif
 
 ifeq ($(CONFIG),release)
 PROJECT_TARGET_PATH:=$(PROJECT_HOME)_build/$(PROJECT_NAME)_release
-BASE_COMPILE_FLAG+:= -O3
+BASE_COMPILE_FLAG:= -O3
 else
 PROJECT_TARGET_PATH:=$(PROJECT_HOME)_build/$(PROJECT_NAME)_debug
+BASE_COMPILE_FLAG:=
 endif
 PROJECT_BIN=$(PROJECT_TARGET_PATH)/$(BIN_DIR)
 PROJECT_LIB=$(PROJECT_TARGET_PATH)/$(LIB_DIR)
@@ -226,7 +227,7 @@ else
 TARGET_DEP_FOLDER:=$(TARGET_FOLDER)
 endif
 
-BASE_COMPILE_FLAG:= $(MACROS) -c -fPIC -Werror -Wfatal-errors -Wformat=2 -Winit-self -Wswitch-default -Wall -Wextra -g -std=$(STD)
+BASE_COMPILE_FLAG+= $(MACROS) -c -fPIC -Werror -Wfatal-errors -Wformat=2 -Winit-self -Wswitch-default -Wall -Wextra -g -std=$(STD)
 C_FLAGS+=$(BASE_COMPILE_FLAG)
 CPP_FLAGS+=$(BASE_COMPILE_FLAG)
 EXE_FLAGS+=
@@ -1,19 +1,38 @@
 #ifndef OPENSSL_INITIALIZER_H
 #define OPENSSL_INITIALIZER_H
 
+#include <encrypt/OpenSSLMemoryPool.hpp>
 #include <openssl/err.h>
 #include <openssl/evp.h>
 #include <openssl/ssl.h>
+#include <stdexcept>
 namespace encrypt
 {
 	class OpenSSLInitializer
 	{
 	public:
-		OpenSSLInitializer()
+		enum class Allocator : unsigned int
+		{
+			SYSTEM = 0,
+			MEMORY_POOL = 1
+		};
+
+	public:
+		// The first initializer constructed decides the allocator. To use
+		// OpenSSLMemoryPool construct one with MEMORY_POOL at the top of
+		// main, before any session or other OpenSSL user exists; throws
+		// std::runtime_error when OpenSSL already allocated and keeps its
+		// own allocator.
+		OpenSSLInitializer(Allocator allocator = Allocator::SYSTEM)
 		{
 			static bool initialized = false;
 			if (!initialized)
 			{
+				if (allocator == Allocator::MEMORY_POOL &&
+				    !OpenSSLMemoryPool::install())
+					throw std::runtime_error(
+					    "OpenSSLMemoryPool installed after the first OpenSSL "
+					    "allocation");
 				SSL_library_init();
 				OpenSSL_add_all_algorithms();
 				SSL_load_error_strings();
@@ -0,0 +1,437 @@
+#ifndef ENCRYPT_OPENSSL_MEMORY_POOL_H
+#define ENCRYPT_OPENSSL_MEMORY_POOL_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <openssl/crypto.h>
+#include <vector>
+
+namespace encrypt
+{
+	// Size-class pool behind CRYPTO_set_mem_functions. Requests up to
+	// MAX_BLOCK_SIZE are served from per-thread free lists refilled in
+	// chunks, so SSL_read/SSL_write and the handshake stop hitting the
+	// global allocator once warm. Every allocation is also counted against
+	// the OpenSSL call site (file/line) that made it.
+	//
+	// Counters are per thread, so the allocation path never writes a
+	// line another thread writes; counters() and call_sites() sum them.
+	// Blocks are never returned to the system; a block freed on another
+	// thread joins that thread's free list.
+	class OpenSSLMemoryPool
+	{
+	public:
+		static constexpr std::size_t MIN_BLOCK_SIZE = 16;
+		static constexpr std::size_t MAX_BLOCK_SIZE = 64 * 1024;
+		static constexpr std::size_t SIZE_CLASS_COUNT =
+		    std::bit_width(MAX_BLOCK_SIZE / MIN_BLOCK_SIZE);
+		static constexpr std::size_t MAX_CALL_SITES = 1024;
+		static constexpr std::size_t CHUNK_SIZE = 256 * 1024;
+
+		class CallSite
+		{
+		public:
+			const char *_file;
+			int _line;
+			std::uint64_t _allocations;
+			std::uint64_t _reallocations;
+			std::uint64_t _bytes;
+			CallSite()
+			    : _file(nullptr)
+			    , _line(0)
+			    , _allocations(0)
+			    , _reallocations(0)
+			    , _bytes(0)
+			{
+			}
+		};
+
+		class Counters
+		{
+		public:
+			std::uint64_t _allocations;
+			std::uint64_t _reallocations;
+			std::uint64_t _frees;
+			std::uint64_t _pooled;
+			std::uint64_t _fallback;
+			std::uint64_t _chunks;
+			Counters()
+			    : _allocations(0)
+			    , _reallocations(0)
+			    , _frees(0)
+			    , _pooled(0)
+			    , _fallback(0)
+			    , _chunks(0)
+			{
+			}
+		};
+
+	public:
+		// Route every OpenSSL allocation through the pool. OpenSSL refuses
+		// once it has allocated anything, so this has to run before the
+		// first OpenSSL call of the process.
+		static bool install()
+		{
+			return CRYPTO_set_mem_functions(&do_malloc, &do_realloc,
+			                                &do_free) == 1;
+		}
+
+		// Pre-fault blocks_per_class blocks of every size class for the
+		// calling thread, so the first handshake does not refill chunks.
+		static void prewarm(std::size_t blocks_per_class)
+		{
+			for (std::size_t i = 0; i < SIZE_CLASS_COUNT; ++i)
+			{
+				std::vector<void *> blocks(blocks_per_class);
+				for (auto &block : blocks)
+				{
+					block = allocate(i);
+					if (block)
+						std::memset(block, 0, class_size(i));
+				}
+				for (auto block : blocks)
+					if (block)
+						release(block);
+			}
+		}
+
+		static Counters counters()
+		{
+			Counters out;
+			for (auto node = first_thread(); node; node = node->_next)
+			{
+				auto &c = node->_totals;
+				out._allocations += load(c._allocations);
+				out._reallocations += load(c._reallocations);
+				out._frees += load(c._frees);
+				out._pooled += load(c._pooled);
+				out._fallback += load(c._fallback);
+				out._chunks += load(c._chunks);
+			}
+			return out;
+		}
+
+		// Snapshot of the per call site counters, busiest first.
+		static std::vector<CallSite> call_sites()
+		{
+			std::vector<CallSite> out;
+			auto &table = call_site_table();
+			for (std::size_t i = 0; i < MAX_CALL_SITES; ++i)
+			{
+				auto &slot = table[i];
+				if (slot._key.load(std::memory_order_acquire) == 0)
+					continue;
+				CallSite site;
+				site._file = slot._file.load(std::memory_order_relaxed);
+				site._line = slot._line.load(std::memory_order_relaxed);
+				for (auto node = first_thread(); node; node = node->_next)
+				{
+					auto &counts = node->_sites[i];
+					site._allocations += load(counts._allocations);
+					site._reallocations += load(counts._reallocations);
+					site._bytes += load(counts._bytes);
+				}
+				out.push_back(site);
+			}
+			std::sort(out.begin(), out.end(),
+			          [](const CallSite &a, const CallSite &b)
+			          { return a._allocations > b._allocations; });
+			return out;
+		}
+
+	private:
+		// 16 bytes so the payload keeps malloc's alignment.
+		class block_header
+		{
+		public:
+			std::size_t _size_class;
+			std::size_t _size;
+		};
+
+		class free_block
+		{
+		public:
+			free_block *_next;
+		};
+
+		class thread_cache
+		{
+		public:
+			std::array<free_block *, SIZE_CLASS_COUNT> _free;
+		};
+
+		class counters_node
+		{
+		public:
+			std::atomic<std::uint64_t> _allocations;
+			std::atomic<std::uint64_t> _reallocations;
+			std::atomic<std::uint64_t> _frees;
+			std::atomic<std::uint64_t> _pooled;
+			std::atomic<std::uint64_t> _fallback;
+			std::atomic<std::uint64_t> _chunks;
+		};
+
+		class call_site_node
+		{
+		public:
+			std::atomic<std::uint64_t> _key;
+			std::atomic<const char *> _file;
+			std::atomic<int> _line;
+		};
+
+		class call_site_counts
+		{
+		public:
+			std::atomic<std::uint64_t> _allocations;
+			std::atomic<std::uint64_t> _reallocations;
+			std::atomic<std::uint64_t> _bytes;
+		};
+
+		// Written by its thread only, with a relaxed load and store. Nodes
+		// are never freed, the counts of a thread outlive it.
+		class alignas(64) thread_counters
+		{
+		public:
+			counters_node _totals;
+			std::array<call_site_counts, MAX_CALL_SITES> _sites;
+			thread_counters *_next;
+			thread_counters() : _totals(), _sites(), _next(nullptr) {}
+		};
+
+		static constexpr std::size_t LARGE_CLASS = SIZE_CLASS_COUNT;
+
+		static thread_cache &local_cache()
+		{
+			// Trivially destructible, no TLS destructor registration on the
+			// allocation path.
+			thread_local thread_cache cache = {};
+			return cache;
+		}
+
+		static std::atomic<thread_counters *> &thread_list()
+		{
+			static std::atomic<thread_counters *> head(nullptr);
+			return head;
+		}
+
+		static thread_counters *first_thread()
+		{
+			return thread_list().load(std::memory_order_acquire);
+		}
+
+		static thread_counters &local_counters()
+		{
+			thread_local thread_counters *counters = nullptr;
+			if (!counters)
+				counters = register_thread();
+			return *counters;
+		}
+
+		// Plain operator new, not OpenSSL's allocator, so this never
+		// recurses. Without memory the thread shares a spare node whose
+		// counts may then lose updates.
+		static thread_counters *register_thread()
+		{
+			auto node = new (std::nothrow) thread_counters();
+			if (!node)
+			{
+				static thread_counters spare;
+				return &spare;
+			}
+			auto &head = thread_list();
+			node->_next = head.load(std::memory_order_relaxed);
+			while (!head.compare_exchange_weak(node->_next, node,
+			                                   std::memory_order_release,
+			                                   std::memory_order_relaxed))
+				;
+			return node;
+		}
+
+		static void bump(std::atomic<std::uint64_t> &counter,
+		                 std::uint64_t delta = 1)
+		{
+			counter.store(counter.load(std::memory_order_relaxed) + delta,
+			              std::memory_order_relaxed);
+		}
+
+		static std::uint64_t load(const std::atomic<std::uint64_t> &counter)
+		{
+			return counter.load(std::memory_order_relaxed);
+		}
+
+		static std::array<call_site_node, MAX_CALL_SITES> &call_site_table()
+		{
+			static std::array<call_site_node, MAX_CALL_SITES> table = {};
+			return table;
+		}
+
+		static constexpr std::size_t class_size(std::size_t size_class)
+		{
+			return MIN_BLOCK_SIZE << size_class;
+		}
+
+		static std::size_t size_class_of(std::size_t size)
+		{
+			if (size <= MIN_BLOCK_SIZE)
+				return 0;
+			if (size > MAX_BLOCK_SIZE)
+				return LARGE_CLASS;
+			return std::bit_width((size - 1) / MIN_BLOCK_SIZE);
+		}
+
+		static void refill(thread_cache &cache, std::size_t size_class)
+		{
+			auto block_size = sizeof(block_header) + class_size(size_class);
+			auto count = std::max<std::size_t>(1, CHUNK_SIZE / block_size);
+			auto chunk = static_cast<char *>(std::malloc(count * block_size));
+			if (!chunk)
+				return;
+			bump(local_counters()._totals._chunks);
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				auto header = reinterpret_cast<block_header *>(
+				    chunk + i * block_size);
+				header->_size_class = size_class;
+				auto block = reinterpret_cast<free_block *>(header + 1);
+				block->_next = cache._free[size_class];
+				cache._free[size_class] = block;
+			}
+		}
+
+		static void *allocate(std::size_t size_class)
+		{
+			auto &cache = local_cache();
+			if (!cache._free[size_class])
+				refill(cache, size_class);
+			auto block = cache._free[size_class];
+			if (!block)
+				return nullptr;
+			cache._free[size_class] = block->_next;
+			return block;
+		}
+
+		static void release(void *ptr)
+		{
+			auto header = static_cast<block_header *>(ptr) - 1;
+			if (header->_size_class == LARGE_CLASS)
+			{
+				std::free(header);
+				return;
+			}
+			auto &cache = local_cache();
+			auto block = static_cast<free_block *>(ptr);
+			block->_next = cache._free[header->_size_class];
+			cache._free[header->_size_class] = block;
+		}
+
+		static void *allocate_sized(std::size_t size)
+		{
+			auto size_class = size_class_of(size);
+			auto &totals = local_counters()._totals;
+			if (size_class == LARGE_CLASS)
+			{
+				bump(totals._fallback);
+				auto header = static_cast<block_header *>(
+				    std::malloc(sizeof(block_header) + size));
+				if (!header)
+					return nullptr;
+				header->_size_class = LARGE_CLASS;
+				header->_size = size;
+				return header + 1;
+			}
+			bump(totals._pooled);
+			auto ptr = allocate(size_class);
+			if (ptr)
+				(static_cast<block_header *>(ptr) - 1)->_size = size;
+			return ptr;
+		}
+
+		static void count_call_site(thread_counters &counters,
+		                            const char *file, int line,
+		                            std::size_t size, bool realloc)
+		{
+			auto key = (reinterpret_cast<std::uintptr_t>(file) &
+			            0xffffffffffffULL) |
+			           (static_cast<std::uint64_t>(line & 0xffff) << 48);
+			if (key == 0)
+				key = 1;
+			auto &table = call_site_table();
+			auto index = (key * 0x9E3779B97F4A7C15ULL) >> 54;
+			for (std::size_t probe = 0; probe < MAX_CALL_SITES; ++probe)
+			{
+				auto position = (index + probe) & (MAX_CALL_SITES - 1);
+				auto &slot = table[position];
+				auto current = slot._key.load(std::memory_order_acquire);
+				if (current == 0 &&
+				    slot._key.compare_exchange_strong(
+				        current, key, std::memory_order_acq_rel))
+				{
+					slot._file.store(file, std::memory_order_relaxed);
+					slot._line.store(line, std::memory_order_relaxed);
+					current = key;
+				}
+				if (current != key)
+					continue;
+				auto &counts = counters._sites[position];
+				if (realloc)
+					bump(counts._reallocations);
+				else
+					bump(counts._allocations);
+				bump(counts._bytes, size);
+				return;
+			}
+		}
+
+		static void *do_malloc(std::size_t size, const char *file, int line)
+		{
+			auto &counters = local_counters();
+			bump(counters._totals._allocations);
+			count_call_site(counters, file, line, size, false);
+			return allocate_sized(size);
+		}
+
+		static void *do_realloc(void *ptr, std::size_t size, const char *file,
+		                        int line)
+		{
+			if (!ptr)
+				return do_malloc(size, file, line);
+			if (size == 0)
+			{
+				do_free(ptr, file, line);
+				return nullptr;
+			}
+			auto &counters = local_counters();
+			bump(counters._totals._reallocations);
+			count_call_site(counters, file, line, size, true);
+			auto header = static_cast<block_header *>(ptr) - 1;
+			if (header->_size_class != LARGE_CLASS &&
+			    size <= class_size(header->_size_class))
+			{
+				header->_size = size;
+				return ptr;
+			}
+			auto moved = allocate_sized(size);
+			if (!moved)
+				return nullptr;
+			std::memcpy(moved, ptr, std::min(size, header->_size));
+			release(ptr);
+			return moved;
+		}
+
+		static void do_free(void *ptr, const char *, int)
+		{
+			if (!ptr)
+				return;
+			bump(local_counters()._totals._frees);
+			release(ptr);
+		}
+	};
+} // namespace encrypt
+#endif // ENCRYPT_OPENSSL_MEMORY_POOL_H
@@ -1,11 +1,16 @@
-#include <chrono>
+#ifndef ENCRYPT_ENCRYPT_H
+#define ENCRYPT_ENCRYPT_H
+
 #include <cstddef>
 #include <cstring>
+#include <iomanip>
 #include <net/buffer_container.hpp>
 #include <openssl/evp.h>
 #include <random>
 #include <sstream>
+#include <stdexcept>
 #include <string>
+#include <timing/Clock.hpp>
 #include <vector>
 
 namespace encrypt
@@ -51,14 +56,13 @@ namespace encrypt
 		return ss.str();
 	}
 
-	inline std::vector<char> generate_random_bytes(std::size_t size)
+	inline std::vector<char>
+	generate_random_bytes(std::size_t size,
+	                      timing::ClockSource clock = timing::ClockSource())
 	{
 		std::vector<char> buffer(size + 8);
 
-		uint64_t now_ns =
-		    std::chrono::duration_cast<std::chrono::nanoseconds>(
-		        std::chrono::steady_clock::now().time_since_epoch())
-		        .count();
+		uint64_t now_ns = static_cast<uint64_t>(clock.now_ns());
 
 		std::memcpy(buffer.data(), &now_ns, sizeof(now_ns));
 
@@ -74,8 +78,10 @@ namespace encrypt
 		return buffer;
 	}
 
-	inline std::string generate_random_sha256_string(std::size_t size)
+	inline std::string generate_random_sha256_string(
+	    std::size_t size, timing::ClockSource clock = timing::ClockSource())
 	{
-		return get_sha256_from_buffer(generate_random_bytes(size));
+		return get_sha256_from_buffer(generate_random_bytes(size, clock));
 	}
-} // namespace encrypt
\ No newline at end of file
+} // namespace encrypt
+#endif // ENCRYPT_ENCRYPT_H
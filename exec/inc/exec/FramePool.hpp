@@ -0,0 +1,157 @@
+#ifndef EXEC_FRAME_POOL_H
+#define EXEC_FRAME_POOL_H
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <vector>
+
+namespace exec
+{
+	// Size-class pool for coroutine frames. Blocks of MIN_BLOCK_SIZE up
+	// to MAX_BLOCK_SIZE come from free lists refilled by carving chunks,
+	// so a workflow that runs again reuses the frame memory of the one
+	// before instead of going to the global heap. Larger frames fall
+	// back to operator new.
+	//
+	// Chunks are kept until the pool goes away. Not thread-safe: it
+	// belongs to one actor, on one loop.
+	class FramePool
+	{
+	public:
+		static constexpr std::size_t MIN_BLOCK_SIZE = 64;
+		static constexpr std::size_t MAX_BLOCK_SIZE = 4096;
+		static constexpr std::size_t SIZE_CLASS_COUNT =
+		    std::bit_width(MAX_BLOCK_SIZE / MIN_BLOCK_SIZE);
+		static constexpr std::size_t CHUNK_SIZE = 64 * 1024;
+
+		class Counters
+		{
+		public:
+			std::uint64_t _allocations;
+			std::uint64_t _frees;
+			std::uint64_t _pooled;
+			std::uint64_t _fallback;
+			std::uint64_t _chunks;
+			Counters()
+			    : _allocations(0)
+			    , _frees(0)
+			    , _pooled(0)
+			    , _fallback(0)
+			    , _chunks(0)
+			{
+			}
+		};
+
+	public:
+		explicit FramePool(std::size_t chunk_size = CHUNK_SIZE)
+		    : _chunk_size(std::max(chunk_size, MAX_BLOCK_SIZE))
+		    , _free()
+		    , _chunks()
+		    , _chunk_pos(nullptr)
+		    , _chunk_end(nullptr)
+		    , _counters()
+		{
+			_free.fill(nullptr);
+		}
+
+		FramePool(const FramePool &) = delete;
+
+		FramePool &operator=(const FramePool &) = delete;
+
+		void *allocate(std::size_t size)
+		{
+			++_counters._allocations;
+			if (size > MAX_BLOCK_SIZE)
+			{
+				++_counters._fallback;
+				return ::operator new(size);
+			}
+			++_counters._pooled;
+			auto index = do_class(size);
+			if (auto block = _free[index])
+			{
+				_free[index] = block->_next;
+				return block;
+			}
+			auto block_size = do_class_size(index);
+			if (static_cast<std::size_t>(_chunk_end - _chunk_pos) < block_size)
+				do_refill();
+			auto block = _chunk_pos;
+			_chunk_pos += block_size;
+			return block;
+		}
+
+		// size must be the size given to allocate().
+		void deallocate(void *block, std::size_t size)
+		{
+			++_counters._frees;
+			if (size > MAX_BLOCK_SIZE)
+			{
+				::operator delete(block);
+				return;
+			}
+			auto index = do_class(size);
+			auto node = static_cast<free_block *>(block);
+			node->_next = _free[index];
+			_free[index] = node;
+		}
+
+		// Put count blocks of size on the free list ahead of time, so the
+		// first workflows do not carve chunks.
+		void reserve(std::size_t size, std::size_t count)
+		{
+			if (size > MAX_BLOCK_SIZE)
+				return;
+			std::vector<void *> blocks(count);
+			for (auto &block : blocks)
+				block = allocate(size);
+			for (auto block : blocks)
+				deallocate(block, size);
+		}
+
+		const Counters &counters() const { return _counters; }
+
+	private:
+		class free_block
+		{
+		public:
+			free_block *_next;
+		};
+
+		std::size_t _chunk_size;
+		std::array<free_block *, SIZE_CLASS_COUNT> _free;
+		std::vector<std::unique_ptr<char[]>> _chunks;
+		char *_chunk_pos;
+		char *_chunk_end;
+		Counters _counters;
+
+		static std::size_t do_class(std::size_t size)
+		{
+			if (size <= MIN_BLOCK_SIZE)
+				return 0;
+			return std::bit_width((size - 1) / MIN_BLOCK_SIZE);
+		}
+
+		static std::size_t do_class_size(std::size_t index)
+		{
+			return MIN_BLOCK_SIZE << index;
+		}
+
+		// The tail of the old chunk is dropped; it is smaller than the
+		// block that did not fit.
+		void do_refill()
+		{
+			_chunks.push_back(std::make_unique<char[]>(_chunk_size));
+			_chunk_pos = _chunks.back().get();
+			_chunk_end = _chunk_pos + _chunk_size;
+			++_counters._chunks;
+		}
+	};
+} // namespace exec
+
+#endif // EXEC_FRAME_POOL_H
@@ -0,0 +1,576 @@
+#ifndef EXEC_RATE_SCHEDULER_H
+#define EXEC_RATE_SCHEDULER_H
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <string>
+#include <timing/Clock.hpp>
+#include <vector>
+
+namespace exec
+{
+	// Release order within a bucket, most urgent first.
+	enum class ActionPriority : unsigned int
+	{
+		CANCEL = 0,
+		HEDGE = 1,
+		ORDER = 2,
+		QUOTE = 3,
+	};
+
+	// Spec §10: HTTP 429 backs off exponentially from 200 ms; the venue
+	// is disabled after 5 retries or once the run of 429s has lasted
+	// 10 s.
+	class BackoffPolicy
+	{
+	public:
+		std::int64_t _initial_ns;
+		std::uint32_t _max_retries;
+		std::int64_t _max_streak_ns;
+		BackoffPolicy()
+		    : _initial_ns(200000000)
+		    , _max_retries(5)
+		    , _max_streak_ns(10000000000)
+		{
+		}
+	};
+
+	// Where a bucket stands, for the quote planner: _remaining is what
+	// is left once everything queued has gone out, negative while the
+	// bucket is behind.
+	class Budget
+	{
+	public:
+		double _tokens;
+		double _capacity;
+		double _refill_per_second;
+		double _queued_weight;
+		std::size_t _queued_actions;
+		double _remaining;
+		// Until then nothing is sent to the venue; 0 if not backing off.
+		std::int64_t _backoff_until_ns;
+		bool _disabled;
+		Budget()
+		    : _tokens(0)
+		    , _capacity(0)
+		    , _refill_per_second(0)
+		    , _queued_weight(0)
+		    , _queued_actions(0)
+		    , _remaining(0)
+		    , _backoff_until_ns(0)
+		    , _disabled(false)
+		{
+		}
+
+		// _remaining as a share of capacity, at most 1.
+		double fraction() const
+		{
+			return _capacity > 0 ? _remaining / _capacity : 0;
+		}
+	};
+
+	// Holds order actions until the venue's rate limits allow them out.
+	// Each (venue, endpoint class) has a token bucket of weight: capacity
+	// is the burst, refilled continuously at the venue's rate, read off
+	// the clock. An action costs its request weight; it is released,
+	// i.e. its callback runs and sends it, once its bucket holds that
+	// much and nothing more urgent is waiting there. Within a bucket
+	// actions wait in ActionPriority order, first in first out within a
+	// priority, so cancels always go ahead of new orders and quotes.
+	//
+	// submit() releases straight away when it can; poll() releases what
+	// has become affordable since, and belongs in the event loop. The
+	// transport reports every 429 through on_rate_limited() and other
+	// answers through on_success(); while a venue backs off nothing goes
+	// to it, and a venue that gets disabled drops what it had queued.
+	//
+	// Single threaded, like the loop that drives it.
+	class RateScheduler
+	{
+	public:
+		using ActionId = std::uint64_t;
+		using OnReleaseCallBack = std::function<void()>;
+		using OnDroppedCallBack = std::function<void(ActionId)>;
+		using OnVenueDisabledCallBack = std::function<void(std::uint32_t)>;
+
+		static constexpr ActionId NO_ACTION = 0;
+		static constexpr std::uint32_t NO_VENUE =
+		    std::numeric_limits<std::uint32_t>::max();
+		static constexpr std::uint32_t NO_BUCKET =
+		    std::numeric_limits<std::uint32_t>::max();
+		static constexpr std::size_t PRIORITY_COUNT = 4;
+
+	public:
+		explicit RateScheduler(
+		    timing::ClockSource clock = timing::ClockSource(),
+		    const BackoffPolicy &backoff = BackoffPolicy())
+		    : _clock(clock)
+		    , _backoff(backoff)
+		    , _venues()
+		    , _buckets()
+		    , _actions()
+		    , _free()
+		    , _on_dropped([](ActionId) {})
+		    , _on_venue_disabled([](std::uint32_t) {})
+		{
+		}
+
+		RateScheduler(const RateScheduler &) = delete;
+
+		RateScheduler &operator=(const RateScheduler &) = delete;
+
+		std::uint32_t add_venue(const std::string &name)
+		{
+			for (std::size_t i = 0; i < _venues.size(); ++i)
+			{
+				if (_venues[i]._name == name)
+					return static_cast<std::uint32_t>(i);
+			}
+			_venues.emplace_back();
+			_venues.back()._name = name;
+			return static_cast<std::uint32_t>(_venues.size() - 1);
+		}
+
+		std::uint32_t venue_id(const std::string &name) const
+		{
+			for (std::size_t i = 0; i < _venues.size(); ++i)
+			{
+				if (_venues[i]._name == name)
+					return static_cast<std::uint32_t>(i);
+			}
+			return NO_VENUE;
+		}
+
+		const std::string &venue_name(std::uint32_t venue) const
+		{
+			return _venues[venue]._name;
+		}
+
+		// An endpoint class of venue with its own limit, e.g. order
+		// placement at 1200 weight per minute: capacity 1200, refill 20.
+		// The bucket starts full. NO_BUCKET for an unknown venue.
+		std::uint32_t add_endpoint(std::uint32_t venue, const std::string &name,
+		                           double capacity, double refill_per_second)
+		{
+			if (venue >= _venues.size())
+				return NO_BUCKET;
+			auto id = static_cast<std::uint32_t>(_buckets.size());
+			_buckets.emplace_back();
+			auto &bucket = _buckets.back();
+			bucket._venue = venue;
+			bucket._name = name;
+			bucket._capacity = capacity;
+			bucket._refill_per_ns = refill_per_second / 1e9;
+			bucket._tokens = capacity;
+			bucket._refilled_ns = _clock.now_ns();
+			_venues[venue]._buckets.push_back(id);
+			return id;
+		}
+
+		const std::string &endpoint_name(std::uint32_t bucket) const
+		{
+			return _buckets[bucket]._name;
+		}
+
+		void set_on_dropped(OnDroppedCallBack &&on_dropped)
+		{
+			_on_dropped = std::move(on_dropped);
+		}
+
+		void set_on_venue_disabled(OnVenueDisabledCallBack &&on_disabled)
+		{
+			_on_venue_disabled = std::move(on_disabled);
+		}
+
+		// Runs on_release now if the bucket allows, otherwise queues it.
+		// NO_ACTION if the venue is disabled or weight exceeds the
+		// bucket's capacity, so it could never go out.
+		ActionId submit(std::uint32_t bucket_id, ActionPriority priority,
+		                double weight, OnReleaseCallBack &&on_release)
+		{
+			auto &bucket = _buckets[bucket_id];
+			auto &venue = _venues[bucket._venue];
+			if (venue._disabled || !(weight <= bucket._capacity))
+				return NO_ACTION;
+			auto now = _clock.now_ns();
+			auto level = static_cast<std::size_t>(priority);
+			if (now >= venue._backoff_until_ns &&
+			    !do_waiting_ahead(bucket, level))
+			{
+				do_refill(bucket, now);
+				if (bucket._tokens >= weight)
+				{
+					// The id is retired at once; cancel() turns it down.
+					bucket._tokens -= weight;
+					auto index = do_acquire();
+					auto id = do_id(index);
+					do_release_node(index);
+					on_release();
+					return id;
+				}
+			}
+			auto index = do_acquire();
+			auto &action = _actions[index];
+			action._bucket = bucket_id;
+			action._priority = static_cast<std::uint32_t>(level);
+			action._weight = weight;
+			action._queued = true;
+			action._on_release = std::move(on_release);
+			do_push(bucket, index);
+			return do_id(index);
+		}
+
+		// Withdraws a queued action, e.g. a quote that a newer one
+		// replaced. False if it already went out or was dropped.
+		bool cancel(ActionId id)
+		{
+			auto index = static_cast<std::uint32_t>(id);
+			if (index >= _actions.size() ||
+			    _actions[index]._generation != do_generation(id) ||
+			    !_actions[index]._queued)
+				return false;
+			do_unlink(index);
+			do_release_node(index);
+			return true;
+		}
+
+		// Releases every queued action its bucket now allows; returns
+		// how many went out.
+		std::size_t poll()
+		{
+			auto now = _clock.now_ns();
+			std::size_t released = 0;
+			for (auto &bucket : _buckets)
+			{
+				if (bucket._queued_actions == 0 ||
+				    now < _venues[bucket._venue]._backoff_until_ns)
+					continue;
+				do_refill(bucket, now);
+				released += do_release(bucket);
+			}
+			return released;
+		}
+
+		// The venue answered 429: back off, or disable the venue once the
+		// policy says so.
+		void on_rate_limited(std::uint32_t venue_id)
+		{
+			auto &venue = _venues[venue_id];
+			if (venue._disabled)
+				return;
+			auto now = _clock.now_ns();
+			if (venue._retries == 0)
+				venue._streak_start_ns = now;
+			if (venue._retries >= _backoff._max_retries ||
+			    now - venue._streak_start_ns >= _backoff._max_streak_ns)
+			{
+				do_disable(venue_id);
+				return;
+			}
+			venue._backoff_until_ns = now + (_backoff._initial_ns
+			                                 << venue._retries);
+			++venue._retries;
+			// Requests in flight spent budget too; start from empty so the
+			// bucket does not burst the moment the back-off ends.
+			for (auto bucket : venue._buckets)
+			{
+				_buckets[bucket]._tokens = 0;
+				_buckets[bucket]._refilled_ns = venue._backoff_until_ns;
+			}
+		}
+
+		// Any answer but 429 ends the venue's run of 429s.
+		void on_success(std::uint32_t venue_id)
+		{
+			_venues[venue_id]._retries = 0;
+		}
+
+		// Take a disabled venue back, e.g. on an operator command.
+		void enable_venue(std::uint32_t venue_id)
+		{
+			auto &venue = _venues[venue_id];
+			venue._disabled = false;
+			venue._retries = 0;
+			venue._backoff_until_ns = 0;
+		}
+
+		bool venue_disabled(std::uint32_t venue_id) const
+		{
+			return _venues[venue_id]._disabled;
+		}
+
+		// 429s in the venue's current run.
+		std::uint32_t retries(std::uint32_t venue_id) const
+		{
+			return _venues[venue_id]._retries;
+		}
+
+		Budget budget(std::uint32_t bucket_id)
+		{
+			auto &bucket = _buckets[bucket_id];
+			auto &venue = _venues[bucket._venue];
+			auto now = _clock.now_ns();
+			do_refill(bucket, now);
+			Budget budget;
+			budget._tokens = bucket._tokens;
+			budget._capacity = bucket._capacity;
+			budget._refill_per_second = bucket._refill_per_ns * 1e9;
+			budget._queued_weight = bucket._queued_weight;
+			budget._queued_actions = bucket._queued_actions;
+			budget._remaining = bucket._tokens - bucket._queued_weight;
+			budget._backoff_until_ns =
+			    venue._backoff_until_ns > now ? venue._backoff_until_ns : 0;
+			budget._disabled = venue._disabled;
+			return budget;
+		}
+
+		// Budget::fraction() of the venue's tightest bucket, 0 while it
+		// backs off or is disabled: how hard the quote planner may
+		// re-quote there.
+		double headroom(std::uint32_t venue_id)
+		{
+			auto &venue = _venues[venue_id];
+			if (venue._disabled || venue._backoff_until_ns > _clock.now_ns())
+				return 0;
+			double headroom = 1;
+			for (auto bucket : venue._buckets)
+				headroom = std::min(headroom, budget(bucket).fraction());
+			return headroom;
+		}
+
+	private:
+		static constexpr std::uint32_t NIL =
+		    std::numeric_limits<std::uint32_t>::max();
+
+		class venue_state
+		{
+		public:
+			std::string _name;
+			std::vector<std::uint32_t> _buckets;
+			std::uint32_t _retries;
+			std::int64_t _streak_start_ns;
+			std::int64_t _backoff_until_ns;
+			bool _disabled;
+			venue_state()
+			    : _name()
+			    , _buckets()
+			    , _retries(0)
+			    , _streak_start_ns(0)
+			    , _backoff_until_ns(0)
+			    , _disabled(false)
+			{
+			}
+		};
+
+		class bucket_state
+		{
+		public:
+			std::uint32_t _venue;
+			std::string _name;
+			double _capacity;
+			double _refill_per_ns;
+			double _tokens;
+			std::int64_t _refilled_ns;
+			// Queued actions per priority, a FIFO list each.
+			std::array<std::uint32_t, PRIORITY_COUNT> _heads;
+			std::array<std::uint32_t, PRIORITY_COUNT> _tails;
+			double _queued_weight;
+			std::size_t _queued_actions;
+			bucket_state()
+			    : _venue(0)
+			    , _name()
+			    , _capacity(0)
+			    , _refill_per_ns(0)
+			    , _tokens(0)
+			    , _refilled_ns(0)
+			    , _heads()
+			    , _tails()
+			    , _queued_weight(0)
+			    , _queued_actions(0)
+			{
+				_heads.fill(NIL);
+				_tails.fill(NIL);
+			}
+		};
+
+		class action_node
+		{
+		public:
+			std::uint32_t _bucket;
+			std::uint32_t _priority;
+			std::uint32_t _prev;
+			std::uint32_t _next;
+			std::uint32_t _generation;
+			bool _queued;
+			double _weight;
+			OnReleaseCallBack _on_release;
+			action_node()
+			    : _bucket(0)
+			    , _priority(0)
+			    , _prev(NIL)
+			    , _next(NIL)
+			    , _generation(1)
+			    , _queued(false)
+			    , _weight(0)
+			    , _on_release()
+			{
+			}
+		};
+
+		timing::ClockSource _clock;
+		BackoffPolicy _backoff;
+		std::vector<venue_state> _venues;
+		std::vector<bucket_state> _buckets;
+		std::vector<action_node> _actions;
+		std::vector<std::uint32_t> _free;
+		OnDroppedCallBack _on_dropped;
+		OnVenueDisabledCallBack _on_venue_disabled;
+
+		static std::uint32_t do_generation(ActionId id)
+		{
+			return static_cast<std::uint32_t>(id >> 32);
+		}
+
+		ActionId do_id(std::uint32_t index) const
+		{
+			return (static_cast<ActionId>(_actions[index]._generation) << 32) |
+			       index;
+		}
+
+		std::uint32_t do_acquire()
+		{
+			if (_free.empty())
+			{
+				_actions.emplace_back();
+				return static_cast<std::uint32_t>(_actions.size() - 1);
+			}
+			auto index = _free.back();
+			_free.pop_back();
+			return index;
+		}
+
+		// Bumping the generation retires the action's id; zero is skipped
+		// to keep NO_ACTION unused.
+		void do_release_node(std::uint32_t index)
+		{
+			auto &action = _actions[index];
+			action._queued = false;
+			action._on_release = nullptr;
+			if (++action._generation == 0)
+				action._generation = 1;
+			_free.push_back(index);
+		}
+
+		void do_refill(bucket_state &bucket, std::int64_t now)
+		{
+			if (now <= bucket._refilled_ns)
+				return;
+			auto elapsed = static_cast<double>(now - bucket._refilled_ns);
+			bucket._tokens =
+			    std::min(bucket._capacity,
+			             bucket._tokens + elapsed * bucket._refill_per_ns);
+			bucket._refilled_ns = now;
+		}
+
+		// Something at level or more urgent is queued in bucket.
+		static bool do_waiting_ahead(const bucket_state &bucket,
+		                             std::size_t level)
+		{
+			for (std::size_t i = 0; i <= level; ++i)
+			{
+				if (bucket._heads[i] != NIL)
+					return true;
+			}
+			return false;
+		}
+
+		void do_push(bucket_state &bucket, std::uint32_t index)
+		{
+			auto &action = _actions[index];
+			auto level = action._priority;
+			action._prev = bucket._tails[level];
+			action._next = NIL;
+			if (action._prev != NIL)
+				_actions[action._prev]._next = index;
+			else
+				bucket._heads[level] = index;
+			bucket._tails[level] = index;
+			bucket._queued_weight += action._weight;
+			++bucket._queued_actions;
+		}
+
+		void do_unlink(std::uint32_t index)
+		{
+			auto &action = _actions[index];
+			auto &bucket = _buckets[action._bucket];
+			auto level = action._priority;
+			if (action._prev != NIL)
+				_actions[action._prev]._next = action._next;
+			else
+				bucket._heads[level] = action._next;
+			if (action._next != NIL)
+				_actions[action._next]._prev = action._prev;
+			else
+				bucket._tails[level] = action._prev;
+			action._prev = NIL;
+			action._next = NIL;
+			bucket._queued_weight -= action._weight;
+			--bucket._queued_actions;
+			if (bucket._queued_actions == 0)
+				bucket._queued_weight = 0;
+		}
+
+		// Strict priority: the head of the most urgent queue goes first,
+		// and while it cannot, nothing behind it does.
+		std::size_t do_release(bucket_state &bucket)
+		{
+			std::size_t released = 0;
+			for (std::size_t level = 0; level < PRIORITY_COUNT; ++level)
+			{
+				while (bucket._heads[level] != NIL)
+				{
+					auto index = bucket._heads[level];
+					if (bucket._tokens < _actions[index]._weight)
+						return released;
+					bucket._tokens -= _actions[index]._weight;
+					do_unlink(index);
+					auto on_release = std::move(_actions[index]._on_release);
+					do_release_node(index);
+					++released;
+					on_release();
+				}
+			}
+			return released;
+		}
+
+		void do_disable(std::uint32_t venue_id)
+		{
+			auto &venue = _venues[venue_id];
+			venue._disabled = true;
+			std::vector<ActionId> dropped;
+			for (auto bucket_id : venue._buckets)
+			{
+				auto &bucket = _buckets[bucket_id];
+				for (std::size_t level = 0; level < PRIORITY_COUNT; ++level)
+				{
+					while (bucket._heads[level] != NIL)
+					{
+						auto index = bucket._heads[level];
+						dropped.push_back(do_id(index));
+						do_unlink(index);
+						do_release_node(index);
+					}
+				}
+			}
+			for (auto id : dropped)
+				_on_dropped(id);
+			_on_venue_disabled(venue_id);
+		}
+	};
+} // namespace exec
+
+#endif // EXEC_RATE_SCHEDULER_H
@@ -0,0 +1,529 @@
+#ifndef EXEC_RUNTIME_H
+#define EXEC_RUNTIME_H
+
+#include <algorithm>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <exec/FramePool.hpp>
+#include <exec/Task.hpp>
+#include <exec/TimerWheel.hpp>
+#include <functional>
+#include <timing/Clock.hpp>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace exec
+{
+	// What an order workflow waits for, as bits so that an await can
+	// take several.
+	enum class OrderEventType : std::uint32_t
+	{
+		NONE = 0,
+		// The venue accepted the order.
+		ACK = 1u << 0,
+		REJECT = 1u << 1,
+		FILL = 1u << 2,
+		// Left the book unfilled: cancelled or expired.
+		DONE = 1u << 3,
+		// Nothing came before the await's timeout.
+		TIMEOUT = 1u << 4,
+	};
+
+	constexpr std::uint32_t operator|(OrderEventType a, OrderEventType b)
+	{
+		return static_cast<std::uint32_t>(a) | static_cast<std::uint32_t>(b);
+	}
+
+	constexpr std::uint32_t operator|(std::uint32_t a, OrderEventType b)
+	{
+		return a | static_cast<std::uint32_t>(b);
+	}
+
+	class OrderEvent
+	{
+	public:
+		OrderEventType _type;
+		std::uint64_t _order_id;
+		// FILL: quantity and price of this fill, and what is still open.
+		double _quantity;
+		double _price;
+		double _leaves_quantity;
+		std::int64_t _timestamp_ns;
+		OrderEvent()
+		    : _type(OrderEventType::NONE)
+		    , _order_id(0)
+		    , _quantity(0)
+		    , _price(0)
+		    , _leaves_quantity(0)
+		    , _timestamp_ns(0)
+		{
+		}
+
+		// Nothing follows a reject, a done or a fill that leaves nothing
+		// open.
+		bool is_final() const
+		{
+			return _type == OrderEventType::REJECT ||
+			       _type == OrderEventType::DONE ||
+			       (_type == OrderEventType::FILL && _leaves_quantity <= 0);
+		}
+	};
+
+	class Runtime;
+
+	// co_await of Actor::order_ack() and friends: the next event of an
+	// order whose type is in the mask, or TIMEOUT. The first await on an
+	// order makes the runtime follow it; from then on an event that
+	// arrives while nobody waits for it is kept for the next await, until
+	// the order's final event is taken. A workflow that gives up on an
+	// order before that calls Runtime::forget(). Destroying the awaiting
+	// coroutine forgets the order.
+	class OrderAwaiter
+	{
+	public:
+		OrderAwaiter(Runtime &runtime, std::uint64_t order_id,
+		             std::uint32_t mask, std::int64_t timeout_ns)
+		    : _runtime(runtime)
+		    , _order_id(order_id)
+		    , _mask(mask)
+		    , _timeout_ns(timeout_ns)
+		    , _event()
+		    , _handle()
+		    , _timer(TimerWheel::NO_TIMER)
+		    , _waiting(false)
+		    , _posted(false)
+		{
+		}
+
+		OrderAwaiter(const OrderAwaiter &) = delete;
+
+		OrderAwaiter &operator=(const OrderAwaiter &) = delete;
+
+		~OrderAwaiter();
+
+		bool await_ready();
+
+		void await_suspend(std::coroutine_handle<> handle);
+
+		OrderEvent await_resume()
+		{
+			_posted = false;
+			return _event;
+		}
+
+	private:
+		friend class Runtime;
+
+		Runtime &_runtime;
+		std::uint64_t _order_id;
+		std::uint32_t _mask;
+		std::int64_t _timeout_ns;
+		OrderEvent _event;
+		std::coroutine_handle<> _handle;
+		TimerWheel::TimerId _timer;
+		// Registered with the order, and queued to resume.
+		bool _waiting;
+		bool _posted;
+	};
+
+	// co_await of Actor::sleep_until() and sleep_for().
+	class SleepAwaiter
+	{
+	public:
+		SleepAwaiter(Runtime &runtime, std::int64_t deadline_ns)
+		    : _runtime(runtime)
+		    , _deadline_ns(deadline_ns)
+		    , _timer(TimerWheel::NO_TIMER)
+		    , _handle()
+		    , _posted(false)
+		{
+		}
+
+		SleepAwaiter(const SleepAwaiter &) = delete;
+
+		SleepAwaiter &operator=(const SleepAwaiter &) = delete;
+
+		~SleepAwaiter();
+
+		bool await_ready() const;
+
+		void await_suspend(std::coroutine_handle<> handle);
+
+		void await_resume() { _posted = false; }
+
+	private:
+		Runtime &_runtime;
+		std::int64_t _deadline_ns;
+		TimerWheel::TimerId _timer;
+		std::coroutine_handle<> _handle;
+		bool _posted;
+	};
+
+	// Drives order workflows (spec §3.1, §12.2) from the event loop: a
+	// timer wheel on the given clock, the order events the gateway feeds
+	// in through notify(), and a queue of coroutines ready to run. Call
+	// poll() on every turn of the loop, next to the sessions' poll().
+	//
+	// Coroutines are only ever resumed from poll(), never from inside
+	// notify() or a timer callback, so a workflow that sends orders does
+	// not run inside the session callback that woke it. Single threaded:
+	// everything runs on the loop's thread.
+	class Runtime
+	{
+	public:
+		explicit Runtime(timing::ClockSource clock = timing::ClockSource(),
+		                 std::int64_t tick_ns = 1000000,
+		                 std::size_t slot_count = 1024)
+		    : _clock(clock)
+		    , _timers(tick_ns, slot_count, clock.now_ns())
+		    , _orders()
+		    , _ready()
+		    , _running()
+		{
+		}
+
+		Runtime(const Runtime &) = delete;
+
+		Runtime &operator=(const Runtime &) = delete;
+
+		std::int64_t now_ns() const { return _clock.now_ns(); }
+
+		TimerWheel &timers() { return _timers; }
+
+		// Fires due timers, then resumes every coroutine that was ready
+		// when the call began; returns how many it resumed.
+		std::size_t poll()
+		{
+			_timers.poll(_clock.now_ns());
+			_running.swap(_ready);
+			for (std::size_t i = 0; i < _running.size(); ++i)
+			{
+				// A resumed coroutine may destroy one queued after it.
+				if (auto handle = _running[i])
+					handle.resume();
+			}
+			auto resumed = _running.size();
+			_running.clear();
+			return resumed;
+		}
+
+		// An event from the venue for order_id. False if no workflow
+		// follows the order, i.e. none has awaited it.
+		bool notify(const OrderEvent &event)
+		{
+			auto it = _orders.find(event._order_id);
+			if (it == _orders.end())
+				return false;
+			auto &order = it->second;
+			auto waiter = order._waiter;
+			if (!waiter || !(waiter->_mask &
+			                 static_cast<std::uint32_t>(event._type)))
+			{
+				order._pending.push_back(event);
+				return true;
+			}
+			do_withdraw(*waiter);
+			waiter->_event = event;
+			if (event.is_final() && order._pending.empty())
+				_orders.erase(it);
+			do_post(*waiter);
+			return true;
+		}
+
+		// Stop following order_id and drop its queued events.
+		void forget(std::uint64_t order_id)
+		{
+			auto it = _orders.find(order_id);
+			if (it == _orders.end())
+				return;
+			if (it->second._waiter)
+				do_withdraw(*it->second._waiter);
+			_orders.erase(it);
+		}
+
+		// Orders followed.
+		std::size_t order_count() const { return _orders.size(); }
+
+		// Queue handle to resume on the next poll().
+		void post(std::coroutine_handle<> handle) { _ready.push_back(handle); }
+
+		// Take a queued handle back, e.g. because its frame is going
+		// away.
+		void unpost(std::coroutine_handle<> handle)
+		{
+			std::replace(_ready.begin(), _ready.end(), handle,
+			             std::coroutine_handle<>());
+			std::replace(_running.begin(), _running.end(), handle,
+			             std::coroutine_handle<>());
+		}
+
+	private:
+		friend class OrderAwaiter;
+
+		class order_state
+		{
+		public:
+			OrderAwaiter *_waiter;
+			std::vector<OrderEvent> _pending;
+			order_state()
+			    : _waiter(nullptr)
+			    , _pending()
+			{
+			}
+		};
+
+		timing::ClockSource _clock;
+		TimerWheel _timers;
+		std::unordered_map<std::uint64_t, order_state> _orders;
+		std::vector<std::coroutine_handle<>> _ready;
+		std::vector<std::coroutine_handle<>> _running;
+
+		// Takes a queued event for waiter, if there is one.
+		bool do_take(OrderAwaiter &waiter)
+		{
+			auto it = _orders.find(waiter._order_id);
+			if (it == _orders.end())
+				return false;
+			auto &pending = it->second._pending;
+			for (auto event = pending.begin(); event != pending.end();
+			     ++event)
+			{
+				if (!(waiter._mask & static_cast<std::uint32_t>(event->_type)))
+					continue;
+				waiter._event = *event;
+				pending.erase(event);
+				if (waiter._event.is_final() && pending.empty())
+					_orders.erase(it);
+				return true;
+			}
+			return false;
+		}
+
+		void do_wait(OrderAwaiter &waiter)
+		{
+			_orders[waiter._order_id]._waiter = &waiter;
+			waiter._waiting = true;
+			if (waiter._timeout_ns <= 0)
+				return;
+			waiter._timer = _timers.schedule(
+			    _clock.now_ns() + waiter._timeout_ns,
+			    [this, &waiter]()
+			    {
+				    waiter._timer = TimerWheel::NO_TIMER;
+				    do_withdraw(waiter);
+				    waiter._event = OrderEvent();
+				    waiter._event._type = OrderEventType::TIMEOUT;
+				    waiter._event._order_id = waiter._order_id;
+				    waiter._event._timestamp_ns = _clock.now_ns();
+				    do_post(waiter);
+			    });
+		}
+
+		void do_withdraw(OrderAwaiter &waiter)
+		{
+			if (waiter._timer != TimerWheel::NO_TIMER)
+			{
+				_timers.cancel(waiter._timer);
+				waiter._timer = TimerWheel::NO_TIMER;
+			}
+			if (!waiter._waiting)
+				return;
+			waiter._waiting = false;
+			auto it = _orders.find(waiter._order_id);
+			if (it != _orders.end() && it->second._waiter == &waiter)
+				it->second._waiter = nullptr;
+		}
+
+		void do_post(OrderAwaiter &waiter)
+		{
+			waiter._posted = true;
+			post(waiter._handle);
+		}
+	};
+
+	// Destroyed before it resumed: the workflow that followed the order
+	// is gone, so the order goes with it.
+	inline OrderAwaiter::~OrderAwaiter()
+	{
+		if (_waiting || _posted)
+			_runtime.forget(_order_id);
+		else
+			_runtime.do_withdraw(*this);
+		if (_posted)
+			_runtime.unpost(_handle);
+	}
+
+	inline bool OrderAwaiter::await_ready()
+	{
+		return _runtime.do_take(*this);
+	}
+
+	inline void OrderAwaiter::await_suspend(std::coroutine_handle<> handle)
+	{
+		_handle = handle;
+		_runtime.do_wait(*this);
+	}
+
+	inline SleepAwaiter::~SleepAwaiter()
+	{
+		if (_timer != TimerWheel::NO_TIMER)
+			_runtime.timers().cancel(_timer);
+		if (_posted)
+			_runtime.unpost(_handle);
+	}
+
+	inline bool SleepAwaiter::await_ready() const
+	{
+		return _deadline_ns <= _runtime.now_ns();
+	}
+
+	inline void SleepAwaiter::await_suspend(std::coroutine_handle<> handle)
+	{
+		_handle = handle;
+		_timer = _runtime.timers().schedule(_deadline_ns,
+		                                    [this]()
+		                                    {
+			                                    _timer = TimerWheel::NO_TIMER;
+			                                    _posted = true;
+			                                    _runtime.post(_handle);
+		                                    });
+	}
+
+	// Owner of a group of workflows, e.g. the ones of one symbol (spec
+	// §2 per-symbol actors). Their frames come from the actor's own
+	// FramePool when the coroutine takes the actor as its first
+	// parameter:
+	//
+	//   EXEC_COROUTINES_BEGIN
+	//   exec::Task<> hedge(exec::Actor &actor, std::uint64_t order_id)
+	//   {
+	//       auto event =
+	//           co_await actor.fill_or_timeout(order_id, 2'000'000'000);
+	//       ...
+	//   }
+	//   EXEC_COROUTINES_END
+	//   actor.spawn(hedge(actor, id));
+	//
+	// An exception that escapes a spawned workflow goes to on_error,
+	// which must not throw; by default it ends the process.
+	class Actor
+	{
+	public:
+		using OnErrorCallBack = std::function<void(std::exception_ptr)>;
+
+	public:
+		explicit Actor(Runtime &runtime,
+		               OnErrorCallBack &&on_error =
+		                   [](std::exception_ptr error)
+		               { std::rethrow_exception(error); })
+		    : _pool()
+		    , _runtime(runtime)
+		    , _on_error(std::move(on_error))
+		    , _tasks()
+		{
+		}
+
+		Actor(const Actor &) = delete;
+
+		Actor &operator=(const Actor &) = delete;
+
+		~Actor() { stop(); }
+
+		FramePool &frame_pool() { return _pool; }
+
+		Runtime &runtime() { return _runtime; }
+
+		// Runs task up to its first suspension, then leaves it to the
+		// runtime. The actor destroys the frame once it ends.
+		void spawn(Task<> &&task)
+		{
+			auto handle = task.release();
+			if (!handle)
+				return;
+			auto &promise = handle.promise();
+			promise._on_done = &Actor::do_done;
+			promise._owner = this;
+			promise._index = _tasks.size();
+			_tasks.push_back(handle);
+			handle.resume();
+		}
+
+		// Workflows spawned and not yet ended.
+		std::size_t task_count() const { return _tasks.size(); }
+
+		// Destroys every workflow where it stands, withdrawing its waits
+		// and timers. Not from inside one of them.
+		void stop()
+		{
+			while (!_tasks.empty())
+			{
+				auto handle = _tasks.back();
+				_tasks.pop_back();
+				handle.destroy();
+			}
+		}
+
+		// The order's ACK or REJECT, or TIMEOUT; timeout_ns <= 0 waits
+		// for ever.
+		OrderAwaiter order_ack(std::uint64_t order_id, std::int64_t timeout_ns)
+		{
+			return OrderAwaiter(_runtime, order_id,
+			                    OrderEventType::ACK | OrderEventType::REJECT,
+			                    timeout_ns);
+		}
+
+		// The order's next FILL, or the REJECT or DONE that ends it, or
+		// TIMEOUT.
+		OrderAwaiter fill_or_timeout(std::uint64_t order_id,
+		                             std::int64_t timeout_ns)
+		{
+			return OrderAwaiter(_runtime, order_id,
+			                    OrderEventType::FILL | OrderEventType::REJECT |
+			                        OrderEventType::DONE,
+			                    timeout_ns);
+		}
+
+		// The order's next event of any type in mask, or TIMEOUT.
+		OrderAwaiter order_event(std::uint64_t order_id, std::uint32_t mask,
+		                         std::int64_t timeout_ns)
+		{
+			return OrderAwaiter(_runtime, order_id, mask, timeout_ns);
+		}
+
+		SleepAwaiter sleep_until(std::int64_t deadline_ns)
+		{
+			return SleepAwaiter(_runtime, deadline_ns);
+		}
+
+		SleepAwaiter sleep_for(std::int64_t duration_ns)
+		{
+			return SleepAwaiter(_runtime, _runtime.now_ns() + duration_ns);
+		}
+
+	private:
+		FramePool _pool;
+		Runtime &_runtime;
+		OnErrorCallBack _on_error;
+		std::vector<Task<>::handle_type> _tasks;
+
+		static void do_done(void *owner, std::coroutine_handle<> handle)
+		{
+			auto actor = static_cast<Actor *>(owner);
+			auto task = Task<>::handle_type::from_address(handle.address());
+			auto index = task.promise()._index;
+			auto error = task.promise()._exception;
+			auto last = actor->_tasks.back();
+			actor->_tasks[index] = last;
+			last.promise()._index = index;
+			actor->_tasks.pop_back();
+			task.destroy();
+			if (error)
+				actor->_on_error(error);
+		}
+	};
+} // namespace exec
+
+#endif // EXEC_RUNTIME_H
@@ -0,0 +1,286 @@
+#ifndef EXEC_TASK_H
+#define EXEC_TASK_H
+
+#include <concepts>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <exec/FramePool.hpp>
+#include <optional>
+#include <utility>
+
+// GCC lowers every coroutine body to a switch without a default label,
+// which -Wswitch-default then reports at the coroutine. Nothing in the
+// source can avoid it, so code that defines coroutines wraps them in
+// these, which turn the warning off between them and nowhere else:
+//
+//   EXEC_COROUTINES_BEGIN
+//   exec::Task<> hedge(exec::Actor &actor, std::uint64_t order_id) {...}
+//   EXEC_COROUTINES_END
+#if defined(__GNUC__) && !defined(__clang__)
+#define EXEC_COROUTINES_BEGIN \
+	_Pragma("GCC diagnostic push") \
+	_Pragma("GCC diagnostic ignored \"-Wswitch-default\"")
+#define EXEC_COROUTINES_END _Pragma("GCC diagnostic pop")
+#else
+#define EXEC_COROUTINES_BEGIN
+#define EXEC_COROUTINES_END
+#endif
+
+namespace exec
+{
+	// Anything that hands out a FramePool, e.g. an Actor.
+	template <typename T>
+	concept FrameSource = requires(T &source) {
+		{ source.frame_pool() } -> std::same_as<FramePool &>;
+	};
+
+	// What every Task promise shares: frame allocation, the awaiting
+	// coroutine to resume on completion, and the hook a detached task
+	// reports its end through.
+	//
+	// A coroutine whose first parameter is a FrameSource (or whose
+	// second is, for a member function) gets its frame from that
+	// source's pool; any other coroutine uses the global heap. The pool
+	// is recorded in front of the frame so that the frame goes back to
+	// the pool it came from.
+	class PromiseBase
+	{
+	public:
+		using OnDoneCallBack = void (*)(void *owner,
+		                                std::coroutine_handle<> handle);
+
+		class final_awaiter
+		{
+		public:
+			bool await_ready() const noexcept { return false; }
+
+			template <typename P>
+			std::coroutine_handle<>
+			await_suspend(std::coroutine_handle<P> handle) noexcept
+			{
+				auto &promise = handle.promise();
+				if (promise._continuation)
+					return promise._continuation;
+				if (promise._on_done)
+					promise._on_done(promise._owner, handle);
+				return std::noop_coroutine();
+			}
+
+			void await_resume() const noexcept {}
+		};
+
+	public:
+		PromiseBase()
+		    : _continuation()
+		    , _exception()
+		    , _on_done(nullptr)
+		    , _owner(nullptr)
+		    , _index(0)
+		{
+		}
+
+		static void *operator new(std::size_t size)
+		{
+			return do_allocate(nullptr, size);
+		}
+
+		template <FrameSource S, typename... Args>
+		static void *operator new(std::size_t size, S &source, Args &...)
+		{
+			return do_allocate(&source.frame_pool(), size);
+		}
+
+		template <typename Self, FrameSource S, typename... Args>
+		    requires(!FrameSource<Self>)
+		static void *operator new(std::size_t size, Self &, S &source,
+		                          Args &...)
+		{
+			return do_allocate(&source.frame_pool(), size);
+		}
+
+		static void operator delete(void *frame, std::size_t size)
+		{
+			do_deallocate(frame, size);
+		}
+
+		std::suspend_always initial_suspend() noexcept { return {}; }
+
+		final_awaiter final_suspend() noexcept { return {}; }
+
+		void unhandled_exception() { _exception = std::current_exception(); }
+
+		// Coroutine to resume when this one ends; none for a detached
+		// task.
+		std::coroutine_handle<> _continuation;
+		std::exception_ptr _exception;
+		// Set on a detached task by its owner; called once it ends, with
+		// the frame suspended for good, so it may destroy it.
+		OnDoneCallBack _on_done;
+		void *_owner;
+		// Free for the owner, e.g. the task's place in its list.
+		std::size_t _index;
+
+	private:
+		// Keeps the frame at the default new alignment.
+		static constexpr std::size_t HEADER_SIZE =
+		    __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+
+		static void *do_allocate(FramePool *pool, std::size_t size)
+		{
+			auto block = static_cast<char *>(
+			    pool ? pool->allocate(size + HEADER_SIZE)
+			         : ::operator new(size + HEADER_SIZE));
+			*reinterpret_cast<FramePool **>(block) = pool;
+			return block + HEADER_SIZE;
+		}
+
+		static void do_deallocate(void *frame, std::size_t size)
+		{
+			auto block = static_cast<char *>(frame) - HEADER_SIZE;
+			auto pool = *reinterpret_cast<FramePool **>(block);
+			if (pool)
+				pool->deallocate(block, size + HEADER_SIZE);
+			else
+				::operator delete(block);
+		}
+	};
+
+	// Where a Task keeps its result.
+	template <typename T>
+	class TaskResult : public PromiseBase
+	{
+	public:
+		template <typename U>
+		void return_value(U &&value)
+		{
+			_value.emplace(std::forward<U>(value));
+		}
+
+		T take() { return std::move(*_value); }
+
+	private:
+		std::optional<T> _value;
+	};
+
+	template <>
+	class TaskResult<void> : public PromiseBase
+	{
+	public:
+		void return_void() {}
+
+		void take() {}
+	};
+
+	// A lazily started coroutine returning T. co_await on a Task starts
+	// it and resumes the awaiting coroutine when it ends, passing on its
+	// result or exception; an Actor runs a Task<> detached with spawn().
+	// The Task owns the frame and destroys it with itself.
+	template <typename T = void>
+	class Task
+	{
+	public:
+		class promise_type : public TaskResult<T>
+		{
+		public:
+			Task get_return_object()
+			{
+				return Task(
+				    std::coroutine_handle<promise_type>::from_promise(*this));
+			}
+		};
+
+		using handle_type = std::coroutine_handle<promise_type>;
+
+		class awaiter
+		{
+		public:
+			explicit awaiter(handle_type handle)
+			    : _handle(handle)
+			{
+			}
+
+			bool await_ready() const noexcept
+			{
+				return !_handle || _handle.done();
+			}
+
+			std::coroutine_handle<>
+			await_suspend(std::coroutine_handle<> continuation) noexcept
+			{
+				_handle.promise()._continuation = continuation;
+				return _handle;
+			}
+
+			T await_resume()
+			{
+				auto &promise = _handle.promise();
+				if (promise._exception)
+					std::rethrow_exception(promise._exception);
+				return promise.take();
+			}
+
+		private:
+			handle_type _handle;
+		};
+
+	public:
+		Task()
+		    : _handle()
+		{
+		}
+
+		explicit Task(handle_type handle)
+		    : _handle(handle)
+		{
+		}
+
+		Task(Task &&other) noexcept
+		    : _handle(std::exchange(other._handle, handle_type()))
+		{
+		}
+
+		Task &operator=(Task &&other) noexcept
+		{
+			if (this != &other)
+			{
+				if (_handle)
+					_handle.destroy();
+				_handle = std::exchange(other._handle, handle_type());
+			}
+			return *this;
+		}
+
+		Task(const Task &) = delete;
+
+		Task &operator=(const Task &) = delete;
+
+		~Task()
+		{
+			if (_handle)
+				_handle.destroy();
+		}
+
+		awaiter operator co_await() const & noexcept
+		{
+			return awaiter(_handle);
+		}
+
+		awaiter operator co_await() const && noexcept
+		{
+			return awaiter(_handle);
+		}
+
+		bool valid() const { return static_cast<bool>(_handle); }
+
+		bool done() const { return _handle && _handle.done(); }
+
+		// Hands the frame over, e.g. to an Actor.
+		handle_type release() { return std::exchange(_handle, handle_type()); }
+
+	private:
+		handle_type _handle;
+	};
+} // namespace exec
+
+#endif // EXEC_TASK_H
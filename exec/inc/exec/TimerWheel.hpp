@@ -0,0 +1,241 @@
+#ifndef EXEC_TIMER_WHEEL_H
+#define EXEC_TIMER_WHEEL_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <vector>
+
+namespace exec
+{
+	// Hashed timer wheel: slot_count slots of tick_ns each, a timer in
+	// the slot of its deadline tick. schedule() and cancel() are O(1);
+	// poll() visits the slots of the ticks that passed and fires the
+	// timers that are due, so a timer further out than one turn of the
+	// wheel is passed over until its turn comes. Timers never fire early
+	// and at most one tick late (plus however late poll() runs).
+	//
+	// Timer nodes are recycled through a free list, so a warm wheel does
+	// not allocate. Not thread-safe: one loop owns it.
+	class TimerWheel
+	{
+	public:
+		using TimerId = std::uint64_t;
+		using OnTimerCallBack = std::function<void()>;
+
+		static constexpr TimerId NO_TIMER = 0;
+
+	public:
+		TimerWheel(std::int64_t tick_ns = 1000000,
+		           std::size_t slot_count = 1024, std::int64_t now_ns = 0)
+		    : _tick_ns(std::max<std::int64_t>(tick_ns, 1))
+		    , _current_tick(now_ns / _tick_ns)
+		    , _slots(std::max<std::size_t>(slot_count, 1), NIL)
+		    , _nodes()
+		    , _free()
+		    , _due()
+		    , _size(0)
+		{
+		}
+
+		TimerWheel(const TimerWheel &) = delete;
+
+		TimerWheel &operator=(const TimerWheel &) = delete;
+
+		// callback runs from poll() once now_ns reaches deadline_ns. A
+		// deadline in the past fires on the next tick.
+		TimerId schedule(std::int64_t deadline_ns, OnTimerCallBack &&callback)
+		{
+			std::uint32_t index;
+			if (_free.empty())
+			{
+				index = static_cast<std::uint32_t>(_nodes.size());
+				_nodes.emplace_back();
+			}
+			else
+			{
+				index = _free.back();
+				_free.pop_back();
+			}
+			auto &node = _nodes[index];
+			// Round up so that a timer never fires before its deadline.
+			node._deadline_tick = deadline_ns / _tick_ns +
+			                      (deadline_ns % _tick_ns > 0 ? 1 : 0);
+			node._state = node_state::LINKED;
+			node._callback = std::move(callback);
+			do_link(index);
+			++_size;
+			return do_id(index);
+		}
+
+		// False if the timer already fired or was cancelled.
+		bool cancel(TimerId id)
+		{
+			auto index = static_cast<std::uint32_t>(id);
+			if (index >= _nodes.size() ||
+			    _nodes[index]._generation != do_generation(id))
+				return false;
+			auto &node = _nodes[index];
+			if (node._state == node_state::LINKED)
+				do_unlink(index);
+			else if (node._state != node_state::DUE)
+				return false;
+			do_release(index);
+			return true;
+		}
+
+		// Fires every timer due at now_ns; returns how many fired.
+		// Callbacks may schedule and cancel timers; one they schedule
+		// fires on a later poll() at the earliest.
+		std::size_t poll(std::int64_t now_ns)
+		{
+			auto target = now_ns / _tick_ns;
+			if (target <= _current_tick)
+				return 0;
+			auto steps = std::min<std::int64_t>(
+			    target - _current_tick,
+			    static_cast<std::int64_t>(_slots.size()));
+			for (std::int64_t i = 1; i <= steps; ++i)
+			{
+				auto slot = do_slot(_current_tick + i);
+				auto index = _slots[slot];
+				while (index != NIL)
+				{
+					auto next = _nodes[index]._next;
+					if (_nodes[index]._deadline_tick <= target)
+					{
+						do_unlink(index);
+						_nodes[index]._state = node_state::DUE;
+						_due.push_back(do_id(index));
+					}
+					index = next;
+				}
+			}
+			_current_tick = target;
+			std::size_t fired = 0;
+			for (std::size_t i = 0; i < _due.size(); ++i)
+			{
+				auto id = _due[i];
+				auto index = static_cast<std::uint32_t>(id);
+				auto &node = _nodes[index];
+				if (node._generation != do_generation(id) ||
+				    node._state != node_state::DUE)
+					continue;
+				auto callback = std::move(node._callback);
+				do_release(index);
+				++fired;
+				callback();
+			}
+			_due.clear();
+			return fired;
+		}
+
+		// Timers scheduled and not yet fired or cancelled.
+		std::size_t size() const { return _size; }
+
+		std::int64_t tick_ns() const { return _tick_ns; }
+
+	private:
+		static constexpr std::uint32_t NIL =
+		    std::numeric_limits<std::uint32_t>::max();
+
+		enum class node_state : unsigned int
+		{
+			FREE,
+			LINKED,
+			DUE,
+		};
+
+		class timer_node
+		{
+		public:
+			std::int64_t _deadline_tick;
+			std::uint32_t _slot;
+			std::uint32_t _prev;
+			std::uint32_t _next;
+			std::uint32_t _generation;
+			node_state _state;
+			OnTimerCallBack _callback;
+			timer_node()
+			    : _deadline_tick(0)
+			    , _slot(0)
+			    , _prev(NIL)
+			    , _next(NIL)
+			    , _generation(1)
+			    , _state(node_state::FREE)
+			    , _callback()
+			{
+			}
+		};
+
+		std::int64_t _tick_ns;
+		// Last tick poll() processed.
+		std::int64_t _current_tick;
+		// Head node of each slot's list, or NIL.
+		std::vector<std::uint32_t> _slots;
+		std::vector<timer_node> _nodes;
+		std::vector<std::uint32_t> _free;
+		std::vector<TimerId> _due;
+		std::size_t _size;
+
+		std::size_t do_slot(std::int64_t tick) const
+		{
+			return static_cast<std::size_t>(tick) % _slots.size();
+		}
+
+		static std::uint32_t do_generation(TimerId id)
+		{
+			return static_cast<std::uint32_t>(id >> 32);
+		}
+
+		TimerId do_id(std::uint32_t index) const
+		{
+			return (static_cast<TimerId>(_nodes[index]._generation) << 32) |
+			       index;
+		}
+
+		// Timers already due go in the next slot poll() will visit.
+		void do_link(std::uint32_t index)
+		{
+			auto &node = _nodes[index];
+			node._slot = static_cast<std::uint32_t>(
+			    do_slot(std::max(node._deadline_tick, _current_tick + 1)));
+			node._prev = NIL;
+			node._next = _slots[node._slot];
+			if (node._next != NIL)
+				_nodes[node._next]._prev = index;
+			_slots[node._slot] = index;
+		}
+
+		void do_unlink(std::uint32_t index)
+		{
+			auto &node = _nodes[index];
+			if (node._prev != NIL)
+				_nodes[node._prev]._next = node._next;
+			else
+				_slots[node._slot] = node._next;
+			if (node._next != NIL)
+				_nodes[node._next]._prev = node._prev;
+			node._prev = NIL;
+			node._next = NIL;
+		}
+
+		// Bumping the generation retires the node's id, so neither a late
+		// cancel() nor a queued firing can reach its next timer. Zero is
+		// skipped to keep NO_TIMER unused.
+		void do_release(std::uint32_t index)
+		{
+			auto &node = _nodes[index];
+			node._state = node_state::FREE;
+			node._callback = nullptr;
+			if (++node._generation == 0)
+				node._generation = 1;
+			_free.push_back(index);
+			--_size;
+		}
+	};
+} // namespace exec
+
+#endif // EXEC_TIMER_WHEEL_H
@@ -0,0 +1,199 @@
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fa/OpportunityScanner.hpp>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+// The scanner's two paths over SYMBOLS symbols on three venues and two
+// pairs: one funding update re-evaluating its pairs, and the sweep of
+// every pair. The sweep's edge loop is repeated here twice, once as the
+// compiler builds it and once with vectorisation off, so the figures
+// show what vectorising it is worth; both must agree with the scanner
+// to the bit. A quarter of the hedge books are stale, so the sweep also
+// drops pairs. Exits 1 when the edges differ.
+
+using namespace fa;
+using Clock = std::chrono::steady_clock;
+
+static constexpr std::size_t SYMBOLS = 4096;
+static constexpr std::size_t SWEEPS = 2000;
+static constexpr std::size_t UPDATES = 1 << 21;
+static constexpr std::int64_t NOW_NS = 10000000000;
+
+static double elapsed_ns(Clock::time_point from)
+{
+	return std::chrono::duration<double, std::nano>(Clock::now() - from)
+	    .count();
+}
+
+// One venue's inputs, as the scanner derives them from its updates.
+class venue_inputs
+{
+public:
+	std::vector<double> _funding;
+	std::vector<double> _until;
+	std::vector<double> _half_spread;
+	venue_inputs()
+	    : _funding(SYMBOLS)
+	    , _until(SYMBOLS)
+	    , _half_spread(SYMBOLS)
+	{
+	}
+};
+
+// The scanner's edge for one symbol.
+static inline double edge_of(const venue_inputs &passive,
+                             const venue_inputs &hedge, double maker_fee,
+                             double taker_fee, double now, std::size_t s)
+{
+	auto valid = static_cast<double>(passive._until[s] >= now) *
+	             static_cast<double>(hedge._until[s] >= now);
+	auto edge = std::fabs(hedge._funding[s] - passive._funding[s]) -
+	            maker_fee - taker_fee - hedge._half_spread[s];
+	return valid * edge + (valid - 1) * std::numeric_limits<double>::max();
+}
+
+static void vector_edges(double *__restrict edges,
+                         const venue_inputs &passive,
+                         const venue_inputs &hedge, double maker_fee,
+                         double taker_fee, double now)
+{
+	for (std::size_t s = 0; s < SYMBOLS; ++s)
+		edges[s] = edge_of(passive, hedge, maker_fee, taker_fee, now, s);
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+__attribute__((optimize("no-tree-vectorize")))
+#endif
+static void scalar_edges(double *__restrict edges,
+                         const venue_inputs &passive,
+                         const venue_inputs &hedge, double maker_fee,
+                         double taker_fee, double now)
+{
+	for (std::size_t s = 0; s < SYMBOLS; ++s)
+		edges[s] = edge_of(passive, hedge, maker_fee, taker_fee, now, s);
+}
+
+// Mean time of SWEEPS rounds of edges() over both pairs into out.
+template <typename F>
+static double edges_ns(F &&edges, std::vector<double> &out,
+                       const std::vector<venue_inputs> &inputs,
+                       const double *maker_fee, const double *taker_fee,
+                       double now)
+{
+	auto start = Clock::now();
+	for (std::size_t i = 0; i < SWEEPS; ++i)
+	{
+		for (std::size_t p = 0; p < 2; ++p)
+			edges(out.data() + p * SYMBOLS, inputs[0], inputs[p + 1],
+			      maker_fee[0], taker_fee[p + 1], now);
+		asm volatile("" : : "r"(out.data()) : "memory");
+	}
+	return elapsed_ns(start) / static_cast<double>(SWEEPS);
+}
+
+int main(int, const char **)
+{
+	ScannerConfig config;
+	OpportunityScanner scanner(SYMBOLS, 3, config);
+	std::uint32_t venues[] = {scanner.add_venue("Hyperliquid"),
+	                          scanner.add_venue("Bybit"),
+	                          scanner.add_venue("Binance")};
+	std::uint32_t pairs[] = {scanner.add_pair(venues[0], venues[1]),
+	                         scanner.add_pair(venues[0], venues[2])};
+	double maker_fee[] = {1.5, 1, 1};
+	double taker_fee[] = {4.5, 5.5, 4};
+	for (std::size_t v = 0; v < 3; ++v)
+		scanner.set_fees(venues[v], maker_fee[v], taker_fee[v]);
+
+	std::mt19937 random(1);
+	std::vector<venue_inputs> inputs(3);
+	for (std::size_t s = 0; s < SYMBOLS; ++s)
+	{
+		std::string name("S");
+		name += std::to_string(s);
+		auto symbol = scanner.add_symbol(name);
+		for (std::size_t v = 0; v < 3; ++v)
+		{
+			auto &in = inputs[v];
+			auto bid = 100.0;
+			auto ask = 100.0 + 0.01 * static_cast<double>(random() % 5 + 1);
+			auto book_ns = v != 0 && random() % 4 == 0 ? 0 : NOW_NS;
+			auto funding = static_cast<double>(random() % 80) - 20;
+			scanner.update_book(symbol, venues[v], bid, ask, book_ns);
+			scanner.update_funding(symbol, venues[v], funding, book_ns);
+			in._funding[s] = funding;
+			in._until[s] =
+			    static_cast<double>(book_ns + config._max_book_age_ns);
+			in._half_spread[s] = (ask - bid) / (ask + bid) * 1e4;
+		}
+	}
+
+	auto start = Clock::now();
+	for (std::size_t i = 0; i < UPDATES; ++i)
+	{
+		auto symbol = static_cast<std::uint32_t>(i * 2654435761u % SYMBOLS);
+		auto v = i % 3;
+		scanner.update_funding(symbol, venues[v], inputs[v]._funding[symbol],
+		                       NOW_NS);
+	}
+	auto update_ns = elapsed_ns(start) / static_cast<double>(UPDATES);
+
+	auto now = NOW_NS + config._max_book_age_ns / 2;
+	start = Clock::now();
+	for (std::size_t i = 0; i < SWEEPS; ++i)
+		scanner.sweep(now);
+	auto sweep_ns = elapsed_ns(start) / static_cast<double>(SWEEPS);
+
+	std::vector<double> vector(2 * SYMBOLS);
+	std::vector<double> scalar(2 * SYMBOLS);
+	auto vector_ns = edges_ns(vector_edges, vector, inputs, maker_fee,
+	                          taker_fee, static_cast<double>(now));
+	auto scalar_ns = edges_ns(scalar_edges, scalar, inputs, maker_fee,
+	                          taker_fee, static_cast<double>(now));
+
+	std::size_t mismatches = 0;
+	std::size_t live = 0;
+	for (std::size_t p = 0; p < 2; ++p)
+	{
+		for (std::size_t s = 0; s < SYMBOLS; ++s)
+		{
+			auto edge = scanner.edge_bps(static_cast<std::uint32_t>(s),
+			                             pairs[p]);
+			mismatches += edge != vector[p * SYMBOLS + s];
+			mismatches += edge != scalar[p * SYMBOLS + s];
+			live += edge != OpportunityScanner::NO_EDGE;
+		}
+	}
+
+	std::vector<Candidate> out;
+	start = Clock::now();
+	for (std::size_t i = 0; i < SWEEPS; ++i)
+		scanner.candidates(out, 16);
+	auto rank_ns = elapsed_ns(start) / static_cast<double>(SWEEPS);
+
+	auto slots = static_cast<double>(2 * SYMBOLS);
+	std::cout << SYMBOLS << " symbols, 2 pairs, " << live << " of "
+	          << 2 * SYMBOLS << " pairs live" << std::endl;
+	std::cout << "update: " << update_ns << " ns per funding update"
+	          << std::endl;
+	std::cout << "sweep: " << sweep_ns << " ns, " << sweep_ns / slots
+	          << " ns per pair, hot set rebuilt" << std::endl;
+	std::cout << "edges, vectorised: " << vector_ns << " ns, "
+	          << vector_ns / slots << " ns per pair" << std::endl;
+	std::cout << "edges, scalar: " << scalar_ns << " ns, "
+	          << scalar_ns / slots << " ns per pair" << std::endl;
+	std::cout << "candidates(16): " << rank_ns << " ns" << std::endl;
+	if (mismatches != 0)
+	{
+		std::cout << mismatches << " edges differ from the scanner's"
+		          << std::endl;
+		return 1;
+	}
+	return 0;
+}
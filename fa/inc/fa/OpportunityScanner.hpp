@@ -0,0 +1,521 @@
+#ifndef FA_OPPORTUNITY_SCANNER_H
+#define FA_OPPORTUNITY_SCANNER_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace fa
+{
+	// Scanner settings (spec §4 funding_arb.*, §5 feed heartbeat).
+	class ScannerConfig
+	{
+	public:
+		double _min_edge_bps;
+		// Entry orders a symbol may have open at once.
+		std::uint32_t _max_open_orders;
+		std::int64_t _sweep_interval_ns;
+		// A book older than this does not count.
+		std::int64_t _max_book_age_ns;
+		ScannerConfig()
+		    : _min_edge_bps(20)
+		    , _max_open_orders(4)
+		    , _sweep_interval_ns(100000000)
+		    , _max_book_age_ns(1000000000)
+		{
+		}
+	};
+
+	// Side of the passive entry. The values are those of schema::Side,
+	// so a cast carries it into a message.
+	enum class Side : std::uint8_t
+	{
+		BUY = 0,
+		SELL = 1,
+	};
+
+	// An entry the Funding-Arb FSM may start (spec §3.1): post on the
+	// passive venue at its mid on _side, hedge on the other venue.
+	class Candidate
+	{
+	public:
+		std::uint32_t _symbol;
+		std::uint32_t _passive_venue;
+		std::uint32_t _hedge_venue;
+		Side _side;
+		double _edge_bps;
+		double _entry_price;
+	};
+
+	// Funding-arb opportunities for every symbol on every venue pair.
+	// A pair is a passive venue, where the entry posts (Hyperliquid),
+	// and a hedge venue (Bybit, Binance). Its edge is the predicted
+	// funding differential less the maker fee on the passive venue, the
+	// taker fee on the hedge venue and half the hedge venue's spread,
+	// all in the units of min_edge_bps. A pair is a candidate while its
+	// edge is at least min_edge_bps and both books are fresh.
+	//
+	// Inputs live in struct-of-arrays form, one array per field and
+	// venue, indexed by symbol, and edges in one array per pair. A
+	// funding or book update re-evaluates only the pairs of its
+	// (symbol, venue). poll() also sweeps every pair on schedule; the
+	// sweep is a straight loop over the arrays that the compiler
+	// vectorises, and it is what expires books that stopped updating.
+	//
+	// Candidates above the threshold are tracked as they change, so
+	// candidates() sorts only those, best edge first, and keeps to
+	// max_open_orders per symbol given the orders already open.
+	//
+	// One thread owns the scanner. Symbols, venues and pairs are added
+	// during setup.
+	class OpportunityScanner
+	{
+	public:
+		static constexpr std::uint32_t NO_SYMBOL =
+		    std::numeric_limits<std::uint32_t>::max();
+		static constexpr std::uint32_t NO_VENUE =
+		    std::numeric_limits<std::uint32_t>::max();
+		static constexpr std::uint32_t NO_PAIR =
+		    std::numeric_limits<std::uint32_t>::max();
+		// Edge of a pair that cannot trade: a funding rate is unknown or
+		// a book is one-sided or stale.
+		static constexpr double NO_EDGE = std::numeric_limits<double>::lowest();
+
+	public:
+		OpportunityScanner(std::size_t max_symbols, std::size_t max_venues,
+		                   const ScannerConfig &config = ScannerConfig())
+		    : _max_symbols(max_symbols)
+		    , _max_venues(max_venues)
+		    , _config(config)
+		    , _funding(do_array(max_venues * max_symbols, 0))
+		    , _bid(do_array(max_venues * max_symbols, 0))
+		    , _ask(do_array(max_venues * max_symbols, 0))
+		    , _half_spread(do_array(max_venues * max_symbols, 0))
+		    , _valid_until(do_array(max_venues * max_symbols, NO_EDGE))
+		    , _maker_fee(do_array(max_venues * max_symbols, 0))
+		    , _taker_fee(do_array(max_venues * max_symbols, 0))
+		    , _book_ns(std::make_unique<std::int64_t[]>(max_venues *
+		                                                max_symbols))
+		    , _funding_known(std::make_unique<bool[]>(max_venues *
+		                                              max_symbols))
+		    , _open_orders(std::make_unique<std::uint32_t[]>(max_symbols))
+		    , _taken(std::make_unique<std::uint32_t[]>(max_symbols))
+		    , _pairs()
+		    , _venue_pairs(max_venues)
+		    , _edges()
+		    , _hot_index()
+		    , _hot()
+		    , _ranked()
+		    , _next_sweep_ns(std::numeric_limits<std::int64_t>::min())
+		    , _symbol_names()
+		    , _venue_names()
+		    , _symbols()
+		{
+			_symbol_names.reserve(max_symbols);
+			_venue_names.reserve(max_venues);
+		}
+
+		OpportunityScanner(const OpportunityScanner &) = delete;
+
+		OpportunityScanner &operator=(const OpportunityScanner &) = delete;
+
+		// NO_SYMBOL once max_symbols are taken.
+		std::uint32_t add_symbol(const std::string &name)
+		{
+			auto it = _symbols.find(name);
+			if (it != _symbols.end())
+				return it->second;
+			if (_symbol_names.size() >= _max_symbols)
+				return NO_SYMBOL;
+			auto id = static_cast<std::uint32_t>(_symbol_names.size());
+			_symbol_names.push_back(name);
+			_symbols.emplace(name, id);
+			return id;
+		}
+
+		std::uint32_t symbol_id(const std::string &name) const
+		{
+			auto it = _symbols.find(name);
+			return it == _symbols.end() ? NO_SYMBOL : it->second;
+		}
+
+		std::size_t symbol_count() const { return _symbol_names.size(); }
+
+		const std::string &symbol_name(std::uint32_t symbol) const
+		{
+			return _symbol_names[symbol];
+		}
+
+		// NO_VENUE once max_venues are taken.
+		std::uint32_t add_venue(const std::string &name)
+		{
+			for (std::size_t i = 0; i < _venue_names.size(); ++i)
+			{
+				if (_venue_names[i] == name)
+					return static_cast<std::uint32_t>(i);
+			}
+			if (_venue_names.size() >= _max_venues)
+				return NO_VENUE;
+			_venue_names.push_back(name);
+			return static_cast<std::uint32_t>(_venue_names.size() - 1);
+		}
+
+		std::size_t venue_count() const { return _venue_names.size(); }
+
+		const std::string &venue_name(std::uint32_t venue) const
+		{
+			return _venue_names[venue];
+		}
+
+		// NO_PAIR for an unknown or repeated venue.
+		std::uint32_t add_pair(std::uint32_t passive_venue,
+		                       std::uint32_t hedge_venue)
+		{
+			if (passive_venue >= _venue_names.size() ||
+			    hedge_venue >= _venue_names.size() ||
+			    passive_venue == hedge_venue)
+				return NO_PAIR;
+			for (std::size_t i = 0; i < _pairs.size(); ++i)
+			{
+				if (_pairs[i]._passive == passive_venue &&
+				    _pairs[i]._hedge == hedge_venue)
+					return static_cast<std::uint32_t>(i);
+			}
+			auto id = static_cast<std::uint32_t>(_pairs.size());
+			venue_pair pair;
+			pair._passive = passive_venue;
+			pair._hedge = hedge_venue;
+			_pairs.push_back(pair);
+			_venue_pairs[passive_venue].push_back(id);
+			_venue_pairs[hedge_venue].push_back(id);
+			_edges.resize(_pairs.size() * _max_symbols, NO_EDGE);
+			_hot_index.resize(_pairs.size() * _max_symbols, NOT_HOT);
+			return id;
+		}
+
+		std::size_t pair_count() const { return _pairs.size(); }
+
+		// Fees in bps of notional, for every symbol on venue.
+		void set_fees(std::uint32_t venue, double maker_bps, double taker_bps)
+		{
+			for (std::size_t s = 0; s < _max_symbols; ++s)
+				set_fees(static_cast<std::uint32_t>(s), venue, maker_bps,
+				         taker_bps);
+		}
+
+		// Fees for one symbol, e.g. a tier with its own schedule.
+		void set_fees(std::uint32_t symbol, std::uint32_t venue,
+		              double maker_bps, double taker_bps)
+		{
+			auto index = do_index(symbol, venue);
+			_maker_fee[index] = maker_bps;
+			_taker_fee[index] = taker_bps;
+			do_reprice(symbol, venue);
+		}
+
+		void set_min_edge(double min_edge_bps)
+		{
+			_config._min_edge_bps = min_edge_bps;
+			do_rebuild_hot();
+		}
+
+		void set_max_open_orders(std::uint32_t max_open_orders)
+		{
+			_config._max_open_orders = max_open_orders;
+		}
+
+		// Entry orders the FSM has open for symbol.
+		void set_open_orders(std::uint32_t symbol, std::uint32_t count)
+		{
+			_open_orders[symbol] = count;
+		}
+
+		// Predicted funding rate, in the units of min_edge_bps.
+		void update_funding(std::uint32_t symbol, std::uint32_t venue,
+		                    double funding_bps, std::int64_t timestamp_ns)
+		{
+			auto index = do_index(symbol, venue);
+			_funding_known[index] = funding_bps == funding_bps;
+			_funding[index] = _funding_known[index] ? funding_bps : 0;
+			do_refresh(index);
+			do_touch(symbol, venue, timestamp_ns);
+		}
+
+		// Top of book; a side that is gone is 0.
+		void update_book(std::uint32_t symbol, std::uint32_t venue,
+		                 double bid, double ask, std::int64_t timestamp_ns)
+		{
+			auto index = do_index(symbol, venue);
+			_bid[index] = bid;
+			_ask[index] = ask;
+			_book_ns[index] = timestamp_ns;
+			do_refresh(index);
+			do_touch(symbol, venue, timestamp_ns);
+		}
+
+		// Sweeps every pair once sweep_interval_ns has passed since the
+		// last sweep; returns true if it did.
+		bool poll(std::int64_t now_ns)
+		{
+			if (now_ns < _next_sweep_ns)
+				return false;
+			sweep(now_ns);
+			return true;
+		}
+
+		// Re-evaluates every symbol on every pair.
+		void sweep(std::int64_t now_ns)
+		{
+			auto now = static_cast<double>(now_ns);
+			auto count = _symbol_names.size();
+			for (std::size_t p = 0; p < _pairs.size(); ++p)
+			{
+				auto passive = _pairs[p]._passive * _max_symbols;
+				auto hedge = _pairs[p]._hedge * _max_symbols;
+				do_sweep(_edges.data() + p * _max_symbols,
+				         _funding.get() + passive, _funding.get() + hedge,
+				         _valid_until.get() + passive,
+				         _valid_until.get() + hedge,
+				         _maker_fee.get() + passive,
+				         _taker_fee.get() + hedge,
+				         _half_spread.get() + hedge, now, count);
+			}
+			do_rebuild_hot();
+			_next_sweep_ns = now_ns + _config._sweep_interval_ns;
+		}
+
+		double edge_bps(std::uint32_t symbol, std::uint32_t pair) const
+		{
+			return _edges[pair * _max_symbols + symbol];
+		}
+
+		// Candidates, best edge first, at most max_count, and per symbol
+		// no more than max_open_orders less the orders already open.
+		void candidates(std::vector<Candidate> &out,
+		                std::size_t max_count =
+		                    std::numeric_limits<std::size_t>::max())
+		{
+			out.clear();
+			_ranked.assign(_hot.begin(), _hot.end());
+			std::sort(_ranked.begin(), _ranked.end(),
+			          [this](std::uint32_t a, std::uint32_t b)
+			          {
+				          return _edges[a] > _edges[b] ||
+				                 (_edges[a] == _edges[b] && a < b);
+			          });
+			for (auto slot : _ranked)
+			{
+				if (out.size() >= max_count)
+					break;
+				auto symbol = static_cast<std::uint32_t>(slot % _max_symbols);
+				if (_open_orders[symbol] + _taken[symbol] >=
+				    _config._max_open_orders)
+					continue;
+				++_taken[symbol];
+				auto &pair = _pairs[slot / _max_symbols];
+				auto passive = do_index(symbol, pair._passive);
+				auto hedge = do_index(symbol, pair._hedge);
+				Candidate candidate;
+				candidate._symbol = symbol;
+				candidate._passive_venue = pair._passive;
+				candidate._hedge_venue = pair._hedge;
+				// Receive the higher funding on the short leg.
+				candidate._side = _funding[hedge] > _funding[passive]
+				                      ? Side::BUY
+				                      : Side::SELL;
+				candidate._edge_bps = _edges[slot];
+				candidate._entry_price =
+				    0.5 * (_bid[passive] + _ask[passive]);
+				out.push_back(candidate);
+			}
+			for (auto &candidate : out)
+				_taken[candidate._symbol] = 0;
+		}
+
+	private:
+		static constexpr std::uint32_t NOT_HOT =
+		    std::numeric_limits<std::uint32_t>::max();
+
+		class venue_pair
+		{
+		public:
+			std::uint32_t _passive;
+			std::uint32_t _hedge;
+			venue_pair()
+			    : _passive(0)
+			    , _hedge(0)
+			{
+			}
+		};
+
+		std::size_t _max_symbols;
+		std::size_t _max_venues;
+		ScannerConfig _config;
+		// Per venue, then symbol: venue * max_symbols + symbol.
+		std::unique_ptr<double[]> _funding;
+		std::unique_ptr<double[]> _bid;
+		std::unique_ptr<double[]> _ask;
+		std::unique_ptr<double[]> _half_spread;
+		// Book time plus max_book_age_ns while the funding rate is known
+		// and the book two-sided, NO_EDGE otherwise.
+		std::unique_ptr<double[]> _valid_until;
+		std::unique_ptr<double[]> _maker_fee;
+		std::unique_ptr<double[]> _taker_fee;
+		std::unique_ptr<std::int64_t[]> _book_ns;
+		std::unique_ptr<bool[]> _funding_known;
+		// Per symbol.
+		std::unique_ptr<std::uint32_t[]> _open_orders;
+		std::unique_ptr<std::uint32_t[]> _taken;
+		std::vector<venue_pair> _pairs;
+		std::vector<std::vector<std::uint32_t>> _venue_pairs;
+		// Per pair, then symbol: pair * max_symbols + symbol.
+		std::vector<double> _edges;
+		// Position of a slot in _hot, or NOT_HOT.
+		std::vector<std::uint32_t> _hot_index;
+		// Slots whose edge clears min_edge_bps.
+		std::vector<std::uint32_t> _hot;
+		std::vector<std::uint32_t> _ranked;
+		std::int64_t _next_sweep_ns;
+		std::vector<std::string> _symbol_names;
+		std::vector<std::string> _venue_names;
+		std::unordered_map<std::string, std::uint32_t> _symbols;
+
+		static std::unique_ptr<double[]> do_array(std::size_t size,
+		                                          double value)
+		{
+			auto array = std::make_unique<double[]>(size);
+			std::fill_n(array.get(), size, value);
+			return array;
+		}
+
+		std::size_t do_index(std::uint32_t symbol, std::uint32_t venue) const
+		{
+			return static_cast<std::size_t>(venue) * _max_symbols + symbol;
+		}
+
+		void do_refresh(std::size_t index)
+		{
+			auto bid = _bid[index];
+			auto ask = _ask[index];
+			bool ready = _funding_known[index] && bid > 0 && ask > bid;
+			_half_spread[index] = ready ? (ask - bid) / (ask + bid) * 1e4 : 0;
+			_valid_until[index] =
+			    ready ? static_cast<double>(_book_ns[index] +
+			                                _config._max_book_age_ns)
+			          : NO_EDGE;
+		}
+
+		// NO_EDGE unless both sides are valid at now. Arithmetic only,
+		// two compares and no select, so that the sweep vectorises.
+		static double do_edge(double passive_funding, double hedge_funding,
+		                      double passive_until, double hedge_until,
+		                      double maker_fee, double taker_fee,
+		                      double half_spread, double now)
+		{
+			auto valid = static_cast<double>(passive_until >= now) *
+			             static_cast<double>(hedge_until >= now);
+			auto edge = std::fabs(hedge_funding - passive_funding) -
+			            maker_fee - taker_fee - half_spread;
+			return valid * edge +
+			       (valid - 1) * std::numeric_limits<double>::max();
+		}
+
+		static void do_sweep(double *__restrict edges,
+		                     const double *__restrict passive_funding,
+		                     const double *__restrict hedge_funding,
+		                     const double *__restrict passive_until,
+		                     const double *__restrict hedge_until,
+		                     const double *__restrict maker_fee,
+		                     const double *__restrict taker_fee,
+		                     const double *__restrict half_spread,
+		                     double now, std::size_t count)
+		{
+			for (std::size_t s = 0; s < count; ++s)
+				edges[s] = do_edge(passive_funding[s], hedge_funding[s],
+				                   passive_until[s], hedge_until[s],
+				                   maker_fee[s], taker_fee[s],
+				                   half_spread[s], now);
+		}
+
+		// Re-evaluates the pairs venue is in, for symbol.
+		void do_touch(std::uint32_t symbol, std::uint32_t venue,
+		              std::int64_t now_ns)
+		{
+			auto now = static_cast<double>(now_ns);
+			for (auto p : _venue_pairs[venue])
+			{
+				auto passive = do_index(symbol, _pairs[p]._passive);
+				auto hedge = do_index(symbol, _pairs[p]._hedge);
+				do_set(p * _max_symbols + symbol,
+				       do_edge(_funding[passive], _funding[hedge],
+				               _valid_until[passive], _valid_until[hedge],
+				               _maker_fee[passive], _taker_fee[hedge],
+				               _half_spread[hedge], now));
+			}
+		}
+
+		// Re-evaluates the pairs venue is in, for symbol, after a fee
+		// change. A pair keeps the validity of its last evaluation: one
+		// that had no edge keeps none, and for the others NO_EDGE as now
+		// leaves both sides valid.
+		void do_reprice(std::uint32_t symbol, std::uint32_t venue)
+		{
+			for (auto p : _venue_pairs[venue])
+			{
+				auto slot = p * _max_symbols + symbol;
+				if (_edges[slot] == NO_EDGE)
+					continue;
+				auto passive = do_index(symbol, _pairs[p]._passive);
+				auto hedge = do_index(symbol, _pairs[p]._hedge);
+				do_set(slot,
+				       do_edge(_funding[passive], _funding[hedge],
+				               _valid_until[passive], _valid_until[hedge],
+				               _maker_fee[passive], _taker_fee[hedge],
+				               _half_spread[hedge], NO_EDGE));
+			}
+		}
+
+		void do_set(std::size_t slot, double edge)
+		{
+			_edges[slot] = edge;
+			bool hot = edge >= _config._min_edge_bps;
+			auto &index = _hot_index[slot];
+			if (hot && index == NOT_HOT)
+			{
+				index = static_cast<std::uint32_t>(_hot.size());
+				_hot.push_back(static_cast<std::uint32_t>(slot));
+			}
+			else if (!hot && index != NOT_HOT)
+			{
+				auto last = _hot.back();
+				_hot[index] = last;
+				_hot_index[last] = index;
+				_hot.pop_back();
+				index = NOT_HOT;
+			}
+		}
+
+		void do_rebuild_hot()
+		{
+			_hot.clear();
+			for (std::size_t slot = 0; slot < _edges.size(); ++slot)
+			{
+				if (_edges[slot] >= _config._min_edge_bps)
+				{
+					_hot_index[slot] = static_cast<std::uint32_t>(_hot.size());
+					_hot.push_back(static_cast<std::uint32_t>(slot));
+				}
+				else
+					_hot_index[slot] = NOT_HOT;
+			}
+		}
+	};
+} // namespace fa
+
+#endif // FA_OPPORTUNITY_SCANNER_H
@@ -0,0 +1,57 @@
+#ifndef IPC_LAYOUT_H
+#define IPC_LAYOUT_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ipc
+{
+	// Layout of a shared-memory channel. A RingHeader is followed by
+	// slot_count slots of slot_size bytes each. A slot is a SlotHeader,
+	// then the channel name, then the payload. The counters that
+	// publishers and readers write sit on separate cache lines. All
+	// fields are host-endian, both ends run on the same machine.
+	//
+	// Message n lives in slot n % slot_count. The slot's _sequence is
+	// 2n + 1 while it is being written and 2n + 2 once the message is
+	// complete; 0 means the slot was never written.
+	constexpr std::uint64_t RING_MAGIC = 0x31304d4853435049; // IPCSHM01
+	constexpr std::uint32_t LAYOUT_VERSION = 1;
+	constexpr std::size_t CACHE_LINE = 64;
+
+	class RingHeader
+	{
+	public:
+		std::uint64_t _magic;
+		std::uint32_t _version;
+		std::uint32_t _header_size;
+		std::uint64_t _slot_count;
+		std::uint64_t _slot_size;
+		std::uint64_t _reserved[4];
+		// Next sequence number to hand to a publisher.
+		alignas(CACHE_LINE) std::uint64_t _claim;
+		// Bumped on each publish that finds sleeping readers; the futex
+		// word they wait on.
+		alignas(CACHE_LINE) std::uint32_t _wake;
+		std::uint32_t _waiters;
+	};
+	static_assert(sizeof(RingHeader) == 3 * CACHE_LINE);
+
+	class SlotHeader
+	{
+	public:
+		std::uint64_t _sequence;
+		std::uint32_t _length;
+		std::uint16_t _channel_length;
+		std::uint16_t _flags;
+	};
+	static_assert(sizeof(SlotHeader) == 16);
+
+	// Largest channel name plus payload a slot of slot_size carries.
+	constexpr std::size_t slot_capacity(std::size_t slot_size)
+	{
+		return slot_size - sizeof(SlotHeader);
+	}
+} // namespace ipc
+
+#endif // IPC_LAYOUT_H
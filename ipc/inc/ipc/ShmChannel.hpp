@@ -0,0 +1,426 @@
+#ifndef IPC_SHM_CHANNEL_H
+#define IPC_SHM_CHANNEL_H
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <functional>
+#include <ipc/Layout.hpp>
+#include <linux/futex.h>
+#include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace ipc
+{
+	// What a service needs from a pub/sub transport. ShmChannel and
+	// net::redis::Client both fit, so a service templated on it runs
+	// over either.
+	template <typename T>
+	concept PubSubTransport =
+	    requires(T transport, std::string_view text, const std::string &name,
+	             std::function<void(std::string_view, std::string_view)> fn) {
+		    transport.publish(text, text);
+		    transport.subscribe(name, std::move(fn));
+		    transport.unsubscribe(name);
+		    transport.poll();
+	    };
+
+	// Broadcast ring in POSIX shared memory for services on one host.
+	// Any number of processes and threads publish into it; every reader
+	// sees every message, in sequence order, and keeps its own position.
+	// A publisher claims a sequence number with one fetch_add and writes
+	// its slot under a per-slot seqlock, so readers never block writers.
+	// A reader that falls a whole ring behind skips to the oldest intact
+	// message and counts the loss in dropped().
+	//
+	// Readers either spin on poll() or sleep in wait() on a futex, which
+	// a publisher only wakes when someone is sleeping. A publisher that
+	// dies in the middle of a write stalls the readers at that slot.
+	//
+	// One ShmChannel is used from one thread.
+	class ShmChannel
+	{
+	public:
+		// channel, payload; valid during the call only.
+		using OnMessageCallBack =
+		    std::function<void(std::string_view, std::string_view)>;
+
+		static constexpr std::size_t DEFAULT_SLOT_COUNT = 4096;
+		static constexpr std::size_t DEFAULT_SLOT_SIZE = 256;
+
+	public:
+		ShmChannel()
+		    : _header(nullptr)
+		    , _slots(nullptr)
+		    , _mapped_size(0)
+		    , _slot_count(0)
+		    , _slot_size(0)
+		    , _next(0)
+		    , _dropped(0)
+		    , _channels()
+		    , _scratch()
+		    , _last_error("")
+		{
+		}
+
+		ShmChannel(const ShmChannel &) = delete;
+
+		ShmChannel &operator=(const ShmChannel &) = delete;
+
+		~ShmChannel() { close(); }
+
+		// Map the ring called name (a shm name such as "/hf.fills"),
+		// creating it with this geometry if it does not exist. An existing
+		// ring keeps its own geometry. slot_count must be a power of two
+		// and slot_size a multiple of 64. Reading starts at the next
+		// message published.
+		bool open(const std::string &name,
+		          std::size_t slot_count = DEFAULT_SLOT_COUNT,
+		          std::size_t slot_size = DEFAULT_SLOT_SIZE)
+		{
+			close();
+			if (slot_count == 0 || (slot_count & (slot_count - 1)) != 0 ||
+			    slot_size < 2 * CACHE_LINE || slot_size % CACHE_LINE != 0)
+				return do_fail("invalid ring geometry");
+			int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+			bool created = fd >= 0;
+			if (!created && errno == EEXIST)
+				fd = ::shm_open(name.c_str(), O_RDWR, 0);
+			if (fd < 0)
+				return do_fail("shm_open " + name + ": " + strerror(errno));
+			std::size_t size = sizeof(RingHeader) + slot_count * slot_size;
+			if (created && ::ftruncate(fd, static_cast<off_t>(size)) != 0)
+			{
+				auto err = errno;
+				::close(fd);
+				::shm_unlink(name.c_str());
+				return do_fail("ftruncate " + name + ": " + strerror(err));
+			}
+			if (!created && !do_wait_size(fd, size))
+			{
+				::close(fd);
+				return do_fail("ring " + name + " was never initialised");
+			}
+			void *base = ::mmap(nullptr, size, PROT_READ | PROT_WRITE,
+			                    MAP_SHARED | MAP_POPULATE, fd, 0);
+			::close(fd);
+			if (base == MAP_FAILED)
+				return do_fail("mmap " + name + ": " + strerror(errno));
+			_header = static_cast<RingHeader *>(base);
+			_slots = static_cast<char *>(base) + sizeof(RingHeader);
+			_mapped_size = size;
+			if (created)
+				do_init_header(slot_count, slot_size);
+			else if (!do_check_header())
+			{
+				close();
+				return do_fail("ring " + name + " has a different layout");
+			}
+			_slot_count = _header->_slot_count;
+			_slot_size = _header->_slot_size;
+			_scratch.resize(_slot_size);
+			_next = std::atomic_ref<std::uint64_t>(_header->_claim)
+			            .load(std::memory_order_acquire);
+			_dropped = 0;
+			return true;
+		}
+
+		void close()
+		{
+			if (_header)
+				::munmap(_header, _mapped_size);
+			_header = nullptr;
+			_slots = nullptr;
+			_mapped_size = 0;
+		}
+
+		// The ring lives until every process unmapped it after this.
+		static bool unlink(const std::string &name)
+		{
+			return ::shm_unlink(name.c_str()) == 0;
+		}
+
+		bool is_open() const { return _header != nullptr; }
+
+		// Returns false if the channel is not open or channel plus
+		// message do not fit in a slot.
+		bool publish(std::string_view channel, std::string_view message)
+		{
+			auto length = channel.size() + message.size();
+			if (!_header || channel.size() > 0xffff ||
+			    length > slot_capacity(_slot_size))
+				return false;
+			auto seq = std::atomic_ref<std::uint64_t>(_header->_claim)
+			               .fetch_add(1, std::memory_order_relaxed);
+			auto slot = do_slot(seq);
+			std::atomic_ref<std::uint64_t> state(slot->_sequence);
+			// The publisher one lap earlier may still be writing here.
+			auto previous = seq >= _slot_count
+			                    ? 2 * (seq - _slot_count) + 2
+			                    : std::uint64_t(0);
+			auto expected = previous;
+			while (!state.compare_exchange_weak(expected, 2 * seq + 1,
+			                                    std::memory_order_relaxed))
+			{
+				expected = previous;
+				cpu_relax();
+			}
+			std::atomic_thread_fence(std::memory_order_release);
+			slot->_length = static_cast<std::uint32_t>(length);
+			slot->_channel_length = static_cast<std::uint16_t>(channel.size());
+			slot->_flags = 0;
+			auto body = reinterpret_cast<char *>(slot + 1);
+			std::memcpy(body, channel.data(), channel.size());
+			std::memcpy(body + channel.size(), message.data(),
+			            message.size());
+			state.store(2 * seq + 2, std::memory_order_release);
+			// Pairs with the fence in wait(): either the sleeper sees this
+			// message or this sees the sleeper.
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (std::atomic_ref<std::uint32_t>(_header->_waiters)
+			        .load(std::memory_order_relaxed) > 0)
+				do_wake();
+			return true;
+		}
+
+		void subscribe(const std::string &channel,
+		               OnMessageCallBack &&on_message)
+		{
+			_channels[channel] = std::move(on_message);
+		}
+
+		void unsubscribe(const std::string &channel)
+		{
+			_channels.erase(channel);
+		}
+
+		// Hand up to max_messages published messages to their channel's
+		// handler; messages on other channels are skipped. Returns the
+		// number of messages read, delivered or not.
+		std::size_t poll(std::size_t max_messages = 1024)
+		{
+			std::size_t count = 0;
+			while (_header && count < max_messages)
+			{
+				auto slot = do_slot(_next);
+				std::atomic_ref<std::uint64_t> state(slot->_sequence);
+				auto want = 2 * _next + 2;
+				auto before = state.load(std::memory_order_acquire);
+				if (before < want)
+					break;
+				if (before > want)
+				{
+					do_resync();
+					continue;
+				}
+				std::size_t length = slot->_length;
+				std::size_t channel_length = slot->_channel_length;
+				auto body = reinterpret_cast<const char *>(slot + 1);
+				// A torn header is caught by the sequence check below.
+				if (length > slot_capacity(_slot_size) ||
+				    channel_length > length)
+					length = channel_length = 0;
+				std::memcpy(_scratch.data(), body, channel_length);
+				std::string_view channel(_scratch.data(), channel_length);
+				auto it = _channels.find(channel);
+				if (it != _channels.end())
+					std::memcpy(_scratch.data() + channel_length,
+					            body + channel_length,
+					            length - channel_length);
+				std::atomic_thread_fence(std::memory_order_acquire);
+				if (state.load(std::memory_order_relaxed) != before)
+				{
+					do_resync();
+					continue;
+				}
+				++_next;
+				++count;
+				if (it == _channels.end())
+					continue;
+				std::string_view payload(_scratch.data() + channel_length,
+				                         length - channel_length);
+				it->second(channel, payload);
+			}
+			return count;
+		}
+
+		// Sleep until a message is ready to poll() or timeout_ns passed.
+		// Returns true if a message is ready.
+		bool wait(std::int64_t timeout_ns)
+		{
+			if (!_header)
+				return false;
+			if (do_ready())
+				return true;
+			std::atomic_ref<std::uint32_t> wake(_header->_wake);
+			std::atomic_ref<std::uint32_t> waiters(_header->_waiters);
+			auto seen = wake.load(std::memory_order_acquire);
+			waiters.fetch_add(1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (!do_ready())
+			{
+				timespec timeout;
+				timeout.tv_sec = static_cast<time_t>(timeout_ns / 1000000000);
+				timeout.tv_nsec = static_cast<long>(timeout_ns % 1000000000);
+				::syscall(SYS_futex, &_header->_wake, FUTEX_WAIT, seen,
+				          &timeout, nullptr, 0);
+			}
+			waiters.fetch_sub(1, std::memory_order_relaxed);
+			return do_ready();
+		}
+
+		// Messages this reader lost by falling a whole ring behind.
+		std::uint64_t dropped() const { return _dropped; }
+
+		// Largest channel name plus payload publish() accepts.
+		std::size_t max_message_size() const
+		{
+			return _header ? slot_capacity(_slot_size) : 0;
+		}
+
+		const std::string &last_error() const { return _last_error; }
+
+	private:
+		static_assert(std::atomic_ref<std::uint64_t>::is_always_lock_free,
+		              "the ring needs address-free 64-bit atomics");
+
+		// Lets messages find their handler without a std::string.
+		class name_hash
+		{
+		public:
+			using is_transparent = void;
+			std::size_t operator()(std::string_view name) const
+			{
+				return std::hash<std::string_view>()(name);
+			}
+		};
+
+		static constexpr int OPEN_WAIT_TRIES = 1000;
+
+		RingHeader *_header;
+		char *_slots;
+		std::size_t _mapped_size;
+		std::uint64_t _slot_count;
+		std::uint64_t _slot_size;
+		// Sequence number of the next message to read.
+		std::uint64_t _next;
+		std::uint64_t _dropped;
+		std::unordered_map<std::string, OnMessageCallBack, name_hash,
+		                   std::equal_to<>>
+		    _channels;
+		// Copy of the slot being read, taken before the writer can
+		// reuse it.
+		std::vector<char> _scratch;
+		std::string _last_error;
+
+		static void cpu_relax()
+		{
+#if defined(__x86_64__) || defined(__i386__)
+			_mm_pause();
+#endif
+		}
+
+		bool do_fail(const std::string &error)
+		{
+			_last_error = error;
+			return false;
+		}
+
+		SlotHeader *do_slot(std::uint64_t seq) const
+		{
+			return reinterpret_cast<SlotHeader *>(
+			    _slots + (seq & (_slot_count - 1)) * _slot_size);
+		}
+
+		bool do_ready() const
+		{
+			std::atomic_ref<std::uint64_t> state(do_slot(_next)->_sequence);
+			return state.load(std::memory_order_acquire) >= 2 * _next + 2;
+		}
+
+		// Lapped: continue from the oldest message that can still be
+		// intact.
+		void do_resync()
+		{
+			auto claim = std::atomic_ref<std::uint64_t>(_header->_claim)
+			                 .load(std::memory_order_acquire);
+			auto oldest = claim > _slot_count ? claim - _slot_count : 0;
+			if (oldest <= _next)
+				oldest = _next + 1;
+			_dropped += oldest - _next;
+			_next = oldest;
+		}
+
+		void do_wake()
+		{
+			std::atomic_ref<std::uint32_t>(_header->_wake)
+			    .fetch_add(1, std::memory_order_release);
+			::syscall(SYS_futex, &_header->_wake, FUTEX_WAKE, INT32_MAX,
+			          nullptr, nullptr, 0);
+		}
+
+		void do_init_header(std::size_t slot_count, std::size_t slot_size)
+		{
+			_header->_version = LAYOUT_VERSION;
+			_header->_header_size = sizeof(RingHeader);
+			_header->_slot_count = slot_count;
+			_header->_slot_size = slot_size;
+			// The magic goes last, openers wait for it.
+			std::atomic_ref<std::uint64_t>(_header->_magic)
+			    .store(RING_MAGIC, std::memory_order_release);
+		}
+
+		bool do_check_header()
+		{
+			std::atomic_ref<std::uint64_t> magic(_header->_magic);
+			for (int i = 0; i < OPEN_WAIT_TRIES; ++i)
+			{
+				if (magic.load(std::memory_order_acquire) == RING_MAGIC)
+					break;
+				::usleep(1000);
+			}
+			return magic.load(std::memory_order_acquire) == RING_MAGIC &&
+			       _header->_version == LAYOUT_VERSION &&
+			       _header->_header_size == sizeof(RingHeader) &&
+			       sizeof(RingHeader) +
+			               _header->_slot_count * _header->_slot_size ==
+			           _mapped_size;
+		}
+
+		// An existing ring may still be sized by its creator. On success
+		// size is the ring's actual size.
+		bool do_wait_size(int fd, std::size_t &size)
+		{
+			for (int i = 0; i < OPEN_WAIT_TRIES; ++i)
+			{
+				struct stat st;
+				if (::fstat(fd, &st) != 0)
+					return false;
+				if (st.st_size >= static_cast<off_t>(sizeof(RingHeader)))
+				{
+					size = static_cast<std::size_t>(st.st_size);
+					return true;
+				}
+				::usleep(1000);
+			}
+			return false;
+		}
+	};
+
+	static_assert(PubSubTransport<ShmChannel>);
+} // namespace ipc
+
+#endif // IPC_SHM_CHANNEL_H
@@ -0,0 +1,146 @@
+#ifndef LOGGING_LOG_DECODER_H
+#define LOGGING_LOG_DECODER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <logging/LogRecord.hpp>
+#include <logging/Logger.hpp>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace logging
+{
+	// Offline decoder for LogFormat::BINARY logs. It turns them into the
+	// same JSON lines the logger writes in LogFormat::JSON.
+	class LogDecoder
+	{
+	public:
+		// Returns false if the file is missing, is not a binary log, or
+		// ends in a truncated record (everything before it is written).
+		static bool decode(const std::string &path, std::ostream &out)
+		{
+			std::ifstream in(path, std::ios::binary);
+			if (!in)
+				return false;
+			std::string data((std::istreambuf_iterator<char>(in)),
+			                 std::istreambuf_iterator<char>());
+			return decode_buffer(data, out);
+		}
+
+		static bool decode_buffer(std::string_view data, std::ostream &out)
+		{
+			std::uint64_t magic = 0;
+			std::size_t pos = 0;
+			if (!read_raw(data, pos, magic) || magic != Logger::BINARY_MAGIC)
+				return false;
+			std::unordered_map<std::uint64_t, format_info> formats;
+			std::string line;
+			while (pos < data.size())
+			{
+				line.clear();
+				auto kind = static_cast<Logger::BinaryRecord>(data[pos++]);
+				if (kind == Logger::BinaryRecord::FORMAT)
+				{
+					std::uint64_t id = 0;
+					std::uint8_t level = 0;
+					format_info info;
+					std::string fields;
+					if (!read_raw(data, pos, id) ||
+					    !read_raw(data, pos, level) ||
+					    !read_text(data, pos, info._event) ||
+					    !read_text(data, pos, fields))
+						return false;
+					info._level = static_cast<Level>(level);
+					info._fields = split_fields(fields.c_str());
+					formats[id] = std::move(info);
+				}
+				else if (kind == Logger::BinaryRecord::EVENT)
+				{
+					std::uint64_t id = 0;
+					std::uint32_t thread = 0;
+					std::int64_t timestamp_ns = 0;
+					std::uint32_t length = 0;
+					if (!read_raw(data, pos, id) ||
+					    !read_raw(data, pos, thread) ||
+					    !read_raw(data, pos, timestamp_ns) ||
+					    !read_raw(data, pos, length) ||
+					    pos + length > data.size())
+						return false;
+					auto it = formats.find(id);
+					if (it == formats.end())
+						return false;
+					append_json(line, timestamp_ns, it->second._level,
+					            it->second._event.c_str(), it->second._fields,
+					            thread,
+					            std::span<const char>(data.data() + pos,
+					                                  length));
+					pos += length;
+				}
+				else if (kind == Logger::BinaryRecord::DROPPED)
+				{
+					std::uint32_t thread = 0;
+					std::int64_t timestamp_ns = 0;
+					std::uint64_t count = 0;
+					if (!read_raw(data, pos, thread) ||
+					    !read_raw(data, pos, timestamp_ns) ||
+					    !read_raw(data, pos, count))
+						return false;
+					static const std::vector<std::string> fields{"count"};
+					char args[9];
+					encode_arg(args, count);
+					append_json(line, timestamp_ns, Level::WARN, "log_dropped",
+					            fields, thread,
+					            std::span<const char>(args, sizeof(args)));
+				}
+				else
+					return false;
+				out << line;
+			}
+			return true;
+		}
+
+	private:
+		class format_info
+		{
+		public:
+			Level _level;
+			std::string _event;
+			std::vector<std::string> _fields;
+			format_info()
+			    : _level(Level::INFO)
+			    , _event("")
+			    , _fields()
+			{
+			}
+		};
+
+		template <typename T>
+		static bool read_raw(std::string_view data, std::size_t &pos,
+		                     T &value)
+		{
+			if (pos + sizeof(T) > data.size())
+				return false;
+			std::memcpy(&value, data.data() + pos, sizeof(T));
+			pos += sizeof(T);
+			return true;
+		}
+
+		static bool read_text(std::string_view data, std::size_t &pos,
+		                      std::string &text)
+		{
+			std::uint32_t length = 0;
+			if (!read_raw(data, pos, length) || pos + length > data.size())
+				return false;
+			text.assign(data.data() + pos, length);
+			pos += length;
+			return true;
+		}
+	};
+} // namespace logging
+
+#endif // LOGGING_LOG_DECODER_H
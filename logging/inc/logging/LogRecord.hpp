@@ -0,0 +1,266 @@
+#ifndef LOGGING_LOG_RECORD_H
+#define LOGGING_LOG_RECORD_H
+
+#include <charconv>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+// Levels below this are compiled out of Logger::Writer::log(), e.g.
+// -DLOGGING_MIN_LEVEL=2 keeps INFO and above.
+#ifndef LOGGING_MIN_LEVEL
+#define LOGGING_MIN_LEVEL 0
+#endif
+
+namespace logging
+{
+	enum class Level : unsigned int
+	{
+		TRACE = 0,
+		DEBUG = 1,
+		INFO = 2,
+		WARN = 3,
+		ERROR = 4,
+	};
+
+	inline const char *level_name(Level level)
+	{
+		switch (level)
+		{
+		case Level::TRACE:
+			return "TRACE";
+		case Level::DEBUG:
+			return "DEBUG";
+		case Level::INFO:
+			return "INFO";
+		case Level::WARN:
+			return "WARN";
+		case Level::ERROR:
+			return "ERROR";
+		default:
+			return "UNKNOWN";
+		}
+	}
+
+	// A log statement's static part. Declare one static constexpr Format
+	// per event; its address is the format id carried in each record, so
+	// the hot path copies no text. fields names the arguments in order,
+	// comma separated.
+	//   static constexpr logging::Format order_sent{
+	//       logging::Level::INFO, "order_sent", "trace_id,symbol,venue,px"};
+	class Format
+	{
+	public:
+		Level _level;
+		const char *_event;
+		const char *_fields;
+	};
+
+	// Raw argument encoding: a one-byte tag, then 8 bytes for numbers or
+	// a 4-byte length and the bytes for strings.
+	enum class ArgTag : unsigned char
+	{
+		I64 = 1,
+		U64 = 2,
+		F64 = 3,
+		BOOL = 4,
+		STR = 5,
+	};
+
+	template <typename T>
+	concept LogArg = std::integral<T> || std::floating_point<T> ||
+	                 std::convertible_to<T, std::string_view>;
+
+	template <LogArg T>
+	std::size_t arg_size(const T &value)
+	{
+		if constexpr (std::integral<T> || std::floating_point<T>)
+			return 1 + 8;
+		else
+			return 1 + 4 + std::string_view(value).size();
+	}
+
+	template <LogArg T>
+	char *encode_arg(char *out, const T &value)
+	{
+		if constexpr (std::same_as<T, bool>)
+		{
+			*out++ = static_cast<char>(ArgTag::BOOL);
+			std::uint64_t raw = value ? 1 : 0;
+			std::memcpy(out, &raw, 8);
+			return out + 8;
+		}
+		else if constexpr (std::signed_integral<T>)
+		{
+			*out++ = static_cast<char>(ArgTag::I64);
+			auto raw = static_cast<std::int64_t>(value);
+			std::memcpy(out, &raw, 8);
+			return out + 8;
+		}
+		else if constexpr (std::unsigned_integral<T>)
+		{
+			*out++ = static_cast<char>(ArgTag::U64);
+			auto raw = static_cast<std::uint64_t>(value);
+			std::memcpy(out, &raw, 8);
+			return out + 8;
+		}
+		else if constexpr (std::floating_point<T>)
+		{
+			*out++ = static_cast<char>(ArgTag::F64);
+			auto raw = static_cast<double>(value);
+			std::memcpy(out, &raw, 8);
+			return out + 8;
+		}
+		else
+		{
+			std::string_view text(value);
+			*out++ = static_cast<char>(ArgTag::STR);
+			auto length = static_cast<std::uint32_t>(text.size());
+			std::memcpy(out, &length, 4);
+			std::memcpy(out + 4, text.data(), text.size());
+			return out + 4 + text.size();
+		}
+	}
+
+	// Field names of a Format, split once per format by the consumer.
+	inline std::vector<std::string> split_fields(const char *fields)
+	{
+		std::vector<std::string> names;
+		std::string_view rest(fields ? fields : "");
+		while (!rest.empty())
+		{
+			auto comma = rest.find(',');
+			names.emplace_back(rest.substr(0, comma));
+			if (comma == std::string_view::npos)
+				break;
+			rest.remove_prefix(comma + 1);
+		}
+		return names;
+	}
+
+	inline void append_json_string(std::string &out, std::string_view text)
+	{
+		static const char *hex = "0123456789abcdef";
+		out += '"';
+		for (char c : text)
+		{
+			auto u = static_cast<unsigned char>(c);
+			if (c == '"' || c == '\\')
+			{
+				out += '\\';
+				out += c;
+			}
+			else if (c == '\n')
+				out += "\\n";
+			else if (c == '\r')
+				out += "\\r";
+			else if (c == '\t')
+				out += "\\t";
+			else if (u < 0x20)
+			{
+				out += "\\u00";
+				out += hex[u >> 4];
+				out += hex[u & 0xf];
+			}
+			else
+				out += c;
+		}
+		out += '"';
+	}
+
+	template <typename T>
+	void append_number(std::string &out, T value)
+	{
+		char text[32];
+		auto [end, ec] = std::to_chars(text, text + sizeof(text), value);
+		if (ec == std::errc())
+			out.append(text, end);
+	}
+
+	// One JSON object per line:
+	// {"ts":..,"level":..,"event":..,"thread":..,<field>:<arg>,...}
+	// Arguments past the named fields are called argN. Returns false if
+	// args is malformed.
+	inline bool append_json(std::string &out,
+	                        std::int64_t timestamp_ns,
+	                        Level level,
+	                        const char *event,
+	                        const std::vector<std::string> &fields,
+	                        std::uint32_t thread,
+	                        std::span<const char> args)
+	{
+		out += "{\"ts\":";
+		append_number(out, timestamp_ns);
+		out += ",\"level\":\"";
+		out += level_name(level);
+		out += "\",\"event\":";
+		append_json_string(out, event ? event : "");
+		out += ",\"thread\":";
+		append_number(out, thread);
+		std::size_t pos = 0;
+		for (std::size_t n = 0; pos < args.size(); ++n)
+		{
+			out += ',';
+			if (n < fields.size())
+				append_json_string(out, fields[n]);
+			else
+				append_json_string(out, "arg" + std::to_string(n));
+			out += ':';
+			auto tag = static_cast<ArgTag>(args[pos++]);
+			if (tag == ArgTag::STR)
+			{
+				std::uint32_t length = 0;
+				if (pos + 4 > args.size())
+					return false;
+				std::memcpy(&length, args.data() + pos, 4);
+				pos += 4;
+				if (pos + length > args.size())
+					return false;
+				append_json_string(
+				    out, std::string_view(args.data() + pos, length));
+				pos += length;
+				continue;
+			}
+			if (pos + 8 > args.size())
+				return false;
+			std::uint64_t raw = 0;
+			std::memcpy(&raw, args.data() + pos, 8);
+			pos += 8;
+			switch (tag)
+			{
+			case ArgTag::I64:
+				append_number(out, static_cast<std::int64_t>(raw));
+				break;
+			case ArgTag::U64:
+				append_number(out, raw);
+				break;
+			case ArgTag::F64:
+			{
+				double value = 0;
+				std::memcpy(&value, &raw, 8);
+				// JSON has no NaN or infinity.
+				if (value != value || value - value != 0)
+					out += "null";
+				else
+					append_number(out, value);
+				break;
+			}
+			case ArgTag::BOOL:
+				out += raw ? "true" : "false";
+				break;
+			default:
+				return false;
+			}
+		}
+		out += "}\n";
+		return true;
+	}
+} // namespace logging
+
+#endif // LOGGING_LOG_RECORD_H
@@ -0,0 +1,481 @@
+#ifndef LOGGING_LOGGER_H
+#define LOGGING_LOGGER_H
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <logging/LogRecord.hpp>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <timing/Clock.hpp>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+namespace logging
+{
+	enum class LogFormat : unsigned int
+	{
+		JSON = 0,
+		BINARY = 1,
+	};
+
+	// Asynchronous structured logger. A logging thread only copies the
+	// format id, a timestamp and the raw arguments into its own
+	// single-producer/single-consumer ring. A background thread drains
+	// every ring and writes JSON lines or the compact binary log read by
+	// LogDecoder. Formatting never happens on the caller's thread.
+	//
+	// When a ring is full the record is dropped and counted. The
+	// background thread reports drops as a "log_dropped" event. A write
+	// to the output that fails or stops short loses the rest of that
+	// flush; write_errors() and lost_bytes() count those, as the output
+	// itself cannot be trusted to carry the report.
+	// Records from one thread stay in order, but records from different
+	// threads are interleaved by drain order, not by timestamp.
+	class Logger
+	{
+	public:
+		static constexpr std::size_t DEFAULT_RING_SIZE = 1 << 20;
+		static constexpr std::uint64_t BINARY_MAGIC =
+		    0x313030474f4c4648; // HFLOG001
+
+		// Binary log record kinds, after the 8-byte magic.
+		enum class BinaryRecord : unsigned char
+		{
+			FORMAT = 1,
+			EVENT = 2,
+			DROPPED = 3,
+		};
+
+		class Writer
+		{
+		public:
+			Writer(std::size_t ring_size, std::uint32_t thread,
+			       timing::ClockSource clock)
+			    : _buffer(ring_capacity(ring_size))
+			    , _mask(_buffer.size() - 1)
+			    , _thread(thread)
+			    , _clock(clock)
+			    , _cached_head(0)
+			    , _pending_tail(0)
+			    , _head(0)
+			    , _tail(0)
+			    , _dropped(0)
+			{
+			}
+
+			Writer(const Writer &) = delete;
+
+			Writer &operator=(const Writer &) = delete;
+
+			// Log one event. Levels below LOGGING_MIN_LEVEL compile to
+			// nothing. Returns false if the record was dropped.
+			template <const Format &F, LogArg... Args>
+			bool log(const Args &...args)
+			{
+				if constexpr (static_cast<unsigned int>(F._level) <
+				              LOGGING_MIN_LEVEL)
+					return true;
+				else
+				{
+					auto size = align(sizeof(record_header) +
+					                  (std::size_t(0) + ... + arg_size(args)));
+					auto *record = do_reserve(size);
+					if (!record)
+					{
+						_dropped.store(
+						    _dropped.load(std::memory_order_relaxed) + 1,
+						    std::memory_order_relaxed);
+						return false;
+					}
+					auto *header = reinterpret_cast<record_header *>(record);
+					header->_size = static_cast<std::uint32_t>(size);
+					header->_args = 0;
+					header->_format = &F;
+					header->_timestamp_ns = _clock.now_ns();
+					auto *out = record + sizeof(record_header);
+					((out = encode_arg(out, args)), ...);
+					header->_args = static_cast<std::uint32_t>(
+					    out - record - sizeof(record_header));
+					do_commit();
+					return true;
+				}
+			}
+
+			std::uint64_t dropped() const
+			{
+				return _dropped.load(std::memory_order_relaxed);
+			}
+
+			std::uint32_t thread() const { return _thread; }
+
+		private:
+			friend class Logger;
+
+			class record_header
+			{
+			public:
+				std::uint32_t _size;
+				std::uint32_t _args;
+				// nullptr marks padding up to the end of the ring.
+				const Format *_format;
+				std::int64_t _timestamp_ns;
+			};
+
+			std::vector<char> _buffer;
+			std::size_t _mask;
+			std::uint32_t _thread;
+			timing::ClockSource _clock;
+			// Producer's last view of _head, refreshed only when the ring
+			// looks full.
+			std::uint64_t _cached_head;
+			std::uint64_t _pending_tail;
+			alignas(64) std::atomic<std::uint64_t> _head;
+			alignas(64) std::atomic<std::uint64_t> _tail;
+			std::atomic<std::uint64_t> _dropped;
+
+			static std::size_t ring_capacity(std::size_t size)
+			{
+				std::size_t capacity = 4096;
+				while (capacity < size)
+					capacity <<= 1;
+				return capacity;
+			}
+
+			static constexpr std::size_t align(std::size_t size)
+			{
+				return (size + 7) & ~std::size_t(7);
+			}
+
+			char *do_reserve(std::size_t size)
+			{
+				auto capacity = _buffer.size();
+				if (size > capacity / 4)
+					return nullptr;
+				auto tail = _tail.load(std::memory_order_relaxed);
+				auto pos = tail & _mask;
+				auto contiguous = capacity - pos;
+				auto needed = contiguous < size ? contiguous + size : size;
+				if (tail + needed - _cached_head > capacity)
+				{
+					_cached_head = _head.load(std::memory_order_acquire);
+					if (tail + needed - _cached_head > capacity)
+						return nullptr;
+				}
+				if (contiguous < size)
+				{
+					if (contiguous >= sizeof(record_header))
+					{
+						auto *pad = reinterpret_cast<record_header *>(
+						    _buffer.data() + pos);
+						pad->_size = static_cast<std::uint32_t>(contiguous);
+						pad->_format = nullptr;
+					}
+					pos = 0;
+				}
+				_pending_tail = tail + needed;
+				return _buffer.data() + pos;
+			}
+
+			void do_commit()
+			{
+				_tail.store(_pending_tail, std::memory_order_release);
+			}
+		};
+
+	public:
+		Logger(std::string path,
+		       LogFormat format = LogFormat::JSON,
+		       std::size_t ring_size = DEFAULT_RING_SIZE,
+		       timing::ClockSource clock = timing::ClockSource())
+		    : _path(std::move(path))
+		    , _format(format)
+		    , _ring_size(ring_size)
+		    , _clock(clock)
+		    , _fd(-1)
+		    , _mutex()
+		    , _writers()
+		    , _writer_count(0)
+		    , _running(false)
+		    , _thread()
+		    , _out()
+		    , _fields()
+		    , _reported_drops()
+		    , _written(0)
+		    , _write_errors(0)
+		    , _lost_bytes(0)
+		{
+		}
+
+		Logger(const Logger &) = delete;
+
+		Logger &operator=(const Logger &) = delete;
+
+		~Logger() { close(); }
+
+		// Open the output for appending and start the background thread.
+		bool open()
+		{
+			if (_running.load(std::memory_order_acquire))
+				return false;
+			_fd = ::open(_path.c_str(),
+			             O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+			if (_fd < 0)
+				return false;
+			if (_format == LogFormat::BINARY && ::lseek(_fd, 0, SEEK_END) == 0)
+			{
+				_out.append(reinterpret_cast<const char *>(&BINARY_MAGIC),
+				            sizeof(BINARY_MAGIC));
+			}
+			_running.store(true, std::memory_order_release);
+			_thread = std::thread([this]() { do_run(); });
+			return true;
+		}
+
+		// Drain every ring, flush and stop the background thread.
+		void close()
+		{
+			if (!_running.exchange(false, std::memory_order_acq_rel))
+				return;
+			_thread.join();
+			::close(_fd);
+			_fd = -1;
+		}
+
+		// A ring for the calling thread. Keep the reference; it stays
+		// valid for the logger's lifetime.
+		Writer &writer()
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_writers.push_back(std::make_unique<Writer>(
+			    _ring_size, static_cast<std::uint32_t>(_writers.size()),
+			    _clock));
+			_writer_count.store(_writers.size(), std::memory_order_release);
+			return *_writers.back();
+		}
+
+		// Records written to the output so far.
+		std::uint64_t written() const
+		{
+			return _written.load(std::memory_order_relaxed);
+		}
+
+		// Flushes the output did not take in full.
+		std::uint64_t write_errors() const
+		{
+			return _write_errors.load(std::memory_order_relaxed);
+		}
+
+		// Bytes those flushes lost.
+		std::uint64_t lost_bytes() const
+		{
+			return _lost_bytes.load(std::memory_order_relaxed);
+		}
+
+	private:
+		static constexpr auto IDLE_INTERVAL = std::chrono::milliseconds(1);
+		static constexpr std::size_t FLUSH_SIZE = 64 * 1024;
+
+		std::string _path;
+		LogFormat _format;
+		std::size_t _ring_size;
+		timing::ClockSource _clock;
+		int _fd;
+		std::mutex _mutex;
+		std::vector<std::unique_ptr<Writer>> _writers;
+		std::atomic<std::size_t> _writer_count;
+		std::atomic<bool> _running;
+		std::thread _thread;
+		// Owned by the background thread.
+		std::string _out;
+		std::unordered_map<const Format *, std::vector<std::string>> _fields;
+		std::vector<std::uint64_t> _reported_drops;
+		std::atomic<std::uint64_t> _written;
+		std::atomic<std::uint64_t> _write_errors;
+		std::atomic<std::uint64_t> _lost_bytes;
+
+		void do_run()
+		{
+			while (true)
+			{
+				bool running = _running.load(std::memory_order_acquire);
+				auto drained = do_drain();
+				do_flush(_out.size() >= FLUSH_SIZE || drained == 0);
+				if (!running && drained == 0)
+					break;
+				if (drained == 0)
+					std::this_thread::sleep_for(IDLE_INTERVAL);
+			}
+			do_flush(true);
+		}
+
+		std::size_t do_drain()
+		{
+			std::size_t drained = 0;
+			auto count = _writer_count.load(std::memory_order_acquire);
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				Writer *writer = nullptr;
+				{
+					std::lock_guard<std::mutex> lock(_mutex);
+					writer = _writers[i].get();
+				}
+				drained += do_drain(*writer);
+			}
+			return drained;
+		}
+
+		std::size_t do_drain(Writer &writer)
+		{
+			using header_type = Writer::record_header;
+			std::size_t drained = 0;
+			auto capacity = writer._buffer.size();
+			auto head = writer._head.load(std::memory_order_relaxed);
+			auto tail = writer._tail.load(std::memory_order_acquire);
+			while (head < tail)
+			{
+				auto pos = head & writer._mask;
+				if (capacity - pos < sizeof(header_type))
+				{
+					head += capacity - pos;
+					continue;
+				}
+				auto *record = writer._buffer.data() + pos;
+				auto *header = reinterpret_cast<const header_type *>(record);
+				if (!header->_format)
+				{
+					head += capacity - pos;
+					continue;
+				}
+				do_write(writer._thread, *header->_format,
+				         header->_timestamp_ns,
+				         std::span<const char>(record + sizeof(header_type),
+				                               header->_args));
+				head += header->_size;
+				++drained;
+				if (_out.size() >= FLUSH_SIZE)
+					do_flush(true);
+			}
+			writer._head.store(head, std::memory_order_release);
+			do_report_drops(writer);
+			return drained;
+		}
+
+		void do_report_drops(const Writer &writer)
+		{
+			if (_reported_drops.size() <= writer._thread)
+				_reported_drops.resize(writer._thread + 1, 0);
+			auto dropped = writer.dropped();
+			auto &reported = _reported_drops[writer._thread];
+			if (dropped == reported)
+				return;
+			auto count = dropped - reported;
+			reported = dropped;
+			auto now = _clock.now_ns();
+			if (_format == LogFormat::BINARY)
+			{
+				do_append_byte(BinaryRecord::DROPPED);
+				do_append_raw(writer._thread);
+				do_append_raw(now);
+				do_append_raw(count);
+				return;
+			}
+			static const std::vector<std::string> fields{"count"};
+			char args[9];
+			encode_arg(args, count);
+			append_json(_out, now, Level::WARN, "log_dropped",
+			            fields, writer._thread,
+			            std::span<const char>(args, sizeof(args)));
+		}
+
+		void do_write(std::uint32_t thread, const Format &format,
+		              std::int64_t timestamp_ns, std::span<const char> args)
+		{
+			auto it = _fields.find(&format);
+			if (it == _fields.end())
+			{
+				it = _fields.emplace(&format, split_fields(format._fields))
+				         .first;
+				if (_format == LogFormat::BINARY)
+					do_append_format(format);
+			}
+			_written.store(_written.load(std::memory_order_relaxed) + 1,
+			               std::memory_order_relaxed);
+			if (_format == LogFormat::JSON)
+			{
+				append_json(_out, timestamp_ns, format._level, format._event,
+				            it->second, thread, args);
+				return;
+			}
+			do_append_byte(BinaryRecord::EVENT);
+			do_append_raw(reinterpret_cast<std::uint64_t>(&format));
+			do_append_raw(thread);
+			do_append_raw(timestamp_ns);
+			do_append_raw(static_cast<std::uint32_t>(args.size()));
+			_out.append(args.data(), args.size());
+		}
+
+		void do_append_format(const Format &format)
+		{
+			do_append_byte(BinaryRecord::FORMAT);
+			do_append_raw(reinterpret_cast<std::uint64_t>(&format));
+			do_append_raw(static_cast<std::uint8_t>(format._level));
+			do_append_text(format._event);
+			do_append_text(format._fields);
+		}
+
+		void do_append_byte(BinaryRecord kind)
+		{
+			_out += static_cast<char>(kind);
+		}
+
+		template <typename T>
+		void do_append_raw(T value)
+		{
+			_out.append(reinterpret_cast<const char *>(&value), sizeof(T));
+		}
+
+		void do_append_text(const char *text)
+		{
+			std::string_view view(text ? text : "");
+			do_append_raw(static_cast<std::uint32_t>(view.size()));
+			_out.append(view.data(), view.size());
+		}
+
+		void do_flush(bool force)
+		{
+			if (!force || _out.empty())
+				return;
+			std::size_t written = 0;
+			while (written < _out.size())
+			{
+				auto ret = ::write(_fd, _out.data() + written,
+				                   _out.size() - written);
+				if (ret < 0 && errno == EINTR)
+					continue;
+				if (ret <= 0)
+					break;
+				written += static_cast<std::size_t>(ret);
+			}
+			if (written < _out.size())
+			{
+				_write_errors.store(
+				    _write_errors.load(std::memory_order_relaxed) + 1,
+				    std::memory_order_relaxed);
+				_lost_bytes.store(_lost_bytes.load(std::memory_order_relaxed) +
+				                      _out.size() - written,
+				                  std::memory_order_relaxed);
+			}
+			_out.clear();
+		}
+	};
+} // namespace logging
+
+#endif // LOGGING_LOGGER_H
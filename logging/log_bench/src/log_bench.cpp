@@ -0,0 +1,111 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <logging/Logger.hpp>
+#include <string>
+#include <thread>
+#include <timing/TscClock.hpp>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Cost of Writer::log() on the producer's thread: an order event of
+// five arguments, two of them strings, timestamped by the TSC clock.
+// Events go out in bursts of BURST, and the bench waits for the
+// background thread to drain each burst, so the consumer keeps up and
+// no record is dropped. Every call is timed on its own, fenced, less the
+// median cost of an empty clock pair. The log goes to /dev/null unless
+// a path is given. Exits 1 if a record was dropped.
+
+static constexpr std::size_t BURST = 1024;
+static constexpr logging::Format order_sent{
+    logging::Level::INFO, "order_sent", "trace_id,symbol,venue,px,ok"};
+
+// Keeps the compiler from moving the value's computation across the
+// clock reads around it.
+template <typename T>
+static void keep(T &value)
+{
+	asm volatile("" : "+r,m"(value) : : "memory");
+}
+
+// rdtscp waits for the work before it but not the work after, so the
+// call must not start until the first read is done.
+static std::int64_t start_ns(const timing::TscClock &clock)
+{
+	auto ns = clock.now_ns();
+#if defined(__x86_64__) || defined(__i386__)
+	_mm_lfence();
+#endif
+	return ns;
+}
+
+// Median of back-to-back clock reads with nothing between them.
+static std::int64_t clock_overhead(const timing::TscClock &clock)
+{
+	std::vector<std::int64_t> ns(100000);
+	for (auto &sample : ns)
+	{
+		auto from = start_ns(clock);
+		keep(from);
+		sample = clock.now_ns() - from;
+	}
+	std::sort(ns.begin(), ns.end());
+	return ns[ns.size() / 2];
+}
+
+int main(int argc, const char **argv)
+{
+	std::string path = argc > 1 ? argv[1] : "/dev/null";
+	std::size_t bursts =
+	    argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 2000;
+	timing::TscClock clock;
+	logging::Logger logger(path, logging::LogFormat::BINARY,
+	                       logging::Logger::DEFAULT_RING_SIZE, clock);
+	if (!logger.open())
+	{
+		std::cout << path << ": cannot open" << std::endl;
+		return 1;
+	}
+	auto &writer = logger.writer();
+	auto overhead = clock_overhead(clock);
+	std::cout << "clock pair " << overhead << " ns, "
+	          << (clock.is_tsc() ? "tsc" : "CLOCK_MONOTONIC") << std::endl;
+
+	std::vector<std::int64_t> ns;
+	ns.reserve(bursts * BURST);
+	std::uint64_t logged = 0;
+	for (std::size_t burst = 0; burst < bursts; ++burst)
+	{
+		for (std::size_t i = 0; i < BURST; ++i, ++logged)
+		{
+			auto price = 3000.0 + static_cast<double>(i);
+			auto from = start_ns(clock);
+			keep(price);
+			auto ok = writer.log<order_sent>(logged, "ETH", "Hyperliquid",
+			                                 price, true);
+			keep(ok);
+			ns.push_back(
+			    std::max<std::int64_t>(clock.now_ns() - from - overhead, 0));
+		}
+		while (logger.written() + writer.dropped() < logged)
+			std::this_thread::yield();
+	}
+	logger.close();
+
+	double total = 0;
+	for (auto sample : ns)
+		total += static_cast<double>(sample);
+	std::sort(ns.begin(), ns.end());
+	std::cout << "log: mean " << total / static_cast<double>(ns.size())
+	          << " ns, p50 " << ns[ns.size() / 2] << " ns, p99 "
+	          << ns[ns.size() * 99 / 100] << " ns, p99.9 "
+	          << ns[ns.size() * 999 / 1000] << " ns, max " << ns.back()
+	          << " ns over " << ns.size() << " events" << std::endl;
+	std::cout << "written " << logger.written() << ", dropped "
+	          << writer.dropped() << ", write errors "
+	          << logger.write_errors() << std::endl;
+	return writer.dropped() == 0 && logger.write_errors() == 0 ? 0 : 1;
+}
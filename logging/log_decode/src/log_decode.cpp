@@ -0,0 +1,50 @@
+#include <fstream>
+#include <iostream>
+#include <logging/LogDecoder.hpp>
+#include <string>
+
+// Turns a LogFormat::BINARY log into the JSON lines the logger writes in
+// LogFormat::JSON, on stdout or into a file.
+//
+//     log_decode <binary log> [<json lines out>]
+//
+// Exits 1 when the input is missing or not a binary log, or ends in a
+// truncated record; the lines before it are still written. Exits 2 on
+// bad arguments.
+
+int main(int argc, const char **argv)
+{
+	if (argc < 2 || argc > 3)
+	{
+		std::cerr << "usage: " << argv[0]
+		          << " <binary log> [<json lines out>]" << std::endl;
+		return 2;
+	}
+	std::ofstream file;
+	if (argc == 3)
+	{
+		file.open(argv[2], std::ios::out | std::ios::trunc);
+		if (!file)
+		{
+			std::cerr << argv[2] << ": cannot open for writing" << std::endl;
+			return 1;
+		}
+	}
+	std::ostream &out = argc == 3 ? file : std::cout;
+	auto ok = logging::LogDecoder::decode(argv[1], out);
+	out.flush();
+	if (!out)
+	{
+		std::cerr << "write failed" << std::endl;
+		return 1;
+	}
+	if (!ok)
+	{
+		std::cerr << argv[1]
+		          << ": missing, not a binary log, or ends in a truncated "
+		             "record"
+		          << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,205 @@
+#ifndef METRICS_LATENCY_HISTOGRAM_H
+#define METRICS_LATENCY_HISTOGRAM_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace metrics
+{
+	// HDR-style histogram of nanosecond latencies with log-linear
+	// buckets. Values below 2^SUB_BUCKET_BITS are exact. Above that, each
+	// power of two is split into 2^(SUB_BUCKET_BITS - 1) buckets, so a
+	// reported value is within 1/2^(SUB_BUCKET_BITS - 1) (0.8%) of the
+	// recorded one. Values from 2^MAX_VALUE_BITS ns (about 4.9 hours) up
+	// land in the last bucket.
+	//
+	// Memory is fixed at construction. record() belongs to one thread and
+	// does relaxed loads and stores only, with no read-modify-write.
+	// snapshot() can run on any other thread at the same time. It copies
+	// the counters without stalling the writer, at the cost of possibly
+	// missing the records made while it copies.
+	class LatencyHistogram
+	{
+	public:
+		static constexpr unsigned int SUB_BUCKET_BITS = 8;
+		static constexpr unsigned int MAX_VALUE_BITS = 44;
+		static constexpr std::size_t SUB_BUCKET_COUNT = 1u
+		                                                << SUB_BUCKET_BITS;
+		static constexpr std::size_t BUCKET_COUNT =
+		    SUB_BUCKET_COUNT +
+		    (MAX_VALUE_BITS - SUB_BUCKET_BITS) * (SUB_BUCKET_COUNT / 2);
+
+		class Snapshot
+		{
+		public:
+			std::vector<std::uint64_t> _counts;
+			std::uint64_t _count;
+			std::uint64_t _sum;
+			std::uint64_t _min;
+			std::uint64_t _max;
+			Snapshot()
+			    : _counts(BUCKET_COUNT, 0)
+			    , _count(0)
+			    , _sum(0)
+			    , _min(0)
+			    , _max(0)
+			{
+			}
+
+			// Smallest recorded value that at least p percent of the
+			// records are at or below, e.g. percentile(99.9).
+			std::uint64_t percentile(double p) const
+			{
+				if (_count == 0)
+					return 0;
+				auto rank = static_cast<std::uint64_t>(
+				    p / 100.0 * static_cast<double>(_count) + 0.5);
+				rank = std::clamp<std::uint64_t>(rank, 1, _count);
+				std::uint64_t seen = 0;
+				for (std::size_t i = 0; i < _counts.size(); ++i)
+				{
+					seen += _counts[i];
+					if (seen >= rank)
+						return std::clamp(highest_equivalent(i), _min, _max);
+				}
+				return _max;
+			}
+
+			double mean() const
+			{
+				return _count ? static_cast<double>(_sum) /
+				                    static_cast<double>(_count)
+				              : 0.0;
+			}
+
+			// Records made between an earlier snapshot of the same
+			// histogram and this one. min and max come from the buckets.
+			Snapshot since(const Snapshot &earlier) const
+			{
+				Snapshot delta;
+				bool any = false;
+				for (std::size_t i = 0; i < _counts.size(); ++i)
+				{
+					auto n = _counts[i] - std::min(_counts[i],
+					                               earlier._counts[i]);
+					delta._counts[i] = n;
+					if (n == 0)
+						continue;
+					delta._count += n;
+					if (!any)
+						delta._min = lowest_equivalent(i);
+					delta._max = highest_equivalent(i);
+					any = true;
+				}
+				delta._sum = _sum - std::min(_sum, earlier._sum);
+				if (any)
+				{
+					delta._min = std::max(delta._min, _min);
+					delta._max = std::min(delta._max, _max);
+				}
+				return delta;
+			}
+		};
+
+	public:
+		LatencyHistogram()
+		    : _counts()
+		    , _count(0)
+		    , _sum(0)
+		    , _min(std::numeric_limits<std::uint64_t>::max())
+		    , _max(0)
+		{
+		}
+
+		LatencyHistogram(const LatencyHistogram &) = delete;
+
+		LatencyHistogram &operator=(const LatencyHistogram &) = delete;
+
+		// Negative values (a clock that stepped back) count as 0.
+		void record(std::int64_t value_ns)
+		{
+			auto value =
+			    static_cast<std::uint64_t>(value_ns > 0 ? value_ns : 0);
+			bump(_counts[bucket_index(value)], 1);
+			bump(_count, 1);
+			bump(_sum, value);
+			if (value < _min.load(std::memory_order_relaxed))
+				_min.store(value, std::memory_order_relaxed);
+			if (value > _max.load(std::memory_order_relaxed))
+				_max.store(value, std::memory_order_relaxed);
+		}
+
+		Snapshot snapshot() const
+		{
+			Snapshot snap;
+			for (std::size_t i = 0; i < BUCKET_COUNT; ++i)
+			{
+				snap._counts[i] = _counts[i].load(std::memory_order_relaxed);
+				snap._count += snap._counts[i];
+			}
+			snap._sum = _sum.load(std::memory_order_relaxed);
+			snap._max = _max.load(std::memory_order_relaxed);
+			auto min = _min.load(std::memory_order_relaxed);
+			snap._min = snap._count ? std::min(min, snap._max) : 0;
+			return snap;
+		}
+
+		std::uint64_t count() const
+		{
+			return _count.load(std::memory_order_relaxed);
+		}
+
+		static std::size_t bucket_index(std::uint64_t value)
+		{
+			if (value < SUB_BUCKET_COUNT)
+				return static_cast<std::size_t>(value);
+			auto shift = static_cast<unsigned int>(std::bit_width(value)) -
+			             SUB_BUCKET_BITS;
+			if (shift > MAX_VALUE_BITS - SUB_BUCKET_BITS)
+				return BUCKET_COUNT - 1;
+			auto mantissa = static_cast<std::size_t>(value >> shift);
+			return SUB_BUCKET_COUNT + (shift - 1) * (SUB_BUCKET_COUNT / 2) +
+			       (mantissa - SUB_BUCKET_COUNT / 2);
+		}
+
+		static std::uint64_t lowest_equivalent(std::size_t index)
+		{
+			if (index < SUB_BUCKET_COUNT)
+				return index;
+			auto offset = index - SUB_BUCKET_COUNT;
+			auto shift = offset / (SUB_BUCKET_COUNT / 2) + 1;
+			auto mantissa =
+			    offset % (SUB_BUCKET_COUNT / 2) + SUB_BUCKET_COUNT / 2;
+			return static_cast<std::uint64_t>(mantissa) << shift;
+		}
+
+		static std::uint64_t highest_equivalent(std::size_t index)
+		{
+			if (index + 1 >= BUCKET_COUNT)
+				return std::numeric_limits<std::uint64_t>::max();
+			return lowest_equivalent(index + 1) - 1;
+		}
+
+	private:
+		std::array<std::atomic<std::uint64_t>, BUCKET_COUNT> _counts;
+		std::atomic<std::uint64_t> _count;
+		std::atomic<std::uint64_t> _sum;
+		std::atomic<std::uint64_t> _min;
+		std::atomic<std::uint64_t> _max;
+
+		static void bump(std::atomic<std::uint64_t> &counter,
+		                 std::uint64_t delta)
+		{
+			counter.store(counter.load(std::memory_order_relaxed) + delta,
+			              std::memory_order_relaxed);
+		}
+	};
+} // namespace metrics
+
+#endif // METRICS_LATENCY_HISTOGRAM_H
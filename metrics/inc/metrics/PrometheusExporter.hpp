@@ -0,0 +1,165 @@
+#ifndef METRICS_PROMETHEUS_EXPORTER_H
+#define METRICS_PROMETHEUS_EXPORTER_H
+
+#include <arpa/inet.h>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <metrics/Registry.hpp>
+#include <netinet/in.h>
+#include <poll.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <thread>
+#include <unistd.h>
+
+namespace metrics
+{
+	// Serves Registry::render() at GET /metrics over plain HTTP/1.0 from
+	// a background thread. Aggregation across writers happens on that
+	// thread, once per scrape. One request is handled at a time; meant
+	// for a local Prometheus agent, not the open network.
+	class PrometheusExporter
+	{
+	public:
+		PrometheusExporter(const Registry &registry)
+		    : _registry(registry)
+		    , _listen_fd(-1)
+		    , _port(0)
+		    , _running(false)
+		    , _thread()
+		{
+		}
+
+		PrometheusExporter(const PrometheusExporter &) = delete;
+
+		PrometheusExporter &operator=(const PrometheusExporter &) = delete;
+
+		~PrometheusExporter() { stop(); }
+
+		// Port 0 binds an ephemeral port, see port().
+		bool start(const std::string &host = "127.0.0.1", int port = 9464)
+		{
+			if (_running.load(std::memory_order_acquire))
+				return false;
+			sockaddr_in addr;
+			std::memset(&addr, 0, sizeof(addr));
+			addr.sin_family = AF_INET;
+			addr.sin_port = htons(static_cast<std::uint16_t>(port));
+			if (::inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1)
+				return false;
+			int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+			if (fd < 0)
+				return false;
+			int reuse = 1;
+			::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+			socklen_t len = sizeof(addr);
+			if (::bind(fd, reinterpret_cast<sockaddr *>(&addr), len) != 0 ||
+			    ::listen(fd, 16) != 0 ||
+			    ::getsockname(fd, reinterpret_cast<sockaddr *>(&addr),
+			                  &len) != 0)
+			{
+				::close(fd);
+				return false;
+			}
+			_listen_fd = fd;
+			_port = ntohs(addr.sin_port);
+			_running.store(true, std::memory_order_release);
+			_thread = std::thread([this]() { do_run(); });
+			return true;
+		}
+
+		void stop()
+		{
+			if (!_running.exchange(false, std::memory_order_acq_rel))
+				return;
+			_thread.join();
+			::close(_listen_fd);
+			_listen_fd = -1;
+		}
+
+		int port() const { return _port; }
+
+	private:
+		static constexpr int POLL_INTERVAL_MS = 100;
+		static constexpr std::size_t MAX_REQUEST_SIZE = 8192;
+
+		const Registry &_registry;
+		int _listen_fd;
+		int _port;
+		std::atomic<bool> _running;
+		std::thread _thread;
+
+		void do_run()
+		{
+			while (_running.load(std::memory_order_acquire))
+			{
+				pollfd pfd;
+				pfd.fd = _listen_fd;
+				pfd.events = POLLIN;
+				pfd.revents = 0;
+				if (::poll(&pfd, 1, POLL_INTERVAL_MS) <= 0)
+					continue;
+				int client = ::accept4(_listen_fd, nullptr, nullptr,
+				                       SOCK_CLOEXEC);
+				if (client < 0)
+					continue;
+				do_serve(client);
+				::close(client);
+			}
+		}
+
+		void do_serve(int client)
+		{
+			timeval timeout;
+			timeout.tv_sec = 1;
+			timeout.tv_usec = 0;
+			::setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout,
+			             sizeof(timeout));
+			::setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout,
+			             sizeof(timeout));
+			std::string request;
+			char buffer[1024];
+			while (request.find("\r\n\r\n") == std::string::npos &&
+			       request.size() < MAX_REQUEST_SIZE)
+			{
+				auto ret = ::recv(client, buffer, sizeof(buffer), 0);
+				if (ret < 0 && errno == EINTR)
+					continue;
+				if (ret <= 0)
+					return;
+				request.append(buffer, static_cast<std::size_t>(ret));
+			}
+			std::string status = "200 OK";
+			std::string body;
+			if (request.starts_with("GET /metrics ") ||
+			    request.starts_with("GET /metrics?"))
+				body = _registry.render();
+			else
+			{
+				status = "404 Not Found";
+				body = "not found\n";
+			}
+			auto response = "HTTP/1.0 " + status +
+			                 "\r\nContent-Type: text/plain; version=0.0.4"
+			                 "\r\nContent-Length: " +
+			                 std::to_string(body.size()) +
+			                 "\r\nConnection: close\r\n\r\n" + body;
+			std::size_t sent = 0;
+			while (sent < response.size())
+			{
+				auto ret = ::send(client, response.data() + sent,
+				                  response.size() - sent, MSG_NOSIGNAL);
+				if (ret < 0 && errno == EINTR)
+					continue;
+				if (ret <= 0)
+					return;
+				sent += static_cast<std::size_t>(ret);
+			}
+		}
+	};
+} // namespace metrics
+
+#endif // METRICS_PROMETHEUS_EXPORTER_H
@@ -0,0 +1,431 @@
+#ifndef METRICS_REGISTRY_H
+#define METRICS_REGISTRY_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <metrics/LatencyHistogram.hpp>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace metrics
+{
+	// Prometheus-style metric registry. Every (name, labels) series is
+	// resolved to a dense index when it is registered. Updates on the hot
+	// path index straight into memory: no string is hashed and no lock
+	// is taken.
+	//
+	// Counters are per thread. Each thread updates through its own
+	// Writer, whose slots are cache-line aligned so that no two threads
+	// share a line, and render() sums the writers. Gauges have a single
+	// cache-line-padded slot each and must have one writer. Summaries
+	// export a LatencyHistogram by reference, in seconds.
+	//
+	// Registration, writer() and render() take a mutex; call the first
+	// two at startup.
+	class Registry
+	{
+	public:
+		using Labels = std::vector<std::pair<std::string, std::string>>;
+
+		static constexpr std::size_t DEFAULT_CAPACITY = 1024;
+
+		class Counter
+		{
+		public:
+			std::uint32_t _index;
+			Counter() : _index(0) {}
+		};
+
+		class Gauge
+		{
+		public:
+			std::uint32_t _index;
+			Gauge() : _index(0) {}
+		};
+
+		class Writer
+		{
+		public:
+			Writer(std::size_t capacity)
+			    : _lines((capacity + SLOTS_PER_LINE - 1) / SLOTS_PER_LINE)
+			{
+			}
+
+			Writer(const Writer &) = delete;
+
+			Writer &operator=(const Writer &) = delete;
+
+			void add(Counter counter, std::uint64_t delta = 1)
+			{
+				auto &cell = slot_at(counter._index);
+				cell.store(cell.load(std::memory_order_relaxed) + delta,
+				           std::memory_order_relaxed);
+			}
+
+			std::uint64_t value(Counter counter) const
+			{
+				return slot_at(counter._index)
+				    .load(std::memory_order_relaxed);
+			}
+
+		private:
+			static constexpr std::size_t SLOTS_PER_LINE = 8;
+
+			class alignas(64) line
+			{
+			public:
+				std::atomic<std::uint64_t> _slots[SLOTS_PER_LINE];
+				line() : _slots() {}
+			};
+
+			std::vector<line> _lines;
+
+			std::atomic<std::uint64_t> &slot_at(std::uint32_t index)
+			{
+				return _lines[index / SLOTS_PER_LINE]
+				    ._slots[index % SLOTS_PER_LINE];
+			}
+
+			const std::atomic<std::uint64_t> &
+			slot_at(std::uint32_t index) const
+			{
+				return _lines[index / SLOTS_PER_LINE]
+				    ._slots[index % SLOTS_PER_LINE];
+			}
+		};
+
+	public:
+		Registry(std::size_t capacity = DEFAULT_CAPACITY)
+		    : _capacity(capacity)
+		    , _mutex()
+		    , _families()
+		    , _family_index()
+		    , _series()
+		    , _series_index()
+		    , _counter_count(0)
+		    , _gauges(capacity)
+		    , _gauge_count(0)
+		    , _writers()
+		{
+		}
+
+		Registry(const Registry &) = delete;
+
+		Registry &operator=(const Registry &) = delete;
+
+		Counter counter(const std::string &name, const std::string &help,
+		                const Labels &labels = {})
+		{
+			Counter handle;
+			handle._index = do_register(name, help, labels,
+			                            MetricType::COUNTER, nullptr);
+			return handle;
+		}
+
+		Gauge gauge(const std::string &name, const std::string &help,
+		            const Labels &labels = {})
+		{
+			Gauge handle;
+			handle._index = do_register(name, help, labels,
+			                            MetricType::GAUGE, nullptr);
+			return handle;
+		}
+
+		// Export p50/p90/p99/p99.9 of a histogram that must outlive the
+		// registry. Name it *_seconds.
+		void summary(const std::string &name, const std::string &help,
+		             const LatencyHistogram &histogram,
+		             const Labels &labels = {})
+		{
+			do_register(name, help, labels, MetricType::SUMMARY, &histogram);
+		}
+
+		// A new set of counter slots for the calling thread. Keep the
+		// reference; it stays valid for the registry's lifetime.
+		Writer &writer()
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_writers.push_back(std::make_unique<Writer>(_capacity));
+			return *_writers.back();
+		}
+
+		void set(Gauge gauge, double value)
+		{
+			_gauges[gauge._index]._value.store(value,
+			                                   std::memory_order_relaxed);
+		}
+
+		void add(Gauge gauge, double delta)
+		{
+			auto &slot = _gauges[gauge._index]._value;
+			slot.store(slot.load(std::memory_order_relaxed) + delta,
+			           std::memory_order_relaxed);
+		}
+
+		double value(Gauge gauge) const
+		{
+			return _gauges[gauge._index]._value.load(
+			    std::memory_order_relaxed);
+		}
+
+		// Sum of the counter over every writer.
+		std::uint64_t value(Counter counter) const
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			return do_sum(counter._index);
+		}
+
+		// Prometheus text exposition format, version 0.0.4.
+		std::string render() const
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			std::string out;
+			for (std::size_t f = 0; f < _families.size(); ++f)
+			{
+				auto &family = _families[f];
+				out += "# HELP " + family._name + " " +
+				       escape(family._help, false) + "\n";
+				out += "# TYPE " + family._name + " " +
+				       type_name(family._type) + "\n";
+				for (auto &series : _series)
+				{
+					if (series._family == f)
+						do_render(out, family, series);
+				}
+			}
+			return out;
+		}
+
+	private:
+		enum class MetricType : unsigned int
+		{
+			COUNTER = 0,
+			GAUGE = 1,
+			SUMMARY = 2,
+		};
+
+		class family
+		{
+		public:
+			std::string _name;
+			std::string _help;
+			MetricType _type;
+			family()
+			    : _name("")
+			    , _help("")
+			    , _type(MetricType::COUNTER)
+			{
+			}
+		};
+
+		class series
+		{
+		public:
+			std::size_t _family;
+			// Rendered label pairs without braces, e.g. venue="bybit".
+			std::string _labels;
+			std::uint32_t _index;
+			const LatencyHistogram *_histogram;
+			series()
+			    : _family(0)
+			    , _labels("")
+			    , _index(0)
+			    , _histogram(nullptr)
+			{
+			}
+		};
+
+		class alignas(64) gauge_slot
+		{
+		public:
+			std::atomic<double> _value;
+			gauge_slot() : _value(0.0) {}
+		};
+
+		std::size_t _capacity;
+		mutable std::mutex _mutex;
+		std::vector<family> _families;
+		std::map<std::string, std::size_t> _family_index;
+		std::vector<series> _series;
+		std::map<std::string, std::size_t> _series_index;
+		std::size_t _counter_count;
+		std::vector<gauge_slot> _gauges;
+		std::size_t _gauge_count;
+		std::vector<std::unique_ptr<Writer>> _writers;
+
+		static const char *type_name(MetricType type)
+		{
+			switch (type)
+			{
+			case MetricType::COUNTER:
+				return "counter";
+			case MetricType::GAUGE:
+				return "gauge";
+			case MetricType::SUMMARY:
+				return "summary";
+			default:
+				return "untyped";
+			}
+		}
+
+		static std::string escape(const std::string &text, bool quote)
+		{
+			std::string out;
+			for (char c : text)
+			{
+				if (c == '\\')
+					out += "\\\\";
+				else if (c == '\n')
+					out += "\\n";
+				else if (quote && c == '"')
+					out += "\\\"";
+				else
+					out += c;
+			}
+			return out;
+		}
+
+		static std::string render_labels(const Labels &labels)
+		{
+			std::string out;
+			for (auto &[key, value] : labels)
+			{
+				if (!out.empty())
+					out += ',';
+				out += key + "=\"" + escape(value, true) + "\"";
+			}
+			return out;
+		}
+
+		static std::string format_value(double value)
+		{
+			char text[32];
+			std::snprintf(text, sizeof(text), "%.15g", value);
+			return text;
+		}
+
+		std::uint32_t do_register(const std::string &name,
+		                          const std::string &help,
+		                          const Labels &labels,
+		                          MetricType type,
+		                          const LatencyHistogram *histogram)
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			auto family_it = _family_index.find(name);
+			std::size_t family_id = 0;
+			if (family_it == _family_index.end())
+			{
+				family_id = _families.size();
+				family entry;
+				entry._name = name;
+				entry._help = help;
+				entry._type = type;
+				_families.push_back(std::move(entry));
+				_family_index.emplace(name, family_id);
+			}
+			else
+			{
+				family_id = family_it->second;
+				if (_families[family_id]._type != type)
+					throw std::runtime_error("Metric " + name +
+					                         " registered with another type");
+			}
+			auto rendered = render_labels(labels);
+			auto key = name + "{" + rendered + "}";
+			auto series_it = _series_index.find(key);
+			if (series_it != _series_index.end())
+			{
+				auto &existing = _series[series_it->second];
+				if (type == MetricType::SUMMARY)
+					existing._histogram = histogram;
+				return existing._index;
+			}
+			series entry;
+			entry._family = family_id;
+			entry._labels = rendered;
+			entry._histogram = histogram;
+			if (type == MetricType::COUNTER)
+			{
+				if (_counter_count >= _capacity)
+					throw std::runtime_error("Too many counters");
+				entry._index = static_cast<std::uint32_t>(_counter_count++);
+			}
+			else if (type == MetricType::GAUGE)
+			{
+				if (_gauge_count >= _capacity)
+					throw std::runtime_error("Too many gauges");
+				entry._index = static_cast<std::uint32_t>(_gauge_count++);
+			}
+			_series_index.emplace(key, _series.size());
+			_series.push_back(std::move(entry));
+			return _series.back()._index;
+		}
+
+		std::uint64_t do_sum(std::uint32_t index) const
+		{
+			std::uint64_t total = 0;
+			Counter counter;
+			counter._index = index;
+			for (auto &writer : _writers)
+				total += writer->value(counter);
+			return total;
+		}
+
+		void do_render(std::string &out, const family &family,
+		               const series &series) const
+		{
+			auto braces = [&](const std::string &extra)
+			{
+				std::string labels = series._labels;
+				if (!extra.empty())
+					labels += (labels.empty() ? "" : ",") + extra;
+				return labels.empty() ? std::string() : "{" + labels + "}";
+			};
+			switch (family._type)
+			{
+			case MetricType::COUNTER:
+				out += family._name + braces("") + " " +
+				       std::to_string(do_sum(series._index)) + "\n";
+				break;
+			case MetricType::GAUGE:
+				out += family._name + braces("") + " " +
+				       format_value(_gauges[series._index]._value.load(
+				           std::memory_order_relaxed)) +
+				       "\n";
+				break;
+			case MetricType::SUMMARY:
+			{
+				auto snap = series._histogram->snapshot();
+				const std::pair<const char *, double> quantiles[] = {
+				    {"0.5", 50.0}, {"0.9", 90.0}, {"0.99", 99.0},
+				    {"0.999", 99.9}};
+				for (auto &[label, percentile] : quantiles)
+				{
+					auto ns = snap.percentile(percentile);
+					out += family._name +
+					       braces(std::string("quantile=\"") + label + "\"") +
+					       " " + format_value(static_cast<double>(ns) / 1e9) +
+					       "\n";
+				}
+				out += family._name + "_sum" + braces("") + " " +
+				       format_value(static_cast<double>(snap._sum) / 1e9) +
+				       "\n";
+				out += family._name + "_count" + braces("") + " " +
+				       std::to_string(snap._count) + "\n";
+				break;
+			}
+			default:
+				break;
+			}
+		}
+	};
+} // namespace metrics
+
+#endif // METRICS_REGISTRY_H
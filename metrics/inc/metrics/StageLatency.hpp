@@ -0,0 +1,213 @@
+#ifndef METRICS_STAGE_LATENCY_H
+#define METRICS_STAGE_LATENCY_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <metrics/LatencyHistogram.hpp>
+#include <string>
+#include <timing/Clock.hpp>
+#include <vector>
+
+namespace metrics
+{
+	// Points along the tick-to-quote path, plus the fill-to-hedge leg.
+	// Each is measured from the start of its trace. SOCKET_RECEIVE only
+	// means something when the trace starts earlier than the read, e.g.
+	// at the exchange timestamp; the rest normally start at the read.
+	enum class Stage : unsigned int
+	{
+		SOCKET_RECEIVE = 0,
+		ON_DATA = 1,
+		FRAME_DECODED = 2,
+		BOOK_UPDATED = 3,
+		THEO_UPDATED = 4,
+		QUOTE_PLANNED = 5,
+		SSL_WRITE_RETURNED = 6,
+		ACK_RECEIVED = 7,
+		FILL_TO_HEDGE = 8,
+	};
+
+	constexpr std::size_t STAGE_COUNT = 9;
+
+	inline const char *stage_name(Stage stage)
+	{
+		switch (stage)
+		{
+		case Stage::SOCKET_RECEIVE:
+			return "socket_receive";
+		case Stage::ON_DATA:
+			return "on_data";
+		case Stage::FRAME_DECODED:
+			return "frame_decoded";
+		case Stage::BOOK_UPDATED:
+			return "book_updated";
+		case Stage::THEO_UPDATED:
+			return "theo_updated";
+		case Stage::QUOTE_PLANNED:
+			return "quote_planned";
+		case Stage::SSL_WRITE_RETURNED:
+			return "ssl_write_returned";
+		case Stage::ACK_RECEIVED:
+			return "ack_received";
+		case Stage::FILL_TO_HEDGE:
+			return "fill_to_hedge";
+		default:
+			return "unknown";
+		}
+	}
+
+	// One LatencyHistogram per (venue, stage). Register every venue
+	// before recording starts; histograms never move afterwards, so
+	// another thread can snapshot them while the owner records.
+	class StageLatency
+	{
+	public:
+		class Summary
+		{
+		public:
+			std::string _venue;
+			Stage _stage;
+			std::uint64_t _count;
+			std::uint64_t _p50_ns;
+			std::uint64_t _p99_ns;
+			std::uint64_t _p999_ns;
+			std::uint64_t _max_ns;
+			Summary()
+			    : _venue("")
+			    , _stage(Stage::SOCKET_RECEIVE)
+			    , _count(0)
+			    , _p50_ns(0)
+			    , _p99_ns(0)
+			    , _p999_ns(0)
+			    , _max_ns(0)
+			{
+			}
+		};
+
+	public:
+		StageLatency()
+		    : _venues()
+		    , _histograms()
+		{
+		}
+
+		std::size_t add_venue(const std::string &name)
+		{
+			for (std::size_t i = 0; i < _venues.size(); ++i)
+			{
+				if (_venues[i] == name)
+					return i;
+			}
+			_venues.push_back(name);
+			_histograms.push_back(std::make_unique<venue_histograms>());
+			return _venues.size() - 1;
+		}
+
+		std::size_t venue_count() const { return _venues.size(); }
+
+		const std::string &venue_name(std::size_t venue) const
+		{
+			return _venues[venue];
+		}
+
+		void record(std::size_t venue, Stage stage, std::int64_t latency_ns)
+		{
+			histogram(venue, stage).record(latency_ns);
+		}
+
+		LatencyHistogram &histogram(std::size_t venue, Stage stage)
+		{
+			return (*_histograms[venue])[static_cast<std::size_t>(stage)];
+		}
+
+		const LatencyHistogram &histogram(std::size_t venue,
+		                                  Stage stage) const
+		{
+			return (*_histograms[venue])[static_cast<std::size_t>(stage)];
+		}
+
+		// p50/p99/p99.9/max of every (venue, stage) with records.
+		std::vector<Summary> summarize() const
+		{
+			std::vector<Summary> out;
+			for (std::size_t v = 0; v < _venues.size(); ++v)
+			{
+				for (std::size_t s = 0; s < STAGE_COUNT; ++s)
+				{
+					auto snap = (*_histograms[v])[s].snapshot();
+					if (snap._count == 0)
+						continue;
+					Summary summary;
+					summary._venue = _venues[v];
+					summary._stage = static_cast<Stage>(s);
+					summary._count = snap._count;
+					summary._p50_ns = snap.percentile(50.0);
+					summary._p99_ns = snap.percentile(99.0);
+					summary._p999_ns = snap.percentile(99.9);
+					summary._max_ns = snap._max;
+					out.push_back(std::move(summary));
+				}
+			}
+			return out;
+		}
+
+	private:
+		using venue_histograms = std::array<LatencyHistogram, STAGE_COUNT>;
+
+		std::vector<std::string> _venues;
+		std::vector<std::unique_ptr<venue_histograms>> _histograms;
+	};
+
+	// Stamps the stages of one message against a start time. Typical use
+	// in on_data:
+	//   trace.begin(venue, session.last_receive_ns());
+	//   ... decode ...
+	//   trace.mark(Stage::FRAME_DECODED);
+	template <timing::Clock C>
+	class StageTrace
+	{
+	public:
+		StageTrace(StageLatency &latency, const C &clock)
+		    : _latency(latency)
+		    , _clock(clock)
+		    , _venue(0)
+		    , _start_ns(0)
+		{
+		}
+
+		void begin(std::size_t venue, std::int64_t start_ns)
+		{
+			_venue = venue;
+			_start_ns = start_ns;
+		}
+
+		void begin(std::size_t venue) { begin(venue, _clock.now_ns()); }
+
+		// Record now - start against stage, and return now.
+		std::int64_t mark(Stage stage)
+		{
+			auto now = _clock.now_ns();
+			_latency.record(_venue, stage, now - _start_ns);
+			return now;
+		}
+
+		// Record at_ns - start against stage, for a stage stamped
+		// elsewhere, e.g. TcpTlsSession::last_send_ns() in on_sent.
+		void mark(Stage stage, std::int64_t at_ns)
+		{
+			_latency.record(_venue, stage, at_ns - _start_ns);
+		}
+
+		std::int64_t start_ns() const { return _start_ns; }
+
+	private:
+		StageLatency &_latency;
+		const C &_clock;
+		std::size_t _venue;
+		std::int64_t _start_ns;
+	};
+} // namespace metrics
+
+#endif // METRICS_STAGE_LATENCY_H
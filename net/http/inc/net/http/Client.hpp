@@ -0,0 +1,575 @@
+#ifndef NET_HTTP_CLIENT_H
+#define NET_HTTP_CLIENT_H
+
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <initializer_list>
+#include <limits>
+#include <memory>
+#include <net/error.hpp>
+#include <net/http/ResponseParser.hpp>
+#include <net/tcp/TcpSession.hpp>
+#include <net/tcp/TcpTlsSession.hpp>
+#include <span>
+#include <string>
+#include <string_view>
+#include <timing/Clock.hpp>
+#include <utility>
+#include <vector>
+
+namespace net
+{
+	namespace http
+	{
+		// HTTP/1.1 client driven by poll(), on TcpTlsSession (or TcpSession
+		// for plain HTTP). Each host added gets a small pool of persistent
+		// connections, opened up front and reopened when they drop, so a
+		// poll does not pay for a handshake. Requests are pipelined: one
+		// goes to the least busy connection of its host as long as fewer
+		// than max_pipeline are in flight there, otherwise it waits in the
+		// host's queue. Everything a poll() dispatched leaves in one write
+		// per connection. Responses are parsed in place from the session's
+		// read buffer and handed to callbacks as Response views, valid
+		// during the callback only.
+		//
+		// A response asking to close the connection puts the requests
+		// pipelined behind it back in the queue, the server never saw
+		// them. When a connection drops, GET, HEAD and OPTIONS requests in
+		// flight are queued again once, as a server closing an idle
+		// connection can race a new request; other requests fail with
+		// status 0, since a POST may have gone through.
+		template <typename Session>
+		class BasicClient
+		{
+		public:
+			using OnResponseCallBack = std::function<void(const Response &)>;
+			// host, error
+			using OnErrorCallBack =
+			    std::function<void(std::uint32_t, net::NetError)>;
+
+			static constexpr std::uint32_t NO_HOST =
+			    std::numeric_limits<std::uint32_t>::max();
+
+		public:
+			explicit BasicClient(
+			    OnErrorCallBack &&on_error =
+			        [](std::uint32_t, net::NetError) {},
+			    std::size_t read_buffer_size = 65536)
+			    : _on_error(std::move(on_error))
+			    , _read_buffer_size(read_buffer_size)
+			    , _timeout_ns(0)
+			    , _clock()
+			    , _hosts()
+			{
+			}
+
+			BasicClient(const BasicClient &) = delete;
+
+			BasicClient &operator=(const BasicClient &) = delete;
+
+			// Starts connections to hostname:port; a host already added
+			// keeps its pool and id.
+			std::uint32_t add_host(const std::string &hostname, int port,
+			                       std::size_t connections = 2,
+			                       std::size_t max_pipeline = 8)
+			{
+				auto id = host_id(hostname, port);
+				if (id != NO_HOST)
+					return id;
+				id = static_cast<std::uint32_t>(_hosts.size());
+				_hosts.push_back(std::make_unique<host_state>());
+				auto &host = *_hosts.back();
+				host._hostname = hostname;
+				host._port = port;
+				host._authority = port == 443 || port == 80
+				                      ? hostname
+				                      : hostname + ":" + std::to_string(port);
+				host._max_pipeline = max_pipeline > 0 ? max_pipeline : 1;
+				for (std::size_t i = 0; i < (connections > 0 ? connections : 1);
+				     ++i)
+				{
+					host._connections.push_back(std::make_unique<connection>(
+					    *this, id, host._queue, hostname, port));
+					host._connections.back()->_session.connect(hostname, port);
+				}
+				return id;
+			}
+
+			std::uint32_t host_id(const std::string &hostname, int port) const
+			{
+				for (std::size_t i = 0; i < _hosts.size(); ++i)
+				{
+					if (_hosts[i]->_hostname == hostname &&
+					    _hosts[i]->_port == port)
+						return static_cast<std::uint32_t>(i);
+				}
+				return NO_HOST;
+			}
+
+			// Sent with every request to host, e.g. an API key.
+			void set_header(std::uint32_t host, const std::string &name,
+			                const std::string &value)
+			{
+				auto &headers = _hosts[host]->_headers;
+				for (auto &header : headers)
+				{
+					if (header.first == name)
+					{
+						header.second = value;
+						return;
+					}
+				}
+				headers.emplace_back(name, value);
+			}
+
+			// A request without its response this long after it was made
+			// fails with ERR_ETIMEDOUT, and the connection it waits on is
+			// dropped, as the responses behind it cannot overtake it.
+			// 0, the default, waits forever.
+			void set_timeout(std::int64_t timeout_ns)
+			{
+				_timeout_ns = timeout_ns;
+			}
+
+			// Clock for timeouts. It must outlive the client.
+			void set_clock(timing::ClockSource clock) { _clock = clock; }
+
+			void get(std::uint32_t host, std::string_view target,
+			         OnResponseCallBack &&on_response,
+			         std::initializer_list<Header> headers = {})
+			{
+				std::span<const Header> extra(headers.begin(), headers.size());
+				request(host, "GET", target, extra, std::string_view(),
+				        std::move(on_response));
+			}
+
+			void post(std::uint32_t host, std::string_view target,
+			          std::string_view body, std::string_view content_type,
+			          OnResponseCallBack &&on_response,
+			          std::initializer_list<Header> headers = {})
+			{
+				std::vector<Header> all(headers);
+				all.push_back(Header{"Content-Type", content_type});
+				request(host, "POST", target, all, body,
+				        std::move(on_response));
+			}
+
+			// Queues the request; poll() sends it. Host, Content-Length
+			// (for a body, or any POST, PUT and PATCH) and the host's
+			// headers are added.
+			void request(std::uint32_t host, std::string_view method,
+			             std::string_view target,
+			             std::span<const Header> headers,
+			             std::string_view body,
+			             OnResponseCallBack &&on_response)
+			{
+				auto &state = *_hosts[host];
+				request_state request;
+				do_encode(state, request._data, method, target, headers, body);
+				request._on_response = std::move(on_response);
+				request._deadline_ns =
+				    _timeout_ns > 0 ? _clock.now_ns() + _timeout_ns : 0;
+				request._head = method == "HEAD";
+				request._retry =
+				    method == "GET" || request._head || method == "OPTIONS";
+				state._queue.push_back(std::move(request));
+			}
+
+			// Read and dispatch responses, expire requests past their
+			// timeout, then hand queued requests to connections and send.
+			void poll()
+			{
+				for (std::uint32_t id = 0; id < _hosts.size(); ++id)
+				{
+					auto &host = *_hosts[id];
+					for (auto &connection : host._connections)
+						connection->poll();
+					if (_timeout_ns > 0)
+						do_expire(host);
+					do_dispatch(host);
+					for (auto &connection : host._connections)
+						connection->flush();
+				}
+			}
+
+			// Requests of host without their response yet, queued or in
+			// flight.
+			std::size_t pending(std::uint32_t host) const
+			{
+				auto &state = *_hosts[host];
+				auto count = state._queue.size();
+				for (auto &connection : state._connections)
+					count += connection->_in_flight.size();
+				return count;
+			}
+
+			// Open connections of host.
+			std::size_t connected(std::uint32_t host) const
+			{
+				std::size_t count = 0;
+				for (auto &connection : _hosts[host]->_connections)
+					count += connection->_connected ? 1 : 0;
+				return count;
+			}
+
+		private:
+			class request_state
+			{
+			public:
+				// The encoded request, kept until its response arrived so it
+				// can be sent again on another connection.
+				std::string _data;
+				OnResponseCallBack _on_response;
+				std::int64_t _deadline_ns;
+				bool _head;
+				// Safe to send again after a dropped connection.
+				bool _retry;
+				request_state()
+				    : _data()
+				    , _on_response()
+				    , _deadline_ns(0)
+				    , _head(false)
+				    , _retry(false)
+				{
+				}
+			};
+
+			// One persistent connection and the requests pipelined on it,
+			// oldest first.
+			class connection
+			{
+			public:
+				connection(BasicClient &client, std::uint32_t host,
+				           std::deque<request_state> &queue,
+				           const std::string &hostname, int port)
+				    : _client(client)
+				    , _host(host)
+				    , _queue(queue)
+				    , _hostname(hostname)
+				    , _port(port)
+				    , _parser()
+				    , _out()
+				    , _in()
+				    , _in_flight()
+				    , _connected(false)
+				    , _closing(false)
+				    , _reconnect(false)
+				    , _session(
+				          [this]() { do_connected(); },
+				          [this]() { do_disconnected(); },
+				          [](const std::string &) {},
+				          [this](const std::span<const char> &data)
+				          { do_receive(data); },
+				          [this](net::NetError err)
+				          { _client._on_error(_host, err); },
+				          client._read_buffer_size)
+				{
+				}
+
+				connection(const connection &) = delete;
+
+				connection &operator=(const connection &) = delete;
+
+				// Takes new requests: up, and not told to close.
+				bool usable() const { return _connected && !_closing; }
+
+				void poll()
+				{
+					if (_reconnect)
+					{
+						_reconnect = false;
+						_session.connect(_hostname, _port);
+					}
+					_session.poll();
+				}
+
+				// Closes the connection, and opens it again on the next
+				// poll(): not every Session reconnects by itself.
+				void drop()
+				{
+					_reconnect = true;
+					_session.disconnect();
+				}
+
+				void send(request_state &&request)
+				{
+					_out.insert(_out.end(), request._data.begin(),
+					            request._data.end());
+					_in_flight.push_back(std::move(request));
+				}
+
+				void flush()
+				{
+					if (_out.empty() || !_connected)
+						return;
+					_session.send(
+					    std::span<const char>(_out.data(), _out.size()));
+					_out.clear();
+				}
+
+				BasicClient &_client;
+				std::uint32_t _host;
+				// The host's queue, where requests go to be sent again.
+				std::deque<request_state> &_queue;
+				std::string _hostname;
+				int _port;
+				ResponseParser _parser;
+				// Requests dispatched since the last flush.
+				std::vector<char> _out;
+				// Tail of the input that did not hold a complete response.
+				std::vector<char> _in;
+				std::deque<request_state> _in_flight;
+				bool _connected;
+				// The server said it closes the connection.
+				bool _closing;
+				bool _reconnect;
+				// Last, so that it is destroyed first: its destructor
+				// reports the disconnect to the members above.
+				Session _session;
+
+			private:
+				void do_connected()
+				{
+					_connected = true;
+					_closing = false;
+					_in.clear();
+					_parser.reset();
+				}
+
+				void do_disconnected()
+				{
+					_connected = false;
+					_closing = false;
+					_in.clear();
+					_parser.reset();
+					_out.clear();
+					auto in_flight = std::move(_in_flight);
+					_in_flight.clear();
+					auto front = _queue.begin();
+					for (auto &request : in_flight)
+					{
+						if (!request._retry)
+						{
+							do_fail(request, net::NetError::ERR_ECONNRESET);
+							continue;
+						}
+						// Once only, a request that kills the connection
+						// must not loop.
+						request._retry = false;
+						front = _queue.insert(front, std::move(request)) + 1;
+					}
+				}
+
+				void do_receive(const std::span<const char> &data)
+				{
+					// Usual case: no leftover, parse straight from the
+					// session buffer and keep only an incomplete tail.
+					if (_in.empty())
+					{
+						auto used = do_parse(data.data(), data.size());
+						if (used < data.size() && _connected && !_closing)
+							_in.assign(data.begin() + static_cast<long>(used),
+							           data.end());
+						return;
+					}
+					_in.insert(_in.end(), data.begin(), data.end());
+					auto used = do_parse(_in.data(), _in.size());
+					if (_connected && !_closing)
+						_in.erase(_in.begin(),
+						          _in.begin() + static_cast<long>(used));
+				}
+
+				// Returns the bytes consumed by complete responses.
+				std::size_t do_parse(const char *data, std::size_t size)
+				{
+					std::size_t pos = 0;
+					while (pos < size && _connected && !_closing)
+					{
+						if (_in_flight.empty())
+						{
+							do_protocol_error();
+							return pos;
+						}
+						std::size_t consumed = 0;
+						auto result =
+						    _parser.parse(data + pos, size - pos, consumed,
+						                  _in_flight.front()._head);
+						if (result == ParseResult::INCOMPLETE)
+							return pos;
+						if (result == ParseResult::ERROR)
+						{
+							do_protocol_error();
+							return pos;
+						}
+						pos += consumed;
+						// 100 Continue and the like precede the response.
+						if (_parser.status() < 200)
+							continue;
+						do_response();
+					}
+					return pos;
+				}
+
+				void do_response()
+				{
+					auto request = std::move(_in_flight.front());
+					_in_flight.pop_front();
+					if (!_parser.keep_alive())
+					{
+						// What was pipelined behind it goes out again on
+						// another connection, in order.
+						_closing = true;
+						while (!_in_flight.empty())
+						{
+							_queue.push_front(std::move(_in_flight.back()));
+							_in_flight.pop_back();
+						}
+					}
+					if (request._on_response)
+						request._on_response(
+						    Response(&_parser, net::NetError::ERR_OK));
+					if (_closing)
+						drop();
+				}
+
+				void do_protocol_error()
+				{
+					_client._on_error(_host, net::NetError::ERR_EPROTO);
+					drop();
+				}
+			};
+
+			class host_state
+			{
+			public:
+				std::string _hostname;
+				int _port;
+				// Host header value.
+				std::string _authority;
+				std::vector<std::pair<std::string, std::string>> _headers;
+				std::size_t _max_pipeline;
+				std::deque<request_state> _queue;
+				// Last, so that the connections go first and fail their
+				// requests while the rest is still there.
+				std::vector<std::unique_ptr<connection>> _connections;
+				host_state()
+				    : _hostname()
+				    , _port(0)
+				    , _authority()
+				    , _headers()
+				    , _max_pipeline(1)
+				    , _queue()
+				    , _connections()
+				{
+				}
+			};
+
+			OnErrorCallBack _on_error;
+			std::size_t _read_buffer_size;
+			std::int64_t _timeout_ns;
+			timing::ClockSource _clock;
+			// Behind pointers, connections keep a reference to their host.
+			std::vector<std::unique_ptr<host_state>> _hosts;
+
+			static void do_fail(request_state &request, net::NetError error)
+			{
+				if (request._on_response)
+					request._on_response(Response(nullptr, error));
+			}
+
+			static void do_append(std::string &out, std::string_view name,
+			                      std::string_view value)
+			{
+				out.append(name);
+				out.append(": ");
+				out.append(value);
+				out.append("\r\n");
+			}
+
+			static void do_encode(const host_state &host, std::string &out,
+			                      std::string_view method,
+			                      std::string_view target,
+			                      std::span<const Header> headers,
+			                      std::string_view body)
+			{
+				out.reserve(256 + body.size());
+				out.append(method);
+				out.push_back(' ');
+				out.append(target);
+				out.append(" HTTP/1.1\r\n");
+				do_append(out, "Host", host._authority);
+				for (auto &header : host._headers)
+					do_append(out, header.first, header.second);
+				for (auto &header : headers)
+					do_append(out, header._name, header._value);
+				if (!body.empty() || method == "POST" || method == "PUT" ||
+				    method == "PATCH")
+				{
+					char text[24];
+					auto [end, ec] =
+					    std::to_chars(text, text + sizeof(text), body.size());
+					do_append(out, "Content-Length",
+					          std::string_view(
+					              text, static_cast<std::size_t>(end - text)));
+				}
+				out.append("\r\n");
+				out.append(body);
+			}
+
+			// Queued requests in order, each to the usable connection with
+			// the fewest in flight while that is under max_pipeline.
+			void do_dispatch(host_state &host)
+			{
+				while (!host._queue.empty())
+				{
+					connection *target = nullptr;
+					for (auto &connection : host._connections)
+					{
+						auto depth = connection->_in_flight.size();
+						if (connection->usable() &&
+						    depth < host._max_pipeline &&
+						    (!target || depth < target->_in_flight.size()))
+							target = connection.get();
+					}
+					if (!target)
+						return;
+					target->send(std::move(host._queue.front()));
+					host._queue.pop_front();
+				}
+			}
+
+			void do_expire(host_state &host)
+			{
+				auto now = _clock.now_ns();
+				while (!host._queue.empty() &&
+				       host._queue.front()._deadline_ns > 0 &&
+				       host._queue.front()._deadline_ns <= now)
+				{
+					auto request = std::move(host._queue.front());
+					host._queue.pop_front();
+					do_fail(request, net::NetError::ERR_ETIMEDOUT);
+				}
+				for (auto &connection : host._connections)
+				{
+					auto &in_flight = connection->_in_flight;
+					if (in_flight.empty() ||
+					    in_flight.front()._deadline_ns == 0 ||
+					    in_flight.front()._deadline_ns > now)
+						continue;
+					auto request = std::move(in_flight.front());
+					in_flight.pop_front();
+					do_fail(request, net::NetError::ERR_ETIMEDOUT);
+					connection->drop();
+				}
+			}
+		};
+
+		using Client = BasicClient<net::tcp::TcpTlsSession>;
+		using PlainClient = BasicClient<net::tcp::TcpSession>;
+	} // namespace http
+} // namespace net
+
+#endif // NET_HTTP_CLIENT_H
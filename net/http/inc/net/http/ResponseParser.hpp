@@ -0,0 +1,487 @@
+#ifndef NET_HTTP_RESPONSE_PARSER_H
+#define NET_HTTP_RESPONSE_PARSER_H
+
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <net/error.hpp>
+#include <string_view>
+#include <vector>
+
+namespace net
+{
+	namespace http
+	{
+		enum class ParseResult : unsigned int
+		{
+			COMPLETE = 0,
+			INCOMPLETE = 1,
+			ERROR = 2,
+		};
+
+		class Header
+		{
+		public:
+			std::string_view _name;
+			std::string_view _value;
+		};
+
+		// Incremental HTTP/1.x response parser. parse() reads one complete
+		// response from the front of a buffer; the status line, headers
+		// and body are views into that buffer, not copies. The one
+		// exception is a chunked body of several chunks, which is joined
+		// into a buffer the parser reuses from call to call. A response
+		// that is cut short returns INCOMPLETE and keeps what it parsed:
+		// pass the same bytes again, from the response's first byte, with
+		// more appended, and parsing resumes where it stopped, so the head
+		// and each chunk header are read once over any number of reads.
+		// The bytes may move between calls, the parser holds offsets. Call
+		// reset() when they are dropped instead.
+		//
+		// Bodies are framed by Content-Length or chunked transfer coding.
+		// A body that only ends when the server closes the connection is
+		// not supported and returns ERROR. Trailers are skipped.
+		class ResponseParser
+		{
+		public:
+			// Beyond this a response still without the end of its headers
+			// is an ERROR.
+			static constexpr std::size_t MAX_HEAD_SIZE = 64 * 1024;
+			static constexpr std::size_t MAX_HEADERS = 128;
+
+		public:
+			ResponseParser()
+			    : _headers()
+			    , _header_at()
+			    , _chunks()
+			    , _joined()
+			    , _reason_at()
+			    , _reason()
+			    , _body()
+			    , _status(0)
+			    , _minor_version(1)
+			    , _keep_alive(true)
+			    , _stage(stage::HEAD)
+			    , _pos(0)
+			    , _length(0)
+			    , _resume(false)
+			{
+				_headers.reserve(32);
+				_header_at.reserve(32);
+				_chunks.reserve(16);
+			}
+
+			ResponseParser(const ResponseParser &) = delete;
+
+			ResponseParser &operator=(const ResponseParser &) = delete;
+
+			// On COMPLETE, consumed is the size of the response. A response
+			// to HEAD carries no body whatever its headers say, so the
+			// caller has to tell.
+			ParseResult parse(const char *data, std::size_t size,
+			                  std::size_t &consumed, bool head_request = false)
+			{
+				if (!_resume || size < _pos)
+					reset();
+				consumed = 0;
+				auto result = do_parse(data, size, head_request);
+				_resume = result == ParseResult::INCOMPLETE;
+				if (result == ParseResult::COMPLETE)
+				{
+					do_views(data);
+					consumed = _pos;
+				}
+				return result;
+			}
+
+			// Forget a response left INCOMPLETE; the next parse() starts a
+			// new one.
+			void reset()
+			{
+				_headers.clear();
+				_header_at.clear();
+				_chunks.clear();
+				_reason = std::string_view();
+				_body = std::string_view();
+				_status = 0;
+				_stage = stage::HEAD;
+				_pos = 0;
+				_length = 0;
+				_resume = false;
+			}
+
+			int status() const { return _status; }
+
+			std::string_view reason() const { return _reason; }
+
+			// Value of the first header called name, compared without
+			// case; empty if there is none.
+			std::string_view header(std::string_view name) const
+			{
+				for (auto &header : _headers)
+				{
+					if (iequals(header._name, name))
+						return header._value;
+				}
+				return std::string_view();
+			}
+
+			const std::vector<Header> &headers() const { return _headers; }
+
+			std::string_view body() const { return _body; }
+
+			// Whether the server keeps the connection open after this
+			// response.
+			bool keep_alive() const { return _keep_alive; }
+
+		private:
+			// Where the next parse() goes on.
+			enum class stage : unsigned int
+			{
+				HEAD = 0,
+				BODY = 1,
+				CHUNK_SIZE = 2,
+				CHUNK_DATA = 3,
+				TRAILER = 4,
+			};
+
+			// Bytes at an offset from the response's first byte.
+			class text_at
+			{
+			public:
+				std::size_t _offset;
+				std::size_t _length;
+				text_at()
+				    : _offset(0)
+				    , _length(0)
+				{
+				}
+				text_at(std::size_t offset, std::size_t length)
+				    : _offset(offset)
+				    , _length(length)
+				{
+				}
+				std::string_view in(const char *data) const
+				{
+					return std::string_view(data + _offset, _length);
+				}
+			};
+
+			class header_at
+			{
+			public:
+				text_at _name;
+				text_at _value;
+			};
+
+			// Views of _header_at into the bytes of the last call.
+			std::vector<Header> _headers;
+			std::vector<header_at> _header_at;
+			std::vector<text_at> _chunks;
+			// Body of a response of several chunks.
+			std::vector<char> _joined;
+			text_at _reason_at;
+			std::string_view _reason;
+			std::string_view _body;
+			int _status;
+			int _minor_version;
+			bool _keep_alive;
+			stage _stage;
+			// Next byte to read; while in HEAD, where the search for the
+			// end of the head goes on.
+			std::size_t _pos;
+			// Of the body, or of the chunk being read.
+			std::uint64_t _length;
+			// The last call returned INCOMPLETE and the next one goes on.
+			bool _resume;
+
+			static char to_lower(char c)
+			{
+				return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a')
+				                            : c;
+			}
+
+			static bool iequals(std::string_view a, std::string_view b)
+			{
+				if (a.size() != b.size())
+					return false;
+				for (std::size_t i = 0; i < a.size(); ++i)
+				{
+					if (to_lower(a[i]) != to_lower(b[i]))
+						return false;
+				}
+				return true;
+			}
+
+			static std::string_view trim(std::string_view text)
+			{
+				while (!text.empty() &&
+				       (text.front() == ' ' || text.front() == '\t'))
+					text.remove_prefix(1);
+				while (!text.empty() &&
+				       (text.back() == ' ' || text.back() == '\t'))
+					text.remove_suffix(1);
+				return text;
+			}
+
+			// Whether the comma separated list holds token, without case.
+			static bool has_token(std::string_view list, std::string_view token)
+			{
+				while (!list.empty())
+				{
+					auto comma = list.find(',');
+					if (iequals(trim(list.substr(0, comma)), token))
+						return true;
+					if (comma == std::string_view::npos)
+						return false;
+					list.remove_prefix(comma + 1);
+				}
+				return false;
+			}
+
+			// chunked has to be the last coding applied.
+			static bool ends_with_chunked(std::string_view coding)
+			{
+				auto comma = coding.rfind(',');
+				if (comma != std::string_view::npos)
+					coding.remove_prefix(comma + 1);
+				return iequals(trim(coding), "chunked");
+			}
+
+			static bool to_number(std::string_view text, int base,
+			                      std::uint64_t &value)
+			{
+				auto first = text.data();
+				auto last = first + text.size();
+				auto [ptr, ec] = std::from_chars(first, last, value, base);
+				return ec == std::errc() && ptr == last && first != last;
+			}
+
+			// HTTP/1.x SP 3DIGIT SP reason, at the response's first byte.
+			bool do_status_line(std::string_view line)
+			{
+				if (line.size() < 12 || line.substr(0, 7) != "HTTP/1." ||
+				    line[7] < '0' || line[7] > '9' || line[8] != ' ' ||
+				    (line.size() > 12 && line[12] != ' '))
+					return false;
+				_minor_version = line[7] - '0';
+				std::uint64_t status = 0;
+				if (!to_number(line.substr(9, 3), 10, status) || status < 100)
+					return false;
+				_status = static_cast<int>(status);
+				_reason_at = line.size() > 12 ? text_at(13, line.size() - 13)
+				                              : text_at(12, 0);
+				return true;
+			}
+
+			// No space before the colon and no folded lines. The line is
+			// at offset in the response.
+			bool do_header(std::string_view line, std::size_t offset)
+			{
+				auto colon = line.find(':');
+				if (colon == 0 || colon == std::string_view::npos ||
+				    _header_at.size() >= MAX_HEADERS)
+					return false;
+				auto name = line.substr(0, colon);
+				if (name.back() == ' ' || name.back() == '\t' ||
+				    name.front() == ' ' || name.front() == '\t')
+					return false;
+				auto value = trim(line.substr(colon + 1));
+				auto value_offset =
+				    static_cast<std::size_t>(value.data() - line.data());
+				header_at header;
+				header._name = text_at(offset, colon);
+				header._value = text_at(offset + value_offset, value.size());
+				_header_at.push_back(header);
+				return true;
+			}
+
+			// Points the headers and the reason at data.
+			void do_views(const char *data)
+			{
+				_headers.clear();
+				for (auto &header : _header_at)
+					_headers.push_back(
+					    Header{header._name.in(data), header._value.in(data)});
+				_reason = _reason_at.in(data);
+			}
+
+			ParseResult do_parse(const char *data, std::size_t size,
+			                     bool head_request)
+			{
+				if (_stage == stage::HEAD)
+				{
+					auto result = do_head(data, size, head_request);
+					if (result != ParseResult::INCOMPLETE ||
+					    _stage == stage::HEAD)
+						return result;
+				}
+				if (_stage == stage::BODY)
+				{
+					if (size - _pos < _length)
+						return ParseResult::INCOMPLETE;
+					auto length = static_cast<std::size_t>(_length);
+					_body = std::string_view(data + _pos, length);
+					_pos += length;
+					return ParseResult::COMPLETE;
+				}
+				return do_chunked(data, size);
+			}
+
+			// INCOMPLETE with _stage moved on once the head is read and a
+			// body follows.
+			ParseResult do_head(const char *data, std::size_t size,
+			                    bool head_request)
+			{
+				std::string_view text(data, size);
+				auto head_end = text.find("\r\n\r\n", _pos);
+				if (head_end == std::string_view::npos)
+				{
+					// The end may straddle this call and the next.
+					_pos = size < 3 ? 0 : size - 3;
+					return size > MAX_HEAD_SIZE ? ParseResult::ERROR
+					                            : ParseResult::INCOMPLETE;
+				}
+				auto line_end = text.find("\r\n");
+				if (!do_status_line(text.substr(0, line_end)))
+					return ParseResult::ERROR;
+				auto pos = line_end + 2;
+				while (pos < head_end + 2)
+				{
+					line_end = text.find("\r\n", pos);
+					if (!do_header(text.substr(pos, line_end - pos), pos))
+						return ParseResult::ERROR;
+					pos = line_end + 2;
+				}
+				_pos = head_end + 4;
+				do_views(data);
+				_keep_alive = do_keep_alive();
+				// 1xx, 204 and 304 never have a body.
+				if (head_request || _status < 200 || _status == 204 ||
+				    _status == 304)
+					return ParseResult::COMPLETE;
+				auto coding = header("Transfer-Encoding");
+				if (!coding.empty())
+				{
+					if (!ends_with_chunked(coding))
+						return ParseResult::ERROR;
+					_stage = stage::CHUNK_SIZE;
+					return ParseResult::INCOMPLETE;
+				}
+				auto length_text = header("Content-Length");
+				if (!to_number(length_text, 10, _length))
+					return ParseResult::ERROR;
+				_stage = stage::BODY;
+				return ParseResult::INCOMPLETE;
+			}
+
+			bool do_keep_alive() const
+			{
+				auto connection = header("Connection");
+				if (_minor_version == 0)
+					return has_token(connection, "keep-alive");
+				return !has_token(connection, "close");
+			}
+
+			ParseResult do_chunked(const char *data, std::size_t size)
+			{
+				std::string_view text(data, size);
+				while (_stage == stage::CHUNK_SIZE ||
+				       _stage == stage::CHUNK_DATA)
+				{
+					if (_stage == stage::CHUNK_DATA)
+					{
+						if (size - _pos < _length + 2)
+							return ParseResult::INCOMPLETE;
+						auto bytes = static_cast<std::size_t>(_length);
+						if (data[_pos + bytes] != '\r' ||
+						    data[_pos + bytes + 1] != '\n')
+							return ParseResult::ERROR;
+						_chunks.push_back(text_at(_pos, bytes));
+						_pos += bytes + 2;
+						_stage = stage::CHUNK_SIZE;
+						continue;
+					}
+					auto line_end = text.find("\r\n", _pos);
+					if (line_end == std::string_view::npos)
+						return ParseResult::INCOMPLETE;
+					// Chunk extensions follow the size after ';'.
+					auto line = text.substr(_pos, line_end - _pos);
+					line = trim(line.substr(0, line.find(';')));
+					if (line.size() > 15 || !to_number(line, 16, _length))
+						return ParseResult::ERROR;
+					_pos = line_end + 2;
+					_stage = _length == 0 ? stage::TRAILER : stage::CHUNK_DATA;
+				}
+				// Trailer lines up to an empty one.
+				while (true)
+				{
+					auto line_end = text.find("\r\n", _pos);
+					if (line_end == std::string_view::npos)
+						return ParseResult::INCOMPLETE;
+					auto empty = line_end == _pos;
+					_pos = line_end + 2;
+					if (empty)
+						break;
+				}
+				if (_chunks.size() == 1)
+					_body = _chunks.front().in(data);
+				else if (_chunks.size() > 1)
+				{
+					_joined.clear();
+					for (auto &chunk : _chunks)
+					{
+						auto bytes = chunk.in(data);
+						_joined.insert(_joined.end(), bytes.begin(),
+						               bytes.end());
+					}
+					_body = std::string_view(_joined.data(), _joined.size());
+				}
+				return ParseResult::COMPLETE;
+			}
+		};
+
+		// What a request got back. Without a response, after the
+		// connection was lost or the request timed out, status() is 0 and
+		// error() says why. The views point into the connection's input
+		// and are only valid during the callback it is handed to.
+		class Response
+		{
+		public:
+			Response(const ResponseParser *parser, net::NetError error)
+			    : _parser(parser)
+			    , _error(error)
+			{
+			}
+
+			int status() const { return _parser ? _parser->status() : 0; }
+
+			// A 2xx response.
+			bool ok() const { return status() >= 200 && status() < 300; }
+
+			net::NetError error() const { return _error; }
+
+			std::string_view reason() const
+			{
+				return _parser ? _parser->reason() : std::string_view();
+			}
+
+			std::string_view header(std::string_view name) const
+			{
+				return _parser ? _parser->header(name) : std::string_view();
+			}
+
+			std::string_view body() const
+			{
+				return _parser ? _parser->body() : std::string_view();
+			}
+
+		private:
+			const ResponseParser *_parser;
+			net::NetError _error;
+		};
+	} // namespace http
+} // namespace net
+
+#endif // NET_HTTP_RESPONSE_PARSER_H
@@ -73,6 +73,7 @@ namespace net
 		ERR_EISNAM = EISNAM,
 		ERR_EREMOTEIO = EREMOTEIO,
 		ERR_EDQUOT = EDQUOT,
+		ERR_EPROTO = EPROTO,
 
 		// --- OpenSSL SSL_get_error() return codes ---
 		ERR_SSL_ERROR_NONE = SSL_ERROR_NONE,
@@ -0,0 +1,453 @@
+#ifndef NET_REDIS_CLIENT_H
+#define NET_REDIS_CLIENT_H
+
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <net/error.hpp>
+#include <net/redis/RespParser.hpp>
+#include <net/tcp/TcpSession.hpp>
+#include <net/tcp/TcpTlsSession.hpp>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace net
+{
+	namespace redis
+	{
+		// Pipelined Redis client driven by poll(), on a TcpSession or a
+		// TcpTlsSession. command() only encodes into an output buffer and
+		// queues the reply callback; everything queued goes out in one
+		// write at the end of poll() or on flush(). Replies are parsed in
+		// place from the session's read buffer and handed to callbacks as
+		// RespReply views, valid during the callback only. Pub/sub
+		// messages (RESP3 pushes, or RESP2 message arrays while
+		// subscribed) go to the subscription's handler instead.
+		// A blocking XREAD holds up every command behind it, give it its
+		// own client.
+		template <typename Session>
+		class BasicClient
+		{
+		public:
+			using OnConnectedCallBack = std::function<void()>;
+			using OnDisConnectedCallBack = std::function<void()>;
+			using OnErrorCallBack = std::function<void(net::NetError)>;
+			using OnReplyCallBack = std::function<void(const RespReply &)>;
+			// channel, payload
+			using OnMessageCallBack =
+			    std::function<void(std::string_view, std::string_view)>;
+
+		public:
+			BasicClient(
+			    OnConnectedCallBack &&on_connected = []() {},
+			    OnDisConnectedCallBack &&on_disconnected = []() {},
+			    OnErrorCallBack &&on_error = [](net::NetError) {},
+			    std::size_t read_buffer_size = 65536)
+			    : _on_connected(std::move(on_connected))
+			    , _on_disconnected(std::move(on_disconnected))
+			    , _on_error(std::move(on_error))
+			    , _parser()
+			    , _out()
+			    , _in()
+			    , _pending()
+			    , _channels()
+			    , _patterns()
+			    , _protocol(2)
+			    , _subscribed(false)
+			    , _connected(false)
+			    , _session(
+			          [this]() { do_connected(); },
+			          [this]() { do_disconnected(); },
+			          [](const std::string &) {},
+			          [this](const std::span<const char> &data)
+			          { do_receive(data); },
+			          [this](net::NetError err) { _on_error(err); },
+			          read_buffer_size)
+			{
+				_out.reserve(65536);
+			}
+
+			BasicClient(const BasicClient &) = delete;
+
+			BasicClient &operator=(const BasicClient &) = delete;
+
+			void connect(const std::string &hostname, int port)
+			{
+				_session.connect(hostname, port);
+			}
+
+			void connect(const std::string &host_port)
+			{
+				_session.connect(host_port);
+			}
+
+			void disconnect() { _session.disconnect(); }
+
+			// Read and dispatch replies, then flush what the callbacks and
+			// the caller queued since the last poll.
+			void poll()
+			{
+				_session.poll();
+				flush();
+			}
+
+			bool connected() const { return _connected; }
+
+			// Commands whose reply has not arrived yet.
+			std::size_t pending() const { return _pending.size(); }
+
+			Session &session() { return _session; }
+
+			// Ask for RESP3 with HELLO on every (re)connect; must be set
+			// before connect(). Pub/sub then arrives as push messages.
+			void set_protocol(int protocol) { _protocol = protocol; }
+
+			// Queue a command. Arguments are sent as bulk strings and may
+			// hold any bytes.
+			void command(std::initializer_list<std::string_view> args,
+			             OnReplyCallBack &&on_reply = {})
+			{
+				do_encode(args.begin(), args.end());
+				_pending.push_back(std::move(on_reply));
+			}
+
+			void command(const std::vector<std::string_view> &args,
+			             OnReplyCallBack &&on_reply = {})
+			{
+				do_encode(args.begin(), args.end());
+				_pending.push_back(std::move(on_reply));
+			}
+
+			// Send everything queued by command() now.
+			void flush()
+			{
+				if (_out.empty() || !_connected)
+					return;
+				_session.send(std::span<const char>(_out.data(), _out.size()));
+				_out.clear();
+			}
+
+			// XADD stream [MAXLEN ~ max_len] id field value ...; id "*"
+			// lets the server pick it.
+			void xadd(std::string_view stream, std::string_view id,
+			          std::span<const std::pair<std::string_view,
+			                                    std::string_view>>
+			              fields,
+			          OnReplyCallBack &&on_reply = {},
+			          std::size_t max_len = 0)
+			{
+				char len_text[24];
+				std::vector<std::string_view> args{"XADD", stream};
+				if (max_len > 0)
+				{
+					args.push_back("MAXLEN");
+					args.push_back("~");
+					args.push_back(to_text(len_text, max_len));
+				}
+				args.push_back(id);
+				for (auto &field : fields)
+				{
+					args.push_back(field.first);
+					args.push_back(field.second);
+				}
+				command(args, std::move(on_reply));
+			}
+
+			// XREAD [COUNT count] [BLOCK block_ms] STREAMS s... id...;
+			// block_ms < 0 does not block. "$" reads only new entries.
+			void xread(std::span<const std::string_view> streams,
+			           std::span<const std::string_view> ids,
+			           OnReplyCallBack &&on_reply, std::size_t count = 0,
+			           long block_ms = -1)
+			{
+				char count_text[24];
+				char block_text[24];
+				std::vector<std::string_view> args{"XREAD"};
+				if (count > 0)
+				{
+					args.push_back("COUNT");
+					args.push_back(to_text(count_text, count));
+				}
+				if (block_ms >= 0)
+				{
+					args.push_back("BLOCK");
+					args.push_back(to_text(block_text,
+					                       static_cast<std::size_t>(block_ms)));
+				}
+				args.push_back("STREAMS");
+				args.insert(args.end(), streams.begin(), streams.end());
+				args.insert(args.end(), ids.begin(), ids.end());
+				command(args, std::move(on_reply));
+			}
+
+			void publish(std::string_view channel, std::string_view message,
+			             OnReplyCallBack &&on_reply = {})
+			{
+				command({"PUBLISH", channel, message}, std::move(on_reply));
+			}
+
+			// Subscriptions are renewed after a reconnect. On RESP2 the
+			// connection only takes (un)subscribe and PING while it has
+			// any, use a second client for other commands.
+			void subscribe(const std::string &channel,
+			               OnMessageCallBack &&on_message)
+			{
+				_channels[channel] = std::move(on_message);
+				do_subscribe("SUBSCRIBE", channel);
+			}
+
+			// on_message receives the matching channel, not the pattern.
+			void psubscribe(const std::string &pattern,
+			                OnMessageCallBack &&on_message)
+			{
+				_patterns[pattern] = std::move(on_message);
+				do_subscribe("PSUBSCRIBE", pattern);
+			}
+
+			void unsubscribe(const std::string &channel)
+			{
+				if (_channels.erase(channel) > 0)
+					do_encode_subscription("UNSUBSCRIBE", channel);
+			}
+
+			void punsubscribe(const std::string &pattern)
+			{
+				if (_patterns.erase(pattern) > 0)
+					do_encode_subscription("PUNSUBSCRIBE", pattern);
+			}
+
+		private:
+			// Lets messages look up their handler without a std::string.
+			class name_hash
+			{
+			public:
+				using is_transparent = void;
+				std::size_t operator()(std::string_view name) const
+				{
+					return std::hash<std::string_view>()(name);
+				}
+			};
+
+			OnConnectedCallBack _on_connected;
+			OnDisConnectedCallBack _on_disconnected;
+			OnErrorCallBack _on_error;
+			RespParser _parser;
+			// Encoded commands not sent yet.
+			std::vector<char> _out;
+			// Tail of the input that did not hold a complete reply.
+			std::vector<char> _in;
+			std::deque<OnReplyCallBack> _pending;
+			std::unordered_map<std::string, OnMessageCallBack, name_hash,
+			                   std::equal_to<>>
+			    _channels;
+			std::unordered_map<std::string, OnMessageCallBack, name_hash,
+			                   std::equal_to<>>
+			    _patterns;
+			int _protocol;
+			// RESP2 sends pub/sub messages as plain arrays once subscribed.
+			bool _subscribed;
+			bool _connected;
+			// Last, so that it is destroyed first: its destructor reports
+			// the disconnect to the members above.
+			Session _session;
+
+			static std::string_view to_text(char (&text)[24],
+			                                std::size_t value)
+			{
+				auto [end, ec] = std::to_chars(text, std::end(text), value);
+				return std::string_view(text,
+				                        static_cast<std::size_t>(end - text));
+			}
+
+			void do_append(std::string_view text)
+			{
+				_out.insert(_out.end(), text.begin(), text.end());
+			}
+
+			void do_append_number(char marker, std::size_t value)
+			{
+				char text[24];
+				text[0] = marker;
+				auto [end, ec] =
+				    std::to_chars(text + 1, text + sizeof(text), value);
+				_out.insert(_out.end(), text, end);
+				_out.push_back('\r');
+				_out.push_back('\n');
+			}
+
+			template <typename It>
+			void do_encode(It first, It last)
+			{
+				do_append_number('*', static_cast<std::size_t>(last - first));
+				for (auto it = first; it != last; ++it)
+				{
+					std::string_view arg(*it);
+					do_append_number('$', arg.size());
+					do_append(arg);
+					do_append("\r\n");
+				}
+			}
+
+			void do_encode_subscription(std::string_view verb,
+			                            std::string_view name)
+			{
+				std::string_view args[] = {verb, name};
+				do_encode(std::begin(args), std::end(args));
+			}
+
+			void do_subscribe(std::string_view verb, std::string_view name)
+			{
+				if (_protocol < 3)
+					_subscribed = true;
+				do_encode_subscription(verb, name);
+			}
+
+			void do_connected()
+			{
+				_connected = true;
+				_in.clear();
+				_parser.reset();
+				// Whatever was queued while down goes after the handshake.
+				std::vector<char> queued;
+				queued.swap(_out);
+				std::deque<OnReplyCallBack> callbacks;
+				callbacks.swap(_pending);
+				if (_protocol >= 3)
+					command({"HELLO", "3"});
+				_subscribed = false;
+				for (auto &channel : _channels)
+					do_subscribe("SUBSCRIBE", channel.first);
+				for (auto &pattern : _patterns)
+					do_subscribe("PSUBSCRIBE", pattern.first);
+				_out.insert(_out.end(), queued.begin(), queued.end());
+				for (auto &callback : callbacks)
+					_pending.push_back(std::move(callback));
+				flush();
+				_on_connected();
+			}
+
+			// Commands in flight are lost with the connection: fail their
+			// callbacks so callers do not wait forever.
+			void do_disconnected()
+			{
+				_connected = false;
+				_in.clear();
+				_parser.reset();
+				_out.clear();
+				auto pending = std::move(_pending);
+				_pending.clear();
+				static const char lost[] = "-ERR connection lost\r\n";
+				RespParser parser;
+				std::size_t consumed = 0;
+				parser.parse(lost, sizeof(lost) - 1, consumed);
+				for (auto &callback : pending)
+					if (callback)
+						callback(parser.reply());
+				_on_disconnected();
+			}
+
+			void do_receive(const std::span<const char> &data)
+			{
+				// Usual case: no leftover, parse straight from the session
+				// buffer and keep only an incomplete tail.
+				if (_in.empty())
+				{
+					auto used = do_dispatch(data.data(), data.size());
+					if (used < data.size() && _connected)
+						_in.assign(data.begin() + static_cast<long>(used),
+						           data.end());
+					return;
+				}
+				_in.insert(_in.end(), data.begin(), data.end());
+				auto used = do_dispatch(_in.data(), _in.size());
+				if (_connected)
+					_in.erase(_in.begin(),
+					          _in.begin() + static_cast<long>(used));
+			}
+
+			// Returns the bytes consumed by complete replies.
+			std::size_t do_dispatch(const char *data, std::size_t size)
+			{
+				std::size_t pos = 0;
+				while (pos < size && _connected)
+				{
+					std::size_t consumed = 0;
+					auto result =
+					    _parser.parse(data + pos, size - pos, consumed);
+					if (result == ParseResult::INCOMPLETE)
+						return pos;
+					if (result == ParseResult::ERROR)
+					{
+						_on_error(net::NetError::ERR_EPROTO);
+						_session.disconnect();
+						return pos;
+					}
+					pos += consumed;
+					do_reply(_parser.reply());
+				}
+				return pos;
+			}
+
+			void do_reply(const RespReply &reply)
+			{
+				if (do_pubsub(reply))
+					return;
+				if (_pending.empty())
+					return;
+				auto callback = std::move(_pending.front());
+				_pending.pop_front();
+				if (callback)
+					callback(reply);
+			}
+
+			// Returns true if reply was a pub/sub message or confirmation.
+			bool do_pubsub(const RespReply &reply)
+			{
+				auto push = reply.type() == RespType::PUSH;
+				if (!push && !(_subscribed && reply.type() == RespType::ARRAY))
+					return false;
+				// Other pushes (client tracking) are not handled here.
+				if (reply.size() < 3)
+					return push;
+				auto kind = reply[0].str();
+				if (kind == "message")
+				{
+					auto channel = reply[1].str();
+					auto it = _channels.find(channel);
+					if (it != _channels.end())
+						it->second(channel, reply[2].str());
+					return true;
+				}
+				if (kind == "pmessage" && reply.size() >= 4)
+				{
+					auto it = _patterns.find(reply[1].str());
+					if (it != _patterns.end())
+						it->second(reply[2].str(), reply[3].str());
+					return true;
+				}
+				if (kind == "subscribe" || kind == "psubscribe")
+					return true;
+				if (kind == "unsubscribe" || kind == "punsubscribe")
+				{
+					if (reply[2].integer() == 0)
+						_subscribed = false;
+					return true;
+				}
+				return push;
+			}
+		};
+
+		using Client = BasicClient<net::tcp::TcpSession>;
+		using TlsClient = BasicClient<net::tcp::TcpTlsSession>;
+	} // namespace redis
+} // namespace net
+
+#endif // NET_REDIS_CLIENT_H
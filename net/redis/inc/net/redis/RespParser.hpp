@@ -0,0 +1,563 @@
+#ifndef NET_REDIS_RESP_PARSER_H
+#define NET_REDIS_RESP_PARSER_H
+
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+namespace net
+{
+	namespace redis
+	{
+		enum class RespType : unsigned int
+		{
+			SIMPLE_STRING = 0,
+			ERROR = 1,
+			INTEGER = 2,
+			BULK_STRING = 3,
+			NIL = 4,
+			ARRAY = 5,
+			MAP = 6,
+			SET = 7,
+			PUSH = 8,
+			DOUBLE = 9,
+			BOOLEAN = 10,
+			BIG_NUMBER = 11,
+			VERBATIM_STRING = 12,
+			BULK_ERROR = 13,
+		};
+
+		enum class ParseResult : unsigned int
+		{
+			COMPLETE = 0,
+			INCOMPLETE = 1,
+			ERROR = 2,
+		};
+
+		class RespParser;
+
+		// View of one parsed value. Strings point into the bytes given to
+		// RespParser::parse() and the view itself into the parser's node
+		// pool, so it is only valid until the next parse() or until those
+		// bytes go away. Maps expose their keys and values as alternating
+		// elements.
+		class RespReply
+		{
+		public:
+			class iterator
+			{
+			public:
+				iterator(const RespParser *parser, std::uint32_t index)
+				    : _parser(parser)
+				    , _index(index)
+				{
+				}
+
+				RespReply operator*() const
+				{
+					return RespReply(_parser, _index);
+				}
+
+				iterator &operator++();
+
+				bool operator==(const iterator &other) const
+				{
+					return _index == other._index;
+				}
+
+			private:
+				const RespParser *_parser;
+				std::uint32_t _index;
+			};
+
+		public:
+			RespReply(const RespParser *parser, std::uint32_t index)
+			    : _parser(parser)
+			    , _index(index)
+			{
+			}
+
+			RespType type() const;
+
+			bool is_error() const
+			{
+				return type() == RespType::ERROR ||
+				       type() == RespType::BULK_ERROR;
+			}
+
+			bool is_nil() const { return type() == RespType::NIL; }
+
+			// Text of strings, errors, big numbers and verbatim strings
+			// (without the "txt:" prefix); the raw digits of numbers.
+			std::string_view str() const;
+
+			std::int64_t integer() const;
+
+			double number() const;
+
+			bool boolean() const;
+
+			// Elements of an aggregate; a map has 2 per entry.
+			std::size_t size() const;
+
+			// Linear in i, prefer iterating large aggregates.
+			RespReply operator[](std::size_t i) const;
+
+			iterator begin() const;
+
+			iterator end() const { return iterator(_parser, NO_NODE); }
+
+			static constexpr std::uint32_t NO_NODE = 0xffffffffu;
+
+		private:
+			const RespParser *_parser;
+			std::uint32_t _index;
+		};
+
+		// Incremental RESP2/RESP3 parser. parse() reads one complete value
+		// from the front of a buffer into a node pool that is reused from
+		// call to call; strings are not copied. A value that is cut short
+		// returns INCOMPLETE and keeps what it parsed: pass the same bytes
+		// again, from the value's first byte, with more appended, and
+		// parsing resumes at the element that was cut, so a large reply
+		// costs O(n) over any number of reads. The bytes may move between
+		// calls, nodes hold offsets. Call reset() when they are dropped
+		// instead. Attributes are skipped. Streamed strings and aggregates
+		// (RESP3 "?" lengths) are not supported and return ERROR.
+		class RespParser
+		{
+		public:
+			static constexpr std::size_t MAX_DEPTH = 64;
+
+		public:
+			RespParser()
+			    : _nodes()
+			    , _stack()
+			    , _base(nullptr)
+			    , _pos(0)
+			    , _resume(false)
+			{
+				_nodes.reserve(64);
+				_stack.reserve(MAX_DEPTH);
+			}
+
+			RespParser(const RespParser &) = delete;
+
+			RespParser &operator=(const RespParser &) = delete;
+
+			// On COMPLETE, consumed is the size of the value and reply()
+			// views it.
+			ParseResult parse(const char *data, std::size_t size,
+			                  std::size_t &consumed)
+			{
+				if (!_resume || size < _pos)
+					reset();
+				_base = data;
+				consumed = 0;
+				while (true)
+				{
+					auto result = do_parse_value(data, size, _pos);
+					if (result != ParseResult::COMPLETE)
+					{
+						_resume = result == ParseResult::INCOMPLETE;
+						return result;
+					}
+					// A leading attribute leaves no root behind.
+					if (_stack.empty() && !_nodes.empty())
+					{
+						consumed = _pos;
+						_resume = false;
+						return ParseResult::COMPLETE;
+					}
+				}
+			}
+
+			// Forget a value left INCOMPLETE; the next parse() starts a new
+			// one.
+			void reset()
+			{
+				_nodes.clear();
+				_stack.clear();
+				_pos = 0;
+				_resume = false;
+			}
+
+			RespReply reply() const { return RespReply(this, 0); }
+
+		private:
+			friend class RespReply;
+
+			class resp_node
+			{
+			public:
+				RespType _type;
+				std::uint32_t _size;
+				std::uint32_t _first_child;
+				std::uint32_t _last_child;
+				std::uint32_t _next;
+				std::int64_t _integer;
+				double _double;
+				// Text at _base + _offset, NO_TEXT if there is none.
+				std::size_t _offset;
+				std::size_t _length;
+				resp_node()
+				    : _type(RespType::NIL)
+				    , _size(0)
+				    , _first_child(RespReply::NO_NODE)
+				    , _last_child(RespReply::NO_NODE)
+				    , _next(RespReply::NO_NODE)
+				    , _integer(0)
+				    , _double(0)
+				    , _offset(NO_TEXT)
+				    , _length(0)
+				{
+				}
+			};
+
+			// An aggregate still waiting for elements.
+			class open_frame
+			{
+			public:
+				std::uint32_t _node;
+				std::uint64_t _remaining;
+				bool _attribute;
+				open_frame()
+				    : _node(0)
+				    , _remaining(0)
+				    , _attribute(false)
+				{
+				}
+			};
+
+			static constexpr std::size_t NO_TEXT = ~std::size_t(0);
+
+			std::vector<resp_node> _nodes;
+			std::vector<open_frame> _stack;
+			// Bytes of the last parse() call, and where it stopped.
+			const char *_base;
+			std::size_t _pos;
+			// The last call returned INCOMPLETE and the next one goes on.
+			bool _resume;
+
+			std::string_view do_text(const resp_node &node) const
+			{
+				if (node._offset == NO_TEXT)
+					return std::string_view();
+				return std::string_view(_base + node._offset, node._length);
+			}
+
+			static bool find_line(const char *data, std::size_t size,
+			                      std::size_t pos, std::size_t &end)
+			{
+				while (pos < size)
+				{
+					auto cr = static_cast<const char *>(
+					    std::memchr(data + pos, '\r', size - pos));
+					if (!cr)
+						return false;
+					end = static_cast<std::size_t>(cr - data);
+					if (end + 1 >= size)
+						return false;
+					if (data[end + 1] == '\n')
+						return true;
+					pos = end + 1;
+				}
+				return false;
+			}
+
+			static bool to_integer(const char *first, const char *last,
+			                       std::int64_t &value)
+			{
+				auto [ptr, ec] = std::from_chars(first, last, value);
+				return ec == std::errc() && ptr == last && first != last;
+			}
+
+			// Adds a node under the innermost open aggregate, or as the
+			// root. Attribute nodes are not linked, they are dropped once
+			// read.
+			std::uint32_t do_add_node(RespType type, bool link)
+			{
+				auto index = static_cast<std::uint32_t>(_nodes.size());
+				_nodes.emplace_back();
+				_nodes.back()._type = type;
+				if (!link || _stack.empty())
+					return index;
+				auto &parent = _nodes[_stack.back()._node];
+				if (parent._first_child == RespReply::NO_NODE)
+					parent._first_child = index;
+				else
+					_nodes[parent._last_child]._next = index;
+				parent._last_child = index;
+				return index;
+			}
+
+			// A value finished: count it against the open aggregates and
+			// close the ones it completes.
+			void do_complete()
+			{
+				while (!_stack.empty())
+				{
+					auto &frame = _stack.back();
+					if (frame._remaining > 0 && --frame._remaining > 0)
+						return;
+					auto attribute = frame._attribute;
+					auto node = frame._node;
+					_stack.pop_back();
+					// An attribute only annotates the next value, drop it
+					// and its elements without counting it.
+					if (attribute)
+					{
+						_nodes.resize(node);
+						return;
+					}
+				}
+			}
+
+			ParseResult do_open(RespType type, std::int64_t count,
+			                    std::uint64_t per_entry, bool attribute)
+			{
+				if (count < 0)
+					return ParseResult::ERROR;
+				if (_stack.size() >= MAX_DEPTH)
+					return ParseResult::ERROR;
+				auto index = do_add_node(type, !attribute);
+				auto elements = static_cast<std::uint64_t>(count) * per_entry;
+				_nodes[index]._size = static_cast<std::uint32_t>(elements);
+				if (elements == 0)
+				{
+					if (attribute)
+						_nodes.resize(index);
+					else
+						do_complete();
+					return ParseResult::COMPLETE;
+				}
+				open_frame frame;
+				frame._node = index;
+				frame._remaining = elements;
+				frame._attribute = attribute;
+				_stack.push_back(frame);
+				return ParseResult::COMPLETE;
+			}
+
+			ParseResult do_parse_value(const char *data, std::size_t size,
+			                           std::size_t &pos)
+			{
+				std::size_t end = 0;
+				if (!find_line(data, size, pos + 1, end))
+					return ParseResult::INCOMPLETE;
+				auto marker = data[pos];
+				auto line = data + pos + 1;
+				auto line_end = data + end;
+				auto next = end + 2;
+				switch (marker)
+				{
+				case '+':
+				case '-':
+				case '(':
+				{
+					auto type = marker == '+'   ? RespType::SIMPLE_STRING
+					            : marker == '-' ? RespType::ERROR
+					                            : RespType::BIG_NUMBER;
+					auto index = do_add_node(type, true);
+					_nodes[index]._offset = pos + 1;
+					_nodes[index]._length =
+					    static_cast<std::size_t>(line_end - line);
+					pos = next;
+					do_complete();
+					return ParseResult::COMPLETE;
+				}
+				case ':':
+				{
+					std::int64_t value = 0;
+					if (!to_integer(line, line_end, value))
+						return ParseResult::ERROR;
+					auto index = do_add_node(RespType::INTEGER, true);
+					_nodes[index]._integer = value;
+					_nodes[index]._offset = pos + 1;
+					_nodes[index]._length =
+					    static_cast<std::size_t>(line_end - line);
+					pos = next;
+					do_complete();
+					return ParseResult::COMPLETE;
+				}
+				case ',':
+				{
+					double value = 0;
+					auto [ptr, ec] = std::from_chars(line, line_end, value);
+					if (ec != std::errc() || ptr != line_end)
+						return ParseResult::ERROR;
+					auto index = do_add_node(RespType::DOUBLE, true);
+					_nodes[index]._double = value;
+					_nodes[index]._offset = pos + 1;
+					_nodes[index]._length =
+					    static_cast<std::size_t>(line_end - line);
+					pos = next;
+					do_complete();
+					return ParseResult::COMPLETE;
+				}
+				case '#':
+				{
+					if (line_end - line != 1 || (*line != 't' && *line != 'f'))
+						return ParseResult::ERROR;
+					auto index = do_add_node(RespType::BOOLEAN, true);
+					_nodes[index]._integer = *line == 't' ? 1 : 0;
+					pos = next;
+					do_complete();
+					return ParseResult::COMPLETE;
+				}
+				case '_':
+				{
+					if (line != line_end)
+						return ParseResult::ERROR;
+					do_add_node(RespType::NIL, true);
+					pos = next;
+					do_complete();
+					return ParseResult::COMPLETE;
+				}
+				case '$':
+				case '!':
+				case '=':
+				{
+					std::int64_t length = 0;
+					if (!to_integer(line, line_end, length) || length < -1)
+						return ParseResult::ERROR;
+					if (length == -1)
+					{
+						do_add_node(RespType::NIL, true);
+						pos = next;
+						do_complete();
+						return ParseResult::COMPLETE;
+					}
+					auto bytes = static_cast<std::size_t>(length);
+					if (size < next || size - next < bytes + 2)
+						return ParseResult::INCOMPLETE;
+					if (data[next + bytes] != '\r' ||
+					    data[next + bytes + 1] != '\n')
+						return ParseResult::ERROR;
+					auto type = marker == '$'   ? RespType::BULK_STRING
+					            : marker == '!' ? RespType::BULK_ERROR
+					                            : RespType::VERBATIM_STRING;
+					auto index = do_add_node(type, true);
+					_nodes[index]._offset = next;
+					_nodes[index]._length = bytes;
+					// Verbatim strings start with a 3 letter format and ':'.
+					if (type == RespType::VERBATIM_STRING)
+					{
+						if (bytes < 4 || data[next + 3] != ':')
+							return ParseResult::ERROR;
+						_nodes[index]._offset += 4;
+						_nodes[index]._length -= 4;
+					}
+					pos = next + bytes + 2;
+					do_complete();
+					return ParseResult::COMPLETE;
+				}
+				case '*':
+				case '~':
+				case '>':
+				case '%':
+				case '|':
+				{
+					std::int64_t count = 0;
+					if (!to_integer(line, line_end, count))
+						return ParseResult::ERROR;
+					pos = next;
+					// RESP2 null array.
+					if (marker == '*' && count == -1)
+					{
+						do_add_node(RespType::NIL, true);
+						do_complete();
+						return ParseResult::COMPLETE;
+					}
+					if (marker == '%')
+						return do_open(RespType::MAP, count, 2, false);
+					if (marker == '|')
+						return do_open(RespType::MAP, count, 2, true);
+					auto type = marker == '*'   ? RespType::ARRAY
+					            : marker == '~' ? RespType::SET
+					                            : RespType::PUSH;
+					return do_open(type, count, 1, false);
+				}
+				default:
+					return ParseResult::ERROR;
+				}
+			}
+		};
+
+		inline RespReply::iterator &RespReply::iterator::operator++()
+		{
+			_index = _parser->_nodes[_index]._next;
+			return *this;
+		}
+
+		inline RespType RespReply::type() const
+		{
+			return _parser->_nodes[_index]._type;
+		}
+
+		inline std::string_view RespReply::str() const
+		{
+			return _parser->do_text(_parser->_nodes[_index]);
+		}
+
+		inline std::int64_t RespReply::integer() const
+		{
+			auto &node = _parser->_nodes[_index];
+			if (node._type == RespType::DOUBLE)
+				return static_cast<std::int64_t>(node._double);
+			if (node._type == RespType::BULK_STRING ||
+			    node._type == RespType::SIMPLE_STRING)
+			{
+				std::int64_t value = 0;
+				auto text = _parser->do_text(node);
+				std::from_chars(text.data(), text.data() + text.size(), value);
+				return value;
+			}
+			return node._integer;
+		}
+
+		inline double RespReply::number() const
+		{
+			auto &node = _parser->_nodes[_index];
+			if (node._type == RespType::DOUBLE)
+				return node._double;
+			if (node._type == RespType::BULK_STRING ||
+			    node._type == RespType::SIMPLE_STRING)
+			{
+				double value = 0;
+				auto text = _parser->do_text(node);
+				std::from_chars(text.data(), text.data() + text.size(), value);
+				return value;
+			}
+			return static_cast<double>(node._integer);
+		}
+
+		inline bool RespReply::boolean() const
+		{
+			return _parser->_nodes[_index]._integer != 0;
+		}
+
+		inline std::size_t RespReply::size() const
+		{
+			return _parser->_nodes[_index]._size;
+		}
+
+		inline RespReply RespReply::operator[](std::size_t i) const
+		{
+			auto index = _parser->_nodes[_index]._first_child;
+			while (i-- > 0 && index != NO_NODE)
+				index = _parser->_nodes[index]._next;
+			return RespReply(_parser, index);
+		}
+
+		inline RespReply::iterator RespReply::begin() const
+		{
+			return iterator(_parser, _parser->_nodes[_index]._first_child);
+		}
+	} // namespace redis
+} // namespace net
+
+#endif // NET_REDIS_RESP_PARSER_H
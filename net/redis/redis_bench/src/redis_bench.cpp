@@ -0,0 +1,459 @@
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <ipc/ShmChannel.hpp>
+#include <memory>
+#include <net/redis/Client.hpp>
+#include <net/redis/RespParser.hpp>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <set>
+#include <string>
+#include <string_view>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+// Pipelined INCR at several depths and PUBLISH -> subscriber latency,
+// against a Redis server given as host:port or, by default, against the
+// in-process RESP stand-in below. The stand-in only knows PING, HELLO,
+// INCR, SUBSCRIBE and PUBLISH and runs on its own thread, so the figures
+// are client cost plus loopback.
+
+using namespace net::redis;
+using Clock = std::chrono::steady_clock;
+
+// Both clients stand in for ShmChannel wherever a service is templated
+// on the transport.
+static_assert(ipc::PubSubTransport<Client>);
+static_assert(ipc::PubSubTransport<TlsClient>);
+
+static constexpr auto TIMEOUT = std::chrono::seconds(10);
+
+class resp_stand_in
+{
+public:
+	resp_stand_in()
+	    : _connections()
+	    , _counters()
+	    , _listen_fd(-1)
+	    , _port(0)
+	{
+	}
+
+	resp_stand_in(const resp_stand_in &) = delete;
+
+	resp_stand_in &operator=(const resp_stand_in &) = delete;
+
+	~resp_stand_in()
+	{
+		for (auto &connection : _connections)
+			::close(connection->_fd);
+		if (_listen_fd >= 0)
+			::close(_listen_fd);
+	}
+
+	// 127.0.0.1 on an ephemeral port, see port().
+	bool listen()
+	{
+		_listen_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+		if (_listen_fd < 0)
+			return false;
+		sockaddr_in addr = {};
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		socklen_t len = sizeof(addr);
+		if (0 > ::bind(_listen_fd, reinterpret_cast<sockaddr *>(&addr),
+		               sizeof(addr)) ||
+		    0 > ::listen(_listen_fd, 16) ||
+		    0 > ::getsockname(_listen_fd, reinterpret_cast<sockaddr *>(&addr),
+		                      &len))
+			return false;
+		_port = ntohs(addr.sin_port);
+		return true;
+	}
+
+	int port() const { return _port; }
+
+	void run(const std::atomic<bool> &stop)
+	{
+		std::vector<pollfd> fds;
+		while (!stop.load())
+		{
+			fds.clear();
+			fds.push_back(pollfd{_listen_fd, POLLIN, 0});
+			for (auto &connection : _connections)
+			{
+				short events = POLLIN;
+				if (!connection->_out.empty())
+					events |= POLLOUT;
+				fds.push_back(pollfd{connection->_fd, events, 0});
+			}
+			if (0 >= ::poll(fds.data(), fds.size(), 100))
+				continue;
+			if (fds[0].revents & POLLIN)
+				do_accept();
+			for (std::size_t i = 1; i < fds.size(); ++i)
+			{
+				auto &connection = *_connections[i - 1];
+				if (fds[i].revents & (POLLIN | POLLHUP | POLLERR))
+					do_read(connection);
+			}
+			for (auto &connection : _connections)
+				do_write(*connection);
+			std::erase_if(_connections,
+			              [](const std::unique_ptr<connection> &connection)
+			              { return connection->_fd < 0; });
+		}
+	}
+
+private:
+	class connection
+	{
+	public:
+		std::string _in;
+		std::string _out;
+		std::set<std::string, std::less<>> _channels;
+		// Per connection, as it keeps a command cut short.
+		RespParser _parser;
+		int _fd;
+		int _protocol;
+		connection()
+		    : _in()
+		    , _out()
+		    , _channels()
+		    , _parser()
+		    , _fd(-1)
+		    , _protocol(2)
+		{
+		}
+	};
+
+	std::vector<std::unique_ptr<connection>> _connections;
+	std::unordered_map<std::string, long long> _counters;
+	int _listen_fd;
+	int _port;
+
+	static void append_bulk(std::string &out, std::string_view text)
+	{
+		out += '$';
+		out += std::to_string(text.size());
+		out += "\r\n";
+		out += text;
+		out += "\r\n";
+	}
+
+	static void append_integer(std::string &out, long long value)
+	{
+		out += ':';
+		out += std::to_string(value);
+		out += "\r\n";
+	}
+
+	// Subscription confirmations and messages: a push on RESP3, a plain
+	// array on RESP2.
+	static void append_push(std::string &out, int protocol,
+	                        std::string_view kind, std::string_view channel)
+	{
+		out += protocol == 3 ? ">3\r\n" : "*3\r\n";
+		append_bulk(out, kind);
+		append_bulk(out, channel);
+	}
+
+	void do_accept()
+	{
+		auto fd = ::accept(_listen_fd, nullptr, nullptr);
+		if (fd < 0)
+			return;
+		int one = 1;
+		::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+		_connections.push_back(std::make_unique<connection>());
+		_connections.back()->_fd = fd;
+	}
+
+	void do_read(connection &connection)
+	{
+		char buffer[65536];
+		auto ret = ::recv(connection._fd, buffer, sizeof(buffer), 0);
+		if (ret <= 0)
+		{
+			if (ret < 0 && (errno == EAGAIN || errno == EINTR))
+				return;
+			do_close(connection);
+			return;
+		}
+		connection._in.append(buffer, static_cast<std::size_t>(ret));
+		std::size_t pos = 0;
+		std::size_t used = 0;
+		auto &parser = connection._parser;
+		while (parser.parse(connection._in.data() + pos,
+		                    connection._in.size() - pos,
+		                    used) == ParseResult::COMPLETE)
+		{
+			pos += used;
+			do_command(connection, parser.reply());
+		}
+		connection._in.erase(0, pos);
+	}
+
+	void do_command(connection &connection, const RespReply &command)
+	{
+		std::string name(command[0].str());
+		std::transform(name.begin(), name.end(), name.begin(),
+		               [](unsigned char c)
+		               { return static_cast<char>(std::toupper(c)); });
+		auto &out = connection._out;
+		if (name == "PING")
+			out += "+PONG\r\n";
+		else if (name == "HELLO")
+		{
+			connection._protocol = command.size() > 1 &&
+			                               command[1].str() == "3"
+			                           ? 3
+			                           : 2;
+			out += connection._protocol == 3 ? "%1\r\n" : "*2\r\n";
+			append_bulk(out, "proto");
+			append_integer(out, connection._protocol);
+		}
+		else if (name == "INCR" && command.size() == 2)
+			append_integer(out, ++_counters[std::string(command[1].str())]);
+		else if (name == "SUBSCRIBE" && command.size() == 2)
+		{
+			auto channel = command[1].str();
+			connection._channels.emplace(channel);
+			append_push(out, connection._protocol, "subscribe", channel);
+			append_integer(out, static_cast<long long>(
+			                        connection._channels.size()));
+		}
+		else if (name == "PUBLISH" && command.size() == 3)
+		{
+			auto channel = command[1].str();
+			long long receivers = 0;
+			for (auto &other : _connections)
+			{
+				if (other->_fd < 0 || !other->_channels.contains(channel))
+					continue;
+				++receivers;
+				append_push(other->_out, other->_protocol, "message",
+				            channel);
+				append_bulk(other->_out, command[2].str());
+			}
+			append_integer(out, receivers);
+		}
+		else
+			out += "-ERR unsupported command\r\n";
+	}
+
+	void do_write(connection &connection)
+	{
+		if (connection._fd < 0 || connection._out.empty())
+			return;
+		auto ret = ::send(connection._fd, connection._out.data(),
+		                  connection._out.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+		if (ret < 0)
+		{
+			if (errno != EAGAIN && errno != EINTR)
+				do_close(connection);
+			return;
+		}
+		connection._out.erase(0, static_cast<std::size_t>(ret));
+	}
+
+	void do_close(connection &connection)
+	{
+		::close(connection._fd);
+		connection._fd = -1;
+	}
+};
+
+template <typename P, typename D>
+static bool run_until(P &&poll, D &&done)
+{
+	auto deadline = Clock::now() + TIMEOUT;
+	while (!done())
+	{
+		if (Clock::now() > deadline)
+			return false;
+		poll();
+	}
+	return true;
+}
+
+static void bench_incr(const std::string &host, int port)
+{
+	Client client;
+	client.connect(host, port);
+	if (!run_until([&]() { client.poll(); },
+	               [&]() { return client.connected(); }))
+	{
+		std::cout << "INCR: cannot connect" << std::endl;
+		return;
+	}
+	for (std::size_t depth : {1, 16, 256})
+	{
+		const std::size_t total = 200000;
+		std::size_t sent = 0;
+		std::size_t done = 0;
+		auto start = Clock::now();
+		auto finished = run_until(
+		    [&]()
+		    {
+			    while (sent - done < depth && sent < total)
+			    {
+				    client.command({"INCR", "redis_bench"},
+				                   [&done](const RespReply &) { ++done; });
+				    ++sent;
+			    }
+			    client.poll();
+		    },
+		    [&]() { return done == total; });
+		auto seconds =
+		    std::chrono::duration<double>(Clock::now() - start).count();
+		std::cout << "INCR depth " << std::setw(3) << depth << ": "
+		          << static_cast<double>(done) / seconds << " ops/s";
+		if (!finished)
+			std::cout << " (timed out)";
+		std::cout << std::endl;
+	}
+}
+
+// The payload is the publish time, so the subscriber measures the
+// latency of every message.
+static void bench_pubsub(const std::string &host, int port)
+{
+	const std::size_t total = 100000;
+	const std::size_t batch = 16;
+	// Messages in flight at most; without a cap the latency is the
+	// time spent queued behind a flood the server cannot keep up with.
+	const std::size_t window = 64;
+	std::vector<std::int64_t> latencies;
+	latencies.reserve(total);
+	auto now_ns = []()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		           Clock::now().time_since_epoch())
+		    .count();
+	};
+	Client publisher;
+	Client subscriber;
+	subscriber.subscribe(
+	    "redis_bench",
+	    [&](std::string_view, std::string_view message)
+	    {
+		    std::int64_t sent_ns = 0;
+		    std::from_chars(message.data(), message.data() + message.size(),
+		                    sent_ns);
+		    if (sent_ns > 0)
+			    latencies.push_back(now_ns() - sent_ns);
+	    });
+	publisher.connect(host, port);
+	subscriber.connect(host, port);
+	auto poll = [&]()
+	{
+		publisher.poll();
+		subscriber.poll();
+	};
+	// A message published before the subscription took effect is lost,
+	// wait for one that arrives.
+	long long receivers = 0;
+	if (!run_until(
+	        [&]()
+	        {
+		        poll();
+		        if (publisher.connected() && publisher.pending() == 0)
+			        publisher.publish("redis_bench", "0",
+			                          [&receivers](const RespReply &reply)
+			                          { receivers = reply.integer(); });
+	        },
+	        [&]() { return receivers > 0; }))
+	{
+		std::cout << "PUBLISH: no subscriber" << std::endl;
+		return;
+	}
+	char text[24];
+	std::size_t published = 0;
+	auto start = Clock::now();
+	auto finished = run_until(
+	    [&]()
+	    {
+		    for (std::size_t i = 0; i < batch && published < total &&
+		                            published - latencies.size() < window;
+		         ++i)
+		    {
+			    auto end = std::to_chars(text, text + sizeof(text), now_ns());
+			    publisher.publish("redis_bench",
+			                      std::string_view(text, end.ptr - text));
+			    ++published;
+		    }
+		    poll();
+	    },
+	    [&]() { return latencies.size() >= total; });
+	auto seconds = std::chrono::duration<double>(Clock::now() - start).count();
+	if (latencies.empty())
+	{
+		std::cout << "PUBLISH: nothing received" << std::endl;
+		return;
+	}
+	std::sort(latencies.begin(), latencies.end());
+	auto percentile = [&](double p)
+	{
+		auto index = static_cast<std::size_t>(
+		    p * static_cast<double>(latencies.size() - 1));
+		return static_cast<double>(latencies[index]) / 1e3;
+	};
+	std::cout << "PUBLISH -> subscriber: "
+	          << static_cast<double>(latencies.size()) / seconds
+	          << " msg/s, latency us p50 " << percentile(0.5) << " p99 "
+	          << percentile(0.99) << " max " << percentile(1.0);
+	if (!finished)
+		std::cout << " (timed out)";
+	std::cout << std::endl;
+}
+
+int main(int argc, const char **argv)
+{
+	std::cout << std::fixed << std::setprecision(1);
+	std::atomic<bool> stop(false);
+	std::unique_ptr<resp_stand_in> stand_in;
+	std::thread server;
+	std::string host = "127.0.0.1";
+	int port = 0;
+	if (argc > 1)
+	{
+		std::string host_port(argv[1]);
+		auto pos = host_port.rfind(':');
+		host = host_port.substr(0, pos);
+		port = pos == std::string::npos
+		           ? 6379
+		           : std::atoi(host_port.c_str() + pos + 1);
+	}
+	else
+	{
+		stand_in = std::make_unique<resp_stand_in>();
+		if (!stand_in->listen())
+		{
+			std::cout << "cannot start the RESP stand-in" << std::endl;
+			return 1;
+		}
+		port = stand_in->port();
+		server = std::thread([&]() { stand_in->run(stop); });
+	}
+	std::cout << "server " << host << ":" << port
+	          << (stand_in ? " (stand-in)" : "") << std::endl;
+	bench_incr(host, port);
+	bench_pubsub(host, port);
+	stop = true;
+	if (server.joinable())
+		server.join();
+	return 0;
+}
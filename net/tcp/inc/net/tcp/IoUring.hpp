@@ -0,0 +1,542 @@
+#ifndef NET_TCP_IO_URING_H
+#define NET_TCP_IO_URING_H
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <linux/io_uring.h>
+#include <net/error.hpp>
+#include <span>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <vector>
+
+namespace net
+{
+	namespace tcp
+	{
+		// Thin io_uring driver shared by many sessions. Every session owns a
+		// slot: one fixed file, one registered send buffer and a completion
+		// callback. Sessions only prepare SQEs, the owner of the ring calls
+		// poll() once per loop iteration, which submits everything queued so
+		// far and dispatches all completions with a single io_uring_enter.
+		class IoUring
+		{
+		public:
+			using OnCompletionCallBack = std::function<void(
+			    std::uint8_t op, int res, std::uint32_t flags,
+			    const std::span<const char> &data)>;
+			using OnErrorCallBack = std::function<void(net::NetError)>;
+
+		private:
+			class slot_node
+			{
+			public:
+				OnCompletionCallBack _on_completion;
+				std::uint32_t _generation;
+				bool _used;
+				slot_node() : _on_completion(), _generation(0), _used(false) {}
+			};
+
+			static constexpr std::uint16_t RECV_BUFFER_GROUP = 0;
+
+		public:
+			IoUring(unsigned entries = 4096, unsigned max_slots = 64,
+			        std::size_t send_buffer_size = 64 * 1024,
+			        unsigned recv_buffer_count = 512,
+			        std::size_t recv_buffer_size = 16 * 1024)
+			    : _ring_fd(-1)
+			    , _params()
+			    , _sq_ptr(nullptr)
+			    , _cq_ptr(nullptr)
+			    , _sq_ptr_size(0)
+			    , _cq_ptr_size(0)
+			    , _sqes(nullptr)
+			    , _sq_head(nullptr)
+			    , _sq_tail(nullptr)
+			    , _sq_mask(0)
+			    , _cq_head(nullptr)
+			    , _cq_tail(nullptr)
+			    , _cq_mask(0)
+			    , _cqes(nullptr)
+			    , _sq_local_tail(0)
+			    , _sq_submitted(0)
+			    , _slots(max_slots)
+			    , _send_area(nullptr)
+			    , _send_area_size(0)
+			    , _send_buffer_size(send_buffer_size)
+			    , _buf_ring(nullptr)
+			    , _buf_ring_size(0)
+			    , _recv_area(nullptr)
+			    , _recv_area_size(0)
+			    , _recv_buffer_size(recv_buffer_size)
+			    , _recv_buffer_count(recv_buffer_count)
+			    , _buf_ring_tail(0)
+			    , _enter_flags(0)
+			    , _on_error([](net::NetError) {})
+			{
+				if (recv_buffer_count == 0 ||
+				    (recv_buffer_count & (recv_buffer_count - 1)) != 0 ||
+				    recv_buffer_count > 32768)
+					throw std::invalid_argument(
+					    "recv_buffer_count must be a power of two <= 32768");
+				setup(entries);
+				register_files();
+				register_send_buffers();
+				register_recv_buffers();
+			}
+
+			IoUring(const IoUring &) = delete;
+			IoUring &operator=(const IoUring &) = delete;
+
+			~IoUring()
+			{
+				if (_ring_fd >= 0)
+					::close(_ring_fd);
+				if (_recv_area)
+					::munmap(_recv_area, _recv_area_size);
+				if (_buf_ring)
+					::munmap(_buf_ring, _buf_ring_size);
+				if (_send_area)
+					::munmap(_send_area, _send_area_size);
+				if (_sqes)
+					::munmap(_sqes, _params.sq_entries * sizeof(io_uring_sqe));
+				if (_cq_ptr && _cq_ptr != _sq_ptr)
+					::munmap(_cq_ptr, _cq_ptr_size);
+				if (_sq_ptr)
+					::munmap(_sq_ptr, _sq_ptr_size);
+			}
+
+			// Submit every prepared SQE and dispatch all available
+			// completions. Returns the number of completions handled.
+			std::size_t poll()
+			{
+				submit(0);
+				return reap();
+			}
+
+			// Submit prepared SQEs and block until at least min_complete
+			// completions are available, then dispatch them.
+			std::size_t wait(unsigned min_complete = 1)
+			{
+				submit(min_complete);
+				return reap();
+			}
+
+			// Called when io_uring_enter fails. What was not submitted stays
+			// queued and goes with the next poll(), so EAGAIN and EBUSY
+			// (kernel short of memory, completion queue overflowing) are
+			// transient; anything else means the ring is unusable.
+			void set_on_error(OnErrorCallBack &&on_error)
+			{
+				_on_error = std::move(on_error);
+			}
+
+			unsigned acquire_slot(OnCompletionCallBack &&on_completion)
+			{
+				for (unsigned i = 0; i < _slots.size(); ++i)
+				{
+					if (_slots[i]._used)
+						continue;
+					_slots[i]._used = true;
+					_slots[i]._on_completion = std::move(on_completion);
+					return i;
+				}
+				throw std::runtime_error("IoUring has no free session slot");
+			}
+
+			void release_slot(unsigned slot)
+			{
+				set_fd(slot, -1);
+				_slots[slot]._on_completion = nullptr;
+				_slots[slot]._used = false;
+			}
+
+			// Install fd into the fixed file table at index slot. Any
+			// completion still in flight for the previous fd of the slot is
+			// discarded.
+			net::NetError set_fd(unsigned slot, int fd)
+			{
+				++_slots[slot]._generation;
+				io_uring_files_update update = {};
+				update.offset = slot;
+				update.fds = reinterpret_cast<std::uint64_t>(&fd);
+				if (0 > do_register(IORING_REGISTER_FILES_UPDATE, &update, 1))
+					return static_cast<net::NetError>(errno);
+				return net::NetError::ERR_OK;
+			}
+
+			std::span<char> send_buffer(unsigned slot)
+			{
+				return std::span<char>(_send_area + slot * _send_buffer_size,
+				                       _send_buffer_size);
+			}
+
+			void prep_connect(unsigned slot, std::uint8_t op,
+			                  const sockaddr *addr, socklen_t addr_len)
+			{
+				auto sqe = get_sqe();
+				sqe->opcode = IORING_OP_CONNECT;
+				sqe->flags = IOSQE_FIXED_FILE;
+				sqe->fd = static_cast<int>(slot);
+				sqe->addr = reinterpret_cast<std::uint64_t>(addr);
+				sqe->off = addr_len;
+				sqe->user_data = user_data(slot, op);
+			}
+
+			// Arm a multishot receive on the slot. Data lands in buffers
+			// picked by the kernel from the provided buffer ring, the
+			// request stays armed while IORING_CQE_F_MORE is set.
+			void prep_recv_multishot(unsigned slot, std::uint8_t op)
+			{
+				auto sqe = get_sqe();
+				sqe->opcode = IORING_OP_RECV;
+				sqe->flags = IOSQE_FIXED_FILE | IOSQE_BUFFER_SELECT;
+				sqe->ioprio = IORING_RECV_MULTISHOT;
+				sqe->fd = static_cast<int>(slot);
+				sqe->buf_group = RECV_BUFFER_GROUP;
+				sqe->user_data = user_data(slot, op);
+			}
+
+			// Write len bytes starting at offset of the slot's registered
+			// send buffer.
+			void prep_send_fixed(unsigned slot, std::uint8_t op,
+			                     std::size_t offset, std::size_t len)
+			{
+				auto sqe = get_sqe();
+				sqe->opcode = IORING_OP_WRITE_FIXED;
+				sqe->flags = IOSQE_FIXED_FILE;
+				sqe->fd = static_cast<int>(slot);
+				sqe->addr =
+				    reinterpret_cast<std::uint64_t>(send_buffer(slot).data()) +
+				    offset;
+				sqe->len = static_cast<std::uint32_t>(len);
+				sqe->off = 0;
+				sqe->buf_index = static_cast<std::uint16_t>(slot);
+				sqe->user_data = user_data(slot, op);
+			}
+
+			void prep_cancel(unsigned slot, std::uint8_t target_op,
+			                 std::uint8_t op)
+			{
+				auto sqe = get_sqe();
+				sqe->opcode = IORING_OP_ASYNC_CANCEL;
+				sqe->fd = -1;
+				sqe->addr = user_data(slot, target_op);
+				sqe->user_data = user_data(slot, op);
+			}
+
+		private:
+			int _ring_fd;
+			io_uring_params _params;
+			void *_sq_ptr;
+			void *_cq_ptr;
+			std::size_t _sq_ptr_size;
+			std::size_t _cq_ptr_size;
+			io_uring_sqe *_sqes;
+			unsigned *_sq_head;
+			unsigned *_sq_tail;
+			unsigned _sq_mask;
+			unsigned *_cq_head;
+			unsigned *_cq_tail;
+			unsigned _cq_mask;
+			io_uring_cqe *_cqes;
+			unsigned _sq_local_tail;
+			unsigned _sq_submitted;
+			std::vector<slot_node> _slots;
+			char *_send_area;
+			std::size_t _send_area_size;
+			std::size_t _send_buffer_size;
+			io_uring_buf *_buf_ring;
+			std::size_t _buf_ring_size;
+			char *_recv_area;
+			std::size_t _recv_area_size;
+			std::size_t _recv_buffer_size;
+			unsigned _recv_buffer_count;
+			std::uint16_t _buf_ring_tail;
+			unsigned _enter_flags;
+			OnErrorCallBack _on_error;
+
+			static int do_setup(unsigned entries, io_uring_params *params)
+			{
+				return static_cast<int>(
+				    ::syscall(__NR_io_uring_setup, entries, params));
+			}
+
+			int do_enter(unsigned to_submit, unsigned min_complete,
+			             unsigned flags)
+			{
+				return static_cast<int>(
+				    ::syscall(__NR_io_uring_enter, _ring_fd, to_submit,
+				              min_complete, flags, nullptr, 0));
+			}
+
+			int do_register(unsigned opcode, void *arg, unsigned nr_args)
+			{
+				return static_cast<int>(::syscall(
+				    __NR_io_uring_register, _ring_fd, opcode, arg, nr_args));
+			}
+
+			template <typename T>
+			static T *ring_field(void *base, std::uint32_t offset)
+			{
+				auto ptr = static_cast<char *>(base) + offset;
+				return reinterpret_cast<T *>(ptr);
+			}
+
+			template <typename T>
+			static T *map_anonymous(std::size_t size)
+			{
+				auto ptr = ::mmap(nullptr, size, PROT_READ | PROT_WRITE,
+				                  MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE,
+				                  -1, 0);
+				if (ptr == MAP_FAILED)
+					throw std::runtime_error(std::strerror(errno));
+				return static_cast<T *>(ptr);
+			}
+
+			void setup(unsigned entries)
+			{
+				// Prefer the single issuer / deferred task run mode, the ring
+				// is only ever touched from the trading thread. Older kernels
+				// reject the flags, fall back to a plain ring.
+				_params = {};
+				_params.flags =
+				    IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN;
+				_ring_fd = do_setup(entries, &_params);
+				if (_ring_fd >= 0)
+					_enter_flags = IORING_ENTER_GETEVENTS;
+				else
+				{
+					_params = {};
+					_ring_fd = do_setup(entries, &_params);
+				}
+				if (_ring_fd < 0)
+					throw std::runtime_error(std::strerror(errno));
+				_sq_ptr_size = _params.sq_off.array +
+				               _params.sq_entries * sizeof(unsigned);
+				_cq_ptr_size = _params.cq_off.cqes +
+				               _params.cq_entries * sizeof(io_uring_cqe);
+				bool single_mmap = _params.features & IORING_FEAT_SINGLE_MMAP;
+				if (single_mmap)
+					_sq_ptr_size = _cq_ptr_size =
+					    std::max(_sq_ptr_size, _cq_ptr_size);
+				_sq_ptr = ::mmap(nullptr, _sq_ptr_size, PROT_READ | PROT_WRITE,
+				                 MAP_SHARED | MAP_POPULATE, _ring_fd,
+				                 IORING_OFF_SQ_RING);
+				if (_sq_ptr == MAP_FAILED)
+				{
+					_sq_ptr = nullptr;
+					throw std::runtime_error(std::strerror(errno));
+				}
+				if (single_mmap)
+					_cq_ptr = _sq_ptr;
+				else
+				{
+					_cq_ptr =
+					    ::mmap(nullptr, _cq_ptr_size, PROT_READ | PROT_WRITE,
+					           MAP_SHARED | MAP_POPULATE, _ring_fd,
+					           IORING_OFF_CQ_RING);
+					if (_cq_ptr == MAP_FAILED)
+					{
+						_cq_ptr = nullptr;
+						throw std::runtime_error(std::strerror(errno));
+					}
+				}
+				auto sqes = ::mmap(nullptr,
+				                   _params.sq_entries * sizeof(io_uring_sqe),
+				                   PROT_READ | PROT_WRITE,
+				                   MAP_SHARED | MAP_POPULATE, _ring_fd,
+				                   IORING_OFF_SQES);
+				if (sqes == MAP_FAILED)
+					throw std::runtime_error(std::strerror(errno));
+				_sqes = static_cast<io_uring_sqe *>(sqes);
+
+				const auto &sq_off = _params.sq_off;
+				const auto &cq_off = _params.cq_off;
+				_sq_head = ring_field<unsigned>(_sq_ptr, sq_off.head);
+				_sq_tail = ring_field<unsigned>(_sq_ptr, sq_off.tail);
+				_sq_mask = *ring_field<unsigned>(_sq_ptr, sq_off.ring_mask);
+				_cq_head = ring_field<unsigned>(_cq_ptr, cq_off.head);
+				_cq_tail = ring_field<unsigned>(_cq_ptr, cq_off.tail);
+				_cq_mask = *ring_field<unsigned>(_cq_ptr, cq_off.ring_mask);
+				_cqes = ring_field<io_uring_cqe>(_cq_ptr, cq_off.cqes);
+				// Identity mapping, SQE index i always sits in array slot i.
+				auto array = ring_field<unsigned>(_sq_ptr, sq_off.array);
+				for (unsigned i = 0; i < _params.sq_entries; ++i)
+					array[i] = i;
+				_sq_local_tail = _sq_submitted = *_sq_tail;
+			}
+
+			void register_files()
+			{
+				std::vector<int> fds(_slots.size(), -1);
+				if (0 > do_register(IORING_REGISTER_FILES, fds.data(),
+				                    static_cast<unsigned>(fds.size())))
+					throw std::runtime_error(std::strerror(errno));
+			}
+
+			void register_send_buffers()
+			{
+				_send_area_size = _slots.size() * _send_buffer_size;
+				_send_area = map_anonymous<char>(_send_area_size);
+				std::vector<iovec> iovs(_slots.size());
+				for (std::size_t i = 0; i < iovs.size(); ++i)
+				{
+					iovs[i].iov_base = _send_area + i * _send_buffer_size;
+					iovs[i].iov_len = _send_buffer_size;
+				}
+				if (0 > do_register(IORING_REGISTER_BUFFERS, iovs.data(),
+				                    static_cast<unsigned>(iovs.size())))
+					throw std::runtime_error(std::strerror(errno));
+			}
+
+			void register_recv_buffers()
+			{
+				_buf_ring_size = _recv_buffer_count * sizeof(io_uring_buf);
+				_buf_ring = map_anonymous<io_uring_buf>(_buf_ring_size);
+				_recv_area_size = _recv_buffer_count * _recv_buffer_size;
+				_recv_area = map_anonymous<char>(_recv_area_size);
+				io_uring_buf_reg reg = {};
+				reg.ring_addr = reinterpret_cast<std::uint64_t>(_buf_ring);
+				reg.ring_entries = _recv_buffer_count;
+				reg.bgid = RECV_BUFFER_GROUP;
+				if (0 > do_register(IORING_REGISTER_PBUF_RING, &reg, 1))
+					throw std::runtime_error(std::strerror(errno));
+				for (unsigned i = 0; i < _recv_buffer_count; ++i)
+					provide_buffer(static_cast<std::uint16_t>(i));
+				publish_buffers();
+			}
+
+			void provide_buffer(std::uint16_t bid)
+			{
+				auto mask = _recv_buffer_count - 1;
+				auto &buf = _buf_ring[_buf_ring_tail & mask];
+				buf.addr = reinterpret_cast<std::uint64_t>(
+				    _recv_area + bid * _recv_buffer_size);
+				buf.len = static_cast<std::uint32_t>(_recv_buffer_size);
+				buf.bid = bid;
+				++_buf_ring_tail;
+			}
+
+			// io_uring_buf_ring is not usable from C++: the empty struct in
+			// __DECLARE_FLEX_ARRAY has size 1 here and shifts bufs[] by 8
+			// bytes. Address the entries directly, the ring tail overlays
+			// the resv field of the first entry.
+			void publish_buffers()
+			{
+				std::atomic_ref<std::uint16_t>(_buf_ring[0].resv)
+				    .store(_buf_ring_tail, std::memory_order_release);
+			}
+
+			std::uint64_t user_data(unsigned slot, std::uint8_t op) const
+			{
+				return (static_cast<std::uint64_t>(slot) << 32) |
+				       (static_cast<std::uint64_t>(_slots[slot]._generation &
+				                                   0xffffff)
+				        << 8) |
+				       op;
+			}
+
+			io_uring_sqe *get_sqe()
+			{
+				auto head = std::atomic_ref<unsigned>(*_sq_head).load(
+				    std::memory_order_acquire);
+				if (_sq_local_tail - head >= _params.sq_entries)
+				{
+					// Ring is full, push what we have to the kernel first.
+					submit(0);
+					head = std::atomic_ref<unsigned>(*_sq_head).load(
+					    std::memory_order_acquire);
+					if (_sq_local_tail - head >= _params.sq_entries)
+						throw std::runtime_error("IoUring submission overflow");
+				}
+				auto sqe = &_sqes[_sq_local_tail & _sq_mask];
+				std::memset(sqe, 0, sizeof(*sqe));
+				++_sq_local_tail;
+				return sqe;
+			}
+
+			void submit(unsigned min_complete)
+			{
+				auto to_submit = _sq_local_tail - _sq_submitted;
+				if (to_submit == 0 && min_complete == 0 && _enter_flags == 0)
+					return;
+				std::atomic_ref<unsigned>(*_sq_tail).store(
+				    _sq_local_tail, std::memory_order_release);
+				auto flags = _enter_flags;
+				if (min_complete > 0)
+					flags |= IORING_ENTER_GETEVENTS;
+				int ret = 0;
+				do
+				{
+					ret = do_enter(to_submit, min_complete, flags);
+				} while (ret < 0 && errno == EINTR);
+				if (ret < 0)
+				{
+					_on_error(static_cast<net::NetError>(errno));
+					return;
+				}
+				_sq_submitted += static_cast<unsigned>(ret);
+			}
+
+			std::size_t reap()
+			{
+				std::size_t handled = 0;
+				auto head = *_cq_head;
+				auto tail = std::atomic_ref<unsigned>(*_cq_tail).load(
+				    std::memory_order_acquire);
+				bool recycled = false;
+				while (head != tail)
+				{
+					auto cqe = _cqes[head & _cq_mask];
+					++head;
+					++handled;
+					auto slot = static_cast<unsigned>(cqe.user_data >> 32);
+					auto generation =
+					    static_cast<std::uint32_t>((cqe.user_data >> 8) &
+					                               0xffffff);
+					auto op = static_cast<std::uint8_t>(cqe.user_data & 0xff);
+					std::span<const char> data;
+					std::uint16_t bid = 0;
+					bool has_buffer = cqe.flags & IORING_CQE_F_BUFFER;
+					if (has_buffer)
+					{
+						bid = static_cast<std::uint16_t>(
+						    cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+						if (cqe.res > 0)
+							data = std::span<const char>(
+							    _recv_area + bid * _recv_buffer_size,
+							    static_cast<std::size_t>(cqe.res));
+					}
+					if (slot < _slots.size() && _slots[slot]._used &&
+					    (_slots[slot]._generation & 0xffffff) == generation &&
+					    _slots[slot]._on_completion)
+						_slots[slot]._on_completion(op, cqe.res, cqe.flags,
+						                            data);
+					if (has_buffer)
+					{
+						provide_buffer(bid);
+						recycled = true;
+					}
+					// Release the CQE only after the callback, it may have
+					// queued new SQEs but it never reads the CQ itself.
+					std::atomic_ref<unsigned>(*_cq_head).store(
+					    head, std::memory_order_release);
+				}
+				if (recycled)
+					publish_buffers();
+				return handled;
+			}
+		};
+	} // namespace tcp
+} // namespace net
+
+#endif // NET_TCP_IO_URING_H
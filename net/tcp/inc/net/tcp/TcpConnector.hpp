@@ -0,0 +1,212 @@
+#ifndef NET_TCP_TCP_CONNECTOR_H
+#define NET_TCP_TCP_CONNECTOR_H
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <net/error.hpp>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace net
+{
+	namespace tcp
+	{
+		// The socket half of the connect/reconnect cycle TcpSession and
+		// TcpTlsSession share: the peer, resolving it, the non-blocking
+		// connect and the check that it went through. A session keeps its
+		// own status and drives this from poll():
+		//
+		//     SESSION_DISCONNECTED       connect()
+		//     SESSION_SOCKET_CONNECTING  check()
+		//
+		// until a step returns CONNECTED. On FAILED error() says why and
+		// the session tears down in its own way, close() included.
+		class TcpConnector
+		{
+		public:
+			enum class ConnectStep : unsigned int
+			{
+				FAILED = 0,
+				PENDING = 1,
+				CONNECTED = 2
+			};
+
+		public:
+			TcpConnector()
+			    : _hostname("")
+			    , _port(0)
+			    , _fd(-1)
+			    , _peer_addr()
+			    , _peer_addr_len(0)
+			    , _error(net::NetError::ERR_OK)
+			{
+			}
+
+			TcpConnector(const TcpConnector &) = delete;
+
+			TcpConnector &operator=(const TcpConnector &) = delete;
+
+			~TcpConnector() { close(); }
+
+			static int set_nonblocking(int fd)
+			{
+				int flags = fcntl(fd, F_GETFL, 0);
+				if (flags == -1)
+					return -1;
+				return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+			}
+
+			void set_peer(const std::string &hostname, int port)
+			{
+				_hostname = hostname;
+				_port = port;
+			}
+
+			// "host:port"; false, with error() set, if it is not one.
+			bool set_peer(const std::string &host_port)
+			{
+				auto pos = host_port.rfind(':');
+				if (pos == std::string::npos)
+					return do_fail(net::NetError::ERR_NET_URL_INVALID);
+				auto port_str = host_port.substr(pos + 1);
+				char *endptr = nullptr;
+				long port = std::strtol(port_str.c_str(), &endptr, 10);
+				if (*endptr != '\0' || port <= 0 || port > 65535)
+					return do_fail(net::NetError::ERR_NET_PORT_INVALID);
+				set_peer(host_port.substr(0, pos), static_cast<int>(port));
+				return true;
+			}
+
+			const std::string &hostname() const { return _hostname; }
+
+			int port() const { return _port; }
+
+			int fd() const { return _fd; }
+
+			net::NetError error() const { return _error; }
+
+			// Take over a connected socket, e.g. one from accept(). It has
+			// no peer to reconnect to.
+			bool adopt(int fd)
+			{
+				close();
+				set_peer("", 0);
+				_fd = fd;
+				if (0 > set_nonblocking(_fd))
+					return do_fail(static_cast<net::NetError>(errno));
+				return true;
+			}
+
+			// Resolve the peer into peer_addr() and open a non-blocking
+			// socket for it, without connecting, for callers that connect
+			// another way (io_uring).
+			bool open(bool nodelay)
+			{
+				close();
+				struct addrinfo hints = {}, *res = nullptr;
+				hints.ai_family = AF_UNSPEC;
+				hints.ai_socktype = SOCK_STREAM;
+				int err =
+				    ::getaddrinfo(_hostname.c_str(),
+				                  std::to_string(_port).c_str(), &hints, &res);
+				if (err != 0 || !res)
+					return do_fail(static_cast<net::NetError>(err));
+				std::memcpy(&_peer_addr, res->ai_addr, res->ai_addrlen);
+				_peer_addr_len = res->ai_addrlen;
+				_fd = ::socket(res->ai_family, res->ai_socktype,
+				               res->ai_protocol);
+				freeaddrinfo(res);
+				if (_fd < 0)
+					return do_fail(static_cast<net::NetError>(errno));
+				if (nodelay)
+				{
+					int one = 1;
+					::setsockopt(_fd, IPPROTO_TCP, TCP_NODELAY, &one,
+					             sizeof(one));
+				}
+				if (0 > set_nonblocking(_fd))
+					return do_fail(static_cast<net::NetError>(errno));
+				return true;
+			}
+
+			// open() and start connecting.
+			ConnectStep connect(bool nodelay)
+			{
+				if (!open(nodelay))
+					return ConnectStep::FAILED;
+				auto ret = ::connect(_fd, peer_addr(), _peer_addr_len);
+				if (ret == 0)
+					return ConnectStep::CONNECTED;
+				if (errno != EINPROGRESS)
+				{
+					do_fail(static_cast<net::NetError>(errno));
+					return ConnectStep::FAILED;
+				}
+				return ConnectStep::PENDING;
+			}
+
+			// Whether the connect() that returned PENDING is done.
+			ConnectStep check()
+			{
+				int err = 0;
+				socklen_t len = sizeof(err);
+				if (getsockopt(_fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0)
+				{
+					do_fail(static_cast<net::NetError>(errno));
+					return ConnectStep::FAILED;
+				}
+				if (err == EINPROGRESS || err == EALREADY)
+					return ConnectStep::PENDING;
+				if (err != 0)
+				{
+					do_fail(static_cast<net::NetError>(err));
+					return ConnectStep::FAILED;
+				}
+				// SO_ERROR is also 0 while the connect is still pending;
+				// only a writable socket is really connected.
+				if (::send(_fd, nullptr, 0, MSG_NOSIGNAL) < 0 &&
+				    (errno == ENOTCONN || errno == EAGAIN))
+					return ConnectStep::PENDING;
+				return ConnectStep::CONNECTED;
+			}
+
+			const sockaddr *peer_addr() const
+			{
+				return reinterpret_cast<const sockaddr *>(&_peer_addr);
+			}
+
+			socklen_t peer_addr_len() const { return _peer_addr_len; }
+
+			void close()
+			{
+				if (_fd < 0)
+					return;
+				::close(_fd);
+				_fd = -1;
+			}
+
+		private:
+			std::string _hostname;
+			int _port;
+			int _fd;
+			// Kept after connecting; io_uring reads it at submission.
+			sockaddr_storage _peer_addr;
+			socklen_t _peer_addr_len;
+			net::NetError _error;
+
+			bool do_fail(net::NetError error)
+			{
+				_error = error;
+				return false;
+			}
+		};
+	} // namespace tcp
+} // namespace net
+
+#endif // NET_TCP_TCP_CONNECTOR_H
@@ -0,0 +1,336 @@
+#ifndef NET_TCP_TCP_SESSION_H
+#define NET_TCP_TCP_SESSION_H
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <net/buffer_container.hpp>
+#include <net/error.hpp>
+#include <net/tcp/TcpConnector.hpp>
+#include <net/tcp/WriteId.hpp>
+#include <span>
+#include <string>
+#include <sys/socket.h>
+#include <vector>
+
+namespace net
+{
+	namespace tcp
+	{
+		// Plain-TCP counterpart of TcpTlsSession with the same callbacks,
+		// connect/poll/send/disconnect cycle and status values, for
+		// services on a trusted local network (Redis, metrics). Messages
+		// sent between two polls are coalesced into one send(), and
+		// everything the socket has is drained on each read.
+		class TcpSession
+		{
+		private:
+			class sent_mark
+			{
+			public:
+				std::uint64_t _end;
+				std::string _write_id;
+				sent_mark() : _end(0), _write_id("") {}
+			};
+
+		public:
+			using OnConnectedCallBack = std::function<void()>;
+			using OnDisConnectedCallBack = std::function<void()>;
+			using OnSendCallBack = std::function<void(const std::string &)>;
+			using OnDataCallBack =
+			    std::function<void(const std::span<const char> &)>;
+			using OnErrorCallBack = std::function<void(net::NetError)>;
+
+		public:
+			enum class TcpSessionStatus : unsigned int
+			{
+				SESSION_IDLE = 0,
+				SESSION_DISCONNECTED = 1,
+				SESSION_SOCKET_CONNECTING = 2,
+				SESSION_CONNECTED = 4,
+			};
+
+		public:
+			TcpSession(
+			    OnConnectedCallBack &&on_connected = []() {},
+			    OnDisConnectedCallBack &&on_disconnected = []() {},
+			    OnSendCallBack &&on_sent = [](const std::string &) {},
+			    OnDataCallBack &&on_data = [](const std::span<const char> &) {},
+			    OnErrorCallBack &&on_error = [](net::NetError) {},
+			    std::size_t read_buffer_size = 4096, bool auto_connect = true)
+			    : _on_connected(std::move(on_connected))
+			    , _on_disconnected(std::move(on_disconnected))
+			    , _on_sent(std::move(on_sent))
+			    , _on_data(std::move(on_data))
+			    , _on_error(std::move(on_error))
+			    , _read_buffer()
+			    , _write_buffer()
+			    , _sent_marks()
+			    , _connector()
+			    , _status(TcpSessionStatus::SESSION_IDLE)
+			    , _write_offset(0)
+			    , _written(0)
+			    , _write_end(0)
+			    , _auto_connect(auto_connect)
+			{
+				_read_buffer.resize(read_buffer_size > 0 ? read_buffer_size
+				                                         : 4096);
+			}
+
+			TcpSession(const TcpSession &) = delete;
+
+			TcpSession &operator=(const TcpSession &) = delete;
+
+			~TcpSession()
+			{
+				_auto_connect = false;
+				disconnect();
+			}
+
+			void poll()
+			{
+				switch (_status)
+				{
+				case TcpSession::TcpSessionStatus::SESSION_IDLE:
+					return;
+				case TcpSession::TcpSessionStatus::SESSION_DISCONNECTED:
+				{
+					do_connect();
+					return;
+				}
+				case TcpSession::TcpSessionStatus::SESSION_SOCKET_CONNECTING:
+				{
+					do_check_socket_connecting();
+					return;
+				}
+				case TcpSession::TcpSessionStatus::SESSION_CONNECTED:
+				{
+					try_send_all_buffer();
+					do_read();
+					return;
+				}
+				default:
+					return;
+				}
+			}
+
+			void connect(const std::string &hostname, int port)
+			{
+				_connector.set_peer(hostname, port);
+				if (_status != TcpSession::TcpSessionStatus::SESSION_IDLE)
+					disconnect();
+				do_connect();
+			}
+
+			void connect(const std::string &host_port)
+			{
+				TcpConnector peer;
+				if (!peer.set_peer(host_port))
+				{
+					_on_error(peer.error());
+					return;
+				}
+				connect(peer.hostname(), peer.port());
+			}
+
+			// Messages still buffered are discarded.
+			void disconnect()
+			{
+				if (_status == TcpSession::TcpSessionStatus::SESSION_IDLE)
+					return;
+				auto auto_connect = _auto_connect;
+				_auto_connect = false;
+				do_disconnect();
+				_auto_connect = auto_connect;
+			}
+
+			TcpSession::TcpSessionStatus getStatus() const { return _status; }
+
+			int native_handle() const { return _connector.fd(); }
+
+			// Bytes sent but not yet written to the socket.
+			std::size_t queued_bytes() const
+			{
+				return _write_buffer.size() - _write_offset;
+			}
+
+			// Buffer data for the socket and try to write it at once. The
+			// returned write id is reported through on_sent once the last
+			// byte is written. Sends made before the connection is up are
+			// written when it is.
+			template <typename T>
+			std::string send(const T &data)
+			    requires net::BufferContainer<T>
+			{
+				auto write_id = next_write_id();
+				do_append(data, write_id);
+				if (_status == TcpSessionStatus::SESSION_CONNECTED)
+					try_send_all_buffer();
+				return write_id;
+			}
+
+			std::string send(const char *str)
+			{
+				std::span<const char> data(str, std::strlen(str));
+				return send(data);
+			}
+
+		private:
+			OnConnectedCallBack _on_connected;
+			OnDisConnectedCallBack _on_disconnected;
+			OnSendCallBack _on_sent;
+			OnDataCallBack _on_data;
+			OnErrorCallBack _on_error;
+			std::vector<char> _read_buffer;
+			std::vector<char> _write_buffer;
+			std::deque<sent_mark> _sent_marks;
+			TcpConnector _connector;
+			TcpSessionStatus _status;
+			// Start of the unwritten part of _write_buffer.
+			std::size_t _write_offset;
+			// Bytes written over the life of the connection, and bytes
+			// appended; sent marks are positions in this stream.
+			std::uint64_t _written;
+			std::uint64_t _write_end;
+			bool _auto_connect;
+
+			template <typename T>
+			void do_append(const T &data, const std::string &write_id)
+			    requires net::BufferContainer<T>
+			{
+				_write_buffer.insert(_write_buffer.end(), data.data(),
+				                     data.data() + data.size());
+				_write_end += data.size();
+				sent_mark mark;
+				mark._end = _write_end;
+				mark._write_id = write_id;
+				_sent_marks.push_back(std::move(mark));
+			}
+
+			void do_connect()
+			{
+				do_connect_step(_connector.connect(true));
+			}
+
+			void do_check_socket_connecting()
+			{
+				do_connect_step(_connector.check());
+			}
+
+			void do_connect_step(TcpConnector::ConnectStep step)
+			{
+				using Step = TcpConnector::ConnectStep;
+				if (step == Step::FAILED)
+				{
+					_on_error(_connector.error());
+					do_disconnect();
+					return;
+				}
+				_status =
+				    TcpSession::TcpSessionStatus::SESSION_SOCKET_CONNECTING;
+				if (step == Step::CONNECTED)
+					do_connected();
+			}
+
+			void do_connected()
+			{
+				_status = TcpSession::TcpSessionStatus::SESSION_CONNECTED;
+				_on_connected();
+				if (_status == TcpSession::TcpSessionStatus::SESSION_CONNECTED)
+					try_send_all_buffer();
+			}
+
+			void try_send_all_buffer()
+			{
+				while (_write_offset < _write_buffer.size())
+				{
+					auto ret = ::send(_connector.fd(),
+					                  _write_buffer.data() + _write_offset,
+					                  _write_buffer.size() - _write_offset,
+					                  MSG_NOSIGNAL);
+					if (ret < 0)
+					{
+						if (errno == EINTR)
+							continue;
+						if (errno == EAGAIN || errno == EWOULDBLOCK)
+							break;
+						_on_error(static_cast<net::NetError>(errno));
+						do_disconnect();
+						return;
+					}
+					_write_offset += static_cast<std::size_t>(ret);
+					_written += static_cast<std::uint64_t>(ret);
+				}
+				if (_write_offset == _write_buffer.size())
+				{
+					_write_buffer.clear();
+					_write_offset = 0;
+				}
+				else if (_write_offset > _write_buffer.size() / 2)
+				{
+					_write_buffer.erase(_write_buffer.begin(),
+					                    _write_buffer.begin() +
+					                        static_cast<long>(_write_offset));
+					_write_offset = 0;
+				}
+				while (!_sent_marks.empty() &&
+				       _sent_marks.front()._end <= _written)
+				{
+					auto write_id = std::move(_sent_marks.front()._write_id);
+					_sent_marks.pop_front();
+					_on_sent(write_id);
+				}
+			}
+
+			void do_read()
+			{
+				using Status = TcpSession::TcpSessionStatus;
+				while (_status == Status::SESSION_CONNECTED)
+				{
+					auto ret = ::recv(_connector.fd(), _read_buffer.data(),
+					                  _read_buffer.size(), 0);
+					if (ret < 0)
+					{
+						if (errno == EINTR)
+							continue;
+						if (errno == EAGAIN || errno == EWOULDBLOCK)
+							return;
+						_on_error(static_cast<net::NetError>(errno));
+						do_disconnect();
+						return;
+					}
+					if (ret == 0)
+					{
+						_on_error(net::NetError::ERR_ECONNRESET);
+						do_disconnect();
+						return;
+					}
+					auto len = static_cast<std::size_t>(ret);
+					_on_data(std::span<const char>(_read_buffer.data(), len));
+					if (len < _read_buffer.size())
+						return;
+				}
+			}
+
+			void do_disconnect()
+			{
+				_connector.close();
+				_write_buffer.clear();
+				_sent_marks.clear();
+				_write_offset = 0;
+				_written = 0;
+				_write_end = 0;
+				_on_disconnected();
+				if (_auto_connect)
+					_status =
+					    TcpSession::TcpSessionStatus::SESSION_DISCONNECTED;
+				else
+					_status = TcpSession::TcpSessionStatus::SESSION_IDLE;
+			}
+		};
+	} // namespace tcp
+} // namespace net
+
+#endif // NET_TCP_TCP_SESSION_H
@@ -0,0 +1,445 @@
+#ifndef NET_TCP_TCP_TLS_SERVER_H
+#define NET_TCP_TCP_TLS_SERVER_H
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <encrypt/OpenSSLIInitializer.hpp>
+#include <functional>
+#include <memory>
+#include <net/buffer_container.hpp>
+#include <net/error.hpp>
+#include <net/tcp/TcpConnector.hpp>
+#include <net/tcp/TcpTlsSession.hpp>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+#include <openssl/x509v3.h>
+#include <span>
+#include <string>
+#include <sys/socket.h>
+#include <timing/Clock.hpp>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+namespace net
+{
+	namespace tcp
+	{
+		// Non-blocking TLS listener. Every accepted connection is served by
+		// a TcpTlsSession in server mode, so reads, the send lanes, queue
+		// limits and both transport modes work exactly as for a client.
+		// Connections are identified by an id, 0 stands for the listener
+		// itself in on_error.
+		class TcpTlsServer
+		{
+		public:
+			using OnConnectedCallBack = std::function<void(std::uint64_t)>;
+			using OnDisConnectedCallBack = std::function<void(std::uint64_t)>;
+			using OnSendCallBack =
+			    std::function<void(std::uint64_t, const std::string &)>;
+			using OnDataCallBack = std::function<void(
+			    std::uint64_t, const std::span<const char> &)>;
+			using OnErrorCallBack =
+			    std::function<void(std::uint64_t, net::NetError)>;
+
+		public:
+			TcpTlsServer(
+			    OnConnectedCallBack &&on_connected = [](std::uint64_t) {},
+			    OnDisConnectedCallBack &&on_disconnected = [](std::uint64_t) {},
+			    OnSendCallBack &&on_sent = [](std::uint64_t,
+			                                  const std::string &) {},
+			    OnDataCallBack &&on_data =
+			        [](std::uint64_t, const std::span<const char> &) {},
+			    OnErrorCallBack &&on_error = [](std::uint64_t,
+			                                    net::NetError) {},
+			    std::size_t read_buffer_size = 4096)
+			    : _on_connected(std::move(on_connected))
+			    , _on_disconnected(std::move(on_disconnected))
+			    , _on_sent(std::move(on_sent))
+			    , _on_data(std::move(on_data))
+			    , _on_error(std::move(on_error))
+			    , _ctx(nullptr)
+			    , _sessions()
+			    , _closed()
+			    , _visit_ids()
+			    , _visit_depth(0)
+			    , _transport_mode(TcpTlsSession::TlsTransportMode::SOCKET_BIO)
+			    , _read_buffer_size(read_buffer_size)
+			    , _next_id(0)
+			    , _listen_fd(-1)
+			    , _port(0)
+			    , _clock()
+			{
+				const static encrypt::OpenSSLInitializer ssl_initialize;
+				_ctx = SSL_CTX_new(TLS_server_method());
+				if (_ctx)
+				{
+					SSL_CTX_set_min_proto_version(_ctx, TLS1_2_VERSION);
+					SSL_CTX_set_mode(_ctx,
+					                 SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+				}
+			}
+
+			~TcpTlsServer()
+			{
+				stop();
+				if (_ctx)
+					SSL_CTX_free(_ctx);
+			}
+
+			bool use_certificate_file(const std::string &cert_file,
+			                          const std::string &key_file)
+			{
+				if (!_ctx ||
+				    SSL_CTX_use_certificate_chain_file(
+				        _ctx, cert_file.c_str()) != 1 ||
+				    SSL_CTX_use_PrivateKey_file(_ctx, key_file.c_str(),
+				                                SSL_FILETYPE_PEM) != 1 ||
+				    SSL_CTX_check_private_key(_ctx) != 1)
+				{
+					_on_error(0, static_cast<net::NetError>(ERR_get_error()));
+					return false;
+				}
+				return true;
+			}
+
+			// Generate a throw-away P-256 key and a certificate for it, valid
+			// for common_name, 127.0.0.1 and ::1. Meant for local stand-ins
+			// and benchmarks, clients must not verify the peer.
+			bool use_self_signed_certificate(
+			    const std::string &common_name = "localhost", int days = 30)
+			{
+				if (!_ctx)
+					return false;
+				auto pkey = EVP_EC_gen("P-256");
+				auto cert = X509_new();
+				auto ok = pkey && cert &&
+				          do_build_certificate(cert, pkey, common_name, days) &&
+				          SSL_CTX_use_certificate(_ctx, cert) == 1 &&
+				          SSL_CTX_use_PrivateKey(_ctx, pkey) == 1 &&
+				          SSL_CTX_check_private_key(_ctx) == 1;
+				if (!ok)
+					_on_error(0, static_cast<net::NetError>(ERR_get_error()));
+				if (cert)
+					X509_free(cert);
+				if (pkey)
+					EVP_PKEY_free(pkey);
+				return ok;
+			}
+
+			// Applies to connections accepted afterwards. IO_URING needs a
+			// ring per session and is ignored, those keep SOCKET_BIO.
+			void set_transport_mode(TcpTlsSession::TlsTransportMode mode)
+			{
+				_transport_mode = mode;
+			}
+
+			// Applies to connections accepted afterwards, see
+			// TcpTlsSession::set_clock().
+			void set_clock(timing::ClockSource clock) { _clock = clock; }
+
+			// Port 0 binds an ephemeral port, see port().
+			bool listen(const std::string &hostname, int port,
+			            int backlog = SOMAXCONN)
+			{
+				close_listener();
+				struct addrinfo hints = {}, *res = nullptr;
+				hints.ai_family = AF_UNSPEC;
+				hints.ai_socktype = SOCK_STREAM;
+				hints.ai_flags = AI_PASSIVE;
+				int err = ::getaddrinfo(hostname.c_str(),
+				                        std::to_string(port).c_str(), &hints,
+				                        &res);
+				if (err != 0 || !res)
+				{
+					_on_error(0, static_cast<net::NetError>(err));
+					return false;
+				}
+				_listen_fd = ::socket(res->ai_family, res->ai_socktype,
+				                      res->ai_protocol);
+				if (_listen_fd < 0)
+				{
+					freeaddrinfo(res);
+					_on_error(0, static_cast<net::NetError>(errno));
+					return false;
+				}
+				int reuse = 1;
+				::setsockopt(_listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse,
+				             sizeof(reuse));
+				auto bind_ret =
+				    ::bind(_listen_fd, res->ai_addr, res->ai_addrlen);
+				freeaddrinfo(res);
+				if (0 > bind_ret || 0 > ::listen(_listen_fd, backlog) ||
+				    0 > TcpConnector::set_nonblocking(_listen_fd))
+				{
+					_on_error(0, static_cast<net::NetError>(errno));
+					close_listener();
+					return false;
+				}
+				struct sockaddr_storage addr = {};
+				socklen_t len = sizeof(addr);
+				auto addr_ptr = reinterpret_cast<sockaddr *>(&addr);
+				if (0 > ::getsockname(_listen_fd, addr_ptr, &len))
+				{
+					_on_error(0, static_cast<net::NetError>(errno));
+					close_listener();
+					return false;
+				}
+				if (addr.ss_family == AF_INET6)
+					_port = ntohs(
+					    reinterpret_cast<sockaddr_in6 *>(&addr)->sin6_port);
+				else
+					_port =
+					    ntohs(reinterpret_cast<sockaddr_in *>(&addr)->sin_port);
+				return true;
+			}
+
+			bool listen(const std::string &host_port, int backlog = SOMAXCONN)
+			{
+				auto pos = host_port.rfind(':');
+				if (pos == std::string::npos)
+				{
+					_on_error(0, net::NetError::ERR_NET_URL_INVALID);
+					return false;
+				}
+				auto hostname = host_port.substr(0, pos);
+				auto port_str = host_port.substr(pos + 1);
+				char *endptr = nullptr;
+				long port_num = std::strtol(port_str.c_str(), &endptr, 10);
+				if (*endptr != '\0' || port_num < 0 || port_num > 65535)
+				{
+					_on_error(0, net::NetError::ERR_NET_PORT_INVALID);
+					return false;
+				}
+				return listen(hostname, static_cast<int>(port_num), backlog);
+			}
+
+			int port() const { return _port; }
+
+			// Accept every pending connection, then poll each session.
+			// Closed sessions are released at the end of the call, never
+			// from inside one of their callbacks.
+			void poll()
+			{
+				do_accept();
+				do_visit([](TcpTlsSession &session) { session.poll(); });
+			}
+
+			// Nullptr once the connection is closed.
+			TcpTlsSession *session(std::uint64_t id)
+			{
+				auto it = _sessions.find(id);
+				return it == _sessions.end() ? nullptr : it->second.get();
+			}
+
+			template <typename T>
+			std::string send(std::uint64_t id, const T &data,
+			                 TcpTlsSession::SendLane lane =
+			                     TcpTlsSession::SendLane::QUOTE)
+			    requires net::BufferContainer<T>
+			{
+				auto s = session(id);
+				return s ? s->send(data, lane) : "";
+			}
+
+			std::string send(std::uint64_t id, const char *str,
+			                 TcpTlsSession::SendLane lane =
+			                     TcpTlsSession::SendLane::QUOTE)
+			{
+				auto s = session(id);
+				return s ? s->send(str, lane) : "";
+			}
+
+			void close(std::uint64_t id)
+			{
+				auto s = session(id);
+				if (s)
+					s->disconnect();
+			}
+
+			std::size_t session_count() const { return _sessions.size(); }
+
+			// Stop accepting and close every connection.
+			void stop()
+			{
+				close_listener();
+				do_visit([](TcpTlsSession &session) { session.disconnect(); });
+			}
+
+		private:
+			OnConnectedCallBack _on_connected;
+			OnDisConnectedCallBack _on_disconnected;
+			OnSendCallBack _on_sent;
+			OnDataCallBack _on_data;
+			OnErrorCallBack _on_error;
+			SSL_CTX *_ctx;
+			std::unordered_map<std::uint64_t, std::unique_ptr<TcpTlsSession>>
+			    _sessions;
+			std::vector<std::uint64_t> _closed;
+			// Ids do_visit() walks, kept for their capacity.
+			std::vector<std::uint64_t> _visit_ids;
+			// do_visit() calls under way; sessions are reaped at 0.
+			std::size_t _visit_depth;
+			TcpTlsSession::TlsTransportMode _transport_mode;
+			std::size_t _read_buffer_size;
+			std::uint64_t _next_id;
+			int _listen_fd;
+			int _port;
+			timing::ClockSource _clock;
+
+			void close_listener()
+			{
+				if (_listen_fd < 0)
+					return;
+				::close(_listen_fd);
+				_listen_fd = -1;
+				_port = 0;
+			}
+
+			bool do_build_certificate(X509 *cert, EVP_PKEY *pkey,
+			                          const std::string &common_name,
+			                          int days)
+			{
+				std::uint64_t serial = 0;
+				if (RAND_bytes(reinterpret_cast<unsigned char *>(&serial),
+				               sizeof(serial)) != 1)
+					return false;
+				X509_set_version(cert, 2);
+				ASN1_INTEGER_set_uint64(X509_get_serialNumber(cert),
+				                        serial >> 1);
+				X509_gmtime_adj(X509_getm_notBefore(cert), -3600);
+				X509_gmtime_adj(X509_getm_notAfter(cert),
+				                static_cast<long>(days) * 24 * 3600);
+				if (X509_set_pubkey(cert, pkey) != 1)
+					return false;
+				auto name = X509_get_subject_name(cert);
+				if (X509_NAME_add_entry_by_txt(
+				        name, "CN", MBSTRING_ASC,
+				        reinterpret_cast<const unsigned char *>(
+				            common_name.c_str()),
+				        -1, -1, 0) != 1 ||
+				    X509_set_issuer_name(cert, name) != 1)
+					return false;
+				X509V3_CTX v3;
+				X509V3_set_ctx_nodb(&v3);
+				X509V3_set_ctx(&v3, cert, cert, nullptr, nullptr, 0);
+				auto san = "DNS:" + common_name + ",IP:127.0.0.1,IP:::1";
+				auto ext = X509V3_EXT_conf_nid(nullptr, &v3,
+				                               NID_subject_alt_name,
+				                               san.c_str());
+				if (!ext)
+					return false;
+				auto added = X509_add_ext(cert, ext, -1);
+				X509_EXTENSION_free(ext);
+				return added == 1 && X509_sign(cert, pkey, EVP_sha256()) > 0;
+			}
+
+			void do_accept()
+			{
+				if (_listen_fd < 0)
+					return;
+				while (true)
+				{
+					int fd = ::accept(_listen_fd, nullptr, nullptr);
+					if (fd < 0)
+					{
+						if (errno == EAGAIN || errno == EWOULDBLOCK)
+							return;
+						if (errno == EINTR || errno == ECONNABORTED)
+							continue;
+						_on_error(0, static_cast<net::NetError>(errno));
+						return;
+					}
+					int nodelay = 1;
+					::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay,
+					             sizeof(nodelay));
+					auto id = ++_next_id;
+					auto session = do_make_session(id);
+					auto &ref = *session;
+					_sessions.emplace(id, std::move(session));
+					ref.accept(fd, _ctx);
+				}
+			}
+
+			std::unique_ptr<TcpTlsSession> do_make_session(std::uint64_t id)
+			{
+				auto session = std::make_unique<TcpTlsSession>(
+				    [this, id]() { _on_connected(id); },
+				    [this, id]() { do_closed(id); },
+				    [this, id](const std::string &write_id)
+				    { _on_sent(id, write_id); },
+				    [this, id](const std::span<const char> &data)
+				    { _on_data(id, data); },
+				    [this, id](net::NetError err) { _on_error(id, err); },
+				    _read_buffer_size, false);
+				session->set_transport_mode(_transport_mode);
+				session->set_clock(_clock);
+				return session;
+			}
+
+			// A session reports every disconnect() (the destructor included),
+			// forward the first one only.
+			void do_closed(std::uint64_t id)
+			{
+				if (!_sessions.contains(id) ||
+				    std::find(_closed.begin(), _closed.end(), id) !=
+				        _closed.end())
+					return;
+				_closed.push_back(id);
+				_on_disconnected(id);
+			}
+
+			// Calls fn on every session there is when it starts. Its
+			// callbacks may close sessions, stop() the server or poll()
+			// it again, so it walks a snapshot of the ids and the closed
+			// sessions are released once the outermost call is done.
+			template <typename F>
+			void do_visit(F &&fn)
+			{
+				std::vector<std::uint64_t> ids;
+				ids.swap(_visit_ids);
+				ids.clear();
+				for (auto &[id, session] : _sessions)
+					ids.push_back(id);
+				++_visit_depth;
+				for (auto id : ids)
+				{
+					auto it = _sessions.find(id);
+					if (it != _sessions.end())
+						fn(*it->second);
+				}
+				--_visit_depth;
+				ids.swap(_visit_ids);
+				if (_visit_depth == 0)
+					do_reap();
+			}
+
+			void do_reap()
+			{
+				while (!_closed.empty())
+				{
+					auto id = _closed.back();
+					_closed.pop_back();
+					auto it = _sessions.find(id);
+					if (it == _sessions.end())
+						continue;
+					// Out of the map first, so the destructor's disconnect
+					// is not reported again.
+					auto session = std::move(it->second);
+					_sessions.erase(it);
+				}
+			}
+		};
+	} // namespace tcp
+} // namespace net
+
+#endif // NET_TCP_TCP_TLS_SERVER_H
@@ -1,25 +1,32 @@
 #ifndef NET_TCP_TCP_TLS_SESSION_H
 #define NET_TCP_TCP_TLS_SESSION_H
 
+#include <algorithm>
 #include <arpa/inet.h>
+#include <array>
 #include <cerrno>
+#include <cstdint>
 #include <cstdlib>
 #include <cstring>
 #include <deque>
 #include <encrypt/OpenSSLIInitializer.hpp>
-#include <encrypt/encrypt.hpp>
-#include <fcntl.h>
 #include <functional>
 #include <limits>
 #include <net/buffer_container.hpp>
 #include <net/error.hpp>
-#include <netdb.h>
+#include <net/tcp/IoUring.hpp>
+#include <net/tcp/TcpConnector.hpp>
+#include <net/tcp/TlsBioPipeline.hpp>
+#include <net/tcp/WriteId.hpp>
 #include <openssl/err.h>
 #include <openssl/ssl.h>
+#include <optional>
 #include <span>
 #include <string>
 #include <sys/socket.h>
+#include <timing/Clock.hpp>
 #include <unistd.h>
+#include <unordered_map>
 #include <vector>
 
 namespace net
@@ -28,27 +35,41 @@ namespace net
 	{
 		class TcpTlsSession
 		{
-		private:
-			int set_nonblocking(int fd)
-			{
-				int flags = fcntl(fd, F_GETFL, 0);
-				if (flags == -1)
-					return -1;
-				return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
-			}
-
 		private:
 			class write_node
 			{
 			public:
 				std::vector<char> _data;
 				std::string _write_id;
+				std::string _key;
 				std::size_t _offer_set;
-				write_node() : _data(), _write_id(""), _offer_set(0) {}
+				std::int64_t _enqueued_ns;
+				write_node()
+				    : _data()
+				    , _write_id("")
+				    , _key("")
+				    , _offer_set(0)
+				    , _enqueued_ns(0)
+				{
+				}
 			};
 
-		private:
-			const static encrypt::OpenSSLInitializer _ssl_initialize;
+			class sent_mark
+			{
+			public:
+				std::uint64_t _cipher_end;
+				std::string _write_id;
+				sent_mark() : _cipher_end(0), _write_id("") {}
+			};
+
+			// Operations of an IO_URING session on its ring slot.
+			enum : std::uint8_t
+			{
+				OP_CONNECT = 1,
+				OP_RECV = 2,
+				OP_SEND = 3,
+				OP_CANCEL = 4
+			};
 
 		private:
 			using ErrorCodeCallBack = std::function<void(net::NetError)>;
@@ -60,6 +81,11 @@ namespace net
 			using OnDataCallBack =
 			    std::function<void(const std::span<const char> &)>;
 			using OnErrorCallBack = std::function<void(net::NetError)>;
+			using OnSupersededCallBack =
+			    std::function<void(const std::string &)>;
+			using OnDroppedCallBack = std::function<void(const std::string &)>;
+			using OnBackpressureCallBack = std::function<void()>;
+			using OnDrainCallBack = std::function<void()>;
 
 		public:
 			enum class TcpSessionStatus : unsigned int
@@ -72,6 +98,67 @@ namespace net
 				SESSION_SHUTING_DOWN_SSH = 5
 			};
 
+			// SOCKET_BIO lets OpenSSL read and write the socket itself, one
+			// record per syscall. MEMORY_BIO runs OpenSSL over memory BIOs:
+			// the session drains the socket into a large buffer, decrypts
+			// every complete record, encrypts all messages sent between two
+			// polls and writes them with one send(). kTLS needs SOCKET_BIO.
+			// IO_URING is MEMORY_BIO over a shared IoUring instead of
+			// send()/recv(), see the constructor taking one.
+			enum class TlsTransportMode : unsigned int
+			{
+				SOCKET_BIO = 0,
+				MEMORY_BIO = 1,
+				IO_URING = 2
+			};
+
+			// Queued messages leave in lane order: URGENT (cancels, kill
+			// switch) before HEDGE before QUOTE, see set_starvation_limit()
+			// for how lower lanes still make progress. A message already
+			// handed to OpenSSL is always finished first.
+			enum class SendLane : unsigned int
+			{
+				URGENT = 0,
+				HEDGE = 1,
+				QUOTE = 2
+			};
+
+			static constexpr std::size_t SEND_LANE_COUNT = 3;
+
+			// What a send does when queuing it would exceed a high
+			// watermark. DROP_OLDEST evicts the oldest queued messages of
+			// droppable lanes to make room and rejects only when that is not
+			// enough.
+			enum class BackpressurePolicy : unsigned int
+			{
+				REJECT = 0,
+				DROP_OLDEST = 1
+			};
+
+			class LaneStats
+			{
+			public:
+				std::size_t _depth;
+				std::size_t _max_depth;
+				std::uint64_t _messages;
+				std::uint64_t _queued;
+				std::uint64_t _wait_total_ns;
+				std::uint64_t _wait_max_ns;
+				std::uint64_t _dropped;
+				std::uint64_t _rejected;
+				LaneStats()
+				    : _depth(0)
+				    , _max_depth(0)
+				    , _messages(0)
+				    , _queued(0)
+				    , _wait_total_ns(0)
+				    , _wait_max_ns(0)
+				    , _dropped(0)
+				    , _rejected(0)
+				{
+				}
+			};
+
 		public:
 			TcpTlsSession(
 			    OnConnectedCallBack &&on_connected = []() {},
@@ -85,28 +172,100 @@ namespace net
 			    , _on_sent(std::move(on_sent))
 			    , _on_data(std::move(on_data))
 			    , _on_error(std::move(on_error))
+			    , _on_superseded([](const std::string &) {})
+			    , _on_dropped([](const std::string &) {})
+			    , _on_backpressure([]() {})
+			    , _on_drain([]() {})
 			    , _ctx(nullptr)
+			    , _accept_ctx(nullptr)
 			    , _ssl(nullptr)
 			    , _read_buffer()
-			    , _write_queue()
-			    , _hostname("")
+			    , _write_lanes()
+			    , _keyed_writes()
+			    , _lane_stats()
+			    , _lane_bypassed()
+			    , _lane_droppable({false, false, true})
+			    , _in_flight()
+			    , _pipeline()
+			    , _cipher_in()
+			    , _cipher_out()
+			    , _sent_marks()
+			    , _connector()
 			    , _status(TcpSessionStatus::SESSION_DISCONNECTED)
-			    , _port(0)
-			    , _socket_fd(-1)
+			    , _transport_mode(TlsTransportMode::SOCKET_BIO)
+			    , _cipher_out_offset(0)
+			    , _cipher_sent(0)
+			    , _starvation_limit(8)
+			    , _queued_bytes(0)
+			    , _queued_messages(0)
+			    , _high_bytes(std::numeric_limits<std::size_t>::max())
+			    , _low_bytes(std::numeric_limits<std::size_t>::max())
+			    , _high_messages(std::numeric_limits<std::size_t>::max())
+			    , _low_messages(std::numeric_limits<std::size_t>::max())
+			    , _backpressure_policy(BackpressurePolicy::REJECT)
+			    , _backpressured(false)
 			    , _auto_connect(auto_connect)
+			    , _ktls(false)
+			    , _clock()
+			    , _last_receive_ns(0)
+			    , _last_send_ns(0)
+			    , _ring(nullptr)
+			    , _slot(0)
+			    , _send_offset(0)
+			    , _send_len(0)
+			    , _send_inflight(false)
+			    , _recv_armed(false)
 			{
-				_ctx = SSL_CTX_new(TLS_client_method());
+				// Initialised on first construction rather than at static
+				// init, so main can pick the OpenSSL allocator beforehand.
+				const static encrypt::OpenSSLInitializer ssl_initialize;
 				_read_buffer.resize(read_buffer_size >
 				                            std::numeric_limits<int>::max()
 				                        ? std::numeric_limits<int>::max()
 				                        : read_buffer_size);
 			}
 
+			// IO_URING session: the socket is a fixed file of ring, inbound
+			// data arrives through one multishot recv and the ciphertext of a
+			// poll leaves in a single registered-buffer write. Drive it with:
+			//
+			//     for (auto &session : sessions) session.poll();
+			//     ring.poll();
+			//
+			// so the sends of every session are submitted by one
+			// io_uring_enter. ring must outlive the session.
+			TcpTlsSession(
+			    IoUring &ring, OnConnectedCallBack &&on_connected = []() {},
+			    OnDisConnectedCallBack &&on_disconnected = []() {},
+			    OnSendCallBack &&on_sent = [](const std::string &) {},
+			    OnDataCallBack &&on_data = [](const std::span<const char> &) {},
+			    OnErrorCallBack &&on_error = [](net::NetError) {},
+			    std::size_t read_buffer_size = 4096, bool auto_connect = true)
+			    : TcpTlsSession(std::move(on_connected),
+			                    std::move(on_disconnected), std::move(on_sent),
+			                    std::move(on_data), std::move(on_error),
+			                    read_buffer_size, auto_connect)
+			{
+				_ring = &ring;
+				_transport_mode = TlsTransportMode::IO_URING;
+				_slot = _ring->acquire_slot(
+				    [this](std::uint8_t op, int res, std::uint32_t flags,
+				           const std::span<const char> &data)
+				    { on_completion(op, res, flags, data); });
+			}
+
+			TcpTlsSession(const TcpTlsSession &) = delete;
+			TcpTlsSession &operator=(const TcpTlsSession &) = delete;
+
 			~TcpTlsSession()
 			{
 				disconnect();
+				if (_ring)
+					_ring->release_slot(_slot);
 				if (_ctx)
 					SSL_CTX_free(_ctx);
+				if (_accept_ctx)
+					SSL_CTX_free(_accept_ctx);
 			}
 
 			void poll()
@@ -127,7 +286,14 @@ namespace net
 				}
 				case TcpTlsSession::TcpSessionStatus::SESSION_TSL_CONNECTING:
 				{
-					do_check_tls_connecting();
+					// The ring advances the handshake from its completions.
+					if (is_uring())
+					{
+						arm_recv();
+						do_flush_cipher();
+					}
+					else
+						do_check_tls_connecting();
 					return;
 				}
 				case TcpTlsSession::TcpSessionStatus::SESSION_CONNECTED:
@@ -148,8 +314,8 @@ namespace net
 
 			void connect(const std::string &hostname, int port)
 			{
-				_hostname = hostname;
-				_port = port;
+				_connector.set_peer(hostname, port);
+				do_release_accept_ctx();
 				if (_status != TcpTlsSession::TcpSessionStatus::SESSION_IDLE &&
 				    _status !=
 				        TcpTlsSession::TcpSessionStatus::SESSION_DISCONNECTED)
@@ -165,30 +331,52 @@ namespace net
 
 			void connect(const std::string &host_port)
 			{
-				auto pos = host_port.rfind(':');
-				if (pos == std::string::npos)
+				TcpConnector peer;
+				if (!peer.set_peer(host_port))
 				{
-					_on_error(net::NetError::ERR_NET_URL_INVALID);
+					_on_error(peer.error());
+					return;
 				}
-				auto hostname = host_port.substr(0, pos);
-				auto port_str = host_port.substr(pos + 1);
-				char *endptr = nullptr;
-				long port_num = std::strtol(port_str.c_str(), &endptr, 10);
-				if (*endptr != '\0' || port_num <= 0 || port_num > 65535)
+				connect(peer.hostname(), peer.port());
+			}
+
+			// Take over a socket returned by accept() and run the server side
+			// of the handshake with ctx, which must hold the certificate and
+			// key. The session keeps a reference on ctx. From here on it
+			// behaves like a connected client session, except that it never
+			// reconnects.
+			void accept(int socket_fd, SSL_CTX *ctx)
+			{
+				_auto_connect = false;
+				if (_status != TcpTlsSession::TcpSessionStatus::SESSION_IDLE &&
+				    _status !=
+				        TcpTlsSession::TcpSessionStatus::SESSION_DISCONNECTED)
+					disconnect();
+				do_release_accept_ctx();
+				SSL_CTX_up_ref(ctx);
+				_accept_ctx = ctx;
+				if (!_connector.adopt(socket_fd))
 				{
-					_on_error(net::NetError::ERR_NET_PORT_INVALID);
+					_on_error(_connector.error());
+					disconnect();
+					return;
 				}
-				auto port = static_cast<int>(port_num);
-				return connect(hostname, port);
+				if (is_uring() && !do_install_fixed_file())
+					return;
+				_status =
+				    TcpTlsSession::TcpSessionStatus::SESSION_TSL_CONNECTING;
+				do_tls_connect();
 			}
 
+			bool is_server_side() const { return _accept_ctx != nullptr; }
+
 			void disconnect()
 			{
 				_status =
 				    TcpTlsSession::TcpSessionStatus::SESSION_SHUTING_DOWN_SSH;
-				_read_buffer.clear();
-				_write_queue.clear();
+				do_clear_lanes();
 				do_disconnect();
+				do_check_watermarks(false);
 			}
 
 			TcpTlsSession::TcpSessionStatus getStatus() const
@@ -196,42 +384,200 @@ namespace net
 				return _status;
 			}
 
+			// Takes effect on the next connect. A session built on an
+			// IoUring always runs IO_URING.
+			void set_transport_mode(TlsTransportMode mode)
+			{
+				if (!is_uring() && mode != TlsTransportMode::IO_URING)
+					_transport_mode = mode;
+			}
+
+			TlsTransportMode get_transport_mode() const
+			{
+				return _transport_mode;
+			}
+
+			// Ask OpenSSL to hand record encryption and decryption to the
+			// kernel TLS ULP once the handshake is done. Takes effect on the
+			// next connect or accept(). OpenSSL silently keeps userspace
+			// crypto when it was built without kTLS, the kernel lacks the tls
+			// module or the negotiated cipher is not offloadable, check
+			// is_ktls_send() and is_ktls_recv() after on_connected to see
+			// what was enabled.
+			void enable_ktls(bool enable) { _ktls = enable; }
+
+			bool is_ktls_send() const
+			{
+				return _ssl && BIO_get_ktls_send(SSL_get_wbio(_ssl)) > 0;
+			}
+
+			bool is_ktls_recv() const
+			{
+				return _ssl && BIO_get_ktls_recv(SSL_get_rbio(_ssl)) > 0;
+			}
+
+			// Socket of the established session. With kTLS active in a
+			// direction the kernel frames records itself, so plain
+			// read/write (or io_uring) on this fd carries application data.
+			int native_handle() const { return _connector.fd(); }
+
+			// Called with the write id of a queued message that a later
+			// send_keyed() replaced. The replaced message is never written
+			// and never reported through on_sent.
+			void set_on_superseded(OnSupersededCallBack &&on_superseded)
+			{
+				_on_superseded = std::move(on_superseded);
+			}
+
+			// A lane that is not empty goes next once higher lanes have been
+			// served limit times in a row while it waited.
+			void set_starvation_limit(std::size_t limit)
+			{
+				_starvation_limit = limit;
+			}
+
+			// Clock used to time queued messages, see LaneStats. It must
+			// outlive the session.
+			void set_clock(timing::ClockSource clock) { _clock = clock; }
+
+			// When the data now being handed to on_data came off the socket,
+			// on the session clock. Start latency traces from here.
+			std::int64_t last_receive_ns() const { return _last_receive_ns; }
+
+			// When SSL_write last accepted data, on the session clock. With
+			// a memory BIO SSL_write only encrypts, so this is when the
+			// socket last took ciphertext instead. A queued message goes
+			// out later than its send(), so read this from on_sent for the
+			// SSL_write stage of a trace.
+			std::int64_t last_send_ns() const { return _last_send_ns; }
+
+			const LaneStats &lane_stats(SendLane lane) const
+			{
+				return _lane_stats[static_cast<std::size_t>(lane)];
+			}
+
+			// Bound the queued messages (all lanes, in flight excluded).
+			// Reaching either high watermark raises on_backpressure, sends
+			// that do not fit are handled by the policy, and on_drain fires
+			// once both counts are back at or below the low watermarks. A
+			// message is always accepted into otherwise empty lanes. A low
+			// watermark above its high one is clamped down to it.
+			void set_queue_limits(std::size_t high_bytes, std::size_t low_bytes,
+			                      std::size_t high_messages,
+			                      std::size_t low_messages)
+			{
+				_high_bytes = high_bytes;
+				_low_bytes = std::min(low_bytes, high_bytes);
+				_high_messages = high_messages;
+				_low_messages = std::min(low_messages, high_messages);
+			}
+
+			void set_backpressure_policy(BackpressurePolicy policy)
+			{
+				_backpressure_policy = policy;
+			}
+
+			// Only QUOTE is droppable by default.
+			void set_lane_droppable(SendLane lane, bool droppable)
+			{
+				_lane_droppable[static_cast<std::size_t>(lane)] = droppable;
+			}
+
+			void set_on_backpressure(OnBackpressureCallBack &&on_backpressure)
+			{
+				_on_backpressure = std::move(on_backpressure);
+			}
+
+			void set_on_drain(OnDrainCallBack &&on_drain)
+			{
+				_on_drain = std::move(on_drain);
+			}
+
+			// Called with the write id of a queued message evicted by
+			// DROP_OLDEST. The message is never written.
+			void set_on_dropped(OnDroppedCallBack &&on_dropped)
+			{
+				_on_dropped = std::move(on_dropped);
+			}
+
+			bool is_backpressured() const { return _backpressured; }
+
+			std::size_t queued_bytes() const { return _queued_bytes; }
+
+			std::size_t queued_messages() const { return _queued_messages; }
+
+			// In MEMORY_BIO mode the message is encrypted right away while
+			// the session keeps up, and the ciphertext leaves with the batch
+			// written by the next poll(). Under back-pressure messages wait
+			// in their lane and are encrypted in lane order as the socket
+			// drains. Returns an empty write id when the queue limits
+			// rejected the message.
 			template <typename T>
-			std::string send(const T &data)
+			std::string send(const T &data, SendLane lane = SendLane::QUOTE)
 			    requires net::BufferContainer<T>
 			{
+				if (is_memory_bio())
+					return send_memory_bio(data, "", lane);
 				try_send_all_buffer();
-				auto snd_id = encrypt::generate_random_sha256_string(64);
+				return do_submit(data, "", lane);
+			}
 
-				if (!_write_queue.empty())
+			std::string send(const char *str, SendLane lane = SendLane::QUOTE)
+			{
+				std::span<const char> data(str, std::strlen(str));
+				return send(data, lane);
+			}
+
+			// Conflating send, e.g. keyed by order id or symbol + side. While
+			// an earlier message with the same key still waits in the same
+			// lane and no byte of it went to OpenSSL, its payload is replaced
+			// in place, so the newest version keeps the old queue position
+			// and the old write id is reported through on_superseded. A
+			// replacement that does not fit the queue limits is rejected like
+			// a send, and the queued version stays. Otherwise this behaves
+			// like send().
+			template <typename T>
+			std::string send_keyed(const std::string &key, const T &data,
+			                       SendLane lane = SendLane::QUOTE)
+			    requires net::BufferContainer<T>
+			{
+				if (!is_memory_bio())
+					try_send_all_buffer();
+				auto &keyed = _keyed_writes[static_cast<std::size_t>(lane)];
+				auto it = keyed.find(key);
+				if (it == keyed.end())
 				{
-					write_node n;
-					n._data.resize(data.size());
-					std::memcpy(n._data.data(), data.data(), data.size());
-					n._write_id = snd_id;
-					_write_queue.push_back(n);
+					if (is_memory_bio())
+						return send_memory_bio(data, key, lane);
+					return do_submit(data, key, lane);
 				}
-				else
+				auto &node = *it->second;
+				// Callbacks run once the queue is consistent again.
+				std::vector<std::string> dropped;
+				if (!do_make_room(data.size(), &node, dropped))
 				{
-					std::size_t offer_set = 0;
-					do_send(data, snd_id, offer_set);
-					if (offer_set != data.size())
-					{
-						write_node n;
-						n._data.resize(data.size());
-						std::memcpy(n._data.data(), data.data(), data.size());
-						n._write_id = snd_id;
-						n._offer_set = offer_set;
-						_write_queue.push_back(n);
-					}
+					++_lane_stats[static_cast<std::size_t>(lane)]._rejected;
+					do_check_watermarks(true);
+					return "";
 				}
+				auto superseded = std::move(node._write_id);
+				_queued_bytes = _queued_bytes - node._data.size() + data.size();
+				node._data.resize(data.size());
+				std::memcpy(node._data.data(), data.data(), data.size());
+				node._write_id = next_write_id();
+				auto snd_id = node._write_id;
+				do_check_watermarks(false);
+				for (auto &id : dropped)
+					_on_dropped(id);
+				_on_superseded(superseded);
 				return snd_id;
 			}
 
-			std::string send(const char *str)
+			std::string send_keyed(const std::string &key, const char *str,
+			                       SendLane lane = SendLane::QUOTE)
 			{
 				std::span<const char> data(str, std::strlen(str));
-				return send(data);
+				return send_keyed(key, data, lane);
 			}
 
 		private:
@@ -240,15 +586,88 @@ namespace net
 			OnSendCallBack _on_sent;
 			OnDataCallBack _on_data;
 			OnErrorCallBack _on_error;
+			OnSupersededCallBack _on_superseded;
+			OnDroppedCallBack _on_dropped;
+			OnBackpressureCallBack _on_backpressure;
+			OnDrainCallBack _on_drain;
 			SSL_CTX *_ctx;
+			// Server context of an accepted session, see accept().
+			SSL_CTX *_accept_ctx;
 			SSL *_ssl;
 			std::vector<char> _read_buffer;
-			std::deque<write_node> _write_queue;
-			std::string _hostname;
+			std::array<std::deque<write_node>, SEND_LANE_COUNT> _write_lanes;
+			// Queued keyed messages per lane. Push and pop at the ends of a
+			// deque keep references to the other nodes valid.
+			std::array<std::unordered_map<std::string, write_node *>,
+			           SEND_LANE_COUNT>
+			    _keyed_writes;
+			std::array<LaneStats, SEND_LANE_COUNT> _lane_stats;
+			std::array<std::size_t, SEND_LANE_COUNT> _lane_bypassed;
+			std::array<bool, SEND_LANE_COUNT> _lane_droppable;
+			// SOCKET_BIO message SSL_write has started on.
+			std::optional<write_node> _in_flight;
+			TlsBioPipeline _pipeline;
+			std::vector<char> _cipher_in;
+			std::vector<char> _cipher_out;
+			std::deque<sent_mark> _sent_marks;
+			TcpConnector _connector;
 			TcpSessionStatus _status;
-			int _port;
-			int _socket_fd;
+			TlsTransportMode _transport_mode;
+			std::size_t _cipher_out_offset;
+			std::uint64_t _cipher_sent;
+			std::size_t _starvation_limit;
+			std::size_t _queued_bytes;
+			std::size_t _queued_messages;
+			std::size_t _high_bytes;
+			std::size_t _low_bytes;
+			std::size_t _high_messages;
+			std::size_t _low_messages;
+			BackpressurePolicy _backpressure_policy;
+			bool _backpressured;
 			bool _auto_connect;
+			bool _ktls;
+			timing::ClockSource _clock;
+			std::int64_t _last_receive_ns;
+			std::int64_t _last_send_ns;
+			// IO_URING only: the ring, the slot holding the fixed file and
+			// send buffer, and the one write in flight on it.
+			IoUring *_ring;
+			unsigned _slot;
+			std::size_t _send_offset;
+			std::size_t _send_len;
+			bool _send_inflight;
+			bool _recv_armed;
+
+			static constexpr std::size_t CIPHER_BUFFER_SIZE = 64 * 1024;
+
+			// Client context, made on the first connect so that accepted
+			// sessions never build one.
+			SSL_CTX *do_client_ctx()
+			{
+				if (_ctx)
+					return _ctx;
+				_ctx = SSL_CTX_new(TLS_client_method());
+				// A write that did not complete is retried from the copy
+				// kept in the write queue, not from the caller's buffer.
+				if (_ctx)
+					SSL_CTX_set_mode(_ctx, SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+				return _ctx;
+			}
+
+			void do_release_accept_ctx()
+			{
+				if (!_accept_ctx)
+					return;
+				SSL_CTX_free(_accept_ctx);
+				_accept_ctx = nullptr;
+			}
+
+			bool is_memory_bio() const
+			{
+				return _transport_mode != TlsTransportMode::SOCKET_BIO;
+			}
+
+			bool is_uring() const { return _ring != nullptr; }
 
 			bool is_fatal_error(int ssl_err)
 			{
@@ -258,100 +677,84 @@ namespace net
 
 			void do_connect_socket()
 			{
-				struct addrinfo hints = {}, *res = nullptr;
-				hints.ai_family = AF_UNSPEC;
-				hints.ai_socktype = SOCK_STREAM;
-				int err =
-				    ::getaddrinfo(_hostname.c_str(),
-				                  std::to_string(_port).c_str(), &hints, &res);
-				if (err != 0 || !res)
+				if (is_uring())
 				{
-					_on_error(static_cast<net::NetError>(err));
-					disconnect();
-					return;
-				}
-				_socket_fd = ::socket(res->ai_family, res->ai_socktype,
-				                      res->ai_protocol);
-				if (_socket_fd < 0)
-				{
-					freeaddrinfo(res);
-					_on_error(static_cast<net::NetError>(errno));
-					disconnect();
-					return;
-				}
-				auto nonblock_ret = set_nonblocking(errno);
-				if (0 > nonblock_ret)
-				{
-					_on_error(static_cast<net::NetError>(errno));
-					disconnect();
-					return;
-				}
-				auto connect_ret =
-				    ::connect(_socket_fd, res->ai_addr, res->ai_addrlen);
-				freeaddrinfo(res);
-				if (0 > connect_ret)
-				{
-					if (EINPROGRESS != errno)
+					// The ring connects from the resolved address, which the
+					// connector keeps until the ring submits.
+					if (!_connector.open(false))
 					{
-						_on_error(static_cast<net::NetError>(errno));
+						_on_error(_connector.error());
 						disconnect();
 						return;
 					}
-					else
-					{
-						_status = TcpTlsSession::TcpSessionStatus::
-						    SESSION_SOCKET_CONNECTING;
+					if (!do_install_fixed_file())
 						return;
-					}
+					_ring->prep_connect(_slot, OP_CONNECT,
+					                    _connector.peer_addr(),
+					                    _connector.peer_addr_len());
+					_status = TcpTlsSession::TcpSessionStatus::
+					    SESSION_SOCKET_CONNECTING;
+					return;
 				}
-				else
-					_status =
-					    TcpTlsSession::TcpSessionStatus::SESSION_TSL_CONNECTING;
+				do_connect_step(_connector.connect(false));
 			}
 
 			void do_check_socket_connecting()
 			{
-				int err = 0;
-				socklen_t len = sizeof(err);
-				if (getsockopt(_socket_fd, SOL_SOCKET, SO_ERROR, &err, &len) <
-				    0)
+				// The ring reports the connect through on_connect_complete.
+				if (is_uring())
+					return;
+				do_connect_step(_connector.check());
+				if (_status ==
+				    TcpTlsSession::TcpSessionStatus::SESSION_TSL_CONNECTING)
+					do_tls_connect();
+			}
+
+			void do_connect_step(TcpConnector::ConnectStep step)
+			{
+				using Step = TcpConnector::ConnectStep;
+				if (step == Step::FAILED)
 				{
-					_on_error(static_cast<net::NetError>(errno));
+					_on_error(_connector.error());
 					disconnect();
 					return;
 				}
-				if (err == 0)
+				if (step == Step::PENDING)
 				{
-					_status =
-					    TcpTlsSession::TcpSessionStatus::SESSION_TSL_CONNECTING;
-					do_tls_connect();
+					_status = TcpTlsSession::TcpSessionStatus::
+					    SESSION_SOCKET_CONNECTING;
 					return;
 				}
-				else if (err == EINPROGRESS || err == EALREADY)
-					return;
-				_on_error(static_cast<net::NetError>(errno));
-				disconnect();
+				_status =
+				    TcpTlsSession::TcpSessionStatus::SESSION_TSL_CONNECTING;
 			}
 
 			void do_check_tls_connecting()
 			{
-				int ret = SSL_connect(_ssl);
+				if (is_memory_bio() && !do_recv_cipher())
+					return;
+				int ret = SSL_do_handshake(_ssl);
 				if (ret <= 0)
 				{
-					if (is_fatal_error(ret))
+					auto err = SSL_get_error(_ssl, ret);
+					if (is_fatal_error(err))
 					{
-						auto err = SSL_get_error(_ssl, ret);
 						_on_error(static_cast<net::NetError>(err));
 						disconnect();
+						return;
 					}
+					if (is_memory_bio())
+						do_flush_cipher();
 					return;
 				}
 				_status = TcpTlsSession::TcpSessionStatus::SESSION_CONNECTED;
+				if (is_memory_bio())
+					do_flush_cipher();
 				_on_connected();
 			}
 			void do_tls_connect()
 			{
-				_ssl = SSL_new(_ctx);
+				_ssl = SSL_new(_accept_ctx ? _accept_ctx : do_client_ctx());
 				if (!_ssl)
 				{
 					auto err = ERR_get_error();
@@ -359,19 +762,29 @@ namespace net
 					disconnect();
 					return;
 				}
-				if (!SSL_set_fd(_ssl, _socket_fd))
+				if (_ktls)
+					SSL_set_options(_ssl, SSL_OP_ENABLE_KTLS);
+				if (is_memory_bio() ? !_pipeline.attach(_ssl)
+				                    : !SSL_set_fd(_ssl, _connector.fd()))
 				{
 					auto err = ERR_get_error();
 					_on_error(static_cast<net::NetError>(err));
 					disconnect();
 					return;
 				}
-				if (!SSL_set_tlsext_host_name(_ssl, _hostname.c_str()))
+				if (_accept_ctx)
+					SSL_set_accept_state(_ssl);
+				else
 				{
-					auto err = ERR_get_error();
-					_on_error(static_cast<net::NetError>(err));
-					disconnect();
-					return;
+					SSL_set_connect_state(_ssl);
+					auto &hostname = _connector.hostname();
+					if (!SSL_set_tlsext_host_name(_ssl, hostname.c_str()))
+					{
+						auto err = ERR_get_error();
+						_on_error(static_cast<net::NetError>(err));
+						disconnect();
+						return;
+					}
 				}
 				do_check_tls_connecting();
 			}
@@ -384,6 +797,248 @@ namespace net
 					do_tls_connect();
 			}
 
+			template <typename T>
+			static write_node make_write_node(const T &data,
+			                                  const std::string &write_id)
+			    requires net::BufferContainer<T>
+			{
+				write_node n;
+				n._data.resize(data.size());
+				std::memcpy(n._data.data(), data.data(), data.size());
+				n._write_id = write_id;
+				return n;
+			}
+
+			bool has_queued() const
+			{
+				if (_in_flight)
+					return true;
+				for (auto &queue : _write_lanes)
+					if (!queue.empty())
+						return true;
+				return false;
+			}
+
+			// Whether a message of size fits next to bytes and messages
+			// already queued.
+			bool fits_queue_limits(std::size_t bytes, std::size_t messages,
+			                       std::size_t size) const
+			{
+				if (messages == 0)
+					return true;
+				return bytes + size <= _high_bytes &&
+				       messages + 1 <= _high_messages;
+			}
+
+			// What DROP_OLDEST may evict: every droppable message, except
+			// keep and what is queued behind it in its lane, since only lane
+			// heads are taken.
+			void do_droppable(const write_node *keep, std::size_t &bytes,
+			                  std::size_t &messages) const
+			{
+				for (std::size_t i = 0; i < SEND_LANE_COUNT; ++i)
+				{
+					if (!_lane_droppable[i])
+						continue;
+					for (auto &node : _write_lanes[i])
+					{
+						if (&node == keep)
+							break;
+						bytes += node._data.size();
+						++messages;
+					}
+				}
+			}
+
+			// Make room for a message of size, in place of keep if that is
+			// set, evicting the oldest droppable messages. Nothing is evicted
+			// unless that makes the message fit. Returns false when it has
+			// to be rejected.
+			bool do_make_room(std::size_t size, const write_node *keep,
+			                  std::vector<std::string> &dropped)
+			{
+				auto kept_bytes = keep ? keep->_data.size() : 0;
+				std::size_t kept = keep ? 1 : 0;
+				if (fits_queue_limits(_queued_bytes - kept_bytes,
+				                      _queued_messages - kept, size))
+					return true;
+				if (_backpressure_policy != BackpressurePolicy::DROP_OLDEST)
+					return false;
+				std::size_t bytes = 0;
+				std::size_t messages = 0;
+				do_droppable(keep, bytes, messages);
+				if (!fits_queue_limits(_queued_bytes - kept_bytes - bytes,
+				                       _queued_messages - kept - messages,
+				                       size))
+					return false;
+				while (!fits_queue_limits(_queued_bytes - kept_bytes,
+				                          _queued_messages - kept, size))
+				{
+					auto oldest = SEND_LANE_COUNT;
+					for (std::size_t i = 0; i < SEND_LANE_COUNT; ++i)
+					{
+						if (!_lane_droppable[i] || _write_lanes[i].empty() ||
+						    &_write_lanes[i].front() == keep)
+							continue;
+						if (oldest == SEND_LANE_COUNT ||
+						    _write_lanes[i].front()._enqueued_ns <
+						        _write_lanes[oldest].front()._enqueued_ns)
+							oldest = i;
+					}
+					++_lane_stats[oldest]._dropped;
+					dropped.push_back(do_pop(oldest)._write_id);
+				}
+				return true;
+			}
+
+			void do_check_watermarks(bool rejected)
+			{
+				if (!_backpressured)
+				{
+					if (rejected || _queued_bytes >= _high_bytes ||
+					    _queued_messages >= _high_messages)
+					{
+						_backpressured = true;
+						_on_backpressure();
+					}
+					return;
+				}
+				if (_queued_bytes <= _low_bytes &&
+				    _queued_messages <= _low_messages)
+				{
+					_backpressured = false;
+					_on_drain();
+				}
+			}
+
+			template <typename T>
+			bool do_enqueue(const T &data, const std::string &write_id,
+			                const std::string &key, SendLane lane)
+			    requires net::BufferContainer<T>
+			{
+				auto index = static_cast<std::size_t>(lane);
+				auto &queue = _write_lanes[index];
+				auto &stats = _lane_stats[index];
+				// Callbacks run once the queue is consistent again.
+				std::vector<std::string> dropped;
+				if (!do_make_room(data.size(), nullptr, dropped))
+				{
+					++stats._rejected;
+					do_check_watermarks(true);
+					return false;
+				}
+				queue.push_back(make_write_node(data, write_id));
+				auto &node = queue.back();
+				node._key = key;
+				node._enqueued_ns = _clock.now_ns();
+				if (!key.empty())
+					_keyed_writes[index][key] = &node;
+				++stats._messages;
+				++stats._queued;
+				++stats._depth;
+				if (stats._depth > stats._max_depth)
+					stats._max_depth = stats._depth;
+				_queued_bytes += data.size();
+				++_queued_messages;
+				do_check_watermarks(false);
+				for (auto &id : dropped)
+					_on_dropped(id);
+				return true;
+			}
+
+			// Index of the lane whose head goes next, SEND_LANE_COUNT when
+			// every lane is empty. The highest non-empty lane wins unless a
+			// lane has been passed over _starvation_limit times.
+			std::size_t do_pick_lane()
+			{
+				auto pick = SEND_LANE_COUNT;
+				for (std::size_t i = 0; i < SEND_LANE_COUNT; ++i)
+				{
+					if (_write_lanes[i].empty())
+						continue;
+					if (pick == SEND_LANE_COUNT)
+						pick = i;
+					if (_lane_bypassed[i] >= _starvation_limit)
+					{
+						pick = i;
+						break;
+					}
+				}
+				if (pick == SEND_LANE_COUNT)
+					return pick;
+				_lane_bypassed[pick] = 0;
+				for (auto i = pick + 1; i < SEND_LANE_COUNT; ++i)
+					if (!_write_lanes[i].empty())
+						++_lane_bypassed[i];
+				return pick;
+			}
+
+			write_node do_pop(std::size_t index)
+			{
+				auto &queue = _write_lanes[index];
+				auto &node = queue.front();
+				if (!node._key.empty())
+					_keyed_writes[index].erase(node._key);
+				--_lane_stats[index]._depth;
+				_queued_bytes -= node._data.size();
+				--_queued_messages;
+				auto out = std::move(node);
+				queue.pop_front();
+				return out;
+			}
+
+			// Take the head of a lane. From here on the message can no longer
+			// be superseded.
+			write_node do_dequeue(std::size_t index)
+			{
+				auto node = do_pop(index);
+				auto &stats = _lane_stats[index];
+				auto wait = _clock.now_ns() - node._enqueued_ns;
+				auto wait_ns = static_cast<std::uint64_t>(wait > 0 ? wait : 0);
+				stats._wait_total_ns += wait_ns;
+				if (wait_ns > stats._wait_max_ns)
+					stats._wait_max_ns = wait_ns;
+				return node;
+			}
+
+			void do_clear_lanes()
+			{
+				for (std::size_t i = 0; i < SEND_LANE_COUNT; ++i)
+				{
+					_write_lanes[i].clear();
+					_keyed_writes[i].clear();
+					_lane_stats[i]._depth = 0;
+					_lane_bypassed[i] = 0;
+				}
+				_queued_bytes = 0;
+				_queued_messages = 0;
+				_in_flight.reset();
+			}
+
+			template <typename T>
+			std::string do_submit(const T &data, const std::string &key,
+			                      SendLane lane)
+			    requires net::BufferContainer<T>
+			{
+				auto snd_id = next_write_id();
+				using Status = TcpTlsSession::TcpSessionStatus;
+				if (has_queued() || _status != Status::SESSION_CONNECTED)
+					return do_enqueue(data, snd_id, key, lane) ? snd_id : "";
+				++_lane_stats[static_cast<std::size_t>(lane)]._messages;
+				// SSL_write must be retried with the same bytes once it has
+				// been called, so a message that did not go out in one call
+				// stays in flight and cannot be superseded.
+				std::size_t offer_set = 0;
+				do_send(data, snd_id, offer_set);
+				if (offer_set != data.size() &&
+				    _status == Status::SESSION_CONNECTED)
+				{
+					_in_flight = make_write_node(data, snd_id);
+					_in_flight->_offer_set = offer_set;
+				}
+				return snd_id;
+			}
+
 			template <typename T>
 			void do_send(const T &data, const std::string &write_id,
 			             std::size_t &offer_set)
@@ -405,25 +1060,51 @@ namespace net
 					}
 					return;
 				}
+				_last_send_ns = _clock.now_ns();
 				offer_set += ret;
 				if (offer_set == data.size())
 					_on_sent(write_id);
 			}
 			void try_send_all_buffer()
 			{
-				while (!_write_queue.empty())
+				if (is_memory_bio())
+					try_send_all_memory_bio();
+				else
+					try_send_all_socket_bio();
+				do_check_watermarks(false);
+			}
+
+			void try_send_all_socket_bio()
+			{
+				if (_status !=
+				    TcpTlsSession::TcpSessionStatus::SESSION_CONNECTED)
+					return;
+				while (true)
 				{
-					auto &node = _write_queue.front();
+					if (!_in_flight)
+					{
+						auto lane = do_pick_lane();
+						if (lane == SEND_LANE_COUNT)
+							return;
+						_in_flight = do_dequeue(lane);
+					}
+					auto &node = *_in_flight;
 					do_send(node._data, node._write_id, node._offer_set);
-					if (node._offer_set != node._data.size())
+					// do_send may have torn the session down.
+					if (!_in_flight ||
+					    _in_flight->_offer_set != _in_flight->_data.size())
 						return;
-					else
-						_write_queue.pop_front();
+					_in_flight.reset();
 				}
 			}
 
 			void do_read()
 			{
+				if (is_memory_bio())
+				{
+					do_read_memory_bio();
+					return;
+				}
 				auto try_read_size = static_cast<int>(_read_buffer.size());
 				auto ret = SSL_read(_ssl, _read_buffer.data(), try_read_size);
 				if (ret <= 0)
@@ -436,12 +1117,392 @@ namespace net
 					}
 					return;
 				}
+				_last_receive_ns = _clock.now_ns();
 				auto read_size = static_cast<std::size_t>(ret);
 				_on_data(std::span<const char>(_read_buffer.data(), read_size));
 			}
 
+			template <typename T>
+			std::string send_memory_bio(const T &data, const std::string &key,
+			                            SendLane lane)
+			    requires net::BufferContainer<T>
+			{
+				auto snd_id = next_write_id();
+				if (_status ==
+				        TcpTlsSession::TcpSessionStatus::SESSION_CONNECTED &&
+				    !has_queued() && cipher_backlog() < CIPHER_BUFFER_SIZE)
+				{
+					++_lane_stats[static_cast<std::size_t>(lane)]._messages;
+					do_encrypt(data, snd_id);
+				}
+				else if (!do_enqueue(data, snd_id, key, lane))
+					return "";
+				return snd_id;
+			}
+
+			// Ciphertext produced but not yet accepted by the kernel.
+			std::size_t cipher_backlog() const
+			{
+				return _cipher_out.size() - _cipher_out_offset +
+				       _pipeline.pending_cipher() +
+				       (_send_inflight ? _send_len - _send_offset : 0);
+			}
+
+			// Queued messages are only encrypted once the kernel took all
+			// earlier ciphertext, at most CIPHER_BUFFER_SIZE bytes per round,
+			// so an urgent message never waits behind more than one batch.
+			void try_send_all_memory_bio()
+			{
+				using Status = TcpTlsSession::TcpSessionStatus;
+				while (_status == Status::SESSION_CONNECTED)
+				{
+					do_flush_cipher();
+					if (_status != Status::SESSION_CONNECTED ||
+					    cipher_backlog() != 0)
+						return;
+					std::size_t batch = 0;
+					while (batch < CIPHER_BUFFER_SIZE)
+					{
+						auto lane = do_pick_lane();
+						if (lane == SEND_LANE_COUNT)
+							break;
+						auto node = do_dequeue(lane);
+						batch += node._data.size();
+						do_encrypt(node._data, node._write_id);
+						if (_status != Status::SESSION_CONNECTED)
+							return;
+					}
+					if (batch == 0)
+						return;
+				}
+			}
+
+			template <typename T>
+			void do_encrypt(const T &data, const std::string &write_id)
+			    requires net::BufferContainer<T>
+			{
+				auto err = _pipeline.encrypt(
+				    _ssl, std::span<const char>(data.data(), data.size()));
+				if (err != SSL_ERROR_NONE)
+				{
+					_on_error(static_cast<net::NetError>(err));
+					disconnect();
+					return;
+				}
+				sent_mark mark;
+				mark._cipher_end = _pipeline.cipher_produced();
+				mark._write_id = write_id;
+				_sent_marks.push_back(std::move(mark));
+			}
+
+			// Write the pending ciphertext with as few send() calls as the
+			// socket allows. Whatever the kernel does not take stays in
+			// _cipher_out for the next poll.
+			void do_flush_cipher()
+			{
+				if (is_uring())
+				{
+					do_flush_cipher_uring();
+					return;
+				}
+				while (true)
+				{
+					if (_cipher_out_offset == _cipher_out.size())
+					{
+						_cipher_out.clear();
+						_cipher_out_offset = 0;
+						auto pending = _pipeline.pending_cipher();
+						if (pending == 0)
+							return;
+						_cipher_out.resize(pending);
+						_cipher_out.resize(_pipeline.take_cipher(_cipher_out));
+						if (_cipher_out.empty())
+							return;
+					}
+					auto ptr = _cipher_out.data() + _cipher_out_offset;
+					auto rest_len = _cipher_out.size() - _cipher_out_offset;
+					auto ret =
+					    ::send(_connector.fd(), ptr, rest_len, MSG_NOSIGNAL);
+					if (ret < 0)
+					{
+						if (errno == EAGAIN || errno == EWOULDBLOCK ||
+						    errno == EINTR)
+							return;
+						_on_error(static_cast<net::NetError>(errno));
+						disconnect();
+						return;
+					}
+					_cipher_out_offset += static_cast<std::size_t>(ret);
+					do_cipher_sent(static_cast<std::size_t>(ret));
+				}
+			}
+
+			// Report every message whose last ciphertext byte is now out.
+			void do_cipher_sent(std::size_t bytes)
+			{
+				_last_send_ns = _clock.now_ns();
+				_cipher_sent += static_cast<std::uint64_t>(bytes);
+				while (!_sent_marks.empty() &&
+				       _sent_marks.front()._cipher_end <= _cipher_sent)
+				{
+					auto write_id = std::move(_sent_marks.front()._write_id);
+					_sent_marks.pop_front();
+					_on_sent(write_id);
+				}
+			}
+
+			// Copy the pending ciphertext into the registered send buffer
+			// and queue one write for it. Only one write per session is in
+			// flight so the byte stream stays ordered.
+			void do_flush_cipher_uring()
+			{
+				if (_send_inflight || _connector.fd() < 0)
+					return;
+				auto len = _pipeline.take_cipher(_ring->send_buffer(_slot));
+				if (len == 0)
+					return;
+				_send_offset = 0;
+				_send_len = len;
+				_ring->prep_send_fixed(_slot, OP_SEND, 0, len);
+				_send_inflight = true;
+			}
+
+			void do_flush_cipher_on_close()
+			{
+				// Bytes written behind a pending ring write would reach the
+				// peer out of order.
+				if (_connector.fd() < 0 || _send_inflight)
+					return;
+				if (_cipher_out_offset > 0)
+				{
+					_cipher_out.erase(_cipher_out.begin(),
+					                  _cipher_out.begin() + _cipher_out_offset);
+					_cipher_out_offset = 0;
+				}
+				auto used = _cipher_out.size();
+				_cipher_out.resize(used + _pipeline.pending_cipher());
+				auto taken = _pipeline.take_cipher(
+				    std::span<char>(_cipher_out).subspan(used));
+				_cipher_out.resize(used + taken);
+				if (!_cipher_out.empty())
+					::send(_connector.fd(), _cipher_out.data(),
+					       _cipher_out.size(), MSG_DONTWAIT | MSG_NOSIGNAL);
+			}
+
+			// Drain everything the socket has into the pipeline. Returns
+			// false when the session was torn down.
+			bool do_recv_cipher()
+			{
+				if (is_uring())
+				{
+					arm_recv();
+					return true;
+				}
+				if (_cipher_in.size() != CIPHER_BUFFER_SIZE)
+					_cipher_in.resize(CIPHER_BUFFER_SIZE);
+				while (true)
+				{
+					auto ret = ::recv(_connector.fd(), _cipher_in.data(),
+					                  _cipher_in.size(), 0);
+					if (ret < 0)
+					{
+						if (errno == EAGAIN || errno == EWOULDBLOCK)
+							return true;
+						if (errno == EINTR)
+							continue;
+						_on_error(static_cast<net::NetError>(errno));
+						disconnect();
+						return false;
+					}
+					if (ret == 0)
+					{
+						_on_error(net::NetError::ERR_SSL_ERROR_SYSCALL);
+						disconnect();
+						return false;
+					}
+					_last_receive_ns = _clock.now_ns();
+					auto len = static_cast<std::size_t>(ret);
+					_pipeline.feed(
+					    std::span<const char>(_cipher_in.data(), len));
+					if (len < _cipher_in.size())
+						return true;
+				}
+			}
+
+			void do_read_memory_bio()
+			{
+				if (!do_recv_cipher())
+					return;
+				// The ring feeds and drains the pipeline from its
+				// completions.
+				if (!is_uring())
+					do_drain_plaintext();
+			}
+
+			void do_drain_plaintext()
+			{
+				auto err = _pipeline.drain_plaintext(
+				    _ssl, std::span<char>(_read_buffer),
+				    [this](const std::span<const char> &plain)
+				    {
+					    _on_data(plain);
+					    return _status == TcpTlsSession::TcpSessionStatus::
+					                          SESSION_CONNECTED;
+				    });
+				if (err == SSL_ERROR_NONE)
+					return;
+				if (is_fatal_error(err))
+				{
+					_on_error(static_cast<net::NetError>(err));
+					disconnect();
+					return;
+				}
+				// Reading may have produced records (key updates, alerts).
+				do_flush_cipher();
+			}
+
+			bool do_install_fixed_file()
+			{
+				auto err = _ring->set_fd(_slot, _connector.fd());
+				if (err == net::NetError::ERR_OK)
+					return true;
+				_on_error(err);
+				disconnect();
+				return false;
+			}
+
+			// Completions still in flight for the socket are discarded once
+			// the slot no longer holds it.
+			void do_release_fixed_file()
+			{
+				if (_recv_armed)
+					_ring->prep_cancel(_slot, OP_RECV, OP_CANCEL);
+				::shutdown(_connector.fd(), SHUT_RDWR);
+				_ring->set_fd(_slot, -1);
+			}
+
+			void arm_recv()
+			{
+				if (_recv_armed || _connector.fd() < 0)
+					return;
+				_ring->prep_recv_multishot(_slot, OP_RECV);
+				_recv_armed = true;
+			}
+
+			void on_completion(std::uint8_t op, int res, std::uint32_t flags,
+			                   const std::span<const char> &data)
+			{
+				switch (op)
+				{
+				case OP_CONNECT:
+				{
+					on_connect_complete(res);
+					return;
+				}
+				case OP_RECV:
+				{
+					on_recv_complete(res, flags, data);
+					return;
+				}
+				case OP_SEND:
+				{
+					on_send_complete(res);
+					return;
+				}
+				case OP_CANCEL:
+					return;
+				default:
+					return;
+				}
+			}
+
+			void on_connect_complete(int res)
+			{
+				if (res < 0)
+				{
+					_on_error(static_cast<net::NetError>(-res));
+					disconnect();
+					return;
+				}
+				_status =
+				    TcpTlsSession::TcpSessionStatus::SESSION_TSL_CONNECTING;
+				do_tls_connect();
+			}
+
+			void on_recv_complete(int res, std::uint32_t flags,
+			                      const std::span<const char> &data)
+			{
+				using Status = TcpTlsSession::TcpSessionStatus;
+				if (!(flags & IORING_CQE_F_MORE))
+					_recv_armed = false;
+				// Out of provided buffers, poll() arms the recv again.
+				if (res == -ENOBUFS)
+					return;
+				if (res < 0)
+				{
+					_on_error(static_cast<net::NetError>(-res));
+					disconnect();
+					return;
+				}
+				if (res == 0)
+				{
+					_on_error(net::NetError::ERR_SSL_ERROR_SYSCALL);
+					disconnect();
+					return;
+				}
+				if (!_ssl || !_pipeline.feed(data))
+					return;
+				_last_receive_ns = _clock.now_ns();
+				if (_status == Status::SESSION_TSL_CONNECTING)
+					do_check_tls_connecting();
+				if (_status == Status::SESSION_CONNECTED)
+					do_drain_plaintext();
+			}
+
+			void on_send_complete(int res)
+			{
+				using Status = TcpTlsSession::TcpSessionStatus;
+				_send_inflight = false;
+				if (res < 0)
+				{
+					_on_error(static_cast<net::NetError>(-res));
+					disconnect();
+					return;
+				}
+				_send_offset += static_cast<std::size_t>(res);
+				do_cipher_sent(static_cast<std::size_t>(res));
+				// on_sent may have torn the session down.
+				if (_connector.fd() < 0)
+					return;
+				if (_send_offset < _send_len)
+				{
+					_ring->prep_send_fixed(_slot, OP_SEND, _send_offset,
+					                       _send_len - _send_offset);
+					_send_inflight = true;
+					return;
+				}
+				// The kernel took everything, queued messages go next.
+				if (_status == Status::SESSION_CONNECTED)
+					try_send_all_buffer();
+				else
+					do_flush_cipher();
+			}
+
 			void do_disconnect()
 			{
+				if (_ssl && is_memory_bio())
+				{
+					// Best effort close_notify, a memory BIO never blocks the
+					// shutdown so there is nothing to wait for.
+					if (SSL_is_init_finished(_ssl))
+					{
+						SSL_shutdown(_ssl);
+						do_flush_cipher_on_close();
+					}
+					SSL_free(_ssl);
+					_ssl = nullptr;
+					_pipeline.reset();
+				}
 				if (_ssl)
 				{
 					auto shutdown_rt = SSL_shutdown(_ssl);
@@ -456,11 +1517,20 @@ namespace net
 					SSL_free(_ssl);
 					_ssl = nullptr;
 				}
-				if (_socket_fd >= 0)
+				if (_connector.fd() >= 0)
 				{
-					::close(_socket_fd);
-					_socket_fd = -1;
+					if (is_uring())
+						do_release_fixed_file();
+					_connector.close();
 				}
+				_cipher_out.clear();
+				_cipher_out_offset = 0;
+				_cipher_sent = 0;
+				_sent_marks.clear();
+				_send_offset = 0;
+				_send_len = 0;
+				_send_inflight = false;
+				_recv_armed = false;
 				_on_disconnected();
 				if (_auto_connect)
 					_status =
@@ -469,7 +1539,6 @@ namespace net
 					_status = TcpTlsSession::TcpSessionStatus::SESSION_IDLE;
 			}
 		};
-		const encrypt::OpenSSLInitializer TcpTlsSession::_ssl_initialize;
 	} // namespace tcp
 } // namespace net
 
@@ -0,0 +1,163 @@
+#ifndef NET_TCP_TLS_BIO_PIPELINE_H
+#define NET_TCP_TLS_BIO_PIPELINE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <openssl/bio.h>
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#include <span>
+
+namespace net
+{
+	namespace tcp
+	{
+		// Runs OpenSSL over a pair of memory BIOs so the owner decides when
+		// and how ciphertext moves to and from the socket. Received bytes are
+		// fed in with feed(), every complete record is decrypted by
+		// drain_plaintext(), plaintext is encrypted with encrypt() and the
+		// resulting records are collected with take_cipher().
+		class TlsBioPipeline
+		{
+		public:
+			TlsBioPipeline()
+			    : _rbio(nullptr)
+			    , _wbio(nullptr)
+			    , _cipher_taken(0)
+			{
+			}
+
+			// Attach fresh memory BIOs to ssl. Ownership of the BIOs moves to
+			// ssl, they are released by SSL_free.
+			bool attach(SSL *ssl)
+			{
+				_rbio = BIO_new(BIO_s_mem());
+				_wbio = BIO_new(BIO_s_mem());
+				if (!_rbio || !_wbio)
+				{
+					if (_rbio)
+						BIO_free(_rbio);
+					if (_wbio)
+						BIO_free(_wbio);
+					reset();
+					return false;
+				}
+				// An empty read BIO means "come back later", not end of file.
+				BIO_set_mem_eof_return(_rbio, -1);
+				BIO_set_mem_eof_return(_wbio, -1);
+				SSL_set_bio(ssl, _rbio, _wbio);
+				_cipher_taken = 0;
+				return true;
+			}
+
+			void reset()
+			{
+				_rbio = nullptr;
+				_wbio = nullptr;
+				_cipher_taken = 0;
+			}
+
+			bool attached() const { return _rbio != nullptr; }
+
+			bool feed(const std::span<const char> &cipher)
+			{
+				std::size_t offset = 0;
+				while (offset < cipher.size())
+				{
+					auto chunk = std::min(cipher.size() - offset, max_int());
+					auto ret = BIO_write(_rbio, cipher.data() + offset,
+					                     static_cast<int>(chunk));
+					if (ret <= 0)
+						return false;
+					offset += static_cast<std::size_t>(ret);
+				}
+				return true;
+			}
+
+			// Decrypt every complete record currently buffered, handing each
+			// chunk of plaintext to on_plain, which returns false to stop
+			// early (e.g. after it tore the session down). Returns
+			// SSL_ERROR_NONE when stopped early, otherwise the SSL_get_error
+			// code that ended the loop, SSL_ERROR_WANT_READ once the input is
+			// exhausted.
+			template <typename F>
+			int drain_plaintext(SSL *ssl, std::span<char> buffer, F &&on_plain)
+			{
+				auto try_read_size =
+				    static_cast<int>(std::min(buffer.size(), max_int()));
+				while (true)
+				{
+					auto ret = SSL_read(ssl, buffer.data(), try_read_size);
+					if (ret <= 0)
+						return SSL_get_error(ssl, ret);
+					if (!on_plain(std::span<const char>(
+					        buffer.data(), static_cast<std::size_t>(ret))))
+						return SSL_ERROR_NONE;
+				}
+			}
+
+			// Encrypt plain into the outgoing memory BIO. A memory BIO never
+			// blocks, so a successful call consumes the whole input. Returns
+			// SSL_ERROR_NONE or the SSL_get_error code of the failure.
+			int encrypt(SSL *ssl, const std::span<const char> &plain)
+			{
+				std::size_t offset = 0;
+				while (offset < plain.size())
+				{
+					auto rest_len = plain.size() - offset;
+					auto snd_size =
+					    static_cast<int>(std::min(rest_len, max_int()));
+					auto ret = SSL_write(ssl, plain.data() + offset, snd_size);
+					if (ret <= 0)
+						return SSL_get_error(ssl, ret);
+					offset += static_cast<std::size_t>(ret);
+				}
+				return SSL_ERROR_NONE;
+			}
+
+			std::size_t pending_cipher() const
+			{
+				return _wbio ? BIO_ctrl_pending(_wbio) : 0;
+			}
+
+			// Move up to out.size() bytes of ciphertext into out.
+			std::size_t take_cipher(std::span<char> out)
+			{
+				if (!_wbio || out.empty())
+					return 0;
+				auto want = static_cast<int>(std::min(out.size(), max_int()));
+				auto ret = BIO_read(_wbio, out.data(), want);
+				if (ret <= 0)
+					return 0;
+				_cipher_taken += static_cast<std::size_t>(ret);
+				return static_cast<std::size_t>(ret);
+			}
+
+			// Total ciphertext bytes generated so far. A message handed to
+			// encrypt() is fully on the wire once the owner has written
+			// cipher_produced() (sampled right after encrypt) bytes.
+			std::uint64_t cipher_produced() const
+			{
+				return _cipher_taken + pending_cipher();
+			}
+
+			std::uint64_t cipher_taken() const { return _cipher_taken; }
+
+		private:
+			static constexpr std::size_t max_int()
+			{
+				using limits = std::numeric_limits<int>;
+				return static_cast<std::size_t>(limits::max());
+			}
+
+		private:
+			BIO *_rbio;
+			BIO *_wbio;
+			std::uint64_t _cipher_taken;
+		};
+	} // namespace tcp
+} // namespace net
+
+#endif // NET_TCP_TLS_BIO_PIPELINE_H
@@ -0,0 +1,25 @@
+#ifndef NET_TCP_WRITE_ID_H
+#define NET_TCP_WRITE_ID_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace net
+{
+	namespace tcp
+	{
+		// Id of a message handed to a session's send(), unique within the
+		// process and never empty. It only has to tell on_sent, dropped
+		// and superseded callbacks apart, so a counter does; the decimal
+		// string stays within the small-string buffer.
+		inline std::string next_write_id()
+		{
+			static std::atomic<std::uint64_t> next(0);
+			auto id = next.fetch_add(1, std::memory_order_relaxed) + 1;
+			return std::to_string(id);
+		}
+	} // namespace tcp
+} // namespace net
+
+#endif // NET_TCP_WRITE_ID_H
@@ -0,0 +1,217 @@
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <net/error.hpp>
+#include <net/tcp/IoUring.hpp>
+#include <net/tcp/TcpTlsServer.hpp>
+#include <net/tcp/TcpTlsSession.hpp>
+#include <net/tcp/WriteId.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Quote burst over loopback TLS. Every loop iteration each session sends
+// BATCH messages, then the loop polls once. The sink runs on its own
+// thread, so the figures are the cost of the client loop per backend.
+// send() and poll() are timed apart. SOCKET_BIO writes the socket in
+// send(), the other backends only encrypt and leave the syscalls to
+// poll(). Every send also makes a write id; its cost is timed on its own
+// and taken out of the send figure, so that is the backend alone. The
+// kTLS run is SOCKET_BIO with the kernel framing records, against
+// userspace TLS in the socket bio run. OpenSSL falls back to userspace
+// crypto without a word, so the run is skipped, and the bench fails,
+// unless the kernel took the send side of every session.
+
+using namespace net::tcp;
+using Mode = TcpTlsSession::TlsTransportMode;
+using Clock = std::chrono::steady_clock;
+
+static constexpr std::size_t MESSAGE_SIZE = 128;
+static constexpr std::size_t BATCH = 16;
+static constexpr auto TIMEOUT = std::chrono::seconds(30);
+
+static double elapsed_ns(Clock::time_point from, Clock::time_point to)
+{
+	return std::chrono::duration<double, std::nano>(to - from).count();
+}
+
+// Mean cost of the write id every send() makes.
+static double write_id_ns()
+{
+	constexpr std::size_t IDS = 1000000;
+	std::size_t sink = 0;
+	auto start = Clock::now();
+	for (std::size_t i = 0; i < IDS; ++i)
+		sink += next_write_id().size();
+	auto ns = elapsed_ns(start, Clock::now()) / static_cast<double>(IDS);
+	return sink ? ns : 0;
+}
+
+// False when the run could not be measured as labelled.
+static bool run(const char *name, Mode mode, bool ktls, IoUring *ring,
+                int port, const std::atomic<std::size_t> &received,
+                std::size_t session_count, std::size_t rounds, double id_ns)
+{
+	std::size_t connected = 0;
+	std::size_t errors = 0;
+	std::vector<std::unique_ptr<TcpTlsSession>> sessions;
+	for (std::size_t i = 0; i < session_count; ++i)
+	{
+		auto on_connected = [&connected]() { ++connected; };
+		auto on_error = [&errors](net::NetError) { ++errors; };
+		if (ring)
+			sessions.push_back(std::make_unique<TcpTlsSession>(
+			    *ring, on_connected, []() {}, [](const std::string &) {},
+			    [](const std::span<const char> &) {}, on_error, 4096,
+			    false));
+		else
+			sessions.push_back(std::make_unique<TcpTlsSession>(
+			    on_connected, []() {}, [](const std::string &) {},
+			    [](const std::span<const char> &) {}, on_error, 4096,
+			    false));
+		sessions.back()->set_transport_mode(mode);
+		sessions.back()->enable_ktls(ktls);
+		sessions.back()->connect("127.0.0.1", port);
+	}
+	auto poll = [&]()
+	{
+		for (auto &session : sessions)
+			session->poll();
+		if (ring)
+			ring->poll();
+	};
+	auto deadline = Clock::now() + TIMEOUT;
+	while (connected < session_count && errors == 0 &&
+	       Clock::now() < deadline)
+		poll();
+	if (connected < session_count)
+	{
+		std::cout << name << ": " << connected << " of " << session_count
+		          << " sessions connected, " << errors << " errors"
+		          << std::endl;
+		return false;
+	}
+	if (ktls)
+	{
+		std::size_t send_offload = 0;
+		std::size_t recv_offload = 0;
+		for (auto &session : sessions)
+		{
+			send_offload += session->is_ktls_send();
+			recv_offload += session->is_ktls_recv();
+		}
+		std::cout << name << ": kernel TLS on " << send_offload << " of "
+		          << session_count << " sessions for send, " << recv_offload
+		          << " for receive" << std::endl;
+		if (send_offload < session_count)
+		{
+			std::cout << name << ": not in effect, run skipped" << std::endl;
+			return false;
+		}
+	}
+
+	std::vector<char> message(MESSAGE_SIZE, 'q');
+	auto messages = session_count * rounds * BATCH;
+	auto want = received.load() + messages * MESSAGE_SIZE;
+	double send_ns = 0;
+	double poll_ns = 0;
+	auto start = Clock::now();
+	for (std::size_t round = 0; round < rounds; ++round)
+	{
+		auto send_start = Clock::now();
+		for (auto &session : sessions)
+			for (std::size_t i = 0; i < BATCH; ++i)
+				session->send(message);
+		auto poll_start = Clock::now();
+		poll();
+		auto poll_end = Clock::now();
+		send_ns += elapsed_ns(send_start, poll_start);
+		poll_ns += elapsed_ns(poll_start, poll_end);
+	}
+	deadline = Clock::now() + TIMEOUT;
+	while (received.load() < want && Clock::now() < deadline)
+		poll();
+	auto end = Clock::now();
+
+	auto total_ns = elapsed_ns(start, end);
+	std::cout << name << ": "
+	          << send_ns / static_cast<double>(messages) - id_ns
+	          << " ns per send, "
+	          << poll_ns / static_cast<double>(rounds) << " ns per poll, "
+	          << static_cast<double>(messages) * 1e9 / total_ns << " msg/s, "
+	          << static_cast<double>(messages * MESSAGE_SIZE) * 1e3 / total_ns
+	          << " MB/s";
+	auto complete = received.load() >= want && errors == 0;
+	if (!complete)
+		std::cout << " (incomplete, " << errors << " errors)";
+	std::cout << std::endl;
+	sessions.clear();
+	if (ring)
+		ring->poll();
+	return complete;
+}
+
+int main(int argc, const char **argv)
+{
+	std::size_t session_count =
+	    argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 8;
+	std::size_t rounds = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 5000;
+	std::atomic<std::size_t> received(0);
+	std::atomic<bool> stop(false);
+	TcpTlsServer server(
+	    [](std::uint64_t) {}, [](std::uint64_t) {},
+	    [](std::uint64_t, const std::string &) {},
+	    [&received](std::uint64_t, const std::span<const char> &data)
+	    { received += data.size(); },
+	    [](std::uint64_t, net::NetError) {}, 64 * 1024);
+	server.set_transport_mode(Mode::MEMORY_BIO);
+	if (!server.use_self_signed_certificate() ||
+	    !server.listen("127.0.0.1:0"))
+	{
+		std::cout << "cannot start the loopback TLS sink" << std::endl;
+		return 1;
+	}
+	std::thread sink(
+	    [&]()
+	    {
+		    while (!stop.load())
+			    server.poll();
+		    server.stop();
+	    });
+
+	std::cout << session_count << " sessions, " << rounds << " x " << BATCH
+	          << " messages of " << MESSAGE_SIZE << " bytes each"
+	          << std::endl;
+	auto id_ns = write_id_ns();
+	std::cout << "write id: " << id_ns
+	          << " ns, not counted in the send figures" << std::endl;
+	auto ok = run("socket bio", Mode::SOCKET_BIO, false, nullptr,
+	              server.port(), received, session_count, rounds, id_ns);
+	ok &= run("ktls", Mode::SOCKET_BIO, true, nullptr, server.port(),
+	          received, session_count, rounds, id_ns);
+	ok &= run("memory bio", Mode::MEMORY_BIO, false, nullptr, server.port(),
+	          received, session_count, rounds, id_ns);
+	try
+	{
+		IoUring ring;
+		ring.set_on_error(
+		    [](net::NetError err)
+		    {
+			    std::cout << "io_uring_enter failed: "
+			              << static_cast<long>(err) << std::endl;
+		    });
+		ok &= run("io_uring", Mode::IO_URING, false, &ring, server.port(),
+		          received, session_count, rounds, id_ns);
+	}
+	catch (const std::exception &e)
+	{
+		std::cout << "io_uring: unavailable, " << e.what() << std::endl;
+	}
+
+	stop = true;
+	sink.join();
+	return ok ? 0 : 1;
+}
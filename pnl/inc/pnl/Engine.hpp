@@ -0,0 +1,355 @@
+#ifndef PNL_ENGINE_H
+#define PNL_ENGINE_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace pnl
+{
+	// Realised and unrealised PnL in USD (spec §9 pnl_realised_24h, §11
+	// pnl_realised_usd and pnl_unrealised_usd), kept current as events
+	// arrive instead of recomputed from fill history.
+	//
+	// A book is one symbol on one venue, with its own signed position and
+	// average cost; a fill costs O(1) whatever the history. Reducing a
+	// book realises (price - avg_price) per closed contract; fees (paid
+	// positive, rebates negative) and funding (received positive) go
+	// straight to realised. Contracts are linear, quoted in USD.
+	//
+	// Unrealised PnL is marked at Theo. Per symbol the engine keeps the
+	// net position and cost basis (sum of position * avg_price over
+	// venues), so a Theo tick revalues the symbol and the total in O(1):
+	// unrealised = net_position * theo - cost_basis. Before the first
+	// Theo a symbol is marked at its last fill price.
+	//
+	// Realised PnL also lands in a ring of time buckets covering the
+	// rolling window (24h by default); realised_window_usd() drops the
+	// buckets that fell out of it and returns the running sum.
+	//
+	// State is struct-of-arrays, one array per field, indexed by book
+	// (symbol * max_venues + venue) or by symbol. One thread owns the
+	// engine; it publishes the totals, e.g. to metrics gauges and to
+	// risk::PreTradeGate::update_pnl().
+	class Engine
+	{
+	public:
+		static constexpr std::uint32_t NO_SYMBOL =
+		    std::numeric_limits<std::uint32_t>::max();
+		static constexpr std::uint32_t NO_VENUE =
+		    std::numeric_limits<std::uint32_t>::max();
+		static constexpr std::int64_t DAY_NS = 86400000000000;
+
+	public:
+		// The window is bucket_count buckets of window_ns / bucket_count,
+		// so it reaches back between window_ns less one bucket and
+		// window_ns.
+		Engine(std::size_t max_symbols, std::size_t max_venues,
+		       std::int64_t window_ns = DAY_NS,
+		       std::size_t bucket_count = 1440)
+		    : _max_symbols(max_symbols)
+		    , _max_venues(max_venues)
+		    , _position(std::make_unique<double[]>(max_symbols * max_venues))
+		    , _avg_price(std::make_unique<double[]>(max_symbols * max_venues))
+		    , _realised(std::make_unique<double[]>(max_symbols * max_venues))
+		    , _fees(std::make_unique<double[]>(max_symbols * max_venues))
+		    , _funding(std::make_unique<double[]>(max_symbols * max_venues))
+		    , _net_position(std::make_unique<double[]>(max_symbols))
+		    , _cost_basis(std::make_unique<double[]>(max_symbols))
+		    , _mark(std::make_unique<double[]>(max_symbols))
+		    , _unrealised(std::make_unique<double[]>(max_symbols))
+		    , _has_theo(std::make_unique<bool[]>(max_symbols))
+		    , _realised_total(0)
+		    , _fees_total(0)
+		    , _funding_total(0)
+		    , _unrealised_total(0)
+		    , _bucket_count(std::max<std::size_t>(bucket_count, 1))
+		    , _bucket_ns(std::max<std::int64_t>(
+		          window_ns / static_cast<std::int64_t>(_bucket_count), 1))
+		    , _buckets(std::make_unique<double[]>(_bucket_count))
+		    , _head(std::numeric_limits<std::int64_t>::min())
+		    , _window_total(0)
+		    , _symbol_names()
+		    , _venue_names()
+		    , _symbols()
+		{
+			_symbol_names.reserve(max_symbols);
+			_venue_names.reserve(max_venues);
+		}
+
+		Engine(const Engine &) = delete;
+
+		Engine &operator=(const Engine &) = delete;
+
+		// NO_SYMBOL once max_symbols are taken.
+		std::uint32_t add_symbol(const std::string &name)
+		{
+			auto it = _symbols.find(name);
+			if (it != _symbols.end())
+				return it->second;
+			if (_symbol_names.size() >= _max_symbols)
+				return NO_SYMBOL;
+			auto id = static_cast<std::uint32_t>(_symbol_names.size());
+			_symbol_names.push_back(name);
+			_symbols.emplace(name, id);
+			return id;
+		}
+
+		std::uint32_t symbol_id(const std::string &name) const
+		{
+			auto it = _symbols.find(name);
+			return it == _symbols.end() ? NO_SYMBOL : it->second;
+		}
+
+		std::size_t symbol_count() const { return _symbol_names.size(); }
+
+		const std::string &symbol_name(std::uint32_t symbol) const
+		{
+			return _symbol_names[symbol];
+		}
+
+		// NO_VENUE once max_venues are taken.
+		std::uint32_t add_venue(const std::string &name)
+		{
+			for (std::size_t i = 0; i < _venue_names.size(); ++i)
+			{
+				if (_venue_names[i] == name)
+					return static_cast<std::uint32_t>(i);
+			}
+			if (_venue_names.size() >= _max_venues)
+				return NO_VENUE;
+			_venue_names.push_back(name);
+			return static_cast<std::uint32_t>(_venue_names.size() - 1);
+		}
+
+		std::size_t venue_count() const { return _venue_names.size(); }
+
+		const std::string &venue_name(std::uint32_t venue) const
+		{
+			return _venue_names[venue];
+		}
+
+		// quantity is signed, positive for a buy. The average price
+		// follows the open position: adding averages in, reducing keeps
+		// it, flipping restarts at price. Returns the realised PnL of
+		// this fill, fee included.
+		double on_fill(std::uint32_t symbol, std::uint32_t venue,
+		               double quantity, double price, double fee_usd,
+		               std::int64_t timestamp_ns)
+		{
+			auto book = do_book(symbol, venue);
+			auto before = _position[book];
+			auto avg = _avg_price[book];
+			auto after = before + quantity;
+			double realised = 0;
+			if (before != 0 && (before > 0) != (quantity > 0))
+			{
+				auto closed = std::min(std::fabs(quantity), std::fabs(before));
+				realised = closed * (price - avg) * (before > 0 ? 1 : -1);
+			}
+			double next_avg;
+			if (after == 0)
+				next_avg = 0;
+			else if (before == 0 || (before > 0) != (after > 0))
+				next_avg = price;
+			else if (std::fabs(after) > std::fabs(before))
+				next_avg = (avg * std::fabs(before) +
+				            price * std::fabs(quantity)) /
+				           std::fabs(after);
+			else
+				next_avg = avg;
+			_position[book] = after;
+			_avg_price[book] = next_avg;
+			_fees[book] += fee_usd;
+			_fees_total += fee_usd;
+			if (!_has_theo[symbol])
+				_mark[symbol] = price;
+			do_move(symbol, quantity, after * next_avg - before * avg);
+			realised -= fee_usd;
+			do_realise(book, realised, timestamp_ns);
+			return realised;
+		}
+
+		// A funding payment or accrual on (symbol, venue), received
+		// positive.
+		void on_funding(std::uint32_t symbol, std::uint32_t venue,
+		                double amount_usd, std::int64_t timestamp_ns)
+		{
+			auto book = do_book(symbol, venue);
+			_funding[book] += amount_usd;
+			_funding_total += amount_usd;
+			do_realise(book, amount_usd, timestamp_ns);
+		}
+
+		// Theo tick: revalue the symbol's unrealised PnL.
+		void set_theo(std::uint32_t symbol, double theo)
+		{
+			_mark[symbol] = theo;
+			_has_theo[symbol] = true;
+			do_revalue(symbol);
+		}
+
+		// Overwrite a book with the venue's own view, e.g. after
+		// reconnecting. Realised PnL is left as it is.
+		void set_position(std::uint32_t symbol, std::uint32_t venue,
+		                  double position, double avg_price)
+		{
+			auto book = do_book(symbol, venue);
+			auto next_avg = position == 0 ? 0 : avg_price;
+			do_move(symbol, position - _position[book],
+			        position * next_avg -
+			            _position[book] * _avg_price[book]);
+			_position[book] = position;
+			_avg_price[book] = next_avg;
+		}
+
+		double position(std::uint32_t symbol, std::uint32_t venue) const
+		{
+			return _position[do_book(symbol, venue)];
+		}
+
+		double avg_price(std::uint32_t symbol, std::uint32_t venue) const
+		{
+			return _avg_price[do_book(symbol, venue)];
+		}
+
+		// Fees and funding included.
+		double realised_usd(std::uint32_t symbol, std::uint32_t venue) const
+		{
+			return _realised[do_book(symbol, venue)];
+		}
+
+		double fees_usd(std::uint32_t symbol, std::uint32_t venue) const
+		{
+			return _fees[do_book(symbol, venue)];
+		}
+
+		double funding_usd(std::uint32_t symbol, std::uint32_t venue) const
+		{
+			return _funding[do_book(symbol, venue)];
+		}
+
+		double unrealised_usd(std::uint32_t symbol) const
+		{
+			return _unrealised[symbol];
+		}
+
+		// pnl_realised_usd: everything realised since start, fees and
+		// funding included.
+		double realised_usd() const { return _realised_total; }
+
+		// pnl_unrealised_usd: every symbol at its latest mark.
+		double unrealised_usd() const { return _unrealised_total; }
+
+		double fees_usd() const { return _fees_total; }
+
+		double funding_usd() const { return _funding_total; }
+
+		// pnl_realised_24h with the default window: realised PnL of the
+		// window ending at now_ns.
+		double realised_window_usd(std::int64_t now_ns)
+		{
+			do_advance(now_ns / _bucket_ns);
+			return _window_total;
+		}
+
+	private:
+		std::size_t _max_symbols;
+		std::size_t _max_venues;
+		// Per book.
+		std::unique_ptr<double[]> _position;
+		std::unique_ptr<double[]> _avg_price;
+		std::unique_ptr<double[]> _realised;
+		std::unique_ptr<double[]> _fees;
+		std::unique_ptr<double[]> _funding;
+		// Per symbol, summed over venues.
+		std::unique_ptr<double[]> _net_position;
+		std::unique_ptr<double[]> _cost_basis;
+		std::unique_ptr<double[]> _mark;
+		std::unique_ptr<double[]> _unrealised;
+		std::unique_ptr<bool[]> _has_theo;
+		double _realised_total;
+		double _fees_total;
+		double _funding_total;
+		double _unrealised_total;
+		// Rolling window: bucket i % bucket_count holds realised PnL of
+		// [i * bucket_ns, (i + 1) * bucket_ns); _head is the newest i.
+		std::size_t _bucket_count;
+		std::int64_t _bucket_ns;
+		std::unique_ptr<double[]> _buckets;
+		std::int64_t _head;
+		double _window_total;
+		std::vector<std::string> _symbol_names;
+		std::vector<std::string> _venue_names;
+		std::unordered_map<std::string, std::uint32_t> _symbols;
+
+		std::size_t do_book(std::uint32_t symbol, std::uint32_t venue) const
+		{
+			return static_cast<std::size_t>(symbol) * _max_venues + venue;
+		}
+
+		void do_move(std::uint32_t symbol, double quantity, double cost)
+		{
+			_net_position[symbol] += quantity;
+			_cost_basis[symbol] += cost;
+			do_revalue(symbol);
+		}
+
+		void do_revalue(std::uint32_t symbol)
+		{
+			auto unrealised =
+			    _net_position[symbol] * _mark[symbol] - _cost_basis[symbol];
+			_unrealised_total += unrealised - _unrealised[symbol];
+			_unrealised[symbol] = unrealised;
+		}
+
+		void do_realise(std::size_t book, double amount,
+		                std::int64_t timestamp_ns)
+		{
+			_realised[book] += amount;
+			_realised_total += amount;
+			auto index = timestamp_ns / _bucket_ns;
+			do_advance(index);
+			// A late event still counts if its bucket is in the window.
+			if (_head - index >= static_cast<std::int64_t>(_bucket_count))
+				return;
+			_buckets[static_cast<std::size_t>(index) % _bucket_count] +=
+			    amount;
+			_window_total += amount;
+		}
+
+		// Clears the buckets between the old and the new head; a long
+		// gap clears the ring once.
+		void do_advance(std::int64_t index)
+		{
+			if (index <= _head)
+				return;
+			auto count = static_cast<std::int64_t>(_bucket_count);
+			if (_head == std::numeric_limits<std::int64_t>::min() ||
+			    index - _head >= count)
+			{
+				std::fill_n(_buckets.get(), _bucket_count, 0.0);
+				_window_total = 0;
+			}
+			else
+			{
+				for (auto i = _head + 1; i <= index; ++i)
+				{
+					auto &bucket = _buckets[static_cast<std::size_t>(i) %
+					                        _bucket_count];
+					_window_total -= bucket;
+					bucket = 0;
+				}
+			}
+			_head = index;
+		}
+	};
+} // namespace pnl
+
+#endif // PNL_ENGINE_H
@@ -0,0 +1,293 @@
+#ifndef REPLAY_PLAYER_H
+#define REPLAY_PLAYER_H
+
+#include <algorithm>
+#include <capture/Reader.hpp>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <span>
+#include <string>
+#include <thread>
+#include <timing/Clock.hpp>
+#include <unordered_map>
+#include <vector>
+
+namespace replay
+{
+	enum class PlaybackMode : unsigned int
+	{
+		AS_FAST_AS_POSSIBLE = 0,
+		REAL_TIME = 1,
+		SCALED = 2,
+	};
+
+	// Plays captured records back through the same callbacks a live
+	// TcpTlsSession would drive, on a virtual clock that follows the
+	// capture timestamps. Timers scheduled against that clock fire in
+	// (due time, scheduling order) before any record stamped at or after
+	// their due time, so a run over the same capture is deterministic
+	// whatever the playback speed. Hand clock() to the components under
+	// test so they read the same time.
+	class Player
+	{
+	public:
+		using OnDataCallBack = std::function<void(
+		    std::uint64_t session_id, const std::span<const char> &data)>;
+		using OnEventCallBack = std::function<void(
+		    std::uint64_t session_id, const std::span<const char> &data)>;
+		using OnTimerCallBack = std::function<void()>;
+
+		static constexpr std::int64_t NO_TIME =
+		    std::numeric_limits<std::int64_t>::min();
+
+	public:
+		Player(OnDataCallBack &&on_data,
+		       OnEventCallBack &&on_event =
+		           [](std::uint64_t, const std::span<const char> &) {})
+		    : _on_data(std::move(on_data))
+		    , _on_event(std::move(on_event))
+		    , _reader()
+		    , _pending()
+		    , _has_pending(false)
+		    , _timers()
+		    , _timer_callbacks()
+		    , _next_timer_id(1)
+		    , _mode(PlaybackMode::AS_FAST_AS_POSSIBLE)
+		    , _speed(1.0)
+		    , _clock(NO_TIME)
+		    , _pace_virtual_ns(NO_TIME)
+		    , _pace_wall()
+		    , _stopped(false)
+		    , _records(0)
+		    , _bytes(0)
+		    , _timers_fired(0)
+		{
+		}
+
+		Player(const Player &) = delete;
+
+		Player &operator=(const Player &) = delete;
+
+		bool open(const std::string &path)
+		{
+			return do_open(_reader.open(path));
+		}
+
+		bool open_directory(const std::string &directory,
+		                    const std::string &prefix = "capture")
+		{
+			return do_open(_reader.open_directory(directory, prefix));
+		}
+
+		// speed is only used in SCALED mode, where 10.0 plays ten times
+		// faster than the capture was recorded.
+		void set_mode(PlaybackMode mode, double speed = 1.0)
+		{
+			_mode = mode;
+			_speed = speed > 0.0 ? speed : 1.0;
+			_pace_virtual_ns = NO_TIME;
+		}
+
+		// Virtual time: the timestamp of the record or timer being
+		// delivered. NO_TIME until the first record is read.
+		std::int64_t now_ns() const { return _clock.now_ns(); }
+
+		const timing::VirtualClock &clock() const { return _clock; }
+
+		std::uint64_t schedule_at(std::int64_t due_ns, OnTimerCallBack &&cb)
+		{
+			auto id = _next_timer_id++;
+			_timers.push(timer_entry(due_ns, id));
+			_timer_callbacks.emplace(id, std::move(cb));
+			return id;
+		}
+
+		std::uint64_t schedule_after(std::int64_t delay_ns,
+		                             OnTimerCallBack &&cb)
+		{
+			auto base = now_ns() == NO_TIME ? 0 : now_ns();
+			return schedule_at(base + delay_ns, std::move(cb));
+		}
+
+		bool cancel_timer(std::uint64_t id)
+		{
+			return _timer_callbacks.erase(id) > 0;
+		}
+
+		// Deliver the next record, firing any timers due before it.
+		// Returns false once the capture is exhausted or stop() was
+		// called.
+		bool step()
+		{
+			if (_stopped || !do_peek())
+				return false;
+			do_fire_timers(_pending._timestamp_ns);
+			if (_stopped)
+				return false;
+			do_pace(_pending._timestamp_ns);
+			do_advance(_pending._timestamp_ns);
+			_has_pending = false;
+			++_records;
+			_bytes += _pending._payload.size();
+			if (_pending._type == capture::RecordType::RAW)
+				_on_data(_pending._session_id, _pending._payload);
+			else
+				_on_event(_pending._session_id, _pending._payload);
+			return true;
+		}
+
+		// Play the whole capture. Timers due after the last record are
+		// left pending; use run_until() to play past the end.
+		void run()
+		{
+			while (step())
+			{
+			}
+		}
+
+		// Play records and timers up to and including end_ns, then move
+		// the clock to end_ns.
+		void run_until(std::int64_t end_ns)
+		{
+			while (!_stopped && do_peek() && _pending._timestamp_ns <= end_ns)
+				step();
+			if (_stopped)
+				return;
+			do_fire_timers(end_ns);
+			if (!_stopped && end_ns > now_ns())
+			{
+				do_pace(end_ns);
+				do_advance(end_ns);
+			}
+		}
+
+		// Stop from inside a callback; run() returns after the current
+		// delivery.
+		void stop() { _stopped = true; }
+
+		void resume() { _stopped = false; }
+
+		bool is_stopped() const { return _stopped; }
+
+		std::uint64_t records() const { return _records; }
+
+		std::uint64_t bytes() const { return _bytes; }
+
+		std::uint64_t timers_fired() const { return _timers_fired; }
+
+		std::size_t pending_timers() const { return _timer_callbacks.size(); }
+
+	private:
+		class timer_entry
+		{
+		public:
+			std::int64_t _due_ns;
+			std::uint64_t _id;
+			timer_entry(std::int64_t due_ns, std::uint64_t id)
+			    : _due_ns(due_ns)
+			    , _id(id)
+			{
+			}
+			bool operator>(const timer_entry &other) const
+			{
+				return _due_ns != other._due_ns ? _due_ns > other._due_ns
+				                                : _id > other._id;
+			}
+		};
+
+		OnDataCallBack _on_data;
+		OnEventCallBack _on_event;
+		capture::Reader _reader;
+		capture::Reader::Record _pending;
+		bool _has_pending;
+		std::priority_queue<timer_entry, std::vector<timer_entry>,
+		                    std::greater<timer_entry>>
+		    _timers;
+		std::unordered_map<std::uint64_t, OnTimerCallBack> _timer_callbacks;
+		std::uint64_t _next_timer_id;
+		PlaybackMode _mode;
+		double _speed;
+		timing::VirtualClock _clock;
+		std::int64_t _pace_virtual_ns;
+		std::chrono::steady_clock::time_point _pace_wall;
+		bool _stopped;
+		std::uint64_t _records;
+		std::uint64_t _bytes;
+		std::uint64_t _timers_fired;
+
+		bool do_open(bool opened)
+		{
+			_has_pending = false;
+			_clock.set(NO_TIME);
+			_pace_virtual_ns = NO_TIME;
+			_stopped = false;
+			return opened;
+		}
+
+		bool do_peek()
+		{
+			if (!_has_pending)
+				_has_pending = _reader.next(_pending);
+			return _has_pending;
+		}
+
+		void do_fire_timers(std::int64_t until_ns)
+		{
+			while (!_stopped && !_timers.empty() &&
+			       _timers.top()._due_ns <= until_ns)
+			{
+				auto entry = _timers.top();
+				_timers.pop();
+				auto it = _timer_callbacks.find(entry._id);
+				if (it == _timer_callbacks.end())
+					continue;
+				auto cb = std::move(it->second);
+				_timer_callbacks.erase(it);
+				do_pace(entry._due_ns);
+				do_advance(entry._due_ns);
+				++_timers_fired;
+				cb();
+			}
+		}
+
+		// Capture timestamps from different sessions can interleave out
+		// of order; the clock never goes back.
+		void do_advance(std::int64_t now_ns)
+		{
+			if (now_ns > _clock.now_ns())
+				_clock.set(now_ns);
+		}
+
+		// Hold back delivery until wall time catches up with virtual
+		// time scaled by the playback speed.
+		void do_pace(std::int64_t virtual_ns)
+		{
+			if (_mode == PlaybackMode::AS_FAST_AS_POSSIBLE)
+				return;
+			auto now = std::chrono::steady_clock::now();
+			if (_pace_virtual_ns == NO_TIME)
+			{
+				_pace_virtual_ns = virtual_ns;
+				_pace_wall = now;
+				return;
+			}
+			auto speed = _mode == PlaybackMode::SCALED ? _speed : 1.0;
+			auto offset = static_cast<std::int64_t>(
+			    static_cast<double>(virtual_ns - _pace_virtual_ns) / speed);
+			auto due = _pace_wall + std::chrono::nanoseconds(offset);
+			// Sleep through long gaps and spin the last stretch, where
+			// the scheduler would overshoot.
+			constexpr auto spin = std::chrono::microseconds(200);
+			if (due - now > spin)
+				std::this_thread::sleep_for(due - now - spin);
+			while (std::chrono::steady_clock::now() < due)
+			{
+			}
+		}
+	};
+} // namespace replay
+
+#endif // REPLAY_PLAYER_H
@@ -0,0 +1,399 @@
+#ifndef RISK_PRE_TRADE_GATE_H
+#define RISK_PRE_TRADE_GATE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace risk
+{
+	// Reasons an order is refused, as bits of the mask check() returns;
+	// 0 means it may go out.
+	enum class Reject : std::uint32_t
+	{
+		NONE = 0,
+		KILLED = 1u << 0,
+		UNKNOWN_SYMBOL = 1u << 1,
+		INVALID_ORDER = 1u << 2,
+		NO_REFERENCE = 1u << 3,
+		PRICE_BAND = 1u << 4,
+		ORDER_QTY = 1u << 5,
+		ORDER_NOTIONAL = 1u << 6,
+		MAX_NOTIONAL = 1u << 7,
+	};
+
+	// Why the kill flag is up, as bits.
+	enum class KillReason : std::uint32_t
+	{
+		NONE = 0,
+		MANUAL = 1u << 0,
+		PNL_STOP = 1u << 1,
+		MARGIN_STOP = 1u << 2,
+	};
+
+	inline bool has_reject(std::uint32_t mask, Reject reason)
+	{
+		return (mask & static_cast<std::uint32_t>(reason)) != 0;
+	}
+
+	inline const char *reject_name(Reject reason)
+	{
+		switch (reason)
+		{
+		case Reject::NONE:
+			return "none";
+		case Reject::KILLED:
+			return "killed";
+		case Reject::UNKNOWN_SYMBOL:
+			return "unknown_symbol";
+		case Reject::INVALID_ORDER:
+			return "invalid_order";
+		case Reject::NO_REFERENCE:
+			return "no_reference";
+		case Reject::PRICE_BAND:
+			return "price_band";
+		case Reject::ORDER_QTY:
+			return "order_qty";
+		case Reject::ORDER_NOTIONAL:
+			return "order_notional";
+		case Reject::MAX_NOTIONAL:
+			return "max_notional";
+		default:
+			return "unknown";
+		}
+	}
+
+	// Per-symbol limits (spec §4 symbols.*, §9 per-symbol bands).
+	class SymbolLimits
+	{
+	public:
+		// Worst-case |position| in USD, working orders included.
+		double _max_notional_usd;
+		// Fat-finger limits for a single order.
+		double _max_order_qty;
+		double _max_order_notional_usd;
+		// Largest distance of an order price from the reference price,
+		// in basis points.
+		double _price_band_bps;
+		SymbolLimits()
+		    : _max_notional_usd(0)
+		    , _max_order_qty(0)
+		    , _max_order_notional_usd(0)
+		    , _price_band_bps(0)
+		{
+		}
+	};
+
+	// Pre-trade checks for the order send path (spec §9): the kill flag,
+	// per-symbol max_notional including working orders, a price band
+	// around the reference price (Theo), and fat-finger size limits.
+	// check() evaluates every rule without branching and returns the
+	// mask of failed ones; call it right before the order's send().
+	//
+	// Quantities are signed, positive for buys. Exposure is the case the
+	// order adds to, long for a buy (position + working buys + order)
+	// and short for a sell (working sells - position + order), valued at
+	// the reference price, so working orders count as if they all fill.
+	// An order that flattens a position over its limit therefore passes.
+	//
+	// The per-symbol state belongs to the order thread. The kill flag is
+	// one atomic that any thread may raise: a manual kill(), or the PnL
+	// and margin-ratio stops fed through update_pnl() and
+	// update_margin_ratio() (spec §9 global kill and margin guard).
+	class PreTradeGate
+	{
+	public:
+		static constexpr std::uint32_t NO_SYMBOL =
+		    std::numeric_limits<std::uint32_t>::max();
+
+	public:
+		explicit PreTradeGate(std::size_t max_symbols)
+		    : _max_symbols(max_symbols)
+		    , _symbols(std::make_unique<symbol_state[]>(max_symbols + 1))
+		    , _symbol_names()
+		    , _symbol_ids()
+		    , _kill(0)
+		    , _pnl_stop_usd(-std::numeric_limits<double>::infinity())
+		    , _margin_ratio_stop(std::numeric_limits<double>::infinity())
+		{
+			_symbol_names.reserve(max_symbols);
+		}
+
+		PreTradeGate(const PreTradeGate &) = delete;
+
+		PreTradeGate &operator=(const PreTradeGate &) = delete;
+
+		// NO_SYMBOL once max_symbols are taken. A symbol's limits start
+		// at zero, so it refuses every order until set_limits() and
+		// set_reference_price().
+		std::uint32_t add_symbol(const std::string &name)
+		{
+			auto it = _symbol_ids.find(name);
+			if (it != _symbol_ids.end())
+				return it->second;
+			if (_symbol_names.size() >= _max_symbols)
+				return NO_SYMBOL;
+			auto id = static_cast<std::uint32_t>(_symbol_names.size());
+			_symbol_names.push_back(name);
+			_symbol_ids.emplace(name, id);
+			return id;
+		}
+
+		std::uint32_t symbol_id(const std::string &name) const
+		{
+			auto it = _symbol_ids.find(name);
+			return it == _symbol_ids.end() ? NO_SYMBOL : it->second;
+		}
+
+		std::size_t symbol_count() const { return _symbol_names.size(); }
+
+		const std::string &symbol_name(std::uint32_t symbol) const
+		{
+			return _symbol_names[symbol];
+		}
+
+		// The setters and position updates below ignore ids that
+		// add_symbol() did not hand out and return false for them.
+		bool set_limits(std::uint32_t symbol, const SymbolLimits &limits)
+		{
+			if (!is_known(symbol))
+				return false;
+			auto &state = _symbols[symbol];
+			state._max_notional_usd = limits._max_notional_usd;
+			state._max_order_qty = limits._max_order_qty;
+			state._max_order_notional_usd = limits._max_order_notional_usd;
+			state._band = limits._price_band_bps * 1e-4;
+			return true;
+		}
+
+		// Theo, or another fair price the band and exposure use.
+		bool set_reference_price(std::uint32_t symbol, double price)
+		{
+			if (!is_known(symbol))
+				return false;
+			_symbols[symbol]._reference_price = price;
+			return true;
+		}
+
+		// Global stops (spec §4 risk.global_pnl_stop and
+		// risk.global_margin_ratio_stop).
+		void set_global_stops(double pnl_stop_usd, double margin_ratio_stop)
+		{
+			_pnl_stop_usd.store(pnl_stop_usd, std::memory_order_relaxed);
+			_margin_ratio_stop.store(margin_ratio_stop,
+			                         std::memory_order_relaxed);
+		}
+
+		// Mask of the Reject bits the order fails, 0 if it may go out.
+		std::uint32_t check(std::uint32_t symbol, double quantity,
+		                    double price) const
+		{
+			// Unknown ids land on the spare last entry, whose limits stay
+			// zero.
+			auto index = do_index(symbol);
+			auto &state = _symbols[index];
+			auto reference = state._reference_price;
+			auto size = std::fabs(quantity);
+			auto buy = std::max(quantity, 0.0);
+			auto sell = std::max(-quantity, 0.0);
+			auto long_side = state._position + state._working_buy + buy;
+			auto short_side = state._working_sell + sell - state._position;
+			// Select the side by multiplying, not branching.
+			auto is_buy = static_cast<double>(quantity > 0);
+			auto exposure =
+			    (is_buy * long_side + (1 - is_buy) * short_side) * reference;
+			// Written as !(value <= limit) so that NaN fails too.
+			std::uint32_t mask = 0;
+			mask |= bit(_kill.load(std::memory_order_relaxed) != 0,
+			            Reject::KILLED);
+			mask |= bit(index == _max_symbols, Reject::UNKNOWN_SYMBOL);
+			mask |= bit(!(size > 0) | !(price > 0), Reject::INVALID_ORDER);
+			mask |= bit(!(reference > 0), Reject::NO_REFERENCE);
+			mask |= bit(!(std::fabs(price - reference) <=
+			              state._band * reference),
+			            Reject::PRICE_BAND);
+			mask |= bit(!(size <= state._max_order_qty), Reject::ORDER_QTY);
+			mask |= bit(!(size * price <= state._max_order_notional_usd),
+			            Reject::ORDER_NOTIONAL);
+			mask |= bit(!(exposure <= state._max_notional_usd),
+			            Reject::MAX_NOTIONAL);
+			return mask;
+		}
+
+		// check(), and on success count the order as working.
+		std::uint32_t submit(std::uint32_t symbol, double quantity,
+		                     double price)
+		{
+			auto mask = check(symbol, quantity, price);
+			if (mask == 0)
+			{
+				auto &state = _symbols[symbol];
+				state._working_buy += std::max(quantity, 0.0);
+				state._working_sell += std::max(-quantity, 0.0);
+			}
+			return mask;
+		}
+
+		// A working order filled quantity (signed).
+		bool on_fill(std::uint32_t symbol, double quantity)
+		{
+			if (!is_known(symbol))
+				return false;
+			auto &state = _symbols[symbol];
+			state._position += quantity;
+			do_release(state, quantity);
+			return true;
+		}
+
+		// A working order left the book with quantity (signed) unfilled:
+		// cancelled, expired or rejected by the venue.
+		bool on_done(std::uint32_t symbol, double quantity)
+		{
+			if (!is_known(symbol))
+				return false;
+			do_release(_symbols[symbol], quantity);
+			return true;
+		}
+
+		// Resynchronise with the venue's position and open orders.
+		bool set_exposure(std::uint32_t symbol, double position,
+		                  double working_buy, double working_sell)
+		{
+			if (!is_known(symbol))
+				return false;
+			auto &state = _symbols[symbol];
+			state._position = position;
+			state._working_buy = working_buy;
+			state._working_sell = working_sell;
+			return true;
+		}
+
+		// Zero for unknown ids.
+		double position(std::uint32_t symbol) const
+		{
+			return _symbols[do_index(symbol)]._position;
+		}
+
+		double working_buy(std::uint32_t symbol) const
+		{
+			return _symbols[do_index(symbol)]._working_buy;
+		}
+
+		double working_sell(std::uint32_t symbol) const
+		{
+			return _symbols[do_index(symbol)]._working_sell;
+		}
+
+		// Any thread.
+		void kill(KillReason reason = KillReason::MANUAL)
+		{
+			_kill.fetch_or(static_cast<std::uint32_t>(reason),
+			               std::memory_order_relaxed);
+		}
+
+		// Any thread; lowers the flag for every reason.
+		void reset_kill() { _kill.store(0, std::memory_order_relaxed); }
+
+		bool killed() const
+		{
+			return _kill.load(std::memory_order_relaxed) != 0;
+		}
+
+		// Mask of KillReason bits.
+		std::uint32_t kill_reasons() const
+		{
+			return _kill.load(std::memory_order_relaxed);
+		}
+
+		// Any thread, e.g. the task watching pnl_realised_24h. Raises the
+		// kill flag below the PnL stop; returns true if it did.
+		bool update_pnl(double realised_24h_usd)
+		{
+			if (!(realised_24h_usd <
+			      _pnl_stop_usd.load(std::memory_order_relaxed)))
+				return false;
+			kill(KillReason::PNL_STOP);
+			return true;
+		}
+
+		// Any thread, e.g. the 500 ms margin poll. Raises the kill flag
+		// above the margin-ratio stop; returns true if it did.
+		bool update_margin_ratio(double margin_ratio)
+		{
+			if (!(margin_ratio >
+			      _margin_ratio_stop.load(std::memory_order_relaxed)))
+				return false;
+			kill(KillReason::MARGIN_STOP);
+			return true;
+		}
+
+	private:
+		// Everything check() reads for a symbol, on one cache line.
+		class alignas(64) symbol_state
+		{
+		public:
+			double _reference_price;
+			double _band;
+			double _max_order_qty;
+			double _max_order_notional_usd;
+			double _max_notional_usd;
+			double _position;
+			double _working_buy;
+			double _working_sell;
+			symbol_state()
+			    : _reference_price(0)
+			    , _band(0)
+			    , _max_order_qty(0)
+			    , _max_order_notional_usd(0)
+			    , _max_notional_usd(0)
+			    , _position(0)
+			    , _working_buy(0)
+			    , _working_sell(0)
+			{
+			}
+		};
+
+		std::size_t _max_symbols;
+		// One spare entry past max_symbols for unknown ids.
+		std::unique_ptr<symbol_state[]> _symbols;
+		std::vector<std::string> _symbol_names;
+		std::unordered_map<std::string, std::uint32_t> _symbol_ids;
+		alignas(64) std::atomic<std::uint32_t> _kill;
+		std::atomic<double> _pnl_stop_usd;
+		std::atomic<double> _margin_ratio_stop;
+
+		static std::uint32_t bit(bool failed, Reject reason)
+		{
+			return static_cast<std::uint32_t>(failed) *
+			       static_cast<std::uint32_t>(reason);
+		}
+
+		bool is_known(std::uint32_t symbol) const
+		{
+			return symbol < _symbol_names.size();
+		}
+
+		// Unknown ids map to the spare last entry, which stays zero.
+		std::size_t do_index(std::uint32_t symbol) const
+		{
+			return is_known(symbol) ? symbol : _max_symbols;
+		}
+
+		static void do_release(symbol_state &state, double quantity)
+		{
+			state._working_buy =
+			    std::max(state._working_buy - std::max(quantity, 0.0), 0.0);
+			state._working_sell =
+			    std::max(state._working_sell - std::max(-quantity, 0.0), 0.0);
+		}
+	};
+} // namespace risk
+
+#endif // RISK_PRE_TRADE_GATE_H
@@ -0,0 +1,184 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <risk/PreTradeGate.hpp>
+#include <string>
+#include <timing/TscClock.hpp>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Cost the gate adds to each order, against its 50 ns budget. Orders
+// spread over every symbol so each check pulls a different line, and
+// alternate side so both exposure cases run. Every call is timed on its
+// own with the TSC clock, fenced, less the median cost of an empty clock pair,
+// so the percentiles are per call. Exits 1 when a p99 is over budget.
+
+using namespace risk;
+
+static constexpr std::size_t SYMBOLS = 512;
+static constexpr std::int64_t BUDGET_NS = 50;
+
+// Keeps the compiler from moving the value's computation across the
+// clock reads around it.
+template <typename T>
+static void keep(T &value)
+{
+	asm volatile("" : "+r,m"(value) : : "memory");
+}
+
+// rdtscp waits for the work before it but not the work after, so the
+// call must not start until the first read is done.
+static std::int64_t start_ns(const timing::TscClock &clock)
+{
+	auto ns = clock.now_ns();
+#if defined(__x86_64__) || defined(__i386__)
+	_mm_lfence();
+#endif
+	return ns;
+}
+
+class call_times
+{
+public:
+	std::vector<std::int64_t> _ns;
+	std::int64_t _overhead_ns;
+	call_times(std::size_t calls, std::int64_t overhead_ns)
+	    : _ns()
+	    , _overhead_ns(overhead_ns)
+	{
+		_ns.reserve(calls);
+	}
+
+	void add(std::int64_t from, std::int64_t to)
+	{
+		_ns.push_back(std::max<std::int64_t>(to - from - _overhead_ns, 0));
+	}
+
+	// Reports the figures and whether p99 fits the budget.
+	bool report(const char *name)
+	{
+		double total = 0;
+		for (auto ns : _ns)
+			total += static_cast<double>(ns);
+		std::sort(_ns.begin(), _ns.end());
+		auto p99 = _ns[_ns.size() * 99 / 100];
+		std::cout << name << ": mean "
+		          << total / static_cast<double>(_ns.size()) << " ns, p50 "
+		          << _ns[_ns.size() / 2] << " ns, p99 " << p99
+		          << " ns, p99.9 " << _ns[_ns.size() * 999 / 1000]
+		          << " ns, max " << _ns.back() << " ns over " << _ns.size()
+		          << " calls" << std::endl;
+		return p99 < BUDGET_NS;
+	}
+};
+
+static std::uint32_t symbol_of(std::size_t i)
+{
+	return static_cast<std::uint32_t>((i * 2654435761u) % SYMBOLS);
+}
+
+static double quantity_of(std::size_t i) { return i & 1 ? 1.0 : -1.0; }
+
+// Median of back-to-back clock reads with nothing between them.
+static std::int64_t clock_overhead(const timing::TscClock &clock)
+{
+	std::vector<std::int64_t> ns(100000);
+	for (auto &sample : ns)
+	{
+		auto from = start_ns(clock);
+		keep(from);
+		sample = clock.now_ns() - from;
+	}
+	std::sort(ns.begin(), ns.end());
+	return ns[ns.size() / 2];
+}
+
+int main(int argc, const char **argv)
+{
+	std::size_t calls =
+	    argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 2000000;
+	PreTradeGate gate(SYMBOLS);
+	SymbolLimits limits;
+	limits._max_notional_usd = 1e12;
+	limits._max_order_qty = 1e9;
+	limits._max_order_notional_usd = 1e12;
+	limits._price_band_bps = 500;
+	for (std::size_t i = 0; i < SYMBOLS; ++i)
+	{
+		std::string name("S");
+		name += std::to_string(i);
+		auto symbol = gate.add_symbol(name);
+		gate.set_limits(symbol, limits);
+		gate.set_reference_price(symbol, 100.0 + static_cast<double>(i));
+	}
+
+	timing::TscClock clock;
+	auto overhead = clock_overhead(clock);
+	std::cout << "clock pair " << overhead << " ns, "
+	          << (clock.is_tsc() ? "tsc" : "CLOCK_MONOTONIC") << std::endl;
+
+	std::uint32_t rejects = 0;
+	call_times check(calls, overhead);
+	call_times submit(calls, overhead);
+	call_times killed(calls, overhead);
+	std::size_t n = 0;
+	for (std::size_t i = 0; i < calls; ++i, ++n)
+	{
+		auto symbol = symbol_of(n);
+		auto quantity = quantity_of(n);
+		auto price = 100.0 + symbol + static_cast<double>(n & 3);
+		auto from = start_ns(clock);
+		keep(quantity);
+		auto mask = gate.check(symbol, quantity, price);
+		keep(mask);
+		check.add(from, clock.now_ns());
+		rejects |= mask;
+	}
+	// on_done() runs off the clock, as it is not on the send path; it
+	// keeps the working orders flat.
+	for (std::size_t i = 0; i < calls; ++i, ++n)
+	{
+		auto symbol = symbol_of(n);
+		auto quantity = quantity_of(n);
+		auto price = 100.0 + symbol;
+		auto from = start_ns(clock);
+		keep(quantity);
+		auto mask = gate.submit(symbol, quantity, price);
+		keep(mask);
+		submit.add(from, clock.now_ns());
+		rejects |= mask;
+		gate.on_done(symbol, quantity);
+	}
+	// Every order refused; the mask must cost the same.
+	gate.kill();
+	std::uint32_t killed_mask = ~0u;
+	for (std::size_t i = 0; i < calls; ++i, ++n)
+	{
+		auto symbol = symbol_of(n);
+		auto quantity = quantity_of(n);
+		auto price = 100.0 + symbol;
+		auto from = start_ns(clock);
+		keep(quantity);
+		auto mask = gate.check(symbol, quantity, price);
+		keep(mask);
+		killed.add(from, clock.now_ns());
+		killed_mask &= mask;
+	}
+
+	auto ok = check.report("check");
+	ok &= submit.report("submit");
+	ok &= killed.report("check, killed");
+	if (rejects != 0 ||
+	    killed_mask != static_cast<std::uint32_t>(Reject::KILLED))
+	{
+		std::cout << "unexpected rejects " << rejects << ", killed mask "
+		          << killed_mask << std::endl;
+		return 1;
+	}
+	std::cout << (ok ? "within" : "over") << " the " << BUDGET_NS
+	          << " ns budget at p99" << std::endl;
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,378 @@
+#ifndef SCHEMA_CODEC_H
+#define SCHEMA_CODEC_H
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <logging/LogRecord.hpp>
+#include <span>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace schema
+{
+	// Wire format of an internal message: a MessageHeader, then a fixed
+	// block with every field at a compile-time offset, packed, little
+	// endian. _block_length is the block size the writer's version had;
+	// fields are only ever appended, so a reader skips a longer block's
+	// tail and reads fields past a shorter block's end as zero.
+	class MessageHeader
+	{
+	public:
+		std::uint16_t _block_length;
+		std::uint16_t _template_id;
+		std::uint16_t _schema_id;
+		std::uint16_t _version;
+	};
+	static_assert(sizeof(MessageHeader) == 8);
+
+	// Fixed-width text, zero padded; reads back without the padding.
+	template <std::size_t N>
+	class Chars
+	{
+	public:
+		char _data[N];
+	};
+
+	// A string literal usable as a template argument, for field names.
+	template <std::size_t N>
+	class FixedString
+	{
+	public:
+		char _text[N];
+
+		constexpr FixedString(const char (&text)[N])
+		{
+			std::copy_n(text, N, _text);
+		}
+
+		constexpr std::string_view view() const
+		{
+			return std::string_view(_text, N - 1);
+		}
+	};
+
+	template <typename T>
+	constexpr bool is_chars = false;
+
+	template <std::size_t N>
+	constexpr bool is_chars<Chars<N>> = true;
+
+	template <typename T>
+	concept FieldType =
+	    std::is_arithmetic_v<T> || std::is_enum_v<T> || is_chars<T>;
+
+	// since is the schema version that added the field.
+	template <FixedString Name, FieldType T, std::uint16_t Since = 1>
+	class Field
+	{
+	public:
+		using type = T;
+		static constexpr auto NAME = Name;
+		static constexpr std::uint16_t SINCE = Since;
+	};
+
+	// Field layout of a message, computed at compile time.
+	template <typename... Fields>
+	class FieldList
+	{
+	public:
+		static constexpr std::size_t COUNT = sizeof...(Fields);
+
+		static constexpr std::array<std::size_t, COUNT> OFFSETS = []()
+		{
+			std::array<std::size_t, COUNT> offsets{};
+			std::array<std::size_t, COUNT> sizes{
+			    sizeof(typename Fields::type)...};
+			std::size_t offset = 0;
+			for (std::size_t i = 0; i < COUNT; ++i)
+			{
+				offsets[i] = offset;
+				offset += sizes[i];
+			}
+			return offsets;
+		}();
+
+		static constexpr std::size_t BLOCK_LENGTH =
+		    (std::size_t(0) + ... + sizeof(typename Fields::type));
+
+		template <std::size_t I>
+		using field = std::tuple_element_t<I, std::tuple<Fields...>>;
+
+		// COUNT if there is no such field.
+		static constexpr std::size_t find(std::string_view name)
+		{
+			std::array<std::string_view, COUNT> names{Fields::NAME.view()...};
+			for (std::size_t i = 0; i < COUNT; ++i)
+				if (names[i] == name)
+					return i;
+			return COUNT;
+		}
+
+		template <FixedString Name>
+		static constexpr std::size_t index_of()
+		{
+			constexpr auto index = find(Name.view());
+			static_assert(index < COUNT, "no such field in the message");
+			return index;
+		}
+	};
+
+	// A message type: SCHEMA_ID, TEMPLATE_ID, VERSION, NAME and a
+	// FieldList called fields.
+	template <typename M>
+	concept Message = requires {
+		{ M::SCHEMA_ID } -> std::convertible_to<std::uint16_t>;
+		{ M::TEMPLATE_ID } -> std::convertible_to<std::uint16_t>;
+		{ M::VERSION } -> std::convertible_to<std::uint16_t>;
+		{ M::NAME } -> std::convertible_to<const char *>;
+		M::fields::COUNT;
+	};
+
+	// Bytes an encoded M takes.
+	template <Message M>
+	constexpr std::size_t encoded_size()
+	{
+		return sizeof(MessageHeader) + M::fields::BLOCK_LENGTH;
+	}
+
+	template <typename T>
+	T load_le(const char *src)
+	{
+		T value;
+		std::memcpy(&value, src, sizeof(T));
+		if constexpr (std::endian::native == std::endian::big &&
+		              sizeof(T) > 1 && !is_chars<T>)
+		{
+			char bytes[sizeof(T)];
+			std::memcpy(bytes, &value, sizeof(T));
+			std::reverse(bytes, bytes + sizeof(T));
+			std::memcpy(&value, bytes, sizeof(T));
+		}
+		return value;
+	}
+
+	template <typename T>
+	void store_le(char *dst, const T &value)
+	{
+		std::memcpy(dst, &value, sizeof(T));
+		if constexpr (std::endian::native == std::endian::big &&
+		              sizeof(T) > 1 && !is_chars<T>)
+			std::reverse(dst, dst + sizeof(T));
+	}
+
+	// Template id of an encoded message, 0 if data is too short. Lets a
+	// consumer of a mixed stream pick the view to use.
+	inline std::uint16_t template_id(std::span<const char> data)
+	{
+		if (data.size() < sizeof(MessageHeader))
+			return 0;
+		return load_le<std::uint16_t>(
+		    data.data() + offsetof(MessageHeader, _template_id));
+	}
+
+	// Zero-copy reader over an encoded M. get<"name">() is a bounds check
+	// and a load at a constant offset. Chars fields come back as a
+	// string_view into data, valid as long as data is.
+	template <Message M>
+	class MessageView
+	{
+	public:
+		using fields = typename M::fields;
+
+		explicit MessageView(std::span<const char> data)
+		    : _data()
+		    , _block_length(0)
+		    , _version(0)
+		{
+			if (data.size() < sizeof(MessageHeader))
+				return;
+			auto block_length = load_le<std::uint16_t>(
+			    data.data() + offsetof(MessageHeader, _block_length));
+			if (load_le<std::uint16_t>(data.data() + offsetof(
+			                               MessageHeader, _template_id)) !=
+			        M::TEMPLATE_ID ||
+			    load_le<std::uint16_t>(data.data() + offsetof(
+			                               MessageHeader, _schema_id)) !=
+			        M::SCHEMA_ID ||
+			    data.size() - sizeof(MessageHeader) < block_length)
+				return;
+			_data = data.first(sizeof(MessageHeader) + block_length);
+			_block_length = block_length;
+			_version = load_le<std::uint16_t>(
+			    data.data() + offsetof(MessageHeader, _version));
+		}
+
+		// False if data is short or holds another message.
+		bool valid() const { return !_data.empty(); }
+
+		std::uint16_t version() const { return _version; }
+
+		// Encoded size, to step to the next message in a buffer.
+		std::size_t size() const { return _data.size(); }
+
+		template <FixedString Name>
+		auto get() const
+		{
+			constexpr auto index = fields::template index_of<Name>();
+			return get_at<index>();
+		}
+
+		template <std::size_t I>
+		auto get_at() const
+		{
+			using F = typename fields::template field<I>;
+			using T = typename F::type;
+			constexpr auto offset = fields::OFFSETS[I];
+			bool present = _version >= F::SINCE &&
+			               offset + sizeof(T) <= _block_length;
+			if constexpr (is_chars<T>)
+			{
+				if (!present)
+					return std::string_view();
+				auto src = _data.data() + sizeof(MessageHeader) + offset;
+				auto end = static_cast<const char *>(
+				    std::memchr(src, '\0', sizeof(T)));
+				return std::string_view(
+				    src, end ? static_cast<std::size_t>(end - src)
+				             : sizeof(T));
+			}
+			else
+			{
+				if (!present)
+					return T{};
+				return load_le<T>(_data.data() + sizeof(MessageHeader) +
+				                  offset);
+			}
+		}
+
+	private:
+		std::span<const char> _data;
+		std::uint16_t _block_length;
+		std::uint16_t _version;
+	};
+
+	// Writes an M into a caller buffer of at least encoded_size<M>()
+	// bytes: the header up front, unset fields zero.
+	template <Message M>
+	class MessageEncoder
+	{
+	public:
+		using fields = typename M::fields;
+
+		explicit MessageEncoder(std::span<char> buffer)
+		    : _data()
+		{
+			if (buffer.size() < encoded_size<M>())
+				return;
+			_data = buffer.first(encoded_size<M>());
+			MessageHeader header;
+			header._block_length =
+			    static_cast<std::uint16_t>(fields::BLOCK_LENGTH);
+			header._template_id = M::TEMPLATE_ID;
+			header._schema_id = M::SCHEMA_ID;
+			header._version = M::VERSION;
+			auto out = _data.data();
+			store_le(out + offsetof(MessageHeader, _block_length),
+			         header._block_length);
+			store_le(out + offsetof(MessageHeader, _template_id),
+			         header._template_id);
+			store_le(out + offsetof(MessageHeader, _schema_id),
+			         header._schema_id);
+			store_le(out + offsetof(MessageHeader, _version), header._version);
+			std::memset(out + sizeof(MessageHeader), 0, fields::BLOCK_LENGTH);
+		}
+
+		// False if the buffer was too small; set() is then a no-op.
+		bool valid() const { return !_data.empty(); }
+
+		// Chars fields take text and cut it at their width.
+		template <FixedString Name, typename V>
+		MessageEncoder &set(const V &value)
+		{
+			constexpr auto index = fields::template index_of<Name>();
+			using T = typename fields::template field<index>::type;
+			if (_data.empty())
+				return *this;
+			auto dst = _data.data() + sizeof(MessageHeader) +
+			           fields::OFFSETS[index];
+			if constexpr (is_chars<T>)
+			{
+				std::string_view text(value);
+				auto length = std::min(text.size(), sizeof(T));
+				std::memcpy(dst, text.data(), length);
+				std::memset(dst + length, 0, sizeof(T) - length);
+			}
+			else
+				store_le(dst, static_cast<T>(value));
+			return *this;
+		}
+
+		std::span<const char> bytes() const { return _data; }
+
+	private:
+		std::span<char> _data;
+	};
+
+	// Stack storage for one encoded M.
+	template <Message M>
+	using MessageBuffer = std::array<char, encoded_size<M>()>;
+
+	template <Message M, std::size_t I>
+	void do_render_field(std::string &out, const MessageView<M> &view)
+	{
+		using F = typename M::fields::template field<I>;
+		using T = typename F::type;
+		out += ',';
+		logging::append_json_string(out, F::NAME.view());
+		out += ':';
+		auto value = view.template get_at<I>();
+		if constexpr (is_chars<T>)
+			logging::append_json_string(out, value);
+		else if constexpr (std::is_enum_v<T>)
+			logging::append_number(
+			    out, static_cast<std::underlying_type_t<T>>(value));
+		else if constexpr (std::is_same_v<T, bool>)
+			out += value ? "true" : "false";
+		else if constexpr (std::is_floating_point_v<T>)
+		{
+			// JSON has no NaN or infinity.
+			if (value != value || value - value != 0)
+				out += "null";
+			else
+				logging::append_number(out, value);
+		}
+		else
+			logging::append_number(out, value);
+	}
+
+	// JSON for humans and debugging tools, not for the hot path:
+	// {"type":<NAME>,"version":..,<field>:<value>,...}. Returns false
+	// if data does not hold an M.
+	template <Message M>
+	bool render_json(std::string &out, std::span<const char> data)
+	{
+		MessageView<M> view(data);
+		if (!view.valid())
+			return false;
+		out += "{\"type\":";
+		logging::append_json_string(out, M::NAME);
+		out += ",\"version\":";
+		logging::append_number(out, view.version());
+		[&]<std::size_t... I>(std::index_sequence<I...>)
+		{
+			(do_render_field<M, I>(out, view), ...);
+		}(std::make_index_sequence<M::fields::COUNT>());
+		out += '}';
+		return true;
+	}
+} // namespace schema
+
+#endif // SCHEMA_CODEC_H
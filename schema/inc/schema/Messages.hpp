@@ -0,0 +1,107 @@
+#ifndef SCHEMA_MESSAGES_H
+#define SCHEMA_MESSAGES_H
+
+#include <cstdint>
+#include <schema/Codec.hpp>
+
+namespace schema
+{
+	// Messages between the funding-arb and MM services (spec §2), sent
+	// on the fills, position_state and control channels. Add fields at
+	// the end only, with the version that introduced them, and bump
+	// VERSION; never reorder or resize existing ones.
+	constexpr std::uint16_t SERVICE_SCHEMA_ID = 1;
+
+	using Symbol = Chars<16>;
+	using VenueName = Chars<12>;
+
+	enum class Side : std::uint8_t
+	{
+		BUY = 0,
+		SELL = 1,
+	};
+
+	enum class Liquidity : std::uint8_t
+	{
+		MAKER = 0,
+		TAKER = 1,
+	};
+
+	enum class ControlCommand : std::uint8_t
+	{
+		NONE = 0,
+		DISABLE_ALL = 1,
+		ENABLE_ALL = 2,
+		PAUSE_SYMBOL = 3,
+		RESUME_SYMBOL = 4,
+		// value is the spread multiplier (spec §6 manual override).
+		SPREAD_OVERRIDE = 5,
+	};
+
+	class Fill
+	{
+	public:
+		static constexpr std::uint16_t SCHEMA_ID = SERVICE_SCHEMA_ID;
+		static constexpr std::uint16_t TEMPLATE_ID = 1;
+		static constexpr std::uint16_t VERSION = 1;
+		static constexpr const char *NAME = "fill";
+		using fields = FieldList<Field<"ts_ns", std::int64_t>,
+		                         Field<"trace_id", std::uint64_t>,
+		                         Field<"order_id", std::uint64_t>,
+		                         Field<"price", double>,
+		                         Field<"qty", double>,
+		                         Field<"fee_usd", double>,
+		                         Field<"symbol", Symbol>,
+		                         Field<"venue", VenueName>,
+		                         Field<"side", Side>,
+		                         Field<"liquidity", Liquidity>,
+		                         Field<"is_hedge", bool>>;
+	};
+
+	class PositionState
+	{
+	public:
+		static constexpr std::uint16_t SCHEMA_ID = SERVICE_SCHEMA_ID;
+		static constexpr std::uint16_t TEMPLATE_ID = 2;
+		static constexpr std::uint16_t VERSION = 1;
+		static constexpr const char *NAME = "position_state";
+		using fields = FieldList<Field<"ts_ns", std::int64_t>,
+		                         Field<"position", double>,
+		                         Field<"avg_price", double>,
+		                         Field<"notional_usd", double>,
+		                         Field<"symbol", Symbol>,
+		                         Field<"venue", VenueName>>;
+	};
+
+	class Control
+	{
+	public:
+		static constexpr std::uint16_t SCHEMA_ID = SERVICE_SCHEMA_ID;
+		static constexpr std::uint16_t TEMPLATE_ID = 3;
+		static constexpr std::uint16_t VERSION = 1;
+		static constexpr const char *NAME = "control";
+		using fields = FieldList<Field<"ts_ns", std::int64_t>,
+		                         Field<"value", double>,
+		                         Field<"symbol", Symbol>,
+		                         Field<"cmd", ControlCommand>>;
+	};
+
+	// JSON of any service message, for logs and debugging tools.
+	inline bool render_service_json(std::string &out,
+	                                std::span<const char> data)
+	{
+		switch (template_id(data))
+		{
+		case Fill::TEMPLATE_ID:
+			return render_json<Fill>(out, data);
+		case PositionState::TEMPLATE_ID:
+			return render_json<PositionState>(out, data);
+		case Control::TEMPLATE_ID:
+			return render_json<Control>(out, data);
+		default:
+			return false;
+		}
+	}
+} // namespace schema
+
+#endif // SCHEMA_MESSAGES_H
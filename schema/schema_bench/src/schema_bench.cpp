@@ -0,0 +1,222 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <schema/Codec.hpp>
+#include <schema/Messages.hpp>
+#include <string_view>
+#include <vector>
+
+// Fill through the binary codec against the JSON text it replaces,
+// written with snprintf and read back with strtoll/strtod. Encode and
+// decode are timed apart over a batch of fills, so every decode reads a
+// message that is not in registers already. Each phase runs PASSES
+// times and reports the median pass, per message.
+
+using namespace schema;
+using Clock = std::chrono::steady_clock;
+
+static constexpr std::size_t BATCH = 1024;
+static constexpr std::size_t ROUNDS = 400;
+static constexpr std::size_t PASSES = 5;
+static constexpr std::size_t TEXT_SIZE = 256;
+
+class fill_input
+{
+public:
+	std::int64_t _ts_ns;
+	std::uint64_t _trace_id;
+	std::uint64_t _order_id;
+	double _price;
+	double _qty;
+	double _fee_usd;
+	const char *_symbol;
+	const char *_venue;
+	Side _side;
+	Liquidity _liquidity;
+	bool _is_hedge;
+	fill_input()
+	    : _ts_ns(0)
+	    , _trace_id(0)
+	    , _order_id(0)
+	    , _price(0)
+	    , _qty(0)
+	    , _fee_usd(0)
+	    , _symbol("")
+	    , _venue("")
+	    , _side(Side::BUY)
+	    , _liquidity(Liquidity::MAKER)
+	    , _is_hedge(false)
+	{
+	}
+};
+
+// Keeps the compiler from dropping stores no later code reads.
+static void keep_memory(void *data)
+{
+	asm volatile("" : : "r"(data) : "memory");
+}
+
+// Median over PASSES of phase(round) for ROUNDS rounds, per message,
+// after one pass to warm the caches and the clock speed.
+template <typename F>
+static double per_message_ns(F &&phase)
+{
+	for (std::size_t round = 0; round < ROUNDS; ++round)
+		phase(round);
+	std::array<double, PASSES> ns;
+	for (auto &pass : ns)
+	{
+		auto start = Clock::now();
+		for (std::size_t round = 0; round < ROUNDS; ++round)
+			phase(round);
+		pass = std::chrono::duration<double, std::nano>(Clock::now() - start)
+		           .count() /
+		       static_cast<double>(BATCH * ROUNDS);
+	}
+	std::sort(ns.begin(), ns.end());
+	return ns[PASSES / 2];
+}
+
+// Value following "key": in text.
+static const char *json_value(const char *text, const char *key)
+{
+	auto at = std::strstr(text, key);
+	return at ? at + std::strlen(key) + 2 : text;
+}
+
+static std::string_view json_text(const char *text, const char *key)
+{
+	auto begin = json_value(text, key) + 1;
+	auto end = std::strchr(begin, '"');
+	return std::string_view(begin, end ? end - begin : 0);
+}
+
+int main(int, const char **)
+{
+	std::vector<fill_input> inputs(BATCH);
+	const char *symbols[] = {"BTC", "ETH", "SOL", "HYPE"};
+	const char *venues[] = {"Hyperliquid", "Bybit", "Binance", "OKX"};
+	for (std::size_t i = 0; i < BATCH; ++i)
+	{
+		auto &in = inputs[i];
+		in._ts_ns = 1700000000000000000 + static_cast<std::int64_t>(i);
+		in._trace_id = i * 7919;
+		in._order_id = 1000000 + i;
+		in._price = 65000.5 + static_cast<double>(i) * 0.25;
+		in._qty = 0.001 * static_cast<double>(i % 97 + 1);
+		in._fee_usd = in._price * in._qty * 0.00025;
+		in._symbol = symbols[i % 4];
+		in._venue = venues[(i / 4) % 4];
+		in._side = i % 2 ? Side::SELL : Side::BUY;
+		in._liquidity = i % 3 ? Liquidity::MAKER : Liquidity::TAKER;
+		in._is_hedge = i % 5 == 0;
+	}
+
+	std::vector<MessageBuffer<Fill>> binary(BATCH);
+	std::vector<char> text(BATCH * TEXT_SIZE);
+	std::size_t text_bytes = 0;
+	double sink = 0;
+
+	auto binary_encode_ns = per_message_ns(
+	    [&](std::size_t round)
+	    {
+		    for (std::size_t i = 0; i < BATCH; ++i)
+		    {
+			    auto &in = inputs[i];
+			    MessageEncoder<Fill>(binary[i])
+			        .set<"ts_ns">(in._ts_ns + static_cast<std::int64_t>(round))
+			        .set<"trace_id">(in._trace_id)
+			        .set<"order_id">(in._order_id)
+			        .set<"price">(in._price)
+			        .set<"qty">(in._qty)
+			        .set<"fee_usd">(in._fee_usd)
+			        .set<"symbol">(in._symbol)
+			        .set<"venue">(in._venue)
+			        .set<"side">(in._side)
+			        .set<"liquidity">(in._liquidity)
+			        .set<"is_hedge">(in._is_hedge);
+			    keep_memory(&binary[i]);
+		    }
+	    });
+
+	auto binary_decode_ns = per_message_ns(
+	    [&](std::size_t)
+	    {
+		    for (std::size_t i = 0; i < BATCH; ++i)
+		    {
+			    keep_memory(&binary[i]);
+			    MessageView<Fill> view(binary[i]);
+			    sink += view.get<"price">() * view.get<"qty">() +
+			            view.get<"fee_usd">() +
+			            static_cast<double>(view.get<"ts_ns">() +
+			                                view.get<"order_id">()) +
+			            static_cast<double>(view.get<"symbol">().size() +
+			                                view.get<"venue">().size()) +
+			            static_cast<double>(view.get<"side">() == Side::SELL);
+		    }
+	    });
+
+	auto text_encode_ns = per_message_ns(
+	    [&](std::size_t round)
+	    {
+		    text_bytes = 0;
+		    for (std::size_t i = 0; i < BATCH; ++i)
+		    {
+			    auto &in = inputs[i];
+			    auto written = std::snprintf(
+			        text.data() + i * TEXT_SIZE, TEXT_SIZE,
+			        "{\"ts_ns\":%lld,\"trace_id\":%llu,\"order_id\":%llu,"
+			        "\"price\":%.17g,\"qty\":%.17g,\"fee_usd\":%.17g,"
+			        "\"symbol\":\"%s\",\"venue\":\"%s\",\"side\":\"%s\","
+			        "\"liquidity\":\"%s\",\"is_hedge\":%s}",
+			        static_cast<long long>(in._ts_ns +
+			                               static_cast<std::int64_t>(round)),
+			        static_cast<unsigned long long>(in._trace_id),
+			        static_cast<unsigned long long>(in._order_id), in._price,
+			        in._qty, in._fee_usd, in._symbol, in._venue,
+			        in._side == Side::SELL ? "sell" : "buy",
+			        in._liquidity == Liquidity::TAKER ? "taker" : "maker",
+			        in._is_hedge ? "true" : "false");
+			    text_bytes += static_cast<std::size_t>(written);
+		    }
+	    });
+
+	auto text_decode_ns = per_message_ns(
+	    [&](std::size_t)
+	    {
+		    for (std::size_t i = 0; i < BATCH; ++i)
+		    {
+			    auto json = text.data() + i * TEXT_SIZE;
+			    auto price = std::strtod(json_value(json, "\"price"), nullptr);
+			    auto qty = std::strtod(json_value(json, "\"qty"), nullptr);
+			    auto fee =
+			        std::strtod(json_value(json, "\"fee_usd"), nullptr);
+			    auto ts_ns =
+			        std::strtoll(json_value(json, "\"ts_ns"), nullptr, 10);
+			    auto order_id =
+			        std::strtoull(json_value(json, "\"order_id"), nullptr, 10);
+			    sink +=
+			        price * qty + fee + static_cast<double>(ts_ns) +
+			        static_cast<double>(order_id) +
+			        static_cast<double>(json_text(json, "\"symbol").size() +
+			                            json_text(json, "\"venue").size()) +
+			        static_cast<double>(json_text(json, "\"side") == "sell");
+		    }
+	    });
+
+	std::cout << "binary: " << encoded_size<Fill>() << " bytes, encode "
+	          << binary_encode_ns << " ns, decode " << binary_decode_ns
+	          << " ns" << std::endl;
+	std::cout << "json:   " << text_bytes / BATCH << " bytes, encode "
+	          << text_encode_ns << " ns, decode " << text_decode_ns << " ns"
+	          << std::endl;
+	// Keeps the decode loops from being optimised away.
+	if (sink == 0)
+		std::cout << "checksum 0" << std::endl;
+	return 0;
+}
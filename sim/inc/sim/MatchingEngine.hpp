@@ -0,0 +1,992 @@
+#ifndef SIM_MATCHING_ENGINE_H
+#define SIM_MATCHING_ENGINE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace sim
+{
+	enum class Side : unsigned int
+	{
+		BUY = 0,
+		SELL = 1
+	};
+
+	enum class TimeInForce : unsigned int
+	{
+		GTC = 0,
+		IOC = 1,
+		FOK = 2,
+		POST_ONLY = 3
+	};
+
+	enum class ReportType : unsigned int
+	{
+		ACK = 0,
+		FILL = 1,
+		CANCELED = 2,
+		MODIFIED = 3,
+		REJECTED = 4,
+		EXPIRED = 5
+	};
+
+	enum class RejectReason : unsigned int
+	{
+		NONE = 0,
+		UNKNOWN_SYMBOL = 1,
+		UNKNOWN_ORDER = 2,
+		INVALID_PRICE = 3,
+		INVALID_QUANTITY = 4,
+		WOULD_CROSS = 5,
+		NOT_FILLABLE = 6
+	};
+
+	// How a modify that changes price or size affects queue priority.
+	// KEEP_ON_REDUCE keeps the place for a pure size reduction (Bybit
+	// amend), ALWAYS_LOSE requeues on every modify (Hyperliquid).
+	enum class ModifyPriority : unsigned int
+	{
+		KEEP_ON_REDUCE = 0,
+		ALWAYS_LOSE = 1
+	};
+
+	// Prices are integer ticks and quantities integer lots, the caller owns
+	// the conversion.
+	class OrderRequest
+	{
+	public:
+		std::uint64_t _client_id;
+		std::uint64_t _account;
+		std::uint32_t _symbol;
+		Side _side;
+		TimeInForce _tif;
+		std::int64_t _price;
+		std::int64_t _quantity;
+		OrderRequest()
+		    : _client_id(0)
+		    , _account(0)
+		    , _symbol(0)
+		    , _side(Side::BUY)
+		    , _tif(TimeInForce::GTC)
+		    , _price(0)
+		    , _quantity(0)
+		{
+		}
+	};
+
+	// _price is the order price, or the execution price for FILL.
+	// _timestamp_ns is when the engine acted, the report is delivered
+	// LatencyModel::_ack_ns or _fill_ns later.
+	class ExecutionReport
+	{
+	public:
+		ReportType _type;
+		RejectReason _reason;
+		std::uint64_t _order_id;
+		std::uint64_t _client_id;
+		std::uint64_t _account;
+		std::uint32_t _symbol;
+		Side _side;
+		bool _maker;
+		std::int64_t _price;
+		std::int64_t _last_quantity;
+		std::int64_t _leaves_quantity;
+		std::int64_t _cum_quantity;
+		std::int64_t _timestamp_ns;
+		ExecutionReport()
+		    : _type(ReportType::ACK)
+		    , _reason(RejectReason::NONE)
+		    , _order_id(0)
+		    , _client_id(0)
+		    , _account(0)
+		    , _symbol(0)
+		    , _side(Side::BUY)
+		    , _maker(false)
+		    , _price(0)
+		    , _last_quantity(0)
+		    , _leaves_quantity(0)
+		    , _cum_quantity(0)
+		    , _timestamp_ns(0)
+		{
+		}
+	};
+
+	// _order_ns: submit/cancel/modify until the engine sees it.
+	// _ack_ns: engine to client for everything but fills.
+	// _fill_ns: engine to client for fills.
+	class LatencyModel
+	{
+	public:
+		std::int64_t _order_ns;
+		std::int64_t _ack_ns;
+		std::int64_t _fill_ns;
+		LatencyModel() : _order_ns(0), _ack_ns(0), _fill_ns(0) {}
+	};
+
+	// Price-time priority matching for the dry_run simulator. One book per
+	// symbol, every side a price-sorted vector of levels with the best
+	// level at the back, orders in a pooled intrusive FIFO per level.
+	//
+	// Time is virtual: every call carries now_ns, commands reach the book
+	// LatencyModel::_order_ns later and reports are delivered once their
+	// latency has elapsed, on this or a later call (advance() only moves
+	// time). With a zero latency model everything happens inside the call.
+	//
+	// Recorded market data is replayed with set_market_level() (L2 size
+	// at a price) and apply_market_trade() (prints). Market liquidity sits
+	// in the book like an order without reports: resting orders queue
+	// behind the size already shown at their price, and prints or levels
+	// crossing them fill them as maker.
+	class MatchingEngine
+	{
+	public:
+		using OnReportCallBack = std::function<void(const ExecutionReport &)>;
+
+		static constexpr std::uint32_t NO_SYMBOL =
+		    std::numeric_limits<std::uint32_t>::max();
+		static constexpr std::int64_t NO_PRICE = 0;
+
+	private:
+		static constexpr std::uint32_t NIL =
+		    std::numeric_limits<std::uint32_t>::max();
+
+		enum class order_state : unsigned int
+		{
+			FREE = 0,
+			PENDING = 1,
+			RESTING = 2
+		};
+
+		enum class command_type : unsigned int
+		{
+			NEW = 0,
+			CANCEL = 1,
+			MODIFY = 2
+		};
+
+		class order_node
+		{
+		public:
+			std::uint64_t _client_id;
+			std::uint64_t _account;
+			std::int64_t _price;
+			std::int64_t _quantity;
+			std::int64_t _leaves;
+			std::uint32_t _symbol;
+			std::uint32_t _generation;
+			std::uint32_t _prev;
+			std::uint32_t _next;
+			Side _side;
+			TimeInForce _tif;
+			order_state _state;
+			bool _market;
+			order_node()
+			    : _client_id(0)
+			    , _account(0)
+			    , _price(0)
+			    , _quantity(0)
+			    , _leaves(0)
+			    , _symbol(0)
+			    , _generation(0)
+			    , _prev(NIL)
+			    , _next(NIL)
+			    , _side(Side::BUY)
+			    , _tif(TimeInForce::GTC)
+			    , _state(order_state::FREE)
+			    , _market(false)
+			{
+			}
+		};
+
+		class price_level
+		{
+		public:
+			std::int64_t _price;
+			std::int64_t _quantity;
+			std::uint32_t _head;
+			std::uint32_t _tail;
+			// Market liquidity at this price, NIL when none.
+			std::uint32_t _market;
+			price_level()
+			    : _price(0), _quantity(0), _head(NIL), _tail(NIL), _market(NIL)
+			{
+			}
+		};
+
+		// _bids ascending and _asks descending, the best level is back().
+		class order_book
+		{
+		public:
+			std::string _name;
+			std::vector<price_level> _bids;
+			std::vector<price_level> _asks;
+			order_book() : _name(""), _bids(), _asks() {}
+		};
+
+		class command
+		{
+		public:
+			command_type _type;
+			std::int64_t _due_ns;
+			std::uint64_t _order_id;
+			std::uint64_t _account;
+			std::int64_t _price;
+			std::int64_t _quantity;
+			command()
+			    : _type(command_type::NEW)
+			    , _due_ns(0)
+			    , _order_id(0)
+			    , _account(0)
+			    , _price(0)
+			    , _quantity(0)
+			{
+			}
+		};
+
+		class pending_report
+		{
+		public:
+			std::int64_t _due_ns;
+			std::uint64_t _sequence;
+			ExecutionReport _report;
+			pending_report() : _due_ns(0), _sequence(0), _report() {}
+		};
+
+	public:
+		MatchingEngine(
+		    OnReportCallBack &&on_report = [](const ExecutionReport &) {},
+		    std::size_t order_capacity = 1 << 16)
+		    : _on_report(std::move(on_report))
+		    , _books()
+		    , _symbols()
+		    , _orders()
+		    , _free_orders()
+		    , _commands()
+		    , _acks()
+		    , _fills()
+		    , _latency()
+		    , _modify_priority(ModifyPriority::KEEP_ON_REDUCE)
+		    , _now_ns(0)
+		    , _report_sequence(0)
+		    , _orders_processed(0)
+		    , _delivering(false)
+		{
+			_orders.reserve(order_capacity);
+			_free_orders.reserve(order_capacity);
+		}
+
+		std::uint32_t add_symbol(const std::string &name)
+		{
+			auto it = _symbols.find(name);
+			if (it != _symbols.end())
+				return it->second;
+			auto id = static_cast<std::uint32_t>(_books.size());
+			_books.emplace_back();
+			_books.back()._name = name;
+			_symbols.emplace(name, id);
+			return id;
+		}
+
+		std::uint32_t symbol_id(const std::string &name) const
+		{
+			auto it = _symbols.find(name);
+			return it == _symbols.end() ? NO_SYMBOL : it->second;
+		}
+
+		std::size_t symbol_count() const { return _books.size(); }
+
+		const std::string &symbol_name(std::uint32_t symbol) const
+		{
+			return _books[symbol]._name;
+		}
+
+		void set_latency(const LatencyModel &latency) { _latency = latency; }
+
+		void set_modify_priority(ModifyPriority priority)
+		{
+			_modify_priority = priority;
+		}
+
+		// Returns the engine order id, also carried by every report of the
+		// order, or 0 when the request is rejected outright.
+		std::uint64_t submit(const OrderRequest &request, std::int64_t now_ns)
+		{
+			advance(now_ns);
+			auto reason = validate(request);
+			if (reason != RejectReason::NONE)
+			{
+				ExecutionReport report;
+				report._type = ReportType::REJECTED;
+				report._reason = reason;
+				report._client_id = request._client_id;
+				report._account = request._account;
+				report._symbol = request._symbol;
+				report._side = request._side;
+				report._price = request._price;
+				report._timestamp_ns = now_ns + _latency._order_ns;
+				queue_report(report);
+				deliver();
+				return 0;
+			}
+			auto slot = allocate_order();
+			auto &node = _orders[slot];
+			node._client_id = request._client_id;
+			node._account = request._account;
+			node._price = request._price;
+			node._quantity = request._quantity;
+			node._leaves = request._quantity;
+			node._symbol = request._symbol;
+			node._side = request._side;
+			node._tif = request._tif;
+			node._state = order_state::PENDING;
+			auto id = make_order_id(slot);
+			command cmd;
+			cmd._type = command_type::NEW;
+			cmd._order_id = id;
+			dispatch(cmd, now_ns);
+			return id;
+		}
+
+		// A non-zero account only reaches orders submitted with it, and
+		// receives the UNKNOWN_ORDER reject otherwise.
+		void cancel(std::uint64_t order_id, std::int64_t now_ns,
+		            std::uint64_t account = 0)
+		{
+			advance(now_ns);
+			command cmd;
+			cmd._type = command_type::CANCEL;
+			cmd._order_id = order_id;
+			cmd._account = account;
+			dispatch(cmd, now_ns);
+		}
+
+		// quantity is the new total size, fills included. A size at or
+		// below what already traded cancels the order.
+		void modify(std::uint64_t order_id, std::int64_t price,
+		            std::int64_t quantity, std::int64_t now_ns,
+		            std::uint64_t account = 0)
+		{
+			advance(now_ns);
+			command cmd;
+			cmd._type = command_type::MODIFY;
+			cmd._order_id = order_id;
+			cmd._account = account;
+			cmd._price = price;
+			cmd._quantity = quantity;
+			dispatch(cmd, now_ns);
+		}
+
+		// Recorded L2: the market shows quantity (0 removes it) at price. A
+		// level crossing resting orders first trades against them.
+		void set_market_level(std::uint32_t symbol, Side side,
+		                      std::int64_t price, std::int64_t quantity,
+		                      std::int64_t now_ns)
+		{
+			advance(now_ns);
+			if (symbol >= _books.size() || price <= 0 || quantity < 0)
+				return;
+			auto &book = _books[symbol];
+			if (quantity > 0)
+				quantity = match(book, side, price, quantity, NIL, _now_ns);
+			auto &levels = side == Side::BUY ? book._bids : book._asks;
+			auto it = find_level(levels, side, price);
+			auto found = it != levels.end() && it->_price == price;
+			if (!found && quantity == 0)
+			{
+				deliver();
+				return;
+			}
+			if (!found)
+			{
+				price_level level;
+				level._price = price;
+				it = levels.insert(it, level);
+			}
+			if (it->_market != NIL)
+			{
+				auto &node = _orders[it->_market];
+				it->_quantity += quantity - node._leaves;
+				node._leaves = quantity;
+				node._quantity = quantity;
+				if (quantity == 0)
+				{
+					auto slot = it->_market;
+					it->_market = NIL;
+					unlink(*it, slot);
+					release_order(slot);
+				}
+			}
+			else if (quantity > 0)
+			{
+				auto slot = allocate_order();
+				auto &node = _orders[slot];
+				node._price = price;
+				node._quantity = quantity;
+				node._leaves = quantity;
+				node._symbol = symbol;
+				node._side = side;
+				node._state = order_state::RESTING;
+				node._market = true;
+				it->_market = slot;
+				link(*it, slot);
+			}
+			if (it->_head == NIL)
+				levels.erase(it);
+			deliver();
+		}
+
+		// Recorded print: the market traded quantity at price, the
+		// aggressor taking liquidity on the opposite side.
+		void apply_market_trade(std::uint32_t symbol, Side aggressor,
+		                        std::int64_t price, std::int64_t quantity,
+		                        std::int64_t now_ns)
+		{
+			advance(now_ns);
+			if (symbol >= _books.size() || price <= 0 || quantity <= 0)
+				return;
+			match(_books[symbol], aggressor, price, quantity, NIL, _now_ns);
+			deliver();
+		}
+
+		// Let time pass: run commands and deliver reports due by now_ns.
+		void advance(std::int64_t now_ns)
+		{
+			if (now_ns > _now_ns)
+				_now_ns = now_ns;
+			while (!_commands.empty() && _commands.front()._due_ns <= _now_ns)
+			{
+				auto cmd = _commands.front();
+				_commands.pop_front();
+				execute(cmd);
+			}
+			deliver();
+		}
+
+		std::int64_t best_bid(std::uint32_t symbol) const
+		{
+			auto &levels = _books[symbol]._bids;
+			return levels.empty() ? NO_PRICE : levels.back()._price;
+		}
+
+		std::int64_t best_ask(std::uint32_t symbol) const
+		{
+			auto &levels = _books[symbol]._asks;
+			return levels.empty() ? NO_PRICE : levels.back()._price;
+		}
+
+		std::int64_t depth_at(std::uint32_t symbol, Side side,
+		                      std::int64_t price) const
+		{
+			auto &book = _books[symbol];
+			auto &levels = side == Side::BUY ? book._bids : book._asks;
+			auto it = find_level(levels, side, price);
+			return it != levels.end() && it->_price == price ? it->_quantity
+			                                                 : 0;
+		}
+
+		std::uint64_t orders_processed() const { return _orders_processed; }
+
+	private:
+		OnReportCallBack _on_report;
+		std::vector<order_book> _books;
+		std::unordered_map<std::string, std::uint32_t> _symbols;
+		std::vector<order_node> _orders;
+		std::vector<std::uint32_t> _free_orders;
+		std::deque<command> _commands;
+		std::deque<pending_report> _acks;
+		std::deque<pending_report> _fills;
+		LatencyModel _latency;
+		ModifyPriority _modify_priority;
+		std::int64_t _now_ns;
+		std::uint64_t _report_sequence;
+		std::uint64_t _orders_processed;
+		bool _delivering;
+
+		static bool better(Side side, std::int64_t a, std::int64_t b)
+		{
+			return side == Side::BUY ? a > b : a < b;
+		}
+
+		// A buy at limit trades with asks at or below it and vice versa.
+		static bool crosses(Side side, std::int64_t limit,
+		                    std::int64_t resting)
+		{
+			return side == Side::BUY ? resting <= limit : resting >= limit;
+		}
+
+		// Position of price in levels, or where it would be inserted.
+		template <typename Levels>
+		static auto find_level(Levels &levels, Side side, std::int64_t price)
+		    -> decltype(levels.begin())
+		{
+			// Most activity is at the top, scan a few levels from the back
+			// before falling back to a binary search.
+			auto n = levels.size();
+			for (std::size_t i = 0; i < n && i < 8; ++i)
+			{
+				auto &level = levels[n - 1 - i];
+				if (level._price == price)
+					return levels.begin() + (n - 1 - i);
+				if (better(side, price, level._price))
+					return levels.begin() + (n - i);
+			}
+			return std::lower_bound(levels.begin(), levels.end(), price,
+			                        [side](const price_level &level,
+			                               std::int64_t p)
+			                        { return better(side, p, level._price); });
+		}
+
+		RejectReason validate(const OrderRequest &request) const
+		{
+			if (request._symbol >= _books.size())
+				return RejectReason::UNKNOWN_SYMBOL;
+			if (request._quantity <= 0)
+				return RejectReason::INVALID_QUANTITY;
+			if (request._price <= 0)
+				return RejectReason::INVALID_PRICE;
+			return RejectReason::NONE;
+		}
+
+		std::uint32_t allocate_order()
+		{
+			if (!_free_orders.empty())
+			{
+				auto slot = _free_orders.back();
+				_free_orders.pop_back();
+				return slot;
+			}
+			_orders.emplace_back();
+			return static_cast<std::uint32_t>(_orders.size() - 1);
+		}
+
+		void release_order(std::uint32_t slot)
+		{
+			auto &node = _orders[slot];
+			auto generation = node._generation + 1;
+			node = order_node();
+			node._generation = generation;
+			_free_orders.push_back(slot);
+		}
+
+		// Generation in the high half so a stale id never hits a reused
+		// slot, never 0.
+		std::uint64_t make_order_id(std::uint32_t slot) const
+		{
+			return (static_cast<std::uint64_t>(_orders[slot]._generation + 1)
+			        << 32) |
+			       slot;
+		}
+
+		// NIL unless order_id names a live order.
+		std::uint32_t find_order(std::uint64_t order_id) const
+		{
+			auto slot = static_cast<std::uint32_t>(order_id & 0xffffffffULL);
+			if (slot >= _orders.size())
+				return NIL;
+			auto &node = _orders[slot];
+			if (node._state == order_state::FREE || node._market ||
+			    make_order_id(slot) != order_id)
+				return NIL;
+			return slot;
+		}
+
+		void dispatch(command &cmd, std::int64_t now_ns)
+		{
+			cmd._due_ns = now_ns + _latency._order_ns;
+			if (_latency._order_ns == 0 && _commands.empty())
+				execute(cmd);
+			else
+				_commands.push_back(cmd);
+			deliver();
+		}
+
+		void execute(const command &cmd)
+		{
+			++_orders_processed;
+			switch (cmd._type)
+			{
+			case command_type::NEW:
+				do_new(cmd._order_id, cmd._due_ns);
+				return;
+			case command_type::CANCEL:
+				do_cancel(cmd._order_id, cmd._account, cmd._due_ns);
+				return;
+			case command_type::MODIFY:
+				do_modify(cmd._order_id, cmd._account, cmd._price,
+				          cmd._quantity, cmd._due_ns);
+				return;
+			default:
+				return;
+			}
+		}
+
+		ExecutionReport make_report(ReportType type, std::uint32_t slot,
+		                            std::int64_t now_ns) const
+		{
+			auto &node = _orders[slot];
+			ExecutionReport report;
+			report._type = type;
+			report._order_id = make_order_id(slot);
+			report._client_id = node._client_id;
+			report._account = node._account;
+			report._symbol = node._symbol;
+			report._side = node._side;
+			report._price = node._price;
+			report._leaves_quantity = node._leaves;
+			report._cum_quantity = node._quantity - node._leaves;
+			report._timestamp_ns = now_ns;
+			return report;
+		}
+
+		void queue_report(const ExecutionReport &report)
+		{
+			pending_report pending;
+			pending._sequence = _report_sequence++;
+			if (report._type == ReportType::FILL)
+			{
+				pending._due_ns = report._timestamp_ns + _latency._fill_ns;
+				pending._report = report;
+				_fills.push_back(pending);
+			}
+			else
+			{
+				pending._due_ns = report._timestamp_ns + _latency._ack_ns;
+				pending._report = report;
+				_acks.push_back(pending);
+			}
+		}
+
+		// Hand out due reports in due order, ties in the order they were
+		// raised. Reports raised by callbacks are picked up by the same
+		// loop, never recursively.
+		void deliver()
+		{
+			if (_delivering)
+				return;
+			_delivering = true;
+			while (true)
+			{
+				auto ack_due =
+				    !_acks.empty() && _acks.front()._due_ns <= _now_ns;
+				auto fill_due =
+				    !_fills.empty() && _fills.front()._due_ns <= _now_ns;
+				if (!ack_due && !fill_due)
+					break;
+				auto ack_first =
+				    ack_due &&
+				    (!fill_due || earlier(_acks.front(), _fills.front()));
+				auto &queue = ack_first ? _acks : _fills;
+				auto report = queue.front()._report;
+				queue.pop_front();
+				_on_report(report);
+			}
+			_delivering = false;
+		}
+
+		static bool earlier(const pending_report &a, const pending_report &b)
+		{
+			if (a._due_ns != b._due_ns)
+				return a._due_ns < b._due_ns;
+			return a._sequence < b._sequence;
+		}
+
+		void reject(std::uint32_t slot, RejectReason reason,
+		            std::int64_t now_ns)
+		{
+			auto report = make_report(ReportType::REJECTED, slot, now_ns);
+			report._reason = reason;
+			queue_report(report);
+		}
+
+		void link(price_level &level, std::uint32_t slot)
+		{
+			auto &node = _orders[slot];
+			node._prev = level._tail;
+			node._next = NIL;
+			if (level._tail != NIL)
+				_orders[level._tail]._next = slot;
+			else
+				level._head = slot;
+			level._tail = slot;
+			level._quantity += node._leaves;
+		}
+
+		void unlink(price_level &level, std::uint32_t slot)
+		{
+			auto &node = _orders[slot];
+			if (node._prev != NIL)
+				_orders[node._prev]._next = node._next;
+			else
+				level._head = node._next;
+			if (node._next != NIL)
+				_orders[node._next]._prev = node._prev;
+			else
+				level._tail = node._prev;
+			level._quantity -= node._leaves;
+			node._prev = NIL;
+			node._next = NIL;
+		}
+
+		// Remove a resting order from its level, dropping the level once
+		// it is empty.
+		void remove_resting(std::uint32_t slot)
+		{
+			auto &node = _orders[slot];
+			auto &book = _books[node._symbol];
+			auto &levels = node._side == Side::BUY ? book._bids : book._asks;
+			auto it = find_level(levels, node._side, node._price);
+			unlink(*it, slot);
+			if (it->_head == NIL)
+				levels.erase(it);
+		}
+
+		std::int64_t available(const order_book &book, Side side,
+		                       std::int64_t limit, std::int64_t wanted) const
+		{
+			auto &levels = side == Side::BUY ? book._asks : book._bids;
+			std::int64_t total = 0;
+			for (auto it = levels.rbegin();
+			     it != levels.rend() && total < wanted; ++it)
+			{
+				if (!crosses(side, limit, it->_price))
+					break;
+				total += it->_quantity;
+			}
+			return total;
+		}
+
+		// Trade taker_leaves against the opposite side up to limit. slot is
+		// the taker order, NIL for market liquidity (no taker reports).
+		// Returns the quantity left.
+		std::int64_t match(order_book &book, Side side, std::int64_t limit,
+		                   std::int64_t taker_leaves, std::uint32_t slot,
+		                   std::int64_t now_ns)
+		{
+			auto &levels = side == Side::BUY ? book._asks : book._bids;
+			while (taker_leaves > 0 && !levels.empty() &&
+			       crosses(side, limit, levels.back()._price))
+			{
+				auto &level = levels.back();
+				while (taker_leaves > 0 && level._head != NIL)
+				{
+					auto maker_slot = level._head;
+					auto &maker = _orders[maker_slot];
+					auto qty = std::min(taker_leaves, maker._leaves);
+					taker_leaves -= qty;
+					maker._leaves -= qty;
+					level._quantity -= qty;
+					if (!maker._market)
+					{
+						auto report =
+						    make_report(ReportType::FILL, maker_slot, now_ns);
+						report._price = level._price;
+						report._last_quantity = qty;
+						report._maker = true;
+						queue_report(report);
+					}
+					if (slot != NIL)
+					{
+						auto &taker = _orders[slot];
+						taker._leaves -= qty;
+						auto report =
+						    make_report(ReportType::FILL, slot, now_ns);
+						report._price = level._price;
+						report._last_quantity = qty;
+						queue_report(report);
+					}
+					if (maker._leaves == 0)
+					{
+						if (maker._market)
+							level._market = NIL;
+						unlink(level, maker_slot);
+						release_order(maker_slot);
+					}
+				}
+				if (level._head == NIL)
+					levels.pop_back();
+			}
+			return taker_leaves;
+		}
+
+		void rest(order_book &book, std::uint32_t slot)
+		{
+			auto &node = _orders[slot];
+			auto &levels = node._side == Side::BUY ? book._bids : book._asks;
+			auto it = find_level(levels, node._side, node._price);
+			if (it == levels.end() || it->_price != node._price)
+			{
+				price_level level;
+				level._price = node._price;
+				it = levels.insert(it, level);
+			}
+			node._state = order_state::RESTING;
+			link(*it, slot);
+		}
+
+		// Run an order that just reached the book, or was requeued by a
+		// modify. Returns false when the order is gone afterwards.
+		bool place(std::uint32_t slot, std::int64_t now_ns)
+		{
+			auto &node = _orders[slot];
+			auto &book = _books[node._symbol];
+			auto side = node._side;
+			auto price = node._price;
+			auto &opposite = side == Side::BUY ? book._asks : book._bids;
+			auto crossing = !opposite.empty() &&
+			                crosses(side, price, opposite.back()._price);
+			// Post-only crossing is refused before we get here.
+			switch (node._tif)
+			{
+			case TimeInForce::FOK:
+				if (available(book, side, price, node._leaves) < node._leaves)
+				{
+					auto report =
+					    make_report(ReportType::EXPIRED, slot, now_ns);
+					report._reason = RejectReason::NOT_FILLABLE;
+					report._leaves_quantity = 0;
+					queue_report(report);
+					release_order(slot);
+					return false;
+				}
+				break;
+			case TimeInForce::GTC:
+			case TimeInForce::IOC:
+			case TimeInForce::POST_ONLY:
+				break;
+			default:
+				break;
+			}
+			if (crossing)
+				match(book, side, price, node._leaves, slot, now_ns);
+			auto &taker = _orders[slot];
+			if (taker._leaves == 0)
+			{
+				release_order(slot);
+				return false;
+			}
+			if (taker._tif == TimeInForce::IOC ||
+			    taker._tif == TimeInForce::FOK)
+			{
+				auto report = make_report(ReportType::EXPIRED, slot, now_ns);
+				report._leaves_quantity = 0;
+				queue_report(report);
+				release_order(slot);
+				return false;
+			}
+			rest(book, slot);
+			return true;
+		}
+
+		void do_new(std::uint64_t order_id, std::int64_t now_ns)
+		{
+			auto slot = find_order(order_id);
+			if (slot == NIL)
+				return;
+			auto &node = _orders[slot];
+			auto &book = _books[node._symbol];
+			auto &opposite = node._side == Side::BUY ? book._asks : book._bids;
+			if (node._tif == TimeInForce::POST_ONLY && !opposite.empty() &&
+			    crosses(node._side, node._price, opposite.back()._price))
+			{
+				reject(slot, RejectReason::WOULD_CROSS, now_ns);
+				release_order(slot);
+				return;
+			}
+			queue_report(make_report(ReportType::ACK, slot, now_ns));
+			place(slot, now_ns);
+		}
+
+		// A resting order the account may touch, NIL after queuing the
+		// UNKNOWN_ORDER reject.
+		std::uint32_t find_resting(std::uint64_t order_id,
+		                           std::uint64_t account, std::int64_t now_ns)
+		{
+			auto slot = find_order(order_id);
+			if (slot != NIL && _orders[slot]._state == order_state::RESTING &&
+			    (account == 0 || _orders[slot]._account == account))
+				return slot;
+			ExecutionReport report;
+			report._type = ReportType::REJECTED;
+			report._reason = RejectReason::UNKNOWN_ORDER;
+			report._order_id = order_id;
+			report._account = account;
+			report._symbol = NO_SYMBOL;
+			report._timestamp_ns = now_ns;
+			queue_report(report);
+			return NIL;
+		}
+
+		void do_cancel(std::uint64_t order_id, std::uint64_t account,
+		               std::int64_t now_ns)
+		{
+			auto slot = find_resting(order_id, account, now_ns);
+			if (slot == NIL)
+				return;
+			remove_resting(slot);
+			auto report = make_report(ReportType::CANCELED, slot, now_ns);
+			report._leaves_quantity = 0;
+			queue_report(report);
+			release_order(slot);
+		}
+
+		void do_modify(std::uint64_t order_id, std::uint64_t account,
+		               std::int64_t price, std::int64_t quantity,
+		               std::int64_t now_ns)
+		{
+			auto slot = find_resting(order_id, account, now_ns);
+			if (slot == NIL)
+				return;
+			auto &node = _orders[slot];
+			if (price <= 0)
+			{
+				reject(slot, RejectReason::INVALID_PRICE, now_ns);
+				return;
+			}
+			auto filled = node._quantity - node._leaves;
+			if (quantity <= filled)
+			{
+				do_cancel(order_id, account, now_ns);
+				return;
+			}
+			auto &book = _books[node._symbol];
+			auto &opposite = node._side == Side::BUY ? book._asks : book._bids;
+			// A post-only modify that would trade is refused, the order
+			// stays as it was.
+			if (node._tif == TimeInForce::POST_ONLY && !opposite.empty() &&
+			    crosses(node._side, price, opposite.back()._price))
+			{
+				reject(slot, RejectReason::WOULD_CROSS, now_ns);
+				return;
+			}
+			auto keep_priority =
+			    _modify_priority == ModifyPriority::KEEP_ON_REDUCE &&
+			    price == node._price && quantity <= node._quantity;
+			if (keep_priority)
+			{
+				auto &levels =
+				    node._side == Side::BUY ? book._bids : book._asks;
+				auto it = find_level(levels, node._side, node._price);
+				auto leaves = quantity - filled;
+				it->_quantity += leaves - node._leaves;
+				node._leaves = leaves;
+				node._quantity = quantity;
+				queue_report(make_report(ReportType::MODIFIED, slot, now_ns));
+				return;
+			}
+			remove_resting(slot);
+			node._price = price;
+			node._quantity = quantity;
+			node._leaves = quantity - filled;
+			queue_report(make_report(ReportType::MODIFIED, slot, now_ns));
+			place(slot, now_ns);
+		}
+	};
+} // namespace sim
+
+#endif // SIM_MATCHING_ENGINE_H
@@ -0,0 +1,257 @@
+#ifndef SIM_SIM_GATEWAY_H
+#define SIM_SIM_GATEWAY_H
+
+#include <charconv>
+#include <cstdint>
+#include <functional>
+#include <net/error.hpp>
+#include <net/tcp/TcpTlsServer.hpp>
+#include <sim/MatchingEngine.hpp>
+#include <span>
+#include <string>
+#include <string_view>
+#include <timing/Clock.hpp>
+#include <unordered_map>
+#include <vector>
+
+namespace sim
+{
+	// Puts a MatchingEngine behind a local TLS endpoint. Each connection
+	// is an account (its connection id), and reports go back to the
+	// connection that owns the order. Orders submitted in-process through
+	// engine() use account 0, and their reports go to on_report.
+	//
+	// Newline-terminated text, one command per line:
+	//   NEW <client_id> <symbol> <BUY|SELL> <GTC|IOC|FOK|POST_ONLY> <px> <qty>
+	//   CANCEL <order_id>
+	//   MODIFY <order_id> <px> <qty>
+	// and one report per line:
+	//   <ACK|FILL|CANCELED|MODIFIED|REJECTED|EXPIRED> <order_id> <client_id>
+	//   <symbol> <BUY|SELL> <px> <last_qty> <leaves> <cum> <M|T> <reason>
+	//   <timestamp_ns>
+	// A line that does not parse is answered with "ERROR <line>".
+	class SimGateway
+	{
+	public:
+		using OnReportCallBack = MatchingEngine::OnReportCallBack;
+
+	public:
+		SimGateway(
+		    OnReportCallBack &&on_report = [](const ExecutionReport &) {},
+		    std::size_t read_buffer_size = 65536)
+		    : _on_report(std::move(on_report))
+		    , _engine([this](const ExecutionReport &report)
+		              { do_report(report); })
+		    , _server([](std::uint64_t) {},
+		              [this](std::uint64_t id) { _pending_lines.erase(id); },
+		              [](std::uint64_t, const std::string &) {},
+		              [this](std::uint64_t id,
+		                     const std::span<const char> &data)
+		              { do_data(id, data); },
+		              [](std::uint64_t, net::NetError) {}, read_buffer_size)
+		    , _pending_lines()
+		    , _clock()
+		{
+		}
+
+		MatchingEngine &engine() { return _engine; }
+
+		net::tcp::TcpTlsServer &server() { return _server; }
+
+		// Time base handed to the engine, SteadyClock by default. Set it
+		// before the first order.
+		void set_clock(timing::ClockSource clock) { _clock = clock; }
+
+		std::int64_t now_ns() const { return _clock.now_ns(); }
+
+		void poll()
+		{
+			_server.poll();
+			_engine.advance(now_ns());
+		}
+
+	private:
+		OnReportCallBack _on_report;
+		MatchingEngine _engine;
+		net::tcp::TcpTlsServer _server;
+		std::unordered_map<std::uint64_t, std::string> _pending_lines;
+		timing::ClockSource _clock;
+
+		static std::vector<std::string_view> split(std::string_view line)
+		{
+			std::vector<std::string_view> tokens;
+			std::size_t pos = 0;
+			while (pos < line.size())
+			{
+				auto start = line.find_first_not_of(' ', pos);
+				if (start == std::string_view::npos)
+					break;
+				auto end = line.find(' ', start);
+				if (end == std::string_view::npos)
+					end = line.size();
+				tokens.push_back(line.substr(start, end - start));
+				pos = end;
+			}
+			return tokens;
+		}
+
+		template <typename T>
+		static bool parse_number(std::string_view token, T &value)
+		{
+			auto end = token.data() + token.size();
+			auto [ptr, ec] = std::from_chars(token.data(), end, value);
+			return ec == std::errc() && ptr == end;
+		}
+
+		static bool parse_side(std::string_view token, Side &side)
+		{
+			if (token == "BUY")
+				side = Side::BUY;
+			else if (token == "SELL")
+				side = Side::SELL;
+			else
+				return false;
+			return true;
+		}
+
+		static bool parse_tif(std::string_view token, TimeInForce &tif)
+		{
+			if (token == "GTC")
+				tif = TimeInForce::GTC;
+			else if (token == "IOC")
+				tif = TimeInForce::IOC;
+			else if (token == "FOK")
+				tif = TimeInForce::FOK;
+			else if (token == "POST_ONLY")
+				tif = TimeInForce::POST_ONLY;
+			else
+				return false;
+			return true;
+		}
+
+		static const char *report_name(ReportType type)
+		{
+			switch (type)
+			{
+			case ReportType::ACK:
+				return "ACK";
+			case ReportType::FILL:
+				return "FILL";
+			case ReportType::CANCELED:
+				return "CANCELED";
+			case ReportType::MODIFIED:
+				return "MODIFIED";
+			case ReportType::REJECTED:
+				return "REJECTED";
+			case ReportType::EXPIRED:
+				return "EXPIRED";
+			default:
+				return "UNKNOWN";
+			}
+		}
+
+		void do_data(std::uint64_t id, const std::span<const char> &data)
+		{
+			auto &pending = _pending_lines[id];
+			pending.append(data.data(), data.size());
+			auto last = pending.rfind('\n');
+			if (last == std::string::npos)
+				return;
+			// A command's callbacks may close the session and erase its
+			// pending text, so the complete lines are moved out first.
+			std::string lines = pending.substr(0, last + 1);
+			pending.erase(0, last + 1);
+			std::size_t start = 0;
+			while (start < lines.size())
+			{
+				auto end = lines.find('\n', start);
+				auto line =
+				    std::string_view(lines).substr(start, end - start);
+				if (!line.empty() && line.back() == '\r')
+					line.remove_suffix(1);
+				if (!line.empty() && !do_command(id, line))
+				{
+					auto error = "ERROR " + std::string(line) + "\n";
+					_server.send(id, error.c_str());
+				}
+				start = end + 1;
+				// The session may have gone away from inside a callback.
+				if (!_pending_lines.contains(id))
+					return;
+			}
+		}
+
+		bool do_command(std::uint64_t id, std::string_view line)
+		{
+			auto tokens = split(line);
+			auto now = now_ns();
+			if (tokens.size() == 7 && tokens[0] == "NEW")
+			{
+				OrderRequest request;
+				request._account = id;
+				request._symbol = _engine.symbol_id(std::string(tokens[2]));
+				if (!parse_number(tokens[1], request._client_id) ||
+				    !parse_side(tokens[3], request._side) ||
+				    !parse_tif(tokens[4], request._tif) ||
+				    !parse_number(tokens[5], request._price) ||
+				    !parse_number(tokens[6], request._quantity))
+					return false;
+				_engine.submit(request, now);
+				return true;
+			}
+			std::uint64_t order_id = 0;
+			if (tokens.size() == 2 && tokens[0] == "CANCEL")
+			{
+				if (!parse_number(tokens[1], order_id))
+					return false;
+				_engine.cancel(order_id, now, id);
+				return true;
+			}
+			std::int64_t price = 0, quantity = 0;
+			if (tokens.size() == 4 && tokens[0] == "MODIFY")
+			{
+				if (!parse_number(tokens[1], order_id) ||
+				    !parse_number(tokens[2], price) ||
+				    !parse_number(tokens[3], quantity))
+					return false;
+				_engine.modify(order_id, price, quantity, now, id);
+				return true;
+			}
+			return false;
+		}
+
+		void do_report(const ExecutionReport &report)
+		{
+			if (report._account == 0)
+			{
+				_on_report(report);
+				return;
+			}
+			std::string line = report_name(report._type);
+			line += ' ';
+			line += std::to_string(report._order_id);
+			line += ' ';
+			line += std::to_string(report._client_id);
+			line += ' ';
+			line += report._symbol < _engine.symbol_count()
+			            ? _engine.symbol_name(report._symbol)
+			            : "-";
+			line += report._side == Side::BUY ? " BUY " : " SELL ";
+			line += std::to_string(report._price);
+			line += ' ';
+			line += std::to_string(report._last_quantity);
+			line += ' ';
+			line += std::to_string(report._leaves_quantity);
+			line += ' ';
+			line += std::to_string(report._cum_quantity);
+			line += report._maker ? " M " : " T ";
+			line += std::to_string(static_cast<unsigned int>(report._reason));
+			line += ' ';
+			line += std::to_string(report._timestamp_ns);
+			line += '\n';
+			_server.send(report._account, line.c_str());
+		}
+	};
+} // namespace sim
+
+#endif // SIM_SIM_GATEWAY_H
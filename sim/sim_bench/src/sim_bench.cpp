@@ -0,0 +1,105 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <sim/MatchingEngine.hpp>
+#include <string>
+#include <vector>
+
+// Order throughput of the matching engine with a zero latency model, as
+// the dry_run simulator replays a session. Random flow on SYMBOLS books
+// around one price: GTC limits that rest or cross, one in ten IOC, and
+// modifies and cancels of resting orders, so the books stay near
+// MAX_LIVE orders deep. The requests are made up front; the timed loop
+// only calls the engine. Exits 1 under MIN_OPS_PER_SECOND.
+
+using namespace sim;
+using Clock = std::chrono::steady_clock;
+
+static constexpr std::size_t SYMBOLS = 4;
+static constexpr std::size_t MAX_LIVE = 20000;
+static constexpr double MIN_OPS_PER_SECOND = 1e6;
+
+class report_counts
+{
+public:
+	std::uint64_t _reports;
+	std::uint64_t _fills;
+	report_counts()
+	    : _reports(0)
+	    , _fills(0)
+	{
+	}
+};
+
+int main(int argc, const char **argv)
+{
+	std::size_t orders =
+	    argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 4000000;
+	report_counts counts;
+	MatchingEngine engine(
+	    [&counts](const ExecutionReport &report)
+	    {
+		    ++counts._reports;
+		    counts._fills += report._type == ReportType::FILL;
+	    },
+	    1 << 20);
+	for (std::size_t s = 0; s < SYMBOLS; ++s)
+	{
+		std::string name("S");
+		name += std::to_string(s);
+		engine.add_symbol(name);
+	}
+
+	std::mt19937_64 random(1);
+	std::vector<OrderRequest> requests(orders);
+	for (auto &request : requests)
+	{
+		request._client_id = random();
+		request._symbol = static_cast<std::uint32_t>(random() % SYMBOLS);
+		request._side = random() & 1 ? Side::BUY : Side::SELL;
+		// Buys a little below sells, so some cross and most rest.
+		auto offset = static_cast<std::int64_t>(random() % 40) - 20;
+		request._price =
+		    1000 + offset + (request._side == Side::BUY ? -5 : 5);
+		request._quantity = static_cast<std::int64_t>(1 + random() % 10);
+		request._tif = random() % 10 == 0 ? TimeInForce::IOC
+		                                  : TimeInForce::GTC;
+	}
+
+	std::vector<std::uint64_t> live(MAX_LIVE, 0);
+	std::size_t next_live = 0;
+	std::uint64_t ops = 0;
+	auto start = Clock::now();
+	for (std::size_t i = 0; i < orders; ++i)
+	{
+		auto id = engine.submit(requests[i], 0);
+		++ops;
+		// The order that slot held is modified or cancelled first, so
+		// the books keep about MAX_LIVE orders.
+		auto &slot = live[next_live];
+		if (slot != 0)
+		{
+			if (i % 4 == 0)
+				engine.modify(slot, requests[i]._price,
+				              requests[i]._quantity, 0);
+			else
+				engine.cancel(slot, 0);
+			++ops;
+		}
+		slot = id;
+		next_live = (next_live + 1) % MAX_LIVE;
+	}
+	auto seconds =
+	    std::chrono::duration<double>(Clock::now() - start).count();
+
+	auto ops_per_second = static_cast<double>(ops) / seconds;
+	std::cout << orders << " orders, " << ops << " operations in "
+	          << seconds * 1e3 << " ms: " << ops_per_second / 1e6
+	          << " M ops/s, " << 1e9 / ops_per_second << " ns per operation"
+	          << std::endl;
+	std::cout << counts._reports << " reports, " << counts._fills
+	          << " fills" << std::endl;
+	return ops_per_second >= MIN_OPS_PER_SECOND ? 0 : 1;
+}
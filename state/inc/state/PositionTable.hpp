@@ -0,0 +1,250 @@
+#ifndef STATE_POSITION_TABLE_H
+#define STATE_POSITION_TABLE_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <state/Seqlock.hpp>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace state
+{
+	// One symbol on one venue. position is signed contracts; notional_usd
+	// is position at the Theo known when it was last updated.
+	class Position
+	{
+	public:
+		double _position;
+		double _avg_price;
+		double _notional_usd;
+		double _theo;
+		std::int64_t _updated_ns;
+		std::uint64_t _fills;
+		Position()
+		    : _position(0)
+		    , _avg_price(0)
+		    , _notional_usd(0)
+		    , _theo(0)
+		    , _updated_ns(0)
+		    , _fills(0)
+		{
+		}
+	};
+
+	// Per-symbol, per-venue positions and per-symbol Theo, readable from
+	// any thread. Entries live in one flat, cache-line aligned array
+	// indexed symbol * max_venues + venue, each behind its own seqlock.
+	//
+	// Every entry has a single writer: the thread that handles fills for
+	// that venue writes its (symbol, venue) entries, and the thread that
+	// computes Theo writes set_theo(). Readers get a consistent copy of
+	// one entry; sums across venues read each entry separately.
+	//
+	// Symbols and venues are added during setup, before other threads
+	// use the table, up to the capacities given at construction.
+	class PositionTable
+	{
+	public:
+		static constexpr std::uint32_t NO_SYMBOL =
+		    std::numeric_limits<std::uint32_t>::max();
+		static constexpr std::uint32_t NO_VENUE =
+		    std::numeric_limits<std::uint32_t>::max();
+
+	public:
+		PositionTable(std::size_t max_symbols, std::size_t max_venues)
+		    : _max_symbols(max_symbols)
+		    , _max_venues(max_venues)
+		    , _positions(std::make_unique<Seqlock<Position>[]>(max_symbols *
+		                                                       max_venues))
+		    , _theos(std::make_unique<Seqlock<theo_value>[]>(max_symbols))
+		    , _symbol_names()
+		    , _venue_names()
+		    , _symbols()
+		{
+			_symbol_names.reserve(max_symbols);
+			_venue_names.reserve(max_venues);
+		}
+
+		PositionTable(const PositionTable &) = delete;
+
+		PositionTable &operator=(const PositionTable &) = delete;
+
+		// NO_SYMBOL once max_symbols are taken.
+		std::uint32_t add_symbol(const std::string &name)
+		{
+			auto it = _symbols.find(name);
+			if (it != _symbols.end())
+				return it->second;
+			if (_symbol_names.size() >= _max_symbols)
+				return NO_SYMBOL;
+			auto id = static_cast<std::uint32_t>(_symbol_names.size());
+			_symbol_names.push_back(name);
+			_symbols.emplace(name, id);
+			return id;
+		}
+
+		std::uint32_t symbol_id(const std::string &name) const
+		{
+			auto it = _symbols.find(name);
+			return it == _symbols.end() ? NO_SYMBOL : it->second;
+		}
+
+		std::size_t symbol_count() const { return _symbol_names.size(); }
+
+		const std::string &symbol_name(std::uint32_t symbol) const
+		{
+			return _symbol_names[symbol];
+		}
+
+		// NO_VENUE once max_venues are taken.
+		std::uint32_t add_venue(const std::string &name)
+		{
+			for (std::size_t i = 0; i < _venue_names.size(); ++i)
+			{
+				if (_venue_names[i] == name)
+					return static_cast<std::uint32_t>(i);
+			}
+			if (_venue_names.size() >= _max_venues)
+				return NO_VENUE;
+			_venue_names.push_back(name);
+			return static_cast<std::uint32_t>(_venue_names.size() - 1);
+		}
+
+		std::size_t venue_count() const { return _venue_names.size(); }
+
+		const std::string &venue_name(std::uint32_t venue) const
+		{
+			return _venue_names[venue];
+		}
+
+		// Writer of (symbol, venue). quantity is signed, positive for a
+		// buy. The average price follows the open position: adding
+		// averages in, reducing keeps it, flipping restarts at price.
+		// Notional is revalued at the latest Theo, or at price before
+		// any Theo was set.
+		void apply_fill(std::uint32_t symbol, std::uint32_t venue,
+		                double quantity, double price,
+		                std::int64_t timestamp_ns)
+		{
+			auto &entry = do_entry(symbol, venue);
+			auto position = entry.peek();
+			auto before = position._position;
+			auto after = before + quantity;
+			if (after == 0)
+				position._avg_price = 0;
+			else if (before == 0 || (before > 0) != (after > 0))
+				position._avg_price = price;
+			else if (std::fabs(after) > std::fabs(before))
+				position._avg_price =
+				    (position._avg_price * std::fabs(before) +
+				     price * std::fabs(quantity)) /
+				    std::fabs(after);
+			position._position = after;
+			do_revalue(position, symbol, price);
+			position._updated_ns = timestamp_ns;
+			++position._fills;
+			entry.store(position);
+		}
+
+		// Writer of (symbol, venue): overwrite with the venue's own view,
+		// e.g. after reconnecting.
+		void set_position(std::uint32_t symbol, std::uint32_t venue,
+		                  double position_contracts, double avg_price,
+		                  std::int64_t timestamp_ns)
+		{
+			auto &entry = do_entry(symbol, venue);
+			auto position = entry.peek();
+			position._position = position_contracts;
+			position._avg_price = position_contracts == 0 ? 0 : avg_price;
+			do_revalue(position, symbol, avg_price);
+			position._updated_ns = timestamp_ns;
+			entry.store(position);
+		}
+
+		// Writer of Theo. Readers that want notional at this Theo use
+		// inventory_usd(); entries themselves revalue on their next fill.
+		void set_theo(std::uint32_t symbol, double theo,
+		              std::int64_t timestamp_ns)
+		{
+			theo_value value;
+			value._theo = theo;
+			value._updated_ns = timestamp_ns;
+			_theos[symbol].store(value);
+		}
+
+		Position position(std::uint32_t symbol, std::uint32_t venue) const
+		{
+			return do_entry(symbol, venue).load();
+		}
+
+		double theo(std::uint32_t symbol) const
+		{
+			return _theos[symbol].load()._theo;
+		}
+
+		// Net contracts across venues.
+		double inventory(std::uint32_t symbol) const
+		{
+			double total = 0;
+			for (std::uint32_t v = 0; v < _venue_names.size(); ++v)
+				total += do_entry(symbol, v).load()._position;
+			return total;
+		}
+
+		// inventory_usd{symbol}: net contracts across venues at the
+		// latest Theo (at each entry's own Theo before any is set).
+		double inventory_usd(std::uint32_t symbol) const
+		{
+			auto theo = _theos[symbol].load()._theo;
+			double total = 0;
+			for (std::uint32_t v = 0; v < _venue_names.size(); ++v)
+			{
+				auto position = do_entry(symbol, v).load();
+				total += theo > 0 ? position._position * theo
+				                  : position._notional_usd;
+			}
+			return total;
+		}
+
+	private:
+		class theo_value
+		{
+		public:
+			double _theo;
+			std::int64_t _updated_ns;
+			theo_value()
+			    : _theo(0)
+			    , _updated_ns(0)
+			{
+			}
+		};
+
+		std::size_t _max_symbols;
+		std::size_t _max_venues;
+		std::unique_ptr<Seqlock<Position>[]> _positions;
+		std::unique_ptr<Seqlock<theo_value>[]> _theos;
+		std::vector<std::string> _symbol_names;
+		std::vector<std::string> _venue_names;
+		std::unordered_map<std::string, std::uint32_t> _symbols;
+
+		Seqlock<Position> &do_entry(std::uint32_t symbol,
+		                            std::uint32_t venue) const
+		{
+			return _positions[symbol * _max_venues + venue];
+		}
+
+		void do_revalue(Position &position, std::uint32_t symbol,
+		                double fallback_price) const
+		{
+			auto theo = _theos[symbol].load()._theo;
+			position._theo = theo > 0 ? theo : fallback_price;
+			position._notional_usd = position._position * position._theo;
+		}
+	};
+} // namespace state
+
+#endif // STATE_POSITION_TABLE_H
@@ -0,0 +1,98 @@
+#ifndef STATE_SEQLOCK_H
+#define STATE_SEQLOCK_H
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace state
+{
+	// Single-writer seqlock around a small trivially copyable value, on
+	// its own cache line(s). The writer never waits; a reader copies the
+	// value out and retries if a write overlapped. Neither side does an
+	// atomic read-modify-write. The value is kept as 64-bit words with
+	// relaxed atomic accesses, which compile to plain moves on x86-64.
+	template <typename T>
+	    requires std::is_trivially_copyable_v<T> &&
+	             (sizeof(T) % sizeof(std::uint64_t) == 0)
+	class alignas(64) Seqlock
+	{
+	public:
+		Seqlock()
+		    : _sequence(0)
+		    , _words()
+		{
+			for (auto &word : _words)
+				word.store(0, std::memory_order_relaxed);
+		}
+
+		Seqlock(const Seqlock &) = delete;
+
+		Seqlock &operator=(const Seqlock &) = delete;
+
+		// Writer side only.
+		void store(const T &value)
+		{
+			auto raw = std::bit_cast<words>(value);
+			auto sequence = _sequence.load(std::memory_order_relaxed);
+			_sequence.store(sequence + 1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			for (std::size_t i = 0; i < WORDS; ++i)
+				_words[i].store(raw[i], std::memory_order_relaxed);
+			_sequence.store(sequence + 2, std::memory_order_release);
+		}
+
+		// Writer side only: its own last store, without the retry loop.
+		T peek() const
+		{
+			words raw;
+			for (std::size_t i = 0; i < WORDS; ++i)
+				raw[i] = _words[i].load(std::memory_order_relaxed);
+			return std::bit_cast<T>(raw);
+		}
+
+		// Any thread. False if a write was in progress or overlapped.
+		bool try_load(T &value) const
+		{
+			auto before = _sequence.load(std::memory_order_acquire);
+			if (before & 1)
+				return false;
+			words raw;
+			for (std::size_t i = 0; i < WORDS; ++i)
+				raw[i] = _words[i].load(std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (_sequence.load(std::memory_order_relaxed) != before)
+				return false;
+			value = std::bit_cast<T>(raw);
+			return true;
+		}
+
+		// Any thread; spins until it gets a consistent copy.
+		T load() const
+		{
+			T value;
+			while (!try_load(value))
+			{
+			}
+			return value;
+		}
+
+		// Number of stores so far.
+		std::uint64_t version() const
+		{
+			return _sequence.load(std::memory_order_acquire) / 2;
+		}
+
+	private:
+		static constexpr std::size_t WORDS = sizeof(T) / sizeof(std::uint64_t);
+		using words = std::array<std::uint64_t, WORDS>;
+
+		std::atomic<std::uint64_t> _sequence;
+		std::array<std::atomic<std::uint64_t>, WORDS> _words;
+	};
+} // namespace state
+
+#endif // STATE_SEQLOCK_H
@@ -0,0 +1,104 @@
+#ifndef TIMING_CLOCK_H
+#define TIMING_CLOCK_H
+
+#include <concepts>
+#include <cstdint>
+#include <ctime>
+#include <type_traits>
+
+namespace timing
+{
+	// Anything with a nanosecond now_ns(). Components that stamp or
+	// measure time take a clock instead of calling std::chrono directly,
+	// so the same code runs on TSC time live and on virtual time in
+	// replay.
+	template <typename T>
+	concept Clock = requires(const T &clock) {
+		{ clock.now_ns() } -> std::convertible_to<std::int64_t>;
+	};
+
+	// CLOCK_MONOTONIC. Only meaningful as differences within one host.
+	class SteadyClock
+	{
+	public:
+		std::int64_t now_ns() const
+		{
+			timespec ts;
+			::clock_gettime(CLOCK_MONOTONIC, &ts);
+			return static_cast<std::int64_t>(ts.tv_sec) * 1000000000 +
+			       ts.tv_nsec;
+		}
+	};
+
+	// CLOCK_REALTIME, nanoseconds since the Unix epoch. Use it to compare
+	// against exchange timestamps, not to measure intervals.
+	class RealtimeClock
+	{
+	public:
+		std::int64_t now_ns() const
+		{
+			timespec ts;
+			::clock_gettime(CLOCK_REALTIME, &ts);
+			return static_cast<std::int64_t>(ts.tv_sec) * 1000000000 +
+			       ts.tv_nsec;
+		}
+	};
+
+	// Time that only moves when told to. Replay drives it from capture
+	// timestamps.
+	class VirtualClock
+	{
+	public:
+		VirtualClock(std::int64_t start_ns = 0) : _now_ns(start_ns) {}
+
+		std::int64_t now_ns() const { return _now_ns; }
+
+		void set(std::int64_t now_ns) { _now_ns = now_ns; }
+
+		void advance(std::int64_t delta_ns) { _now_ns += delta_ns; }
+
+	private:
+		std::int64_t _now_ns;
+	};
+
+	// Non-owning handle to any Clock, for components that are not
+	// templates. A call costs one indirect call on top of the clock. The
+	// referenced clock must outlive the handle. Default-constructed, it
+	// reads SteadyClock.
+	class ClockSource
+	{
+	public:
+		ClockSource()
+		    : _clock(nullptr)
+		    , _now(&steady_now)
+		{
+		}
+
+		template <Clock C>
+		    requires(!std::same_as<std::remove_cv_t<C>, ClockSource>)
+		ClockSource(C &clock)
+		    : _clock(&clock)
+		    , _now(&clock_now<C>)
+		{
+		}
+
+		std::int64_t now_ns() const { return _now(_clock); }
+
+	private:
+		const void *_clock;
+		std::int64_t (*_now)(const void *);
+
+		static std::int64_t steady_now(const void *)
+		{
+			return SteadyClock().now_ns();
+		}
+
+		template <Clock C>
+		static std::int64_t clock_now(const void *clock)
+		{
+			return static_cast<const C *>(clock)->now_ns();
+		}
+	};
+} // namespace timing
+
+#endif // TIMING_CLOCK_H
@@ -0,0 +1,207 @@
+#ifndef TIMING_TSC_CLOCK_H
+#define TIMING_TSC_CLOCK_H
+
+#include <cstdint>
+#include <ctime>
+#include <timing/Clock.hpp>
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+
+namespace timing
+{
+	// Monotonic nanoseconds from the time-stamp counter. A read is one
+	// rdtscp plus a multiply and a shift. No vDSO call is made.
+	//
+	// The tick rate is calibrated against CLOCK_MONOTONIC at
+	// construction. recalibrate() corrects drift. It re-measures the rate
+	// over everything since construction and slews onto CLOCK_MONOTONIC
+	// for a bounded window, after which the clock runs at the measured
+	// rate again; readings never go backwards. Call it from the thread
+	// that reads the clock, every second or so. Without an invariant TSC
+	// (or off x86) the clock reads CLOCK_MONOTONIC directly.
+	class TscClock
+	{
+	public:
+		static constexpr std::int64_t DEFAULT_CALIBRATION_NS = 20000000;
+		static constexpr std::int64_t DEFAULT_SLEW_NS = 1000000000;
+
+	public:
+		TscClock(std::int64_t calibration_ns = DEFAULT_CALIBRATION_NS)
+		    : _use_tsc(has_invariant_tsc())
+		    , _anchor_tsc(0)
+		    , _anchor_ns(0)
+		    , _base_tsc(0)
+		    , _base_ns(0)
+		    , _mult(0)
+		    , _slew_end_tsc(0)
+		    , _slew_end_ns(0)
+		    , _rate(0)
+		{
+			if (!_use_tsc)
+				return;
+			sample(_anchor_tsc, _anchor_ns);
+			std::uint64_t tsc = 0;
+			std::int64_t ns = 0;
+			do
+				sample(tsc, ns);
+			while (ns - _anchor_ns < calibration_ns);
+			_mult = rate(tsc - _anchor_tsc, ns - _anchor_ns);
+			_base_tsc = tsc;
+			_base_ns = ns;
+			_slew_end_tsc = tsc;
+			_slew_end_ns = ns;
+			_rate = _mult;
+		}
+
+		std::int64_t now_ns() const
+		{
+			if (!_use_tsc)
+				return monotonic_ns();
+			return to_ns(read_tsc());
+		}
+
+		// Re-measure the tick rate and steer the clock onto
+		// CLOCK_MONOTONIC over the next slew_ns, then run at the measured
+		// rate. A clock behind by more than half of slew_ns steps forward
+		// instead; one ahead by that much runs at half rate for twice its
+		// lead, as it may not step back.
+		void recalibrate(std::int64_t slew_ns = DEFAULT_SLEW_NS)
+		{
+			if (!_use_tsc || slew_ns <= 0)
+				return;
+			std::uint64_t tsc = 0;
+			std::int64_t ns = 0;
+			sample(tsc, ns);
+			if (tsc <= _anchor_tsc || ns <= _anchor_ns)
+				return;
+			auto predicted = to_ns(tsc);
+			auto measured = rate(tsc - _anchor_tsc, ns - _anchor_ns);
+			if (measured == 0)
+				return;
+			auto error = ns - predicted;
+			_rate = measured;
+			_base_tsc = tsc;
+			if (error > slew_ns / 2)
+			{
+				_base_ns = ns;
+				_mult = measured;
+				_slew_end_tsc = tsc;
+				_slew_end_ns = ns;
+				return;
+			}
+			auto window = error < -slew_ns / 2 ? -2 * error : slew_ns;
+			// Cover window + error nanoseconds in the ticks that window
+			// takes at the measured rate.
+			auto ticks = static_cast<std::uint64_t>(
+			    (static_cast<unsigned __int128>(window) << SHIFT) / measured);
+			_base_ns = predicted;
+			_mult = rate(ticks, window + error);
+			// Where the slew ends by its own rate, so the switch back to
+			// the measured rate is seamless.
+			_slew_end_tsc = tsc + ticks;
+			_slew_end_ns = scale(ticks, _base_ns, _mult);
+		}
+
+		bool is_tsc() const { return _use_tsc; }
+
+		// Ticks per second as currently calibrated.
+		double frequency() const
+		{
+			if (!_use_tsc)
+				return 1e9;
+			return static_cast<double>(1ull << SHIFT) * 1e9 /
+			       static_cast<double>(_rate);
+		}
+
+		static bool has_invariant_tsc()
+		{
+#if defined(__x86_64__) || defined(__i386__)
+			unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+			if (__get_cpuid_max(0x80000000, nullptr) < 0x80000007)
+				return false;
+			__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+			return (edx & (1u << 8)) != 0;
+#else
+			return false;
+#endif
+		}
+
+	private:
+		static constexpr unsigned int SHIFT = 32;
+
+		bool _use_tsc;
+		// Start of calibration; the rate is measured from here.
+		std::uint64_t _anchor_tsc;
+		std::int64_t _anchor_ns;
+		// now = _base_ns + (tsc - _base_tsc) * _mult >> SHIFT, up to the
+		// end of a slew; after it _rate takes over from _slew_end_*.
+		std::uint64_t _base_tsc;
+		std::int64_t _base_ns;
+		std::uint64_t _mult;
+		std::uint64_t _slew_end_tsc;
+		std::int64_t _slew_end_ns;
+		std::uint64_t _rate;
+
+		static std::uint64_t read_tsc()
+		{
+#if defined(__x86_64__) || defined(__i386__)
+			unsigned int aux = 0;
+			return __rdtscp(&aux);
+#else
+			return 0;
+#endif
+		}
+
+		static std::int64_t monotonic_ns()
+		{
+			return SteadyClock().now_ns();
+		}
+
+		static std::uint64_t rate(std::uint64_t ticks, std::int64_t ns)
+		{
+			if (ticks == 0 || ns <= 0)
+				return 0;
+			return static_cast<std::uint64_t>(
+			    (static_cast<unsigned __int128>(ns) << SHIFT) / ticks);
+		}
+
+		// Pair a TSC reading with CLOCK_MONOTONIC, taking the tightest of
+		// a few brackets so a preemption between the reads does not skew
+		// the calibration.
+		static void sample(std::uint64_t &tsc, std::int64_t &ns)
+		{
+			std::uint64_t best = ~0ull;
+			for (int i = 0; i < 5; ++i)
+			{
+				auto before = read_tsc();
+				auto mono = monotonic_ns();
+				auto after = read_tsc();
+				if (after - before < best)
+				{
+					best = after - before;
+					tsc = before + (after - before) / 2;
+					ns = mono;
+				}
+			}
+		}
+
+		static std::int64_t scale(std::uint64_t delta_tsc, std::int64_t base_ns,
+		                          std::uint64_t mult)
+		{
+			auto delta = static_cast<std::int64_t>(delta_tsc);
+			auto scaled = static_cast<__int128>(delta) * mult;
+			return base_ns + static_cast<std::int64_t>(scaled >> SHIFT);
+		}
+
+		std::int64_t to_ns(std::uint64_t tsc) const
+		{
+			if (static_cast<std::int64_t>(tsc - _slew_end_tsc) > 0)
+				return scale(tsc - _slew_end_tsc, _slew_end_ns, _rate);
+			return scale(tsc - _base_tsc, _base_ns, _mult);
+		}
+	};
+} // namespace timing
+
+#endif // TIMING_TSC_CLOCK_H